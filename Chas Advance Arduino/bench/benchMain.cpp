@@ -0,0 +1,244 @@
+// Host benchmarks for the Arduino firmware hot paths, built by [env:native]
+#include <Arduino.h>
+#include "arduinoLogger.h"
+#include "gatewayConnection.h"
+
+// Port of the bench's gateway, nothing listens on it unless a test runs a fake gateway there
+#define BENCH_GATEWAY_PORT 8094
+
+// Defined in main.cpp and wifiHandler.cpp on the board, the tests in test/ use them as well
+Logger logger;
+GatewayConnection gateway("127.0.0.1", BENCH_GATEWAY_PORT);
+
+// The test runner builds the sources with its own main
+#ifndef PIO_UNIT_TESTING
+#include <EEPROM.h>
+#include <vector>
+#include <algorithm>
+#include <hostBench.h>
+#include <batchCodec.h>
+#include <dhtDecoder.h>
+#include <changeFilter.h>
+#include "batchHandler.h"
+#include "jsonParser.h"
+#include "backlog.h"
+#include "dhtSampler.h"
+#include "timeProvider.h"
+#include "log.h"
+#include "dhtTraces.h"
+
+// One 30 s batch at 2 s sampling
+#define BENCH_BATCH_SIZE 15
+#define BENCH_DHT_PIN 8
+
+static SensorData lastSample;
+static void onSample(const SensorData &data) { lastSample = data; }
+
+// Runs one measurement through the sampler, replaying the trace as pin interrupts
+// on a frozen clock so the edge times are exact
+static void replayDht(DhtSampler &sampler, const uint32_t *trace, size_t count)
+{
+    hostFreezeClock(true);
+    sampler.start();
+    hostAdvanceMillis(DHT_START_LOW_MS_DHT11);
+    sampler.service();
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i > 0)
+            hostAdvanceMicros(trace[i] - trace[i - 1]);
+        hostTriggerInterrupt(BENCH_DHT_PIN);
+    }
+    sampler.service();
+    hostFreezeClock(false);
+}
+
+static void printDht(const char *name, const uint32_t *trace, size_t count, DhtType type)
+{
+    DhtReading reading;
+    DhtResult result = dhtDecode(trace, count, type, reading);
+    if (result == DHT_OK)
+        printf("  %s: %.2f C %.2f %%\n", name, batchFromFixed(reading.temperature), batchFromFixed(reading.humidity));
+    else
+        printf("  %s: %s\n", name, dhtDecodeError(result));
+}
+
+// calculateMedian before sensorStats, two vectors and two full sorts per call, kept as the baseline
+static SensorData vectorMedian(const SensorBatch &buffer)
+{
+    std::vector<float> temps;
+    std::vector<float> hums;
+
+    for (const SensorData &data : buffer)
+    {
+        if (!data.error)
+        {
+            temps.push_back(data.temperature());
+            hums.push_back(data.humidity());
+        }
+    }
+
+    auto median = [](std::vector<float> &vec) -> float
+    {
+        if (vec.empty())
+            return NAN;
+        std::sort(vec.begin(), vec.end());
+        size_t mid = vec.size() / 2;
+        return (vec.size() % 2 != 0) ? vec[mid] : (vec[mid - 1] + vec[mid]) / 2.0;
+    };
+
+    return makeSensorData(median(temps), median(hums), temps.empty() || hums.empty());
+}
+
+static SensorBatch makeBatch()
+{
+    SensorBatch batch;
+    for (int i = 0; i < BENCH_BATCH_SIZE; i++)
+        batch.push(makeSensorData(21.5f + i * 0.1f, 40.0f + (i % 4) * 0.5f, i == 7));
+    return batch;
+}
+
+int main()
+{
+    SensorBatch batch = makeBatch();
+    logger.begin();
+    Serial.mute(true);
+
+    benchHeader("Arduino serialization");
+    benchRun("createBatchJson", [&] {
+        String json = createBatchJson(batch);
+        benchKeep(json);
+    });
+    benchRun("writeBatchJson (counting sink)", [&] {
+        CountingPrint sink;
+        writeBatchJson(sink, batch);
+        benchKeep(sink);
+    });
+    benchRun("measureBatchJson", [&] {
+        size_t n = measureBatchJson(batch);
+        benchKeep(n);
+    });
+    benchRun("parseJSON (single reading)", [&] {
+        String json = parseJSON(22.5f, 41.0f, false);
+        benchKeep(json);
+    });
+    benchRun("BatchEncoder (binary batch)", [&] {
+        uint8_t frame[BACKLOG_MAX_FRAME];
+        BatchEncoder encoder(frame, sizeof(frame));
+        encoder.begin(BATCH_NODE_ID, 1);
+        for (size_t i = 0; i < batch.size(); i++)
+            encoder.addFixed(batch[i].tempCenti, batch[i].humCenti, batch[i].error);
+        size_t n = encoder.finish();
+        benchKeep(n);
+    });
+
+    benchHeader("Arduino DHT sampling");
+    DhtReading dht = {0, 0};
+    size_t dht11Edges = sizeof(dht11Trace) / sizeof(dht11Trace[0]);
+    size_t dht22Edges = sizeof(dht22Trace) / sizeof(dht22Trace[0]);
+    uint32_t lostEdge[DHT_MAX_EDGES];
+    memcpy(lostEdge, dht11Trace, sizeof(dht11Trace));
+    memmove(lostEdge + 20, lostEdge + 21, (dht11Edges - 21) * sizeof(uint32_t));
+    printDht("DHT11 trace", dht11Trace, dht11Edges, DHT_TYPE_11);
+    printDht("DHT22 trace", dht22Trace, dht22Edges, DHT_TYPE_22);
+    printDht("DHT11 trace, response edge lost", dht11Trace + 1, dht11Edges - 1, DHT_TYPE_11);
+    printDht("DHT11 trace, edge lost mid frame", lostEdge, dht11Edges - 1, DHT_TYPE_11);
+    benchRun("dhtDecode (40 bit frame)", [&] {
+        DhtResult result = dhtDecode(dht11Trace, dht11Edges, DHT_TYPE_11, dht);
+        benchKeep(result);
+    });
+
+    DhtSampler sampler(BENCH_DHT_PIN, DHT_TYPE_11);
+    sampler.begin(onSample);
+    benchRun("DhtSampler measurement (replayed trace)", [&] {
+        replayDht(sampler, dht11Trace, dht11Edges);
+    });
+    printf("  sampler: %s, %.2f C %.2f %%, %u failed\n", dhtDecodeError(sampler.lastResult()),
+           lastSample.temperature(), lastSample.humidity(), sampler.failures());
+
+    benchHeader("Arduino change filter");
+    ChangeFilter door(CHANGE_FILTER_SWINGING_DOOR, BATCH_TEMP_TOLERANCE, BATCH_HUM_TOLERANCE);
+    uint32_t second = 0;
+    benchRun("ChangeFilter::add (swinging door, slow drift)", [&] {
+        // 0.1 C and 0.5 % drift per 10 minutes with a little noise, restarting every 2 hours
+        second += 2;
+        uint32_t drift = second % 7200;
+        SeriesPoint sample = {second, (int16_t)(2150 + drift / 60 + (second & 4)), (int16_t)(4000 + drift / 12), false};
+        SeriesPoint kept[CHANGE_FILTER_MAX_OUTPUT];
+        size_t n = door.add(sample, kept);
+        benchKeep(n);
+    });
+    printf("  kept %u of %u samples\n", door.kept(), door.samples());
+
+    benchHeader("Arduino time sync");
+    // Local clock 500 ppm slow, synced every 30 s for two hours with up to 40 ms of network delay
+    TimeSync clock;
+    uint64_t gatewayEpoch = 1760000000000ULL;
+    uint64_t uptime = 0;
+    for (int i = 0; i < 240; i++)
+    {
+        clock.sync(gatewayEpoch + random(0, 41), uptime);
+        gatewayEpoch += 30000;
+        uptime += 30000 - 15;
+    }
+    // Then ten minutes without a sync, e.g. while the gateway is down
+    gatewayEpoch += 570000;
+    uptime += 570000 - 285;
+    printf("  measured drift %ld ppm (actual 500), error after 10 min without sync %ld ms\n",
+           (long)clock.driftPpm(), (long)((int64_t)clock.epochMillisAt(uptime) - (int64_t)gatewayEpoch));
+    benchRun("parseEpochMillis + TimeSync::sync", [&] {
+        uint64_t epochMs;
+        if (parseEpochMillis("1760000000.250", epochMs))
+            clock.sync(epochMs, uptime);
+        benchKeep(epochMs);
+    });
+    benchRun("TimeSync::epochMillisAt", [&] {
+        uint64_t epochMs = clock.epochMillisAt(uptime++);
+        benchKeep(epochMs);
+    });
+
+    benchHeader("Arduino logging");
+    LogEntry entry;
+    benchRun("logSensorData (queued)", [&] {
+        logSensorData(batch[0]);
+        logQueue.pop(entry);
+    });
+    benchRun("logSensorData + serviceLog (text line)", [&] {
+        logSensorData(batch[0]);
+        serviceLog();
+    });
+
+    benchHeader("Arduino statistics and storage");
+    benchRun("calculateMedian", [&] {
+        SensorData median = calculateMedian(batch);
+        benchKeep(median);
+    });
+    benchRun("calculateMedian (std::vector baseline)", [&] {
+        SensorData median = vectorMedian(batch);
+        benchKeep(median);
+    });
+    unsigned long eepromBefore = EEPROM.writes();
+    unsigned long readings = 0;
+    benchRun("Logger::logReading (+ write-back)", [&] {
+        logger.logReading(batch[readings++ % BENCH_BATCH_SIZE]);
+    });
+    logger.flush();
+    printf("  EEPROM bytes written per reading: %.2f\n",
+           (double)(EEPROM.writes() - eepromBefore) / readings);
+
+    static Backlog backlog;
+    backlog.begin();
+    uint8_t frame[64];
+    memset(frame, 0xA5, sizeof(frame));
+    benchRun("Backlog push + peek + pop", [&] {
+        backlog.push(frame, sizeof(frame));
+        uint8_t out[BACKLOG_MAX_FRAME];
+        size_t n = backlog.peek(0, out, sizeof(out));
+        backlog.pop(1);
+        benchKeep(n);
+    });
+
+    Serial.mute(false);
+    return 0;
+}
+
+#endif
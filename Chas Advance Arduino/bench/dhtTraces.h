@@ -0,0 +1,20 @@
+#ifndef DHTTRACES_H
+#define DHTTRACES_H
+
+#include <stdint.h>
+
+// Recorded sensor answers, replayed by the bench and test/test_dhtDecoder.
+// Falling edge times in us of one answer each, response edge first.
+// DHT11: 45 % / 23.4 C, DHT22: 65.2 % / -10.1 C with micros() wrapping mid frame.
+static const uint32_t dht11Trace[] = {
+    1000, 1161, 1236, 1312, 1432, 1507, 1627, 1745, 1817, 1934, 2008, 2080, 2158, 2235,
+    2310, 2387, 2467, 2542, 2620, 2692, 2767, 2888, 2964, 3083, 3201, 3321, 3403, 3475,
+    3554, 3631, 3704, 3827, 3902, 3977, 4052, 4175, 4255, 4331, 4452, 4527, 4605, 4682};
+static const uint32_t dht22Trace[] = {
+    4294965500u, 4294965663u, 4294965744u, 4294965827u, 4294965904u, 4294965985u, 4294966061u,
+    4294966139u, 4294966260u, 4294966340u, 4294966461u, 4294966535u, 4294966609u, 4294966684u,
+    4294966809u, 4294966928u, 4294967006u, 4294967085u, 4294967208u, 4294967285u, 64, 145, 216,
+    288, 364, 441, 517, 638, 759, 835, 913, 1030, 1106, 1228, 1304, 1428, 1547, 1665, 1743, 1820,
+    1934, 2058};
+
+#endif
@@ -6,36 +6,68 @@
 #include "sensorData.h"
 
 // ==== CONFIG ====
-#define LOGGER_MAX_ENTRIES 64 // total number of logs in EEPROM
-#define LOGGER_MSG_LENGTH 16  // max length of each log message (including '\0')
-#define EEPROM_SIZE (10 + LOGGER_MAX_ENTRIES * LOGGER_MSG_LENGTH)
+#define LOGGER_JOURNAL_START 0                                           // first EEPROM byte used by the journal
+#define LOGGER_RECORD_SIZE 12                                            // bytes per journal record
+#define LOGGER_MAX_ENTRIES 85                                            // records that fit in the journal
+#define LOGGER_LAYOUT_ADDRESS (LOGGER_JOURNAL_START + LOGGER_MAX_ENTRIES * LOGGER_RECORD_SIZE) // marker after the journal
+#define LOGGER_LAYOUT_MAGIC 0x4A                                         // 'J'
+#define LOGGER_LAYOUT_VERSION 1                                          // bump when LogRecord changes
+#define EEPROM_SIZE (LOGGER_LAYOUT_ADDRESS + 2)                          // 1022 bytes
+#define LOGGER_WRITE_BACK 4                                              // records collected in RAM before writing
+#define LOGGER_FLUSH_MS 300000                                           // longest a record waits in RAM
+
+// One journal record as stored in EEPROM (little endian, packed)
+struct LogRecord
+{
+    uint16_t sequence;   // increases by one per record, newest record has the highest
+    uint32_t timestamp;  // epoch seconds, seconds since boot before the first time sync
+    int16_t temperature; // hundredths of a degree
+    int16_t humidity;    // hundredths of a percent
+    uint8_t flags;       // LOG_FLAG_*
+    uint8_t crc;         // CRC-8 over the bytes before it
+} __attribute__((packed));
+
+#define LOG_FLAG_ERROR 0x01
 
 // ==== LOGGER CLASS ====
+/* Binary journal in emulated EEPROM.
+    Records are appended round-robin over the whole journal area, so wear is spread over
+    every cell instead of rewriting a head/count header. The newest record is found at
+    boot by scanning sequence numbers. New records are kept in a small RAM write-back
+    buffer and written together to reduce flash write cycles.
+    A layout marker after the journal is checked at boot. Without the current one the
+    bytes are from an older layout, they are erased once instead of being misread. */
 class Logger
 {
 public:
-    Logger() : head(0), count(0) {}
+    Logger() : head(0), count(0), stored(0), nextSequence(0), pendingCount(0) {}
 
     void begin();
-    void log(const String &msg);
+    void logReading(const SensorData &data);
     void printAll();
     String getEntry(size_t index);
+    bool getRecord(size_t index, LogRecord &record);
     size_t size() { return count; }
     void clearAll();
     void update(bool wifiConnected);
     void logMedian(const SensorData &medianData);
+    // Writes records still held in RAM to EEPROM
+    void flush();
 
     bool loggerActive;
 
 private:
-    char buffer[LOGGER_MAX_ENTRIES][LOGGER_MSG_LENGTH];
-    size_t head;
-    size_t count;
+    size_t head;   // next journal slot to write
+    size_t count;  // records visible through getEntry (in EEPROM and pending)
+    size_t stored; // valid records in EEPROM ending at head
+    uint16_t nextSequence;
+    LogRecord pending[LOGGER_WRITE_BACK];
+    size_t pendingCount;
     unsigned long timeSinceLog = 0;
+    unsigned long firstPendingTime = 0;
 
     void load();
-    void saveMeta();
-    void saveEntry(size_t index);
+    bool readSlot(size_t slot, LogRecord &record);
 };
 
 #endif
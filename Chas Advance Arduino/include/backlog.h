@@ -0,0 +1,54 @@
+#ifndef BACKLOG_H
+#define BACKLOG_H
+
+#include <Arduino.h>
+
+// ==== CONFIG ====
+#define BACKLOG_SLOT_SIZE 128                                     // bytes per slot, 1 length byte + encoded batch
+#define BACKLOG_MAX_FRAME (BACKLOG_SLOT_SIZE - 1)                 // largest encoded batch a slot holds
+#define BACKLOG_RAM_SLOTS 4                                       // newest batches kept in RAM
+#define BACKLOG_EEPROM_START 1024                                 // after the logger journal
+#define BACKLOG_EEPROM_SLOTS ((8192 - BACKLOG_EEPROM_START) / BACKLOG_SLOT_SIZE) // rest of the 8 KB EEPROM
+
+/* FIFO of encoded batches that have not been acknowledged by the ESP32 yet.
+    New batches go to RAM. When RAM is full the oldest RAM batch spills to EEPROM, and
+    when EEPROM is full too the oldest batch is dropped, so memory use is fixed.
+    EEPROM slots survive a reset and are recovered in begin(). */
+class Backlog
+{
+public:
+    Backlog() : ramHead(0), ramCount(0), eepromHead(0), eepromCount(0), droppedCount(0), rejectedCount(0) {}
+
+    void begin();
+    bool push(const uint8_t *frame, size_t length);
+
+    // Copies the index-th oldest batch into out, returns its length (0 if none)
+    size_t peek(size_t index, uint8_t *out, size_t max);
+    // Removes the n oldest batches after the ESP32 acknowledged them
+    void pop(size_t n);
+    // Removes the oldest batch after the ESP32 refused it for good
+    void reject();
+
+    size_t size() const { return ramCount + eepromCount; }
+    uint32_t dropped() const { return droppedCount; }
+    uint32_t rejected() const { return rejectedCount; }
+    // Sequence number of the newest recovered batch, -1 if EEPROM was empty
+    long lastRecoveredSequence() const { return recoveredSequence; }
+
+private:
+    int eepromAddress(size_t slot) const { return BACKLOG_EEPROM_START + slot * BACKLOG_SLOT_SIZE; }
+    bool readEeprom(size_t slot, uint8_t *out, size_t &length);
+    void spillOldestRam();
+
+    uint8_t ram[BACKLOG_RAM_SLOTS][BACKLOG_MAX_FRAME];
+    uint8_t ramLength[BACKLOG_RAM_SLOTS];
+    size_t ramHead;
+    size_t ramCount;
+    size_t eepromHead;
+    size_t eepromCount;
+    uint32_t droppedCount;
+    uint32_t rejectedCount;
+    long recoveredSequence = -1;
+};
+
+#endif
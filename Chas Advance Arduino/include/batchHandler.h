@@ -2,11 +2,48 @@
 #define BATCHHANDLER_H
 
 #include "sensorData.h"
-#include <vector>
+#include "backlog.h"
+#include <changeFilter.h>
 
+// Default node id sent in the binary batch header
+#define BATCH_NODE_ID 1
+// 1 = send compact binary batches, 0 = send JSON arrays (unsent ones wait in the backlog as binary)
+#ifndef BATCH_FORMAT_BINARY
+#define BATCH_FORMAT_BINARY 1
+#endif
+// Most backlog batches sent in one request
+#define BACKLOG_COALESCE 8
+// What the gateway takes in one request (MAX_BODY_SIZE and INGEST_MAX_READINGS in its ingest.h),
+// a bigger one is refused with 413
+#define GATEWAY_MAX_BODY 2048
+#define GATEWAY_MAX_READINGS 128
+// Change driven transmission (changeFilter.h), CHANGE_FILTER_OFF sends every sample
+#ifndef BATCH_FILTER_MODE
+#define BATCH_FILTER_MODE CHANGE_FILTER_SWINGING_DOOR
+#endif
+#define BATCH_TEMP_TOLERANCE 20 // largest reconstruction error, hundredths of a degree
+#define BATCH_HUM_TOLERANCE 100 // hundredths of a percent
+// Batch interval, stretched while the values are stable and shrunk while they change.
+// The longest interval is also the heartbeat: a batch is sent at least that often.
+#define BATCH_INTERVAL_MIN_MS 30000
+#define BATCH_INTERVAL_MAX_MS 600000
+
+// Recovers the backlog and picks the first batch sequence number
+void beginBatching(uint16_t nodeId = BATCH_NODE_ID);
 void batchSensorReadings(const SensorData &data);
-SensorData calculateMedian(std::vector<SensorData>& buffer);
-std::vector<SensorData>& getBatchBuffer();
+// Encodes the buffer as binary batches of at most maxFrame bytes and queues them in the backlog.
+// startSecond is the uptimeSeconds() the time offsets of the buffer count from.
+void queueBinaryBatches(const SensorBatch &buffer, uint32_t startSecond, size_t maxFrame = BACKLOG_MAX_FRAME);
+// Sends the oldest unacknowledged batches if the ESP32 is reachable
+void flushBacklog();
+SensorData calculateMedian(const SensorBatch &buffer);
+const SensorBatch &getBatchBuffer();
+const Backlog &getBacklog();
+// Current batch interval in ms
+uint32_t getBatchInterval();
+// Readings dropped because they didn't fit in a batch of their own
+uint32_t getDroppedReadings();
+const ChangeFilter &getChangeFilter();
 
 
 #endif
\ No newline at end of file
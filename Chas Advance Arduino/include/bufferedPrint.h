@@ -0,0 +1,73 @@
+#ifndef BUFFEREDPRINT_H
+#define BUFFEREDPRINT_H
+
+#include <Arduino.h>
+
+#define BUFFERED_PRINT_SIZE 128
+
+// Print adapter collecting small writes into a fixed chunk before passing them on.
+// Lets serializers write straight to a client without one WiFi write per byte.
+class BufferedPrint : public Print
+{
+public:
+    BufferedPrint(Print &out) : out(out), used(0), total(0) {}
+    ~BufferedPrint() { flush(); }
+
+    size_t write(uint8_t c) override
+    {
+        if (used == BUFFERED_PRINT_SIZE)
+            flush();
+        buffer[used++] = c;
+        total++;
+        return 1;
+    }
+
+    size_t write(const uint8_t *data, size_t size) override
+    {
+        for (size_t i = 0; i < size; i++)
+            write(data[i]);
+        return size;
+    }
+
+    void flush() override
+    {
+        if (used > 0)
+            out.write(buffer, used);
+        used = 0;
+    }
+
+    // Number of bytes written through this adapter
+    size_t written() const { return total; }
+
+private:
+    Print &out;
+    uint8_t buffer[BUFFERED_PRINT_SIZE];
+    size_t used;
+    size_t total;
+};
+
+// Print that only counts bytes, used to precompute Content-Length
+class CountingPrint : public Print
+{
+public:
+    CountingPrint() : total(0) {}
+
+    size_t write(uint8_t) override
+    {
+        total++;
+        return 1;
+    }
+
+    size_t write(const uint8_t *, size_t size) override
+    {
+        total += size;
+        return size;
+    }
+
+    size_t written() const { return total; }
+
+private:
+    size_t total;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef DHTSAMPLER_H
+#define DHTSAMPLER_H
+
+#include <Arduino.h>
+#include <dhtDecoder.h>
+#include "sensorData.h"
+
+// ==== CONFIG ====
+#define DHT_START_LOW_MS_DHT11 20 // start pulse, the DHT11 needs at least 18 ms
+#define DHT_START_LOW_MS_DHT22 2  // the DHT22 needs at least 1 ms
+#define DHT_CAPTURE_TIMEOUT_MS 10 // a whole frame takes about 5 ms
+#define DHT_SERVICE_PERIOD_MS 2   // how often service() should run
+
+// Receives each finished measurement, error is set if the sensor didn't answer correctly
+typedef void (*DhtSampleCallback)(const SensorData &reading);
+
+/* Interrupt driven DHT11/DHT22 reader that never blocks the main loop.
+    start() pulls the data line low, service() releases it after the start pulse and
+    attaches a falling edge interrupt that only stores micros(). Once the frame is in
+    (or the capture times out) service() decodes the edges with dhtDecoder and hands
+    the reading to the callback. Unlike the Adafruit driver interrupts stay enabled,
+    so WiFi and the scheduler keep running while the sensor sends.
+    Only one sampler can be active, the pin must support attachInterrupt(). */
+class DhtSampler
+{
+public:
+    DhtSampler(uint8_t pin, DhtType type);
+
+    // Returns false if the pin has no interrupt
+    bool begin(DhtSampleCallback callback);
+    // Starts a measurement, returns false while the previous one is still running
+    bool start();
+    // Moves the measurement on, call every DHT_SERVICE_PERIOD_MS
+    void service();
+
+    bool busy() const { return state != IDLE; }
+    DhtResult lastResult() const { return result; }
+    uint32_t failures() const { return failed; }
+
+private:
+    enum State
+    {
+        IDLE,
+        START_PULSE,
+        CAPTURING
+    };
+
+    static void onFallingEdge();
+    void finishCapture();
+
+    static DhtSampler *active; // sampler the interrupt writes to
+
+    uint8_t pin;
+    DhtType type;
+    DhtSampleCallback callback;
+    State state;
+    unsigned long stateStart;
+    DhtResult result;
+    uint32_t failed;
+    volatile uint32_t edges[DHT_MAX_EDGES];
+    volatile uint8_t edgeCount;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef GATEWAYCONNECTION_H
+#define GATEWAYCONNECTION_H
+
+#include <WiFiS3.h>
+
+// ==== CONFIG ====
+#define GATEWAY_CONNECT_TIMEOUT_MS 250   // longest a connect may block, the gateway is the access point itself
+#define GATEWAY_RESPONSE_TIMEOUT_MS 2000 // longest to wait for the whole response
+#define GATEWAY_POLL_PERIOD_MS 10        // how often service() runs while a request is open
+#define GATEWAY_BACKOFF_BASE_MS 1000     // first retry delay after a failure
+#define GATEWAY_BACKOFF_MAX_MS 60000     // retry delay cap
+#define GATEWAY_CIRCUIT_FAILURES 5       // consecutive failures before the circuit opens
+#define GATEWAY_CIRCUIT_OPEN_MS 300000   // how long an open circuit blocks attempts
+
+// Outcome of a request
+enum GatewayResult
+{
+    GATEWAY_OK,       // 2xx, the gateway took the body
+    GATEWAY_REJECTED, // 4xx, the gateway will never take this body
+    GATEWAY_BUSY,     // any other status, the same body may be sent again later
+    GATEWAY_FAILED    // no response, counts towards the backoff
+};
+
+// Called from service() once the response of a request is in
+typedef void (*GatewayDone)(GatewayResult result);
+
+/* Keeps one HTTP connection to the ESP32 gateway and reuses it between requests.
+    Nothing waits for the network: connecting and reading the response are steps of
+    a state machine that service() advances from a scheduler task, reading only what
+    has arrived. Failed attempts back off exponentially and after GATEWAY_CIRCUIT_FAILURES
+    in a row the circuit opens, so a dead access point is not hammered every loop. */
+class GatewayConnection
+{
+public:
+    GatewayConnection(const char *host, uint16_t port)
+        : host(host), port(port), state(STATE_CLOSED), failures(0), retryAt(0), lastStatus(0),
+          requestSent(0), responseReceived(0), deadline(0), done(NULL), lineLength(0), contentLength(0),
+          keepAlive(false), hasTime(false), epochMs(0), requestCount(0), failedCount(0), rejectedCount(0) {}
+
+    // Writes the request headers if the connection is open and idle. Without a
+    // connection it starts one for service() to make, and returns false like it
+    // does while a request is open, while backing off or when the circuit is open.
+    bool beginPost(const char *contentType, size_t length);
+
+    // Body of the current request is written here
+    Print &body() { return client; }
+
+    // Ends the request, done gets the result from a later service().
+    // The gateway's time in the response keeps timeSync in step.
+    void endPost(GatewayDone done);
+
+    // Advances a connect or a response by what is possible without waiting
+    void service();
+
+    // True while a connect or a request is open
+    bool busy() const { return state != STATE_CLOSED && state != STATE_OPEN; }
+    // True if a request may be attempted now
+    bool ready() const;
+    bool circuitOpen() const { return failures >= GATEWAY_CIRCUIT_FAILURES && !ready(); }
+    int status() const { return lastStatus; }
+
+    // Requests attempted, ones without a response, and ones answered with a non-2xx status
+    uint32_t requests() const { return requestCount; }
+    uint32_t failed() const { return failedCount; }
+    uint32_t rejected() const { return rejectedCount; }
+
+private:
+    enum State : uint8_t
+    {
+        STATE_CLOSED,
+        STATE_CONNECTING, // connect is made by the next service()
+        STATE_OPEN,       // connected, no request
+        STATE_WRITING,    // between beginPost() and endPost()
+        STATE_STATUS,     // waiting for the status line
+        STATE_HEADERS,
+        STATE_BODY
+    };
+
+    void connect();
+    void readResponse();
+    bool onLine();
+    void finish(GatewayResult result);
+    void onFailure();
+    void close();
+
+    const char *host;
+    uint16_t port;
+    WiFiClient client;
+    State state;
+    uint8_t failures;
+    unsigned long retryAt;
+    int lastStatus;
+    uint64_t requestSent;      // uptimeMillis() when the body was written
+    uint64_t responseReceived; // uptimeMillis() when the status line arrived
+    uint64_t deadline;         // the response is given up on at this uptimeMillis()
+    GatewayDone done;
+
+    // Response being read
+    char line[64];
+    size_t lineLength;
+    long contentLength; // body bytes left, -1 if the body ends when the gateway closes
+    bool keepAlive;
+    bool hasTime;
+    uint64_t epochMs;
+
+    uint32_t requestCount;
+    uint32_t failedCount;
+    uint32_t rejectedCount;
+};
+
+// Defined in wifiHandler.cpp where the gateway address is known
+extern GatewayConnection gateway;
+
+#endif
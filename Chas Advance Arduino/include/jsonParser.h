@@ -2,10 +2,14 @@
 #define JSONPARSER_H
 
 #include <ArduinoJson.h>
-#include <vector>
-#include "SensorData.h"
+#include "sensorData.h"
+#include "bufferedPrint.h"
 
 String parseJSON(float temperature, float humidity, bool error);
-String createBatchJson(const std::vector<SensorData> &buffer);
+String createBatchJson(const SensorBatch &buffer);
+// Stream a batch as a JSON array to any Print, returns number of bytes written
+size_t writeBatchJson(Print &out, const SensorBatch &buffer);
+// Size of the JSON array writeBatchJson would produce
+size_t measureBatchJson(const SensorBatch &buffer);
 
 #endif
@@ -2,10 +2,21 @@
 #define LOG_H
 
 #include <timeProvider.h>
+#include <logQueue.h>
+#include <logMessages.h>
 #include "arduinoLogger.h"
 
-void logEvent(String eventType, String description, String status);
-void logSensorData(float temperature, float humidity, bool error);
+// ==== CONFIG ====
+#ifndef LOG_OUTPUT_BINARY
+#define LOG_OUTPUT_BINARY 0 // 1 = binary frames for tools/logDecode instead of text lines
+#endif
+#define LOG_DRAIN_PERIOD_MS 10 // how often serviceLog() runs
+#define LOG_DRAIN_BYTES 96     // most bytes written per run, keeps below 115200 baud
+#define LOG_LINE_SIZE 96
+
+void logSensorData(const SensorData &data);
 void logStartup();
+// Writes queued log entries to Serial, run from the scheduler
+void serviceLog();
 
 #endif
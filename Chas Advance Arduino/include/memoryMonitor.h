@@ -0,0 +1,30 @@
+#ifndef MEMORYMONITOR_H
+#define MEMORYMONITOR_H
+
+#include <Arduino.h>
+#include <memTelemetry.h>
+
+// ==== CONFIG ====
+#define MEMORY_REPORT_PERIOD_MS 60000 // how often the memory report is logged
+#define MEMORY_STACK_PATTERN 0xA5     // fill of the unused stack, see memoryBegin()
+
+// Subsystems allocations are counted for (lib/memTelemetry).
+// LOG_ARD_ALLOCS and LOG_ARD_ALLOC_BYTES list them in this order.
+enum MemTag
+{
+    MEM_TAG_OTHER,  // everything outside a scope
+    MEM_TAG_BATCH,  // batching, change filter and backlog
+    MEM_TAG_WIFI,   // WiFi join and requests to the ESP32
+    MEM_TAG_LOGGER, // EEPROM journal
+    MEM_TAG_COUNT
+};
+
+// Names the tags and fills the unused stack with MEMORY_STACK_PATTERN so its
+// high-water mark can be measured. Call first in setup().
+void memoryBegin();
+// Heap and stack figures now, the heap low-water mark is kept across calls
+MemSnapshot memorySnapshot();
+// Logs heap, stack and allocations per subsystem, run from the scheduler
+void reportMemory();
+
+#endif
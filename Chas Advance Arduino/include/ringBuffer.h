@@ -0,0 +1,115 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// What push() does when the buffer is full
+enum RingOverflow
+{
+    RING_DROP_OLDEST, // overwrite the oldest item
+    RING_DROP_NEWEST, // reject the new item
+    RING_DOWNSAMPLE   // keep every second item and from then on store only every second push
+};
+
+/* Fixed-capacity ring buffer, all storage is part of the object so the size is known
+    at link time. Items are indexed and iterated from oldest (0) to newest. */
+template <typename T, size_t N, RingOverflow Policy = RING_DROP_OLDEST>
+class RingBuffer
+{
+    static_assert(N > 0, "RingBuffer needs a capacity");
+
+public:
+    class const_iterator
+    {
+    public:
+        const_iterator(const RingBuffer *ring, size_t index) : ring(ring), index(index) {}
+        const T &operator*() const { return (*ring)[index]; }
+        const T *operator->() const { return &(*ring)[index]; }
+        const_iterator &operator++()
+        {
+            index++;
+            return *this;
+        }
+        bool operator!=(const const_iterator &other) const { return index != other.index; }
+        bool operator==(const const_iterator &other) const { return index == other.index; }
+
+    private:
+        const RingBuffer *ring;
+        size_t index;
+    };
+
+    RingBuffer() { clear(); }
+
+    // Returns false if the item was not stored (dropped or skipped by downsampling)
+    bool push(const T &item)
+    {
+        if (Policy == RING_DOWNSAMPLE && ++skipped < stride)
+            return false;
+        skipped = 0;
+
+        if (count == N)
+        {
+            droppedCount++;
+            if (Policy == RING_DROP_NEWEST)
+                return false;
+            if (Policy == RING_DROP_OLDEST)
+            {
+                head = (head + 1) % N;
+                count--;
+            }
+            else
+            {
+                decimate();
+            }
+        }
+
+        items[(head + count) % N] = item;
+        count++;
+        return true;
+    }
+
+    void clear()
+    {
+        head = 0;
+        count = 0;
+        stride = 1;
+        skipped = 0;
+        droppedCount = 0;
+    }
+
+    const T &operator[](size_t index) const { return items[(head + index) % N]; }
+    T &operator[](size_t index) { return items[(head + index) % N]; }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, count); }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == N; }
+    static size_t capacity() { return N; }
+    // Items lost to the overflow policy since the last clear()
+    uint32_t dropped() const { return droppedCount; }
+
+private:
+    // Keeps every second item (the newest survives) and halves the future store rate
+    void decimate()
+    {
+        size_t kept = 0;
+        for (size_t i = (count + 1) % 2; i < count; i += 2)
+            items[kept++] = (*this)[i];
+        // Items were copied to the front in order, so the ring starts at 0 again
+        head = 0;
+        count = kept;
+        stride *= 2;
+    }
+
+    T items[N];
+    size_t head;
+    size_t count;
+    uint32_t stride;
+    uint32_t skipped;
+    uint32_t droppedCount;
+};
+
+#endif
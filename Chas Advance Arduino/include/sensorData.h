@@ -1,11 +1,13 @@
 #ifndef SENSORDATA_H
 #define SENSORDATA_H
 
-struct SensorData
-{
-    float temperature;
-    float humidity;
-    bool error;
-};
+#include <sensorRecord.h>
+#include "ringBuffer.h"
+
+// Readings collected in one batch window (15 at 2 s sampling and 30 s batches)
+#define BATCH_CAPACITY 32
+#define BATCH_OVERFLOW_POLICY RING_DROP_OLDEST
+
+typedef RingBuffer<SensorData, BATCH_CAPACITY, BATCH_OVERFLOW_POLICY> SensorBatch;
 
 #endif
\ No newline at end of file
@@ -2,6 +2,69 @@
 #define TIMEPROVIDER_H
 #include <Arduino.h>
 
+// ==== CONFIG ====
+#define TIME_SYNC_HEADER "X-Time"        // response header carrying the gateway's epoch, "seconds.millis"
+#define TIME_SYNC_EPOCH_MIN 1577836800UL // earlier epochs mean the gateway has no NTP time yet (2020-01-01)
+#define TIME_SYNC_MIN_SPAN_MS 300000     // shortest time between two syncs used to measure drift
+#define TIME_SYNC_MAX_DRIFT_PPM 20000    // larger drift is taken as a clock step, not as drift
+#define TIME_SYNC_STEP_MS 2000           // larger errors re-anchor the clock instead of being smoothed
+#define TIME_SYNC_BACK_SYNCS 3           // a clock stepped back this far is only believed after this many syncs in a row
+
+// Milliseconds since boot that keep counting when millis() wraps
+uint64_t uptimeMillis();
+uint32_t uptimeSeconds();
+
+/* Epoch clock kept in step with the gateway.
+    Every response from the ESP32 carries its NTP time. The first one anchors the
+    epoch to uptimeMillis(), later ones measure how fast the local oscillator runs
+    against it and correct for that drift, so the time stays accurate between syncs
+    and while the gateway is unreachable. Epochs before TIME_SYNC_EPOCH_MIN are
+    rejected, and so is a time more than TIME_SYNC_STEP_MS behind ours until
+    TIME_SYNC_BACK_SYNCS syncs in a row agree: batch times must not go backwards
+    because of one bad response. */
+class TimeSync
+{
+public:
+    TimeSync() : anchorUptime(0), anchorEpoch(0), referenceUptime(0), referenceEpoch(0), drift(0),
+                 driftKnown(false), syncCount(0), lastError(0), backSyncs(0), rejectedCount(0) {}
+
+    // epochMs was the gateway's time at local uptime atUptime (ms), false if it was rejected
+    bool sync(uint64_t epochMs, uint64_t atUptime);
+    bool synced() const { return syncCount > 0; }
+
+    // Epoch in ms at the given uptime, 0 until synced
+    uint64_t epochMillisAt(uint64_t uptime) const;
+    // Current epoch seconds, 0 until synced
+    uint32_t now() const { return epochMillisAt(uptimeMillis()) / 1000; }
+
+    // Measured drift of the local clock in parts per million, positive if it runs slow
+    int32_t driftPpm() const { return drift; }
+    uint32_t syncs() const { return syncCount; }
+    // Difference between the gateway's time and our prediction at the last sync, ms
+    int32_t lastSyncError() const { return lastError; }
+    uint32_t rejected() const { return rejectedCount; }
+
+private:
+    uint64_t anchorUptime; // last sync, epochMillisAt() extrapolates from here
+    uint64_t anchorEpoch;
+    uint64_t referenceUptime; // older sync the drift is measured against
+    uint64_t referenceEpoch;
+    int32_t drift;
+    bool driftKnown;
+    uint32_t syncCount;
+    int32_t lastError;
+    uint8_t backSyncs; // rejected syncs in a row with a time behind ours
+    uint32_t rejectedCount;
+};
+
+extern TimeSync timeSync;
+
+// Parses a TIME_SYNC_HEADER value, returns false if it is not a plausible epoch
+bool parseEpochMillis(const char *text, uint64_t &epochMs);
+
+// "YYYY-MM-DD HH:MM:SS" in UTC once synced, uptime before that
 String getTimestamp();
+// Same for the time at an uptimeMillis(), returns the text length
+size_t formatTimestamp(uint64_t uptime, char *out, size_t size);
 
-#endif
\ No newline at end of file
+#endif
@@ -3,12 +3,20 @@
 
 #include <WiFiS3.h>
 #include <ArduinoJson.h>
+#include "sensorData.h"
+#include "gatewayConnection.h"
 
 extern bool wifiConnecting;
 extern unsigned long wifiConnectStart;
 
 void connectToESPAccessPointAsync();
-void sendDataToESP32(String jsonString);
+// Send functions return true once the request is written, done gets the ESP32's answer later
+bool sendDataToESP32(String jsonString, GatewayDone done = NULL);
+bool sendDataToESP32(const uint8_t *body, size_t length, const char *contentType, GatewayDone done = NULL);
+// Streams the batch as JSON without building the body in RAM
+bool sendBatchJsonToESP32(const SensorBatch &buffer, GatewayDone done = NULL);
+// Reads gateway responses as they arrive, run from the scheduler
+void serviceGateway();
 void updateLogger();
 
 #endif // WIFIHANDLER_H
\ No newline at end of file
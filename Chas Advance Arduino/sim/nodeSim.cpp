@@ -0,0 +1,278 @@
+// Host load simulator: N Arduino nodes posting to the gateway simulator, built by [env:simulator].
+// Every node is a forked process running the real batching, backlog and gateway code,
+// on a clock that runs `speedup` times faster than real time.
+//   program [-n nodes] [-t seconds] [-s speedup] [-j jitterMs] [-f outagePercent]
+#include <Arduino.h>
+#include <WiFiS3.h>
+#include <sensorStats.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+#include "arduinoLogger.h"
+#include "batchHandler.h"
+#include "gatewayConnection.h"
+#include "memoryMonitor.h"
+
+#ifndef SIM_GATEWAY_HOST
+#define SIM_GATEWAY_HOST "127.0.0.1"
+#endif
+#ifndef SIM_GATEWAY_PORT
+#define SIM_GATEWAY_PORT 8080
+#endif
+#define SIM_SAMPLE_PERIOD_MS 2000   // same as the sample task in main.cpp
+#define SIM_BATCH_SAMPLES 15        // samples per 30 s batch window
+#define SIM_OUTAGE_MIN_MS 10000     // link outage length, simulated time
+#define SIM_OUTAGE_MAX_MS 120000
+#define SIM_MAX_LATENCIES 16384     // latency samples kept per node
+
+// Defined in main.cpp and wifiHandler.cpp on the board
+Logger logger;
+GatewayConnection gateway(SIM_GATEWAY_HOST, SIM_GATEWAY_PORT);
+
+struct SimConfig
+{
+    int nodes;
+    unsigned long seconds;
+    float speedup;
+    unsigned long jitterMs;
+    float outagePercent; // chance per batch window that the link goes down
+};
+
+// Sent from every node process to the parent, followed by latencyCount floats (ms)
+struct NodeResult
+{
+    uint32_t samples;
+    uint32_t requests;
+    uint32_t failed;
+    uint32_t rejected;
+    uint32_t outages;
+    uint32_t backlogLeft;
+    uint32_t backlogDropped;
+    MemTagCount allocations[MEM_TAG_COUNT];
+    uint32_t latencyCount;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static float latencies[SIM_MAX_LATENCIES];
+
+// Runs one firmware call, then the gateway task until its request is answered, and keeps
+// the duration if it sent exactly one request that got a response. Timeouts are counted
+// as failed requests instead.
+template <typename F>
+static void timed(NodeResult &result, F call)
+{
+    uint32_t before = gateway.requests();
+    uint32_t failedBefore = gateway.failed();
+    Clock::time_point start = Clock::now();
+    call();
+    while (gateway.busy())
+    {
+        delay(1);
+        gateway.service();
+    }
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    if (gateway.requests() == before + 1 && gateway.failed() == failedBefore &&
+        result.latencyCount < SIM_MAX_LATENCIES)
+        latencies[result.latencyCount++] = ms;
+}
+
+static void runNode(int index, const SimConfig &config, int out)
+{
+    randomSeed(getpid() ^ micros());
+    Serial.mute(true);
+    // The parent counts nothing, so every node starts from zero
+    memoryBegin();
+
+    NodeResult result;
+    memset(&result, 0, sizeof(result));
+    WiFi.begin("sim", "sim");
+    beginBatching(index + 1);
+
+    unsigned long stepMs = SIM_SAMPLE_PERIOD_MS / config.speedup;
+    // Spread the nodes over one batch window so they don't all post at once
+    delay(random(0, stepMs * SIM_BATCH_SAMPLES + 1));
+
+    float temperature = 20.0f + random(0, 500) / 100.0f;
+    float humidity = 35.0f + random(0, 2000) / 100.0f;
+    long outageChance = config.outagePercent * 100;
+    unsigned long outageEnd = 0;
+    Clock::time_point end = Clock::now() + std::chrono::seconds(config.seconds);
+
+    while (Clock::now() < end)
+    {
+        // Link outages, decided once per batch window
+        if (WiFi.status() == WL_CONNECTED)
+        {
+            if (result.samples % SIM_BATCH_SAMPLES == 0 && random(0, 10000) < outageChance)
+            {
+                WiFi.setStatus(WL_DISCONNECTED);
+                outageEnd = millis() + random(SIM_OUTAGE_MIN_MS, SIM_OUTAGE_MAX_MS);
+                result.outages++;
+            }
+        }
+        else if ((long)(millis() - outageEnd) >= 0)
+            WiFi.setStatus(WL_CONNECTED);
+
+        temperature += random(-10, 11) / 100.0f;
+        humidity += random(-20, 21) / 100.0f;
+        SensorData data = makeSensorData(temperature, humidity, random(0, 100) < 2);
+        result.samples++;
+
+        timed(result, [&] { batchSensorReadings(data); });
+        timed(result, [&] { flushBacklog(); });
+
+        // Sleep the scaled period plus jitter, then move the clock to the full period
+        unsigned long sleepMs = stepMs + (config.jitterMs ? random(0, config.jitterMs + 1) : 0);
+        delay(sleepMs);
+        if (sleepMs < SIM_SAMPLE_PERIOD_MS)
+            hostAdvanceMillis(SIM_SAMPLE_PERIOD_MS - sleepMs);
+    }
+
+    result.requests = gateway.requests();
+    result.failed = gateway.failed();
+    result.rejected = gateway.rejected();
+    result.backlogLeft = getBacklog().size();
+    result.backlogDropped = getBacklog().dropped();
+    for (uint8_t tag = 0; tag < MEM_TAG_COUNT; tag++)
+        result.allocations[tag] = memAllocations(tag);
+
+    if (write(out, &result, sizeof(result)) != sizeof(result) ||
+        write(out, latencies, result.latencyCount * sizeof(float)) != (ssize_t)(result.latencyCount * sizeof(float)))
+        _exit(1);
+    _exit(0);
+}
+
+static bool readAll(int fd, void *data, size_t length)
+{
+    uint8_t *p = (uint8_t *)data;
+    while (length > 0)
+    {
+        ssize_t n = read(fd, p, length);
+        if (n <= 0)
+            return false;
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    SimConfig config = {10, 60, 10.0f, 0, 0.0f};
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:s:j:f:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            config.nodes = atoi(optarg);
+            break;
+        case 't':
+            config.seconds = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            config.speedup = atof(optarg);
+            break;
+        case 'j':
+            config.jitterMs = strtoul(optarg, NULL, 10);
+            break;
+        case 'f':
+            config.outagePercent = atof(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n nodes] [-t seconds] [-s speedup] [-j jitterMs] [-f outagePercent]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (config.nodes < 1 || config.speedup < 1.0f)
+    {
+        fprintf(stderr, "need at least one node and a speedup of at least 1\n");
+        return 1;
+    }
+
+    printf("Simulating %d nodes for %lu s at %.0fx (jitter %lu ms, link outage %.1f%% per batch) against %s:%d\n",
+           config.nodes, config.seconds, config.speedup, config.jitterMs, config.outagePercent,
+           SIM_GATEWAY_HOST, SIM_GATEWAY_PORT);
+    fflush(stdout);
+
+    std::vector<int> pipes;
+    std::vector<pid_t> children;
+    for (int i = 0; i < config.nodes; i++)
+    {
+        int fds[2];
+        if (pipe(fds) != 0)
+        {
+            perror("pipe");
+            return 1;
+        }
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(fds[0]);
+            runNode(i, config, fds[1]);
+        }
+        close(fds[1]);
+        pipes.push_back(fds[0]);
+        children.push_back(pid);
+    }
+
+    NodeResult total;
+    memset(&total, 0, sizeof(total));
+    std::vector<float> all;
+    int lost = 0;
+    for (size_t i = 0; i < pipes.size(); i++)
+    {
+        NodeResult r;
+        if (readAll(pipes[i], &r, sizeof(r)))
+        {
+            size_t start = all.size();
+            all.resize(start + r.latencyCount);
+            if (!readAll(pipes[i], all.data() + start, r.latencyCount * sizeof(float)))
+                all.resize(start);
+            total.samples += r.samples;
+            total.requests += r.requests;
+            total.failed += r.failed;
+            total.rejected += r.rejected;
+            total.outages += r.outages;
+            total.backlogLeft += r.backlogLeft;
+            total.backlogDropped += r.backlogDropped;
+            for (uint8_t tag = 0; tag < MEM_TAG_COUNT; tag++)
+            {
+                total.allocations[tag].allocations += r.allocations[tag].allocations;
+                total.allocations[tag].bytes += r.allocations[tag].bytes;
+            }
+        }
+        else
+            lost++;
+        close(pipes[i]);
+        waitpid(children[i], NULL, 0);
+    }
+
+    uint32_t ok = total.requests - total.failed - total.rejected;
+    printf("requests   %u (%.1f/s), ok %u, no response %u, rejected %u\n", total.requests,
+           (float)total.requests / config.seconds, ok, total.failed, total.rejected);
+    if (!all.empty())
+    {
+        const float qs[] = {0.5f, 0.9f, 0.99f, 1.0f};
+        float values[4];
+        statsQuantiles(all.data(), all.size(), qs, values, 4);
+        printf("latency    p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms (%u answered requests)\n",
+               values[0], values[1], values[2], values[3], (unsigned)all.size());
+    }
+    printf("readings   %u sampled (%.1f/s)\n", total.samples, (float)total.samples / config.seconds);
+    printf("drops      %u batches dropped from full backlogs, %u batches still queued, %u link outages\n",
+           total.backlogDropped, total.backlogLeft, total.outages);
+    // Heap use of the firmware code per sample, the simulator's own allocations are in other.
+    // The children are done, here it only names the tags.
+    memoryBegin();
+    printf("allocs    ");
+    for (uint8_t tag = 0; tag < MEM_TAG_COUNT; tag++)
+        printf(" %s %.2f (%.0f B)", memTagName(tag), (float)total.allocations[tag].allocations / total.samples,
+               (float)total.allocations[tag].bytes / total.samples);
+    printf(" per sample\n");
+    if (lost > 0)
+        printf("%d node processes did not report\n", lost);
+    return 0;
+}
@@ -1,6 +1,28 @@
 #include "arduinoLogger.h"
 #include <EEPROM.h>
 #include "batchHandler.h"
+#include "timeProvider.h"
+#include "log.h"
+
+static_assert(sizeof(LogRecord) == LOGGER_RECORD_SIZE, "LogRecord must match LOGGER_RECORD_SIZE");
+static_assert(EEPROM_SIZE <= BACKLOG_EEPROM_START, "the journal overlaps the backlog");
+
+static uint8_t crc8(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0xFF;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc;
+}
+
+static int slotAddress(size_t slot)
+{
+    return LOGGER_JOURNAL_START + slot * LOGGER_RECORD_SIZE;
+}
 
 // Initialize the logger
 void Logger::begin()
@@ -10,31 +32,61 @@ void Logger::begin()
 
     EEPROM.begin();
 
-    // Load previously stored logs (if any) from EEPROM into RAM buffer
+    // A journal of an older layout (or a fresh board) is erased once, like the ESP32
+    // logger converts its old NVS keys
+    if (EEPROM.read(LOGGER_LAYOUT_ADDRESS) != LOGGER_LAYOUT_MAGIC || EEPROM.read(LOGGER_LAYOUT_ADDRESS + 1) != LOGGER_LAYOUT_VERSION)
+    {
+        Serial.println("Journal layout changed, erasing it");
+        clearAll();
+        EEPROM.update(LOGGER_LAYOUT_ADDRESS, LOGGER_LAYOUT_MAGIC);
+        EEPROM.update(LOGGER_LAYOUT_ADDRESS + 1, LOGGER_LAYOUT_VERSION);
+    }
+
+    // Find the newest record in the journal
     load();
 }
 
-// Add a new log entry
-void Logger::log(const String &msg)
+// Read one journal slot, returns false if it doesn't hold a valid record
+bool Logger::readSlot(size_t slot, LogRecord &record)
 {
-    Serial.println("Logging on arduino: " + msg);
-    // Copy the string safely into the fixed-size buffer for the current head slot
-    // Truncates if msg is longer than LOGGER_MSG_LENGTH - 1 to avoid overflow
-    msg.substring(0, LOGGER_MSG_LENGTH - 1).toCharArray(buffer[head], LOGGER_MSG_LENGTH);
-
-    // Save the current entry into EEPROM at the corresponding address
-    // This rotates through slots in a circular buffer to spread flash wear
-    saveEntry(head);
-
-    // Advance the head index (circular buffer logic)
-    head = (head + 1) % LOGGER_MAX_ENTRIES;
+    EEPROM.get(slotAddress(slot), record);
+    return record.crc == crc8((const uint8_t *)&record, sizeof(record) - 1);
+}
 
-    // Increase count until maximum number of entries is reached
+// Append a reading to the journal (written to EEPROM on flush)
+void Logger::logReading(const SensorData &data)
+{
+    LogRecord &record = pending[pendingCount++];
+    record.sequence = nextSequence++;
+    record.timestamp = timeSync.synced() ? timeSync.now() : uptimeSeconds();
+    record.temperature = data.tempCenti;
+    record.humidity = data.humCenti;
+    record.flags = data.error ? LOG_FLAG_ERROR : 0;
+    record.crc = crc8((const uint8_t *)&record, sizeof(record) - 1);
+
+    if (pendingCount == 1)
+        firstPendingTime = millis();
     if (count < LOGGER_MAX_ENTRIES)
         count++;
 
-    // Persist the circular buffer metadata (head and count) in EEPROM
-    saveMeta();
+    LOG_INFO(LOG_ARD_JOURNAL, record.timestamp, data.temperature(), data.humidity(), record.flags);
+
+    if (pendingCount >= LOGGER_WRITE_BACK)
+        flush();
+}
+
+// Write all pending records in one go
+void Logger::flush()
+{
+    for (size_t i = 0; i < pendingCount; i++)
+    {
+        // EEPROM.put() only writes bytes that changed
+        EEPROM.put(slotAddress(head), pending[i]);
+        head = (head + 1) % LOGGER_MAX_ENTRIES;
+        if (stored < LOGGER_MAX_ENTRIES)
+            stored++;
+    }
+    pendingCount = 0;
 }
 
 // Print all stored logs in order from oldest to newest
@@ -48,94 +100,110 @@ void Logger::printAll()
     Serial.println("---- Log end ----");
 }
 
-// Retrieve a single log entry by index (0 = oldest)
-String Logger::getEntry(size_t index)
+// Retrieve a single record by index (0 = oldest)
+bool Logger::getRecord(size_t index, LogRecord &record)
 {
     if (index >= count)
-        return ""; // Return empty string if out of bounds
+        return false;
+
+    // Pending records replace the oldest stored ones once the journal is full
+    size_t skip = stored + pendingCount - count;
+    size_t i = index + skip;
+    if (i >= stored)
+    {
+        record = pending[i - stored];
+        return true;
+    }
 
-    // Calculate real index in circular buffer
-    size_t realIndex = (head + LOGGER_MAX_ENTRIES - count + index) % LOGGER_MAX_ENTRIES;
+    size_t slot = (head + LOGGER_MAX_ENTRIES - stored + i) % LOGGER_MAX_ENTRIES;
+    return readSlot(slot, record);
+}
 
-    // Return as Arduino String for convenience
-    return String(buffer[realIndex]);
+// Retrieve a single log entry as text, "<seconds> <temp>,<hum>,<error>"
+String Logger::getEntry(size_t index)
+{
+    LogRecord record;
+    if (!getRecord(index, record))
+        return ""; // Return empty string if out of bounds or corrupt
+
+    char text[40];
+    snprintf(text, sizeof(text), "%lu %.2f,%.2f,%d", (unsigned long)record.timestamp,
+             batchFromFixed(record.temperature), batchFromFixed(record.humidity),
+             (record.flags & LOG_FLAG_ERROR) ? 1 : 0);
+    return String(text);
 }
 
 // Clear all logs from RAM and EEPROM
 void Logger::clearAll()
 {
-    for (size_t i = 0; i < LOGGER_MAX_ENTRIES; i++)
+    // 0xFF everywhere never forms a valid record
+    for (int addr = slotAddress(0); addr < slotAddress(LOGGER_MAX_ENTRIES); addr++)
     {
-        // Clear the RAM buffer
-        memset(buffer[i], 0, LOGGER_MSG_LENGTH);
-
-        // Clear the corresponding EEPROM memory
-        // EEPROM.update() only writes if value changes, reducing wear
-        for (int j = 0; j < LOGGER_MSG_LENGTH; j++)
-        {
-            EEPROM.update(10 + i * LOGGER_MSG_LENGTH + j, 0);
-        }
+        EEPROM.update(addr, 0xFF);
     }
 
     // Reset counters
     head = 0;
     count = 0;
-
-    // Persist metadata to EEPROM
-    saveMeta();
+    stored = 0;
+    pendingCount = 0;
 
     Serial.println("Logs cleared");
 }
 
-// Load logs from EEPROM into RAM buffer
+// Scan the journal for the newest record and count the history before it
 void Logger::load()
 {
-    // Read metadata: total entries and head index
-    count = EEPROM.read(0);
-    head = EEPROM.read(1);
+    LogRecord record;
+    bool found = false;
+    size_t newest = 0;
+    uint16_t newestSeq = 0;
 
-    // Sanity checks to prevent invalid values (e.g., after flash corruption or first boot)
-    if (count > LOGGER_MAX_ENTRIES)
-        count = 0;
-    if (head >= LOGGER_MAX_ENTRIES)
-        head = 0;
-
-    // Load each log entry from EEPROM into RAM buffer
-    for (size_t i = 0; i < count; i++)
+    for (size_t slot = 0; slot < LOGGER_MAX_ENTRIES; slot++)
     {
-        for (int j = 0; j < LOGGER_MSG_LENGTH; j++)
+        if (!readSlot(slot, record))
+            continue;
+        // Serial number arithmetic so the sequence can wrap around
+        if (!found || (int16_t)(record.sequence - newestSeq) > 0)
         {
-            buffer[i][j] = EEPROM.read(10 + i * LOGGER_MSG_LENGTH + j);
+            newest = slot;
+            newestSeq = record.sequence;
+            found = true;
         }
-
-        // Ensure null-termination for safety when converting to String
-        buffer[i][LOGGER_MSG_LENGTH - 1] = '\0';
     }
-}
-
-// Persist metadata (head index and count) in EEPROM
-void Logger::saveMeta()
-{
-    // Using EEPROM.update() to reduce unnecessary flash writes
-    EEPROM.update(0, count);
-    EEPROM.update(1, head);
-}
 
-// Persist a single log entry in EEPROM at the given index
-void Logger::saveEntry(size_t index)
-{
-    int addr = 10 + index * LOGGER_MSG_LENGTH; // Calculate EEPROM offset for this slot
+    head = 0;
+    stored = 0;
+    nextSequence = 0;
+    pendingCount = 0;
 
-    for (int j = 0; j < LOGGER_MSG_LENGTH; j++)
+    if (found)
     {
-        // Only write bytes that have changed to reduce flash wear
-        EEPROM.update(addr + j, buffer[index][j]);
+        head = (newest + 1) % LOGGER_MAX_ENTRIES;
+        nextSequence = newestSeq + 1;
+
+        // History is the unbroken run of records counting down from the newest
+        uint16_t expected = newestSeq;
+        while (stored < LOGGER_MAX_ENTRIES)
+        {
+            size_t slot = (newest + LOGGER_MAX_ENTRIES - stored) % LOGGER_MAX_ENTRIES;
+            if (!readSlot(slot, record) || record.sequence != expected)
+                break;
+            stored++;
+            expected--;
+        }
     }
+
+    count = stored;
 }
 
 void Logger::update(bool wifiConnected)
 {
-    std::vector<SensorData> &batch = getBatchBuffer();
+    // Don't let records wait in RAM for too long
+    if (pendingCount > 0 && millis() - firstPendingTime >= LOGGER_FLUSH_MS)
+        flush();
+
+    const SensorBatch &batch = getBatchBuffer();
     if (batch.empty())
     {
         return; // No data to log
@@ -161,16 +229,15 @@ void Logger::update(bool wifiConnected)
     }
     else if (wifiConnected && loggerActive)
     {
-        // Log once and then stop logging
+        // Log once and then stop logging, nothing should wait in RAM after that
         SensorData medianData = calculateMedian(batch);
         logMedian(medianData);
+        flush();
         loggerActive = false;
     }
 }
 
 void Logger::logMedian(const SensorData &medianData)
 {
-    log(String(medianData.temperature) + "," +
-        String(medianData.humidity) +
-        (medianData.error ? "1" : "0"));
-}
\ No newline at end of file
+    logReading(medianData);
+}
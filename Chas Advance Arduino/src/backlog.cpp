@@ -0,0 +1,151 @@
+#include "backlog.h"
+#include <EEPROM.h>
+#include <batchCodec.h>
+
+#define SLOT_FREE 0
+
+// Slot layout: byte 0 = frame length (0 or 0xFF = free), then the encoded batch.
+// The length is written last so a reset during the write leaves the slot free.
+
+bool Backlog::readEeprom(size_t slot, uint8_t *out, size_t &length)
+{
+    int addr = eepromAddress(slot);
+    length = EEPROM.read(addr);
+    if (length == SLOT_FREE || length > BACKLOG_MAX_FRAME)
+        return false;
+
+    for (size_t i = 0; i < length; i++)
+        out[i] = EEPROM.read(addr + 1 + i);
+    return true;
+}
+
+void Backlog::begin()
+{
+    uint8_t frame[BACKLOG_MAX_FRAME];
+    size_t length;
+    bool valid[BACKLOG_EEPROM_SLOTS];
+    size_t validCount = 0;
+
+    for (size_t slot = 0; slot < BACKLOG_EEPROM_SLOTS; slot++)
+    {
+        BatchDecoder decoder;
+        valid[slot] = readEeprom(slot, frame, length) && decoder.begin(frame, length) == BATCH_OK;
+        if (valid[slot])
+            validCount++;
+    }
+
+    eepromHead = 0;
+    eepromCount = 0;
+    if (validCount == 0)
+        return;
+
+    // The queue is the run of used slots following a free one
+    for (size_t slot = 0; slot < BACKLOG_EEPROM_SLOTS; slot++)
+    {
+        size_t prev = (slot + BACKLOG_EEPROM_SLOTS - 1) % BACKLOG_EEPROM_SLOTS;
+        if (valid[slot] && !valid[prev])
+        {
+            eepromHead = slot;
+            break;
+        }
+    }
+
+    while (eepromCount < BACKLOG_EEPROM_SLOTS && valid[(eepromHead + eepromCount) % BACKLOG_EEPROM_SLOTS])
+        eepromCount++;
+
+    size_t newest = (eepromHead + eepromCount - 1) % BACKLOG_EEPROM_SLOTS;
+    BatchDecoder decoder;
+    if (readEeprom(newest, frame, length) && decoder.begin(frame, length) == BATCH_OK)
+        recoveredSequence = decoder.header().sequence;
+
+    Serial.print("Recovered batches from EEPROM: ");
+    Serial.println(eepromCount);
+}
+
+void Backlog::spillOldestRam()
+{
+    if (eepromCount == BACKLOG_EEPROM_SLOTS)
+    {
+        // Everything is full, the oldest batch is lost
+        EEPROM.update(eepromAddress(eepromHead), SLOT_FREE);
+        eepromHead = (eepromHead + 1) % BACKLOG_EEPROM_SLOTS;
+        eepromCount--;
+        droppedCount++;
+    }
+
+    size_t slot = (eepromHead + eepromCount) % BACKLOG_EEPROM_SLOTS;
+    int addr = eepromAddress(slot);
+    uint8_t length = ramLength[ramHead];
+
+    EEPROM.update(addr, SLOT_FREE);
+    for (size_t i = 0; i < length; i++)
+        EEPROM.update(addr + 1 + i, ram[ramHead][i]);
+    EEPROM.update(addr, length);
+    eepromCount++;
+
+    ramHead = (ramHead + 1) % BACKLOG_RAM_SLOTS;
+    ramCount--;
+}
+
+bool Backlog::push(const uint8_t *frame, size_t length)
+{
+    if (length == 0 || length > BACKLOG_MAX_FRAME)
+        return false;
+
+    if (ramCount == BACKLOG_RAM_SLOTS)
+        spillOldestRam();
+
+    size_t slot = (ramHead + ramCount) % BACKLOG_RAM_SLOTS;
+    memcpy(ram[slot], frame, length);
+    ramLength[slot] = length;
+    ramCount++;
+    return true;
+}
+
+size_t Backlog::peek(size_t index, uint8_t *out, size_t max)
+{
+    if (index < eepromCount)
+    {
+        size_t length;
+        if (max < BACKLOG_MAX_FRAME || !readEeprom((eepromHead + index) % BACKLOG_EEPROM_SLOTS, out, length))
+            return 0;
+        return length;
+    }
+
+    index -= eepromCount;
+    if (index >= ramCount)
+        return 0;
+
+    size_t slot = (ramHead + index) % BACKLOG_RAM_SLOTS;
+    if (ramLength[slot] > max)
+        return 0;
+    memcpy(out, ram[slot], ramLength[slot]);
+    return ramLength[slot];
+}
+
+void Backlog::pop(size_t n)
+{
+    // Oldest batches are in EEPROM
+    while (n > 0 && eepromCount > 0)
+    {
+        EEPROM.update(eepromAddress(eepromHead), SLOT_FREE);
+        eepromHead = (eepromHead + 1) % BACKLOG_EEPROM_SLOTS;
+        eepromCount--;
+        n--;
+    }
+
+    while (n > 0 && ramCount > 0)
+    {
+        ramHead = (ramHead + 1) % BACKLOG_RAM_SLOTS;
+        ramCount--;
+        n--;
+    }
+}
+
+void Backlog::reject()
+{
+    if (size() == 0)
+        return;
+    pop(1);
+    rejectedCount++;
+}
@@ -2,59 +2,375 @@
 #include "jsonParser.h"
 #include "arduinoLogger.h"
 #include "wifiHandler.h"
+#include "gatewayConnection.h"
+#include "backlog.h"
+#include "timeProvider.h"
+#include "memoryMonitor.h"
+#include "log.h"
+#include <batchCodec.h>
+#include <sensorStats.h>
 
-static std::vector<SensorData> batchBuffer;
+static_assert(BATCH_FORMAT_BINARY || BATCH_FILTER_MODE == CHANGE_FILTER_OFF,
+              "JSON batches carry no times, the change filter needs the binary format");
+static_assert(BATCH_TEMP_TOLERANCE <= 255 && BATCH_HUM_TOLERANCE <= 255, "tolerances are sent as one byte");
+
+static SensorBatch batchBuffer;
 static unsigned long batchStartTime = 0;
+static uint32_t batchStartSecond = 0; // uptimeSeconds() that time offsets count from
+static uint32_t batchInterval = BATCH_INTERVAL_MIN_MS;
+static uint16_t batchSequence = 0;
+static uint16_t batchNodeId = BATCH_NODE_ID;
+static Backlog backlog;
+static size_t isolateFrames = 0; // batches of a refused request still to be sent one at a time
+// Request in flight: how many backlog batches it carries, the first one's sequence,
+// and Backlog::dropped() when it was sent
+static size_t postedFrames = 0;
+static uint16_t postedSequence = 0;
+static uint32_t postedDropped = 0;
+static ChangeFilter filter(BATCH_FILTER_MODE, BATCH_TEMP_TOLERANCE, BATCH_HUM_TOLERANCE);
+static uint32_t droppedReadings = 0; // readings too large for a batch of their own
 extern Logger logger;
 
-void batchSensorReadings(const SensorData &data)
+// Spread of the samples in the current batch window, decides the next interval
+struct WindowStats
 {
-    batchBuffer.push_back(data);
+    uint32_t count;
+    int32_t tempSum;
+    int32_t humSum;
+    int64_t tempSquares;
+    int64_t humSquares;
+};
+static WindowStats window;
 
-    if (batchStartTime == 0)
-        batchStartTime = millis();
+void beginBatching(uint16_t nodeId)
+{
+    batchNodeId = nodeId;
+    backlog.begin();
 
-    if (millis() - batchStartTime >= 30000)
+    // Continue after recovered batches, otherwise start somewhere random so the ESP32
+    // doesn't mistake batches after a reset for duplicates
+    if (backlog.lastRecoveredSequence() >= 0)
+        batchSequence = backlog.lastRecoveredSequence() + 1;
+    else
     {
-        String batchJson = createBatchJson(batchBuffer);
-        sendDataToESP32(batchJson);
-        batchBuffer.clear();
-        batchStartTime = millis();
+        randomSeed(analogRead(A0) ^ micros());
+        batchSequence = random(0, 65536);
     }
 }
 
-SensorData calculateMedian(std::vector<SensorData> &buffer)
+// Offset of a reading from the batch epoch, corrected for the drift of the local clock
+static uint16_t epochOffset(uint32_t startSecond, uint32_t epoch, uint16_t offset)
 {
-    std::vector<float> temps;
-    std::vector<float> hums;
+    return timeSync.epochMillisAt((uint64_t)(startSecond + offset) * 1000) / 1000 - epoch;
+}
+
+void queueBinaryBatches(const SensorBatch &buffer, uint32_t startSecond, size_t maxFrame)
+{
+    uint8_t frame[BACKLOG_MAX_FRAME];
+    BatchEncoder encoder(frame, min(maxFrame, sizeof(frame)));
+    uint8_t flags = 0;
+    if (BATCH_FILTER_MODE == CHANGE_FILTER_DEADBAND)
+        flags = BATCH_FLAG_TIMES | BATCH_FLAG_HOLD;
+    else if (BATCH_FILTER_MODE == CHANGE_FILTER_SWINGING_DOOR)
+        flags = BATCH_FLAG_TIMES | BATCH_FLAG_LINEAR;
 
-    for (const auto &data : buffer)
+    // Once the clock is synced every reading carries its own time: the batch
+    // start as epoch plus one small delta per reading. The epoch is fixed here,
+    // so batches waiting in the backlog keep the time they were sampled at.
+    uint32_t epoch = 0;
+    if (timeSync.synced())
     {
-        if (!data.error)
+        flags |= BATCH_FLAG_TIMES | BATCH_FLAG_EPOCH;
+        epoch = timeSync.epochMillisAt((uint64_t)startSecond * 1000) / 1000;
+    }
+
+    size_t i = 0;
+    bool repeat = false;
+    do
+    {
+        // A filtered series split over several batches repeats the last point,
+        // so every batch can be reconstructed on its own. Plain timed batches don't.
+        size_t first = i;
+        if (repeat)
+            i--;
+        encoder.begin(batchNodeId, batchSequence, flags, BATCH_TEMP_TOLERANCE, BATCH_HUM_TOLERANCE, epoch);
+        while (i < buffer.size())
+        {
+            uint16_t offset = buffer[i].timeOffset;
+            if (epoch != 0)
+                offset = epochOffset(startSecond, epoch, offset);
+            if (!encoder.addFixed(buffer[i].tempCenti, buffer[i].humCenti, buffer[i].error, offset))
+                break;
+            i++;
+        }
+
+        // No new reading fit next to the repeated point: try once more without it,
+        // and drop a reading that doesn't fit a batch on its own, so the loop always moves on
+        if (i <= first && first < buffer.size())
+        {
+            if (repeat)
+                i = first;
+            else
+            {
+                i = first + 1;
+                droppedReadings++;
+                LOG_WARN(LOG_ARD_READING_DROPPED, (uint32_t)first);
+            }
+            repeat = false;
+            continue;
+        }
+
+        size_t length = encoder.finish();
+        if (length == 0)
+            return;
+        backlog.push(frame, length);
+        batchSequence++;
+        repeat = (flags & (BATCH_FLAG_LINEAR | BATCH_FLAG_HOLD)) != 0;
+    } while (i < buffer.size());
+}
+
+// Batches stay in the backlog until the ESP32 confirmed or refused them
+static void onBacklogPosted(GatewayResult result)
+{
+    // Batches the full backlog dropped meanwhile were the oldest, i.e. ones of this request
+    size_t gone = backlog.dropped() - postedDropped;
+    size_t frames = postedFrames > gone ? postedFrames - gone : 0;
+    switch (result)
+    {
+    case GATEWAY_OK:
+        backlog.pop(frames);
+        isolateFrames = isolateFrames > postedFrames ? isolateFrames - postedFrames : 0;
+        break;
+    case GATEWAY_REJECTED:
+        // One of the batches is bad, e.g. a corrupt EEPROM slot. Sent one at a time
+        // the bad one is found and dropped, so it can't hold up the ones behind it.
+        if (postedFrames > 1)
+            isolateFrames = postedFrames;
+        else
         {
-            temps.push_back(data.temperature);
-            hums.push_back(data.humidity);
+            LOG_WARN(LOG_ARD_BATCH_REJECTED, postedSequence);
+            if (frames > 0)
+                backlog.reject();
+            if (isolateFrames > 0)
+                isolateFrames--;
         }
+        break;
+    default:
+        break;
+    }
+}
+
+void flushBacklog()
+{
+    MemScope scope(MEM_TAG_BATCH);
+    if (backlog.size() == 0 || gateway.busy() || !gateway.ready() || WiFi.status() != WL_CONNECTED)
+        return;
+
+    // Oldest batches first, as many per request as the gateway takes
+    uint8_t frame[BACKLOG_MAX_FRAME];
+    size_t limit = isolateFrames > 0 ? 1 : min((size_t)BACKLOG_COALESCE, backlog.size());
+    size_t frames = 0;
+    size_t length = BATCH_LIST_HEADER_SIZE;
+    size_t readings = 0;
+    while (frames < limit)
+    {
+        size_t frameLength = backlog.peek(frames, frame, sizeof(frame));
+        BatchDecoder decoder;
+        size_t count = decoder.begin(frame, frameLength) == BATCH_OK ? decoder.header().count : 0;
+        if (frames > 0 && (length + BATCH_LIST_LENGTH_SIZE + frameLength > GATEWAY_MAX_BODY ||
+                           readings + count > GATEWAY_MAX_READINGS))
+            break;
+        length += BATCH_LIST_LENGTH_SIZE + frameLength;
+        readings += count;
+        frames++;
+    }
+
+    if (!gateway.beginPost(BATCH_CONTENT_TYPE, length))
+        return;
+
+    // Frames are copied one at a time from RAM or EEPROM to the socket
+    Print &out = gateway.body();
+    out.write((uint8_t)BATCH_LIST_MAGIC);
+    out.write((uint8_t)frames);
+    for (size_t i = 0; i < frames; i++)
+    {
+        size_t frameLength = backlog.peek(i, frame, sizeof(frame));
+        // Read from the raw header, a refused batch may not decode
+        if (i == 0 && frameLength >= BATCH_HEADER_SIZE)
+            postedSequence = frame[6] | (frame[7] << 8);
+        out.write((uint8_t)(frameLength & 0xFF));
+        out.write((uint8_t)(frameLength >> 8));
+        out.write(frame, frameLength);
+    }
+
+    postedFrames = frames;
+    postedDropped = backlog.dropped();
+    gateway.endPost(onBacklogPosted);
+}
+
+#if !BATCH_FORMAT_BINARY
+// JSON batch in flight, the response comes from a later gateway.service()
+static SensorBatch postedJson;
+static uint32_t postedJsonStart = 0;
+
+static void onJsonPosted(GatewayResult result)
+{
+    // A refused batch would be refused again, anything else is retried from the backlog
+    if (result == GATEWAY_FAILED || result == GATEWAY_BUSY)
+        queueBinaryBatches(postedJson, postedJsonStart);
+}
+#endif
+
+// Adds a kept point to the batch, stamped with its offset into the batch window
+static void batchPoint(const SeriesPoint &point)
+{
+    SensorData data = makeSensorData(0.0f, 0.0f, point.error, point.time - batchStartSecond);
+    data.tempCenti = point.temperature;
+    data.humCenti = point.humidity;
+    batchBuffer.push(data);
+}
+
+static void addToWindow(const SensorData &data)
+{
+    if (data.error)
+        return;
+    window.count++;
+    window.tempSum += data.tempCenti;
+    window.humSum += data.humCenti;
+    window.tempSquares += (int32_t)data.tempCenti * data.tempCenti;
+    window.humSquares += (int32_t)data.humCenti * data.humCenti;
+}
+
+// Variance times count squared, avoids the division for comparing against a tolerance
+static int64_t scaledVariance(int64_t squares, int32_t sum, uint32_t count)
+{
+    return squares * count - (int64_t)sum * sum;
+}
+
+// Doubles the interval while the spread of a window stays within half the tolerance,
+// halves it once the spread exceeds the tolerance
+static void adaptInterval()
+{
+    if (BATCH_FILTER_MODE == CHANGE_FILTER_OFF || window.count < 2)
+        return;
+
+    int64_t n2 = (int64_t)window.count * window.count;
+    int64_t tempVariance = scaledVariance(window.tempSquares, window.tempSum, window.count);
+    int64_t humVariance = scaledVariance(window.humSquares, window.humSum, window.count);
+    int64_t tempLimit = (int64_t)BATCH_TEMP_TOLERANCE * BATCH_TEMP_TOLERANCE * n2;
+    int64_t humLimit = (int64_t)BATCH_HUM_TOLERANCE * BATCH_HUM_TOLERANCE * n2;
+
+    if (tempVariance * 4 <= tempLimit && humVariance * 4 <= humLimit)
+        batchInterval = min((uint32_t)BATCH_INTERVAL_MAX_MS, batchInterval * 2);
+    else if (tempVariance > tempLimit || humVariance > humLimit)
+        batchInterval = max((uint32_t)BATCH_INTERVAL_MIN_MS, batchInterval / 2);
+}
+
+// Sends the current window and starts the next one
+static void sendBatch()
+{
+    // Close the filtered series at the newest sample
+    SeriesPoint end;
+    if (filter.flush(&end))
+        batchPoint(end);
+
+    if (batchBuffer.size() > 0)
+    {
+#if BATCH_FORMAT_BINARY
+        queueBinaryBatches(batchBuffer, batchStartSecond);
+        flushBacklog();
+#else
+        // A batch the ESP32 didn't take is kept in the backlog and retried as binary,
+        // later batches queue behind it so they arrive in order
+        postedJson = batchBuffer;
+        postedJsonStart = batchStartSecond;
+        if (backlog.size() > 0 || !sendBatchJsonToESP32(postedJson, onJsonPosted))
+            queueBinaryBatches(batchBuffer, batchStartSecond);
+#endif
     }
 
-    auto median = [](std::vector<float> &vec) -> float
+    adaptInterval();
+    memset(&window, 0, sizeof(window));
+    batchBuffer.clear();
+    batchStartTime = millis();
+    batchStartSecond = uptimeSeconds();
+
+    // The next batch starts where this one ended, so it can be reconstructed on its own
+    SeriesPoint anchor;
+    if (BATCH_FILTER_MODE != CHANGE_FILTER_OFF && filter.anchor(anchor))
     {
-        if (vec.empty())
-            return NAN;
-        std::sort(vec.begin(), vec.end());
-        size_t mid = vec.size() / 2;
-        return (vec.size() % 2 != 0) ? vec[mid] : (vec[mid - 1] + vec[mid]) / 2.0;
-    };
+        batchStartSecond = anchor.time;
+        batchPoint(anchor);
+    }
+}
+
+void batchSensorReadings(const SensorData &data)
+{
+    MemScope scope(MEM_TAG_BATCH);
+    if (batchStartTime == 0)
+    {
+        batchStartTime = millis();
+        batchStartSecond = uptimeSeconds();
+    }
+
+    // Room for everything the filter can keep from this sample plus the closing point
+    if (batchBuffer.size() + CHANGE_FILTER_MAX_OUTPUT + 1 > BATCH_CAPACITY)
+        sendBatch();
 
-    SensorData medianData;
-    medianData.temperature = median(temps);
-    medianData.humidity = median(hums);
-    medianData.error = temps.empty() || hums.empty();
+    addToWindow(data);
+    SeriesPoint sample = {uptimeSeconds(), data.tempCenti, data.humCenti, (bool)data.error};
+    SeriesPoint kept[CHANGE_FILTER_MAX_OUTPUT];
+    size_t n = filter.add(sample, kept);
+    for (size_t i = 0; i < n; i++)
+        batchPoint(kept[i]);
 
-    return medianData;
+    if (millis() - batchStartTime >= batchInterval)
+        sendBatch();
 }
 
-std::vector<SensorData> &getBatchBuffer()
+SensorData calculateMedian(const SensorBatch &buffer)
+{
+    // Fixed stack storage, the batch can't hold more than BATCH_CAPACITY readings
+    int16_t temps[BATCH_CAPACITY];
+    int16_t hums[BATCH_CAPACITY];
+    size_t n = 0;
+
+    for (const SensorData &data : buffer)
+    {
+        if (!data.error)
+        {
+            temps[n] = data.tempCenti;
+            hums[n] = data.humCenti;
+            n++;
+        }
+    }
+
+    // Medians are in hundredths already, only the even-count average needs rounding
+    return makeSensorData(batchFromFixed(lroundf(statsMedian(temps, n))),
+                          batchFromFixed(lroundf(statsMedian(hums, n))), n == 0);
+}
+
+const SensorBatch &getBatchBuffer()
 {
     return batchBuffer;
-}
\ No newline at end of file
+}
+
+const Backlog &getBacklog()
+{
+    return backlog;
+}
+
+uint32_t getBatchInterval()
+{
+    return batchInterval;
+}
+
+uint32_t getDroppedReadings()
+{
+    return droppedReadings;
+}
+
+const ChangeFilter &getChangeFilter()
+{
+    return filter;
+}
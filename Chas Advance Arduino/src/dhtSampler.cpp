@@ -0,0 +1,93 @@
+#include "dhtSampler.h"
+
+DhtSampler *DhtSampler::active = NULL;
+
+DhtSampler::DhtSampler(uint8_t pin, DhtType type)
+    : pin(pin), type(type), callback(NULL), state(IDLE), stateStart(0), result(DHT_OK), failed(0), edgeCount(0)
+{
+}
+
+bool DhtSampler::begin(DhtSampleCallback cb)
+{
+    if (digitalPinToInterrupt(pin) < 0)
+        return false;
+
+    callback = cb;
+    active = this;
+    // The line idles high between measurements
+    pinMode(pin, INPUT_PULLUP);
+    return true;
+}
+
+bool DhtSampler::start()
+{
+    if (state != IDLE || active != this)
+        return false;
+
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+    stateStart = millis();
+    state = START_PULSE;
+    return true;
+}
+
+void DhtSampler::service()
+{
+    unsigned long startLow = type == DHT_TYPE_11 ? DHT_START_LOW_MS_DHT11 : DHT_START_LOW_MS_DHT22;
+
+    if (state == START_PULSE && millis() - stateStart >= startLow)
+    {
+        // Release the line and catch the answer, the sensor responds after 20-40 us
+        edgeCount = 0;
+        pinMode(pin, INPUT_PULLUP);
+        attachInterrupt(digitalPinToInterrupt(pin), onFallingEdge, FALLING);
+        stateStart = millis();
+        state = CAPTURING;
+    }
+    else if (state == CAPTURING)
+    {
+        // Response edge plus the 41 frame edges, or give up after the timeout
+        if (edgeCount > DHT_FRAME_EDGES || millis() - stateStart >= DHT_CAPTURE_TIMEOUT_MS)
+            finishCapture();
+    }
+}
+
+void DhtSampler::onFallingEdge()
+{
+    DhtSampler *self = active;
+    uint8_t n = self->edgeCount;
+    if (n < DHT_MAX_EDGES)
+    {
+        self->edges[n] = micros();
+        self->edgeCount = n + 1;
+    }
+}
+
+void DhtSampler::finishCapture()
+{
+    detachInterrupt(digitalPinToInterrupt(pin));
+    state = IDLE;
+
+    // The interrupt is detached, the buffer can be read without locking
+    uint32_t captured[DHT_MAX_EDGES];
+    size_t count = edgeCount;
+    for (size_t i = 0; i < count; i++)
+        captured[i] = edges[i];
+
+    DhtReading reading;
+    result = dhtDecode(captured, count, type, reading);
+
+    SensorData data = makeSensorData(0.0f, 0.0f, result != DHT_OK);
+    if (result == DHT_OK)
+    {
+        data.tempCenti = reading.temperature;
+        data.humCenti = reading.humidity;
+    }
+    else
+    {
+        failed++;
+    }
+
+    if (callback != NULL)
+        callback(data);
+}
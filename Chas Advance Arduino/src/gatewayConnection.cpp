@@ -0,0 +1,235 @@
+#include "gatewayConnection.h"
+#include "bufferedPrint.h"
+#include "timeProvider.h"
+#include "log.h"
+#include "memoryMonitor.h"
+
+static GatewayResult resultOf(int status)
+{
+    if (status >= 200 && status < 300)
+        return GATEWAY_OK;
+    return status >= 400 && status < 500 ? GATEWAY_REJECTED : GATEWAY_BUSY;
+}
+
+bool GatewayConnection::ready() const
+{
+    // Signed difference keeps this correct across millis() overflow
+    return failures == 0 || (long)(millis() - retryAt) >= 0;
+}
+
+// WiFiS3 has no non-blocking connect, this is the one step that waits, bounded by
+// GATEWAY_CONNECT_TIMEOUT_MS. A kept alive connection skips it.
+void GatewayConnection::connect()
+{
+    client.setConnectionTimeout(GATEWAY_CONNECT_TIMEOUT_MS);
+    if (WiFi.status() != WL_CONNECTED || !client.connect(host, port))
+    {
+        LOG_WARN(LOG_ARD_CONNECT_FAILED);
+        requestCount++;
+        failedCount++;
+        close();
+        onFailure();
+        return;
+    }
+    state = STATE_OPEN;
+}
+
+bool GatewayConnection::beginPost(const char *contentType, size_t length)
+{
+    MemScope scope(MEM_TAG_WIFI);
+    if (WiFi.status() != WL_CONNECTED || (state != STATE_CLOSED && state != STATE_OPEN))
+        return false;
+
+    // The gateway may have closed the connection while it was idle
+    if (state == STATE_OPEN && !client.connected())
+        close();
+    if (state == STATE_CLOSED)
+    {
+        if (ready())
+            state = STATE_CONNECTING;
+        return false;
+    }
+
+    requestCount++;
+    state = STATE_WRITING;
+
+    // Headers are written piece by piece instead of building one large String
+    BufferedPrint out(client);
+    out.print("POST /data HTTP/1.1\r\nHost: ");
+    out.print(host);
+    out.print("\r\nContent-Type: ");
+    out.print(contentType);
+    out.print("\r\nContent-Length: ");
+    out.print((unsigned long)length);
+    out.print("\r\nConnection: keep-alive\r\n\r\n");
+    return true;
+}
+
+void GatewayConnection::endPost(GatewayDone onDone)
+{
+    if (state != STATE_WRITING)
+        return;
+
+    done = onDone;
+    requestSent = uptimeMillis();
+    deadline = requestSent + GATEWAY_RESPONSE_TIMEOUT_MS;
+    lineLength = 0;
+    contentLength = -1;
+    keepAlive = false;
+    hasTime = false;
+    state = STATE_STATUS;
+}
+
+void GatewayConnection::service()
+{
+    MemScope scope(MEM_TAG_WIFI);
+    if (state == STATE_CONNECTING)
+        connect();
+    else if (state >= STATE_STATUS)
+        readResponse();
+}
+
+// Reads what has arrived of the status line, headers and body. The body is drained
+// so the connection can be reused.
+void GatewayConnection::readResponse()
+{
+    int n = client.available();
+    while (n-- > 0 && state >= STATE_STATUS)
+    {
+        int c = client.read();
+        if (c < 0)
+            break;
+
+        if (state == STATE_BODY)
+        {
+            if (contentLength > 0 && --contentLength == 0)
+                finish(resultOf(lastStatus));
+            continue;
+        }
+
+        if (c != '\n')
+        {
+            if (lineLength < sizeof(line) - 1)
+                line[lineLength++] = c;
+            continue;
+        }
+        if (lineLength > 0 && line[lineLength - 1] == '\r')
+            lineLength--;
+        line[lineLength] = '\0';
+        bool valid = onLine();
+        lineLength = 0;
+        if (!valid)
+        {
+            finish(GATEWAY_FAILED);
+            return;
+        }
+    }
+
+    if (state < STATE_STATUS)
+        return;
+
+    // Without a length the body ends when the gateway closes
+    if (state == STATE_BODY && contentLength < 0 && !client.connected())
+        finish(resultOf(lastStatus));
+    else if (!client.connected() || (int64_t)(uptimeMillis() - deadline) >= 0)
+        finish(GATEWAY_FAILED);
+}
+
+// Handles one complete line of the response, false if it is not HTTP
+bool GatewayConnection::onLine()
+{
+    if (state == STATE_STATUS)
+    {
+        // "HTTP/1.1 200 OK"
+        char *space = strchr(line, ' ');
+        if (strncmp(line, "HTTP/1.", 7) != 0 || space == NULL)
+            return false;
+        lastStatus = atoi(space + 1);
+        keepAlive = line[7] == '1';
+        responseReceived = uptimeMillis();
+        state = STATE_HEADERS;
+        return true;
+    }
+
+    if (lineLength > 0)
+    {
+        if (strncasecmp(line, "Content-Length:", 15) == 0)
+            contentLength = atol(line + 15);
+        else if (strncasecmp(line, "Connection:", 11) == 0)
+            keepAlive = strstr(line + 11, "close") == NULL;
+        else if (strncasecmp(line, TIME_SYNC_HEADER ":", sizeof(TIME_SYNC_HEADER)) == 0)
+            hasTime = parseEpochMillis(line + sizeof(TIME_SYNC_HEADER), epochMs);
+        return true;
+    }
+
+    // End of headers. The gateway read its clock somewhere between our request and
+    // its reply, the middle of the round trip is the best guess
+    if (hasTime && !timeSync.sync(epochMs, requestSent + (responseReceived - requestSent) / 2))
+        LOG_WARN(LOG_ARD_TIME_REJECTED, (uint32_t)(epochMs / 1000));
+
+    if (contentLength < 0)
+        keepAlive = false;
+    state = STATE_BODY;
+    if (contentLength == 0)
+        finish(resultOf(lastStatus));
+    return true;
+}
+
+void GatewayConnection::finish(GatewayResult result)
+{
+    if (result == GATEWAY_FAILED)
+    {
+        LOG_WARN(LOG_ARD_NO_RESPONSE);
+        failedCount++;
+        close();
+        onFailure();
+    }
+    else
+    {
+        // Keep the socket only if the gateway agreed to reuse it
+        if (keepAlive)
+            state = STATE_OPEN;
+        else
+            close();
+
+        if (result != GATEWAY_OK)
+        {
+            LOG_WARN(LOG_ARD_REJECTED, lastStatus);
+            rejectedCount++;
+        }
+        // The link works, a rejected body is not a reason to back off
+        failures = 0;
+    }
+
+    GatewayDone callback = done;
+    done = NULL;
+    if (callback != NULL)
+        callback(result);
+}
+
+void GatewayConnection::onFailure()
+{
+    if (failures < 255)
+        failures++;
+
+    unsigned long wait;
+    if (failures >= GATEWAY_CIRCUIT_FAILURES)
+    {
+        wait = GATEWAY_CIRCUIT_OPEN_MS;
+        LOG_ERROR(LOG_ARD_PAUSED);
+    }
+    else
+    {
+        wait = GATEWAY_BACKOFF_BASE_MS << (failures - 1);
+        if (wait > GATEWAY_BACKOFF_MAX_MS)
+            wait = GATEWAY_BACKOFF_MAX_MS;
+    }
+    retryAt = millis() + wait;
+}
+
+void GatewayConnection::close()
+{
+    if (state != STATE_CLOSED)
+        client.stop();
+    state = STATE_CLOSED;
+}
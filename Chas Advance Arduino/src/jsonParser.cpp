@@ -13,18 +13,52 @@ String parseJSON(float temperature, float humidity, bool error)
     return jsonString;
 }
 
-String createBatchJson(const std::vector<SensorData> &buffer)
+static void fillEntry(JsonDocument &doc, const SensorData &entry)
 {
-    StaticJsonDocument<1024> doc;
-    JsonArray arr = doc.to<JsonArray>();
-    for (const auto &entry : buffer)
+    doc["temperature"] = entry.temperature();
+    doc["humidity"] = entry.humidity();
+    doc["error"] = (bool)entry.error;
+}
+
+// Serialize one entry at a time so memory use doesn't grow with the batch
+size_t writeBatchJson(Print &out, const SensorBatch &buffer)
+{
+    size_t written = out.print('[');
+    for (size_t i = 0; i < buffer.size(); i++)
     {
-        JsonObject obj = arr.createNestedObject();
-        obj["temperature"] = entry.temperature;
-        obj["humidity"] = entry.humidity;
-        obj["error"] = entry.error;
+        if (i > 0)
+            written += out.print(',');
+
+        StaticJsonDocument<96> doc;
+        fillEntry(doc, buffer[i]);
+        written += serializeJson(doc, out);
     }
+    written += out.print(']');
+    return written;
+}
+
+size_t measureBatchJson(const SensorBatch &buffer)
+{
+    CountingPrint counter;
+    return writeBatchJson(counter, buffer);
+}
+
+String createBatchJson(const SensorBatch &buffer)
+{
     String output;
-    serializeJson(arr, output);
+    output.reserve(measureBatchJson(buffer));
+    output += '[';
+    for (size_t i = 0; i < buffer.size(); i++)
+    {
+        if (i > 0)
+            output += ',';
+
+        StaticJsonDocument<96> doc;
+        fillEntry(doc, buffer[i]);
+        String entry;
+        serializeJson(doc, entry);
+        output += entry;
+    }
+    output += ']';
     return output;
-}
\ No newline at end of file
+}
@@ -2,30 +2,64 @@
 
 extern Logger logger;
 
-void logEvent(String eventType, String description, String status)
+static uint32_t logClock() { return millis(); }
+LogQueue logQueue(logClock);
+
+#if !LOG_OUTPUT_BINARY
+static const LogMessage messages[] = {ARDUINO_LOG_MESSAGES(LOG_MESSAGE_ENTRY)};
+#endif
+
+void logSensorData(const SensorData &data)
 {
-    Serial.print(eventType);
-    Serial.print(" ");
-    Serial.print(description);
-    Serial.print(" ");
-    Serial.println(status);
+    if (data.error)
+        LOG_ERROR(LOG_ARD_READING_ERROR);
+    else
+        LOG_INFO(LOG_ARD_READING, data.temperature(), data.humidity());
 }
 
-void logSensorData(float temperature, float humidity, bool error)
+void logStartup()
 {
-    if (error)
-    {
-        logEvent("ERROR", "No data", "FAIL");
-    }
+    LOG_INFO(LOG_ARD_RESET);
+}
+
+// Writes one entry, returns the bytes written
+static size_t writeEntry(const LogEntry &entry)
+{
+#if LOG_OUTPUT_BINARY
+    uint8_t frame[LOG_FRAME_MAX_SIZE];
+    size_t n = logEncodeFrame(entry, frame, sizeof(frame));
+    return Serial.write(frame, n);
+#else
+    // The entry was queued a moment ago, its time is now minus its age
+    char line[LOG_LINE_SIZE];
+    size_t n = formatTimestamp(uptimeMillis() - (millis() - entry.time), line, sizeof(line));
+    n += snprintf(line + n, sizeof(line) - n, " %s ", logLevelName(entry.level));
+
+    const char *format = logMessageFormat(messages, sizeof(messages) / sizeof(messages[0]), entry.id);
+    if (format != NULL)
+        n += logFormat(line + n, sizeof(line) - n, format, entry.args, entry.argc);
     else
-    {
-        char buffer[50];
-        snprintf(buffer, sizeof(buffer), "Temp=%.1f Hum=%.1f", temperature, humidity);
-        logEvent("INFO", buffer, "OK");
-    }
+        n += snprintf(line + n, sizeof(line) - n, "message 0x%04x", entry.id);
+    n = min(n, sizeof(line) - 3);
+    line[n++] = '\r';
+    line[n++] = '\n';
+    return Serial.write((const uint8_t *)line, n);
+#endif
 }
 
-void logStartup()
+void serviceLog()
 {
-    logEvent("SYSTEM", "RESET", "OK");
-}
\ No newline at end of file
+    LogEntry entry;
+    size_t written = 0;
+    while (written < LOG_DRAIN_BYTES && logQueue.pop(entry))
+        written += writeEntry(entry);
+
+    // Lost entries are reported once the queue has room again
+    static uint32_t reported = 0;
+    uint32_t dropped = logQueue.dropped();
+    if (dropped != reported && written < LOG_DRAIN_BYTES)
+    {
+        LOG_WARN(LOG_ARD_LOG_DROPPED, dropped - reported);
+        reported = dropped;
+    }
+}
@@ -1,25 +1,51 @@
-#include <DHT.h>
 #include "MockSensor.h"
 #include "log.h"
 #include "wifiHandler.h"
 #include "jsonParser.h"
-#include <vector>
-#include "SensorData.h"
+#include "sensorData.h"
 #include "batchHandler.h"
+#include "dhtSampler.h"
+#include "memoryMonitor.h"
+#include <scheduler.h>
 
 #define DHTPIN 8
-#define DHTTYPE DHT11
+#define DHTTYPE DHT_TYPE_11
 
-DHT dht(DHTPIN, DHTTYPE);
+#define SAMPLE_PERIOD_MS 2000
+#define WIFI_PERIOD_MS 250
+#define LOGGER_PERIOD_MS 2000
+#define BACKLOG_PERIOD_MS 1000
+#define SENSOR_WARMUP_MS 3000 // the DHT answers garbage this long after power up
+
+DhtSampler dht(DHTPIN, DHTTYPE);
 Logger logger;
 
-std::vector<SensorData> batchBuffer;
+static uint32_t clockMillis() { return millis(); }
+static void idleDelay(uint32_t waitMs) { delay(waitMs); }
+Scheduler scheduler(clockMillis, idleDelay);
+
+// Starts a measurement, the reading arrives in onSample a few ms later
+void sampleSensor()
+{
+  dht.start();
+}
+
+static void serviceSensor() { dht.service(); }
+
+// Logs a finished reading and adds it to the current batch
+static void onSample(const SensorData &data)
+{
+  logSensorData(data);
+  batchSensorReadings(data);
+}
 
 void setup()
 {
+  // Before anything else uses the stack or the heap
+  memoryBegin();
   Serial.begin(115200);
-  dht.begin();
-  delay(3000);
+  if (!dht.begin(onSample))
+    Serial.println("DHT pin has no interrupt");
   Serial.println("Starting Arduino...");
 
   // Initialize logger
@@ -28,23 +54,25 @@ void setup()
 
   // Print all previous log entries
   logger.printAll();
+
+  // Unsent batches from before the reset are sent first
+  beginBatching();
+
+  // WiFi and logger run first so a sample is batched with an up to date link state
+  scheduler.add("wifi", connectToESPAccessPointAsync, WIFI_PERIOD_MS, 50);
+  scheduler.add("logger", updateLogger, LOGGER_PERIOD_MS, 500);
+  // Sampling starts once the sensor has settled, everything else runs meanwhile
+  scheduler.add("sample", sampleSensor, SAMPLE_PERIOD_MS, 50, SENSOR_WARMUP_MS);
+  scheduler.add("dht", serviceSensor, DHT_SERVICE_PERIOD_MS, 2);
+  scheduler.add("backlog", flushBacklog, BACKLOG_PERIOD_MS, 500);
+  // Connects and reads responses a step at a time, requests never wait in the loop
+  scheduler.add("gateway", serviceGateway, GATEWAY_POLL_PERIOD_MS, 20);
+  // Log lines are written in the background, a few at a time
+  scheduler.add("log", serviceLog, LOG_DRAIN_PERIOD_MS, 50);
+  scheduler.add("memory", reportMemory, MEMORY_REPORT_PERIOD_MS, 1000);
 }
 
 void loop()
 {
-  float temperature = dht.readTemperature();
-  float humidity = dht.readHumidity();
-  bool error = false;
-
-  connectToESPAccessPointAsync();
-
-  if (isnan(humidity) || isnan(temperature))
-    error = true;
-
-  updateLogger();
-  logSensorData(temperature, humidity, error);
-  SensorData data = {temperature, humidity, error};
-  batchSensorReadings(data);
-
-  delay(2000);
+  scheduler.run();
 }
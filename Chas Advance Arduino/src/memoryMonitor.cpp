@@ -0,0 +1,93 @@
+#include "memoryMonitor.h"
+#include "log.h"
+#if defined(ARDUINO_ARCH_RENESAS)
+#include <malloc.h>
+#include <unistd.h>
+#else
+#include <hostAlloc.h>
+#endif
+
+static const char *const tagNames[MEM_TAG_COUNT] = {"other", "batch", "wifi", "logger"};
+
+#if defined(ARDUINO_ARCH_RENESAS)
+// Bounds from the FSP linker script, weak so a script without them reads as 0
+extern "C" char __HeapLimit __attribute__((weak));
+extern "C" char __StackLimit __attribute__((weak));
+
+static bool stackPainted = false;
+
+// The main stack grows down to __StackLimit. Everything below the current frame is
+// unused now, whatever still holds the pattern later has never been touched.
+static void paintStack()
+{
+    if (&__StackLimit == NULL)
+        return;
+    uint8_t *bottom = (uint8_t *)&__StackLimit;
+    uint8_t *current = (uint8_t *)__builtin_frame_address(0) - 64; // keep clear of this frame
+    if (current > bottom)
+        memset(bottom, MEMORY_STACK_PATTERN, current - bottom);
+    stackPainted = true;
+}
+
+static uint32_t stackUntouched()
+{
+    const uint8_t *p = (const uint8_t *)&__StackLimit;
+    const uint8_t *current = (const uint8_t *)__builtin_frame_address(0);
+    while (p < current && *p == MEMORY_STACK_PATTERN)
+        p++;
+    return p - (const uint8_t *)&__StackLimit;
+}
+#endif
+
+void memoryBegin()
+{
+    memSetTagNames(tagNames, MEM_TAG_COUNT);
+#if defined(ARDUINO_ARCH_RENESAS)
+    paintStack();
+#else
+    hostSetAllocationHook(memCountAllocation);
+#endif
+}
+
+MemSnapshot memorySnapshot()
+{
+    MemSnapshot snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+#if defined(ARDUINO_ARCH_RENESAS)
+    // Free chunks inside the arena plus the part above the break that was never handed
+    // out. Only the latter is known to be one block, the largest block is at least that.
+    struct mallinfo info = mallinfo();
+    uint32_t untouched = 0;
+    if (&__HeapLimit != NULL)
+    {
+        char *brk = (char *)sbrk(0);
+        if (brk < &__HeapLimit)
+            untouched = &__HeapLimit - brk;
+    }
+    snapshot.heapFree = info.fordblks + untouched;
+    snapshot.heapLargest = untouched;
+    if (stackPainted)
+    {
+        snapshot.stackNames[0] = "main";
+        snapshot.stackFree[0] = stackUntouched();
+        snapshot.stackCount = 1;
+    }
+    memTrackLowWater(snapshot);
+#endif
+    return snapshot;
+}
+
+void reportMemory()
+{
+    MemSnapshot snapshot = memorySnapshot();
+    LOG_INFO(LOG_ARD_MEMORY, snapshot.heapFree, snapshot.heapLargest, snapshot.heapMinFree,
+             snapshot.stackCount > 0 ? snapshot.stackFree[0] : 0);
+
+    MemTagCount counts[MEM_TAG_COUNT];
+    for (uint8_t tag = 0; tag < MEM_TAG_COUNT; tag++)
+        counts[tag] = memAllocations(tag);
+    LOG_INFO(LOG_ARD_ALLOCS, counts[MEM_TAG_OTHER].allocations, counts[MEM_TAG_BATCH].allocations,
+             counts[MEM_TAG_WIFI].allocations, counts[MEM_TAG_LOGGER].allocations);
+    LOG_INFO(LOG_ARD_ALLOC_BYTES, counts[MEM_TAG_OTHER].bytes, counts[MEM_TAG_BATCH].bytes, counts[MEM_TAG_WIFI].bytes,
+             counts[MEM_TAG_LOGGER].bytes);
+}
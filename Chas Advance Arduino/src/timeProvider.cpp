@@ -1,13 +1,133 @@
 #include "timeProvider.h"
+#include <time.h>
+
+TimeSync timeSync;
+
+uint64_t uptimeMillis()
+{
+    // Called far more often than every 49 days, so one wrap is never missed
+    static uint64_t wraps = 0;
+    static unsigned long last = 0;
+    unsigned long now = millis();
+    if (now < last)
+        wraps += 1ULL << 32;
+    last = now;
+    return wraps + now;
+}
+
+uint32_t uptimeSeconds()
+{
+    return uptimeMillis() / 1000;
+}
+
+uint64_t TimeSync::epochMillisAt(uint64_t uptime) const
+{
+    if (!synced())
+        return 0;
+
+    // Signed, readings taken before the last sync are extrapolated backwards
+    int64_t elapsed = (int64_t)(uptime - anchorUptime);
+    return anchorEpoch + elapsed + elapsed * drift / 1000000;
+}
+
+bool TimeSync::sync(uint64_t epochMs, uint64_t atUptime)
+{
+    // A gateway without NTP time yet
+    if (epochMs < (uint64_t)TIME_SYNC_EPOCH_MIN * 1000)
+    {
+        rejectedCount++;
+        return false;
+    }
+
+    if (!synced())
+    {
+        anchorUptime = referenceUptime = atUptime;
+        anchorEpoch = referenceEpoch = epochMs;
+        syncCount = 1;
+        return true;
+    }
+
+    int64_t error = (int64_t)(epochMs - epochMillisAt(atUptime));
+    lastError = error > INT32_MAX ? INT32_MAX : error < INT32_MIN ? INT32_MIN : (int32_t)error;
+
+    // One response far behind is more likely wrong than our clock, several in a row are a real step
+    if (error < -TIME_SYNC_STEP_MS && ++backSyncs < TIME_SYNC_BACK_SYNCS)
+    {
+        rejectedCount++;
+        return false;
+    }
+    backSyncs = 0;
+    syncCount++;
+
+    // The offset is corrected at once, the gateway's time is better than our estimate
+    anchorUptime = atUptime;
+    anchorEpoch = epochMs;
+
+    if (error > TIME_SYNC_STEP_MS || error < -TIME_SYNC_STEP_MS)
+    {
+        // The gateway's clock was stepped (NTP, reboot), measure the drift from here
+        referenceUptime = atUptime;
+        referenceEpoch = epochMs;
+        return true;
+    }
+
+    // Drift is only measured over a long span, a few ms of network delay would swamp a short one
+    int64_t span = (int64_t)(atUptime - referenceUptime);
+    if (span < TIME_SYNC_MIN_SPAN_MS)
+        return true;
+
+    int64_t measured = ((int64_t)(epochMs - referenceEpoch) - span) * 1000000 / span;
+    referenceUptime = atUptime;
+    referenceEpoch = epochMs;
+    if (measured > TIME_SYNC_MAX_DRIFT_PPM || measured < -TIME_SYNC_MAX_DRIFT_PPM)
+        return true;
+
+    // Smoothed, one measurement still contains the delay jitter of both syncs
+    if (!driftKnown)
+        drift = measured;
+    else
+        drift = (drift * 3 + measured) / 4;
+    driftKnown = true;
+    return true;
+}
+
+bool parseEpochMillis(const char *text, uint64_t &epochMs)
+{
+    while (*text == ' ')
+        text++;
+
+    char *end;
+    unsigned long seconds = strtoul(text, &end, 10);
+    if (end == text || seconds < TIME_SYNC_EPOCH_MIN)
+        return false;
+
+    // Up to three fraction digits
+    uint32_t ms = 0;
+    if (*end == '.')
+    {
+        end++;
+        for (uint32_t scale = 100; scale > 0 && *end >= '0' && *end <= '9'; scale /= 10)
+            ms += (*end++ - '0') * scale;
+    }
+
+    epochMs = (uint64_t)seconds * 1000 + ms;
+    return true;
+}
+
+size_t formatTimestamp(uint64_t uptime, char *out, size_t size)
+{
+    if (!timeSync.synced())
+        return snprintf(out, size, "uptime %lu", (unsigned long)(uptime / 1000));
+
+    time_t t = timeSync.epochMillisAt(uptime) / 1000;
+    struct tm utc;
+    gmtime_r(&t, &utc);
+    return strftime(out, size, "%Y-%m-%d %H:%M:%S", &utc);
+}
 
 String getTimestamp()
 {
-    static unsigned long counter = 0;
-    counter += 1; // öka med 1 sekund per anrop
-    int hours = (counter / 3600) % 24;
-    int minutes = (counter / 60) % 60;
-    int seconds = counter % 60;
-    char buffer[20];
-    snprintf(buffer, sizeof(buffer), "2025-09-02 %02d:%02d:%02d", hours, minutes, seconds);
+    char buffer[24];
+    formatTimestamp(uptimeMillis(), buffer, sizeof(buffer));
     return String(buffer);
-}
\ No newline at end of file
+}
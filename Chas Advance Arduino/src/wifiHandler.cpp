@@ -1,14 +1,20 @@
 #include "wifiHandler.h"
 #include "arduinoLogger.h"
 #include "ARDUINOSECRETS.h"
+#include "jsonParser.h"
+#include "bufferedPrint.h"
+#include "gatewayConnection.h"
+#include "memoryMonitor.h"
 
 extern Logger logger;
+GatewayConnection gateway(host, port);
 
 bool wifiConnecting = false;
 unsigned long wifiConnectStart = 0;
 
 void connectToESPAccessPointAsync()
 {
+    MemScope scope(MEM_TAG_WIFI);
     if (!wifiConnecting && WiFi.status() != WL_CONNECTED)
     {
         WiFi.begin(ssid, password);
@@ -32,37 +38,54 @@ void connectToESPAccessPointAsync()
     }
 }
 
-void sendDataToESP32(String jsonString)
+bool sendDataToESP32(String jsonString, GatewayDone done)
 {
+    return sendDataToESP32((const uint8_t *)jsonString.c_str(), jsonString.length(), "application/json", done);
+}
 
+bool sendDataToESP32(const uint8_t *body, size_t length, const char *contentType, GatewayDone done)
+{
     if (WiFi.status() != WL_CONNECTED)
     {
         Serial.println("WiFi not connected, reconnecting...");
         connectToESPAccessPointAsync();
     }
 
-    WiFiClient client;
+    if (!gateway.beginPost(contentType, length))
+        return false;
+
+    gateway.body().write(body, length);
+    gateway.endPost(done);
+    return true;
+}
 
-    if (!client.connect(host, port))
+bool sendBatchJsonToESP32(const SensorBatch &buffer, GatewayDone done)
+{
+    if (WiFi.status() != WL_CONNECTED)
     {
-        Serial.println("Connection to ESP32 failed");
-        delay(2000);
-        return;
+        Serial.println("WiFi not connected, reconnecting...");
+        connectToESPAccessPointAsync();
     }
 
-    // Send HTTP POST request to the esp
-    client.print(String("POST /data HTTP/1.1\r\n") +
-                 "Host: " + host + "\r\n" +
-                 "Content-Type: application/json\r\n" +
-                 "Content-Length: " + jsonString.length() + "\r\n" +
-                 "Connection: close\r\n\r\n" +
-                 jsonString);
+    if (!gateway.beginPost("application/json", measureBatchJson(buffer)))
+        return false;
 
-    client.stop();
+    // Entries go straight to the socket in BUFFERED_PRINT_SIZE chunks
+    BufferedPrint out(gateway.body());
+    writeBatchJson(out, buffer);
+    out.flush();
+    gateway.endPost(done);
+    return true;
+}
+
+void serviceGateway()
+{
+    gateway.service();
 }
 
 void updateLogger()
 {
+    MemScope scope(MEM_TAG_LOGGER);
     bool connected = (WiFi.status() == WL_CONNECTED);
     logger.update(connected);
 }
\ No newline at end of file
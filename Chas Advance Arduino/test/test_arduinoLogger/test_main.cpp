@@ -0,0 +1,171 @@
+// EEPROM journal of the offline logger: pio test -e native -f test_arduinoLogger
+#include <unity.h>
+#include <EEPROM.h>
+#include "arduinoLogger.h"
+
+void setUp()
+{
+    Serial.mute(true);
+    EEPROM.erase();
+}
+
+void tearDown()
+{
+    Serial.mute(false);
+}
+
+static SensorData reading(int i)
+{
+    return makeSensorData(20.0f + i * 0.01f, 40.0f + i * 0.02f, false);
+}
+
+void test_records_read_back()
+{
+    Logger log;
+    log.begin();
+    log.logReading(makeSensorData(21.25f, 40.5f, false));
+    log.logReading(makeSensorData(0.0f, 0.0f, true));
+    TEST_ASSERT_EQUAL(2, log.size());
+
+    LogRecord record;
+    TEST_ASSERT_TRUE(log.getRecord(0, record));
+    TEST_ASSERT_EQUAL_INT16(2125, record.temperature);
+    TEST_ASSERT_EQUAL_INT16(4050, record.humidity);
+    TEST_ASSERT_EQUAL_UINT8(0, record.flags);
+    TEST_ASSERT_TRUE(log.getRecord(1, record));
+    TEST_ASSERT_EQUAL_UINT8(LOG_FLAG_ERROR, record.flags);
+    TEST_ASSERT_FALSE(log.getRecord(2, record));
+    TEST_ASSERT_TRUE(log.getEntry(0).indexOf(" 21.25,40.50,0") > 0);
+}
+
+void test_records_written_back_together()
+{
+    Logger log;
+    log.begin();
+    unsigned long before = EEPROM.writes();
+    for (int i = 0; i < LOGGER_WRITE_BACK - 1; i++)
+        log.logReading(reading(i));
+    TEST_ASSERT_EQUAL(before, EEPROM.writes());
+
+    log.logReading(reading(LOGGER_WRITE_BACK));
+    TEST_ASSERT_GREATER_THAN(before, EEPROM.writes());
+}
+
+void test_journal_survives_restart()
+{
+    {
+        Logger log;
+        log.begin();
+        for (int i = 0; i < 10; i++)
+            log.logReading(reading(i));
+        log.flush();
+    }
+
+    Logger restarted;
+    restarted.begin();
+    TEST_ASSERT_EQUAL(10, restarted.size());
+    LogRecord record;
+    TEST_ASSERT_TRUE(restarted.getRecord(9, record));
+    TEST_ASSERT_EQUAL_INT16(2009, record.temperature);
+
+    // Sequence numbers continue after the newest record
+    restarted.logReading(reading(10));
+    restarted.flush();
+    TEST_ASSERT_TRUE(restarted.getRecord(10, record));
+    TEST_ASSERT_EQUAL_UINT16(10, record.sequence);
+}
+
+void test_journal_wraps_keeping_newest()
+{
+    Logger log;
+    log.begin();
+    const int total = LOGGER_MAX_ENTRIES * 2 + 3;
+    for (int i = 0; i < total; i++)
+        log.logReading(reading(i));
+    log.flush();
+    TEST_ASSERT_EQUAL(LOGGER_MAX_ENTRIES, log.size());
+
+    Logger restarted;
+    restarted.begin();
+    TEST_ASSERT_EQUAL(LOGGER_MAX_ENTRIES, restarted.size());
+    LogRecord record;
+    TEST_ASSERT_TRUE(restarted.getRecord(0, record));
+    TEST_ASSERT_EQUAL_UINT16(total - LOGGER_MAX_ENTRIES, record.sequence);
+    TEST_ASSERT_TRUE(restarted.getRecord(LOGGER_MAX_ENTRIES - 1, record));
+    TEST_ASSERT_EQUAL_UINT16(total - 1, record.sequence);
+}
+
+void test_corrupt_record_ends_history()
+{
+    Logger log;
+    log.begin();
+    for (int i = 0; i < 8; i++)
+        log.logReading(reading(i));
+    log.flush();
+
+    // A torn write in slot 3: the records before it can't be trusted as one history
+    int address = LOGGER_JOURNAL_START + 3 * LOGGER_RECORD_SIZE + 4;
+    EEPROM.write(address, EEPROM.read(address) ^ 0x5A);
+
+    Logger restarted;
+    restarted.begin();
+    TEST_ASSERT_EQUAL(4, restarted.size());
+    LogRecord record;
+    TEST_ASSERT_TRUE(restarted.getRecord(0, record));
+    TEST_ASSERT_EQUAL_UINT16(4, record.sequence);
+}
+
+void test_clear_all()
+{
+    Logger log;
+    log.begin();
+    for (int i = 0; i < 6; i++)
+        log.logReading(reading(i));
+    log.clearAll();
+    TEST_ASSERT_EQUAL(0, log.size());
+
+    Logger restarted;
+    restarted.begin();
+    TEST_ASSERT_EQUAL(0, restarted.size());
+}
+
+void test_old_layout_erased_once()
+{
+    // Bytes of an older journal layout that happen to pass the CRC would show up as records
+    {
+        Logger log;
+        log.begin();
+        for (int i = 0; i < 5; i++)
+            log.logReading(reading(i));
+        log.flush();
+    }
+    EEPROM.write(LOGGER_LAYOUT_ADDRESS + 1, LOGGER_LAYOUT_VERSION + 1);
+
+    Logger migrated;
+    migrated.begin();
+    TEST_ASSERT_EQUAL(0, migrated.size());
+    TEST_ASSERT_EQUAL_UINT8(LOGGER_LAYOUT_MAGIC, EEPROM.read(LOGGER_LAYOUT_ADDRESS));
+    TEST_ASSERT_EQUAL_UINT8(LOGGER_LAYOUT_VERSION, EEPROM.read(LOGGER_LAYOUT_ADDRESS + 1));
+    migrated.logReading(reading(7));
+    migrated.flush();
+
+    // Only once: the next boot keeps the new records and writes nothing
+    unsigned long before = EEPROM.writes();
+    Logger restarted;
+    restarted.begin();
+    TEST_ASSERT_EQUAL(before, EEPROM.writes());
+    TEST_ASSERT_EQUAL(1, restarted.size());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_records_read_back);
+    RUN_TEST(test_records_written_back_together);
+    RUN_TEST(test_journal_survives_restart);
+    RUN_TEST(test_journal_wraps_keeping_newest);
+    RUN_TEST(test_corrupt_record_ends_history);
+    RUN_TEST(test_clear_all);
+    RUN_TEST(test_old_layout_erased_once);
+    return UNITY_END();
+}
@@ -0,0 +1,336 @@
+// Batch median of the node and the backlog against a fake gateway: pio test -e native -f test_batchHandler
+#include <unity.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include <EEPROM.h>
+#include <WiFiS3.h>
+#include <batchCodec.h>
+#include "batchHandler.h"
+#include "gatewayConnection.h"
+
+#define TEST_GATEWAY_PORT 8094 // BENCH_GATEWAY_PORT, where gateway in bench/benchMain.cpp posts to
+
+// What the fake gateway saw
+static std::atomic<bool> gatewayStop;
+static std::atomic<uint32_t> acceptedFrames;
+static std::atomic<uint32_t> acceptedReadings;
+static std::atomic<uint32_t> refusedRequests;
+static std::atomic<uint32_t> mostReadings;
+
+// Answers like the ESP32's ingest: 413 above its limits, 400 for a batch that doesn't decode
+static int judge(const uint8_t *body, size_t length)
+{
+    if (length > GATEWAY_MAX_BODY)
+        return 413;
+    if (length < BATCH_LIST_HEADER_SIZE || body[0] != BATCH_LIST_MAGIC)
+        return 400;
+
+    size_t pos = BATCH_LIST_HEADER_SIZE;
+    uint32_t readings = 0;
+    for (uint8_t i = 0; i < body[1]; i++)
+    {
+        if (pos + BATCH_LIST_LENGTH_SIZE > length)
+            return 400;
+        size_t frameLength = body[pos] | (body[pos + 1] << 8);
+        pos += BATCH_LIST_LENGTH_SIZE;
+        BatchDecoder decoder;
+        if (pos + frameLength > length || decoder.begin(body + pos, frameLength) != BATCH_OK)
+            return 400;
+        readings += decoder.header().count;
+        pos += frameLength;
+    }
+    if (readings > GATEWAY_MAX_READINGS)
+        return 413;
+
+    if (readings > mostReadings)
+        mostReadings = readings;
+    acceptedFrames += body[1];
+    acceptedReadings += readings;
+    return 200;
+}
+
+// Serves keep-alive connections until gatewayStop is set
+static void fakeGateway(int listener)
+{
+    static uint8_t request[GATEWAY_MAX_BODY * 2];
+    while (!gatewayStop)
+    {
+        pollfd waiting = {listener, POLLIN, 0};
+        if (poll(&waiting, 1, 20) <= 0)
+            continue;
+        int fd = accept(listener, NULL, NULL);
+        size_t received = 0;
+        while (!gatewayStop)
+        {
+            pollfd ready = {fd, POLLIN, 0};
+            if (poll(&ready, 1, 20) <= 0)
+                continue;
+            ssize_t r = recv(fd, request + received, sizeof(request) - 1 - received, 0);
+            if (r <= 0)
+                break;
+            received += r;
+            request[received] = '\0';
+
+            const char *end = strstr((const char *)request, "\r\n\r\n");
+            const char *header = strstr((const char *)request, "Content-Length: ");
+            if (end == NULL || header == NULL)
+                continue;
+            size_t headerLength = end + 4 - (const char *)request;
+            size_t length = atoi(header + 16);
+            if (received < headerLength + length)
+                continue;
+
+            char reply[64];
+            snprintf(reply, sizeof(reply), "HTTP/1.1 %d X\r\nContent-Length: 0\r\n\r\n",
+                     judge(request + headerLength, length));
+            if (reply[9] != '2')
+                refusedRequests++;
+            send(fd, reply, strlen(reply), MSG_NOSIGNAL);
+            memmove(request, request + headerLength + length, received - headerLength - length);
+            received -= headerLength + length;
+        }
+        ::close(fd);
+    }
+}
+
+static int listenOnGatewayPort()
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(TEST_GATEWAY_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST_ASSERT_EQUAL(0, bind(fd, (sockaddr *)&addr, sizeof(addr)));
+    TEST_ASSERT_EQUAL(0, listen(fd, 4));
+    return fd;
+}
+
+// Samples a zigzag far outside the tolerance while the link is down, so the filter keeps
+// every point and each backlog batch is as full as a slot allows
+static size_t fillBacklog(size_t batches)
+{
+    WiFi.setStatus(WL_DISCONNECTED);
+    for (int i = 0; getBacklog().size() < batches; i++)
+    {
+        hostAdvanceMillis(1000);
+        SensorData data = makeSensorData(0.0f, 0.0f, false);
+        data.tempCenti = i % 2 ? 2060 : 2000;
+        data.humCenti = 4000;
+        batchSensorReadings(data);
+    }
+    WiFi.setStatus(WL_CONNECTED);
+    return getBacklog().size();
+}
+
+// Flushes until the backlog is empty or stops shrinking, returns how many flushes it took
+static int drain()
+{
+    int listener = listenOnGatewayPort();
+    gatewayStop = false;
+    std::thread server(fakeGateway, listener);
+
+    // The backlog and gateway tasks of the scheduler, the gateway task running until the response is in
+    int flushes = 0;
+    while (getBacklog().size() > 0 && flushes < 100)
+    {
+        flushBacklog();
+        flushes++;
+        while (gateway.busy())
+        {
+            delay(1);
+            gateway.service();
+        }
+    }
+
+    gatewayStop = true;
+    server.join();
+    ::close(listener);
+    return flushes;
+}
+
+void setUp()
+{
+    acceptedFrames = 0;
+    acceptedReadings = 0;
+    refusedRequests = 0;
+    mostReadings = 0;
+}
+
+void tearDown() {}
+
+void test_median_odd_count()
+{
+    SensorBatch batch;
+    float temps[] = {22.0f, 20.5f, 21.0f};
+    float hums[] = {41.0f, 45.0f, 40.0f};
+    for (int i = 0; i < 3; i++)
+        batch.push(makeSensorData(temps[i], hums[i], false));
+
+    SensorData median = calculateMedian(batch);
+    TEST_ASSERT_FALSE(median.error);
+    TEST_ASSERT_EQUAL_INT16(2100, median.tempCenti);
+    TEST_ASSERT_EQUAL_INT16(4100, median.humCenti);
+}
+
+void test_median_even_count_and_errors()
+{
+    SensorBatch batch;
+    batch.push(makeSensorData(20.0f, 40.0f, false));
+    batch.push(makeSensorData(99.0f, 99.0f, true));
+    batch.push(makeSensorData(21.0f, 41.0f, false));
+
+    // Failed readings are left out, the two valid ones are averaged
+    SensorData median = calculateMedian(batch);
+    TEST_ASSERT_EQUAL_INT16(2050, median.tempCenti);
+    TEST_ASSERT_EQUAL_INT16(4050, median.humCenti);
+}
+
+void test_median_without_valid_readings_is_error()
+{
+    SensorBatch batch;
+    TEST_ASSERT_TRUE(calculateMedian(batch).error);
+    batch.push(makeSensorData(NAN, 40.0f, false));
+    TEST_ASSERT_TRUE(calculateMedian(batch).error);
+}
+
+void test_median_after_ring_overflow()
+{
+    // The oldest readings are dropped, only the last BATCH_CAPACITY count
+    SensorBatch batch;
+    for (int i = 0; i < BATCH_CAPACITY + 10; i++)
+        batch.push(makeSensorData(i < 10 ? -40.0f : 20.0f + (i - 10) * 0.1f, 50.0f, false));
+    TEST_ASSERT_EQUAL(BATCH_CAPACITY, batch.size());
+
+    // 20.0 .. 23.1, middle two are 21.5 and 21.6
+    SensorData median = calculateMedian(batch);
+    TEST_ASSERT_EQUAL_INT16(2155, median.tempCenti);
+}
+
+void test_backlog_of_full_batches_drains()
+{
+    beginBatching();
+    size_t batches = fillBacklog(24);
+    TEST_ASSERT_TRUE(batches > BACKLOG_COALESCE);
+
+    // Eight full batches are more readings than the gateway takes in one request
+    int flushes = drain();
+    TEST_ASSERT_EQUAL(0, getBacklog().size());
+    TEST_ASSERT_EQUAL_UINT32(batches, acceptedFrames);
+    TEST_ASSERT_EQUAL_UINT32(0, refusedRequests);
+    TEST_ASSERT_TRUE(mostReadings <= GATEWAY_MAX_READINGS);
+    TEST_ASSERT_TRUE(mostReadings > GATEWAY_MAX_READINGS / 2);
+    TEST_ASSERT_TRUE(flushes < (int)batches);
+    TEST_ASSERT_EQUAL_UINT32(0, getBacklog().rejected());
+}
+
+void test_refused_batch_is_dropped()
+{
+    beginBatching();
+    size_t batches = fillBacklog(24);
+
+    // A bit rots in one of the EEPROM slots after the backlog was recovered
+    int slot = BACKLOG_EEPROM_START;
+    while (EEPROM.read(slot) == 0 || EEPROM.read(slot) > BACKLOG_MAX_FRAME)
+        slot += BACKLOG_SLOT_SIZE;
+    EEPROM.write(slot + 1 + BATCH_HEADER_SIZE, EEPROM.read(slot + 1 + BATCH_HEADER_SIZE) ^ 0x01);
+
+    // The request with the bad batch is refused, sent one by one only that batch is lost
+    drain();
+    TEST_ASSERT_EQUAL(0, getBacklog().size());
+    TEST_ASSERT_EQUAL_UINT32(1, getBacklog().rejected());
+    TEST_ASSERT_EQUAL_UINT32(batches - 1, acceptedFrames);
+    TEST_ASSERT_EQUAL_UINT32(2, refusedRequests);
+}
+
+// A zigzag series like fillBacklog() samples, every reading encodes to the same size
+static void zigzagBatch(SensorBatch &batch, size_t count)
+{
+    batch.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+        SensorData data = makeSensorData(0.0f, 0.0f, false, i + 1);
+        data.tempCenti = i % 2 ? 2060 : 2000;
+        data.humCenti = 4000;
+        batch.push(data);
+    }
+}
+
+void test_reading_that_does_not_fit_is_dropped()
+{
+    beginBatching();
+    static SensorBatch batch;
+    zigzagBatch(batch, 10);
+
+    // Exactly one reading fits a frame, none next to the repeated last point of the one before
+    uint8_t frame[BACKLOG_MAX_FRAME];
+    BatchEncoder encoder(frame, sizeof(frame));
+    encoder.begin(BATCH_NODE_ID, 0, BATCH_FLAG_TIMES | BATCH_FLAG_LINEAR, BATCH_TEMP_TOLERANCE, BATCH_HUM_TOLERANCE);
+    encoder.addFixed(2060, 4000, false, 10);
+    size_t oneReading = encoder.finish();
+    TEST_ASSERT_TRUE(oneReading > 0);
+
+    // Every reading goes in a batch of its own, none is lost
+    size_t queued = getBacklog().size();
+    uint32_t dropped = getDroppedReadings();
+    queueBinaryBatches(batch, 0, oneReading);
+    TEST_ASSERT_EQUAL(queued + 10, getBacklog().size());
+    TEST_ASSERT_EQUAL_UINT32(dropped, getDroppedReadings());
+    drain();
+    TEST_ASSERT_EQUAL(0, getBacklog().size());
+    TEST_ASSERT_EQUAL_UINT32(queued + 10, acceptedFrames);
+    TEST_ASSERT_EQUAL_UINT32(10, acceptedReadings);
+
+    // A frame too small for one reading drops and counts every reading instead of spinning
+    queueBinaryBatches(batch, 0, oneReading - 1);
+    TEST_ASSERT_EQUAL(0, getBacklog().size());
+    TEST_ASSERT_EQUAL_UINT32(dropped + 10, getDroppedReadings());
+}
+
+void test_silent_gateway_does_not_block()
+{
+    // The connection is taken but never answered
+    beginBatching();
+    size_t batches = fillBacklog(2);
+    int listener = listenOnGatewayPort();
+    uint32_t failed = gateway.failed();
+
+    unsigned long longest = 0;
+    unsigned long start = millis();
+    while (gateway.failed() == failed && millis() - start < GATEWAY_RESPONSE_TIMEOUT_MS * 2)
+    {
+        unsigned long call = millis();
+        flushBacklog();
+        gateway.service();
+        if (millis() - call > longest)
+            longest = millis() - call;
+        delay(GATEWAY_POLL_PERIOD_MS);
+    }
+
+    // Every step returned at once, the request was given up on after the response timeout
+    TEST_ASSERT_TRUE(longest < 50);
+    TEST_ASSERT_EQUAL_UINT32(failed + 1, gateway.failed());
+    TEST_ASSERT_TRUE(millis() - start >= GATEWAY_RESPONSE_TIMEOUT_MS);
+    TEST_ASSERT_FALSE(gateway.busy());
+    TEST_ASSERT_EQUAL(batches, getBacklog().size());
+    ::close(listener);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_median_odd_count);
+    RUN_TEST(test_median_even_count_and_errors);
+    RUN_TEST(test_median_without_valid_readings_is_error);
+    RUN_TEST(test_median_after_ring_overflow);
+    RUN_TEST(test_backlog_of_full_batches_drains);
+    RUN_TEST(test_refused_batch_is_dropped);
+    RUN_TEST(test_reading_that_does_not_fit_is_dropped);
+    RUN_TEST(test_silent_gateway_does_not_block);
+    return UNITY_END();
+}
@@ -0,0 +1,164 @@
+// Recorded DHT edge traces through the decoder and the sampler: pio test -e native -f test_dhtDecoder
+#include <unity.h>
+#include <string.h>
+#include <dhtDecoder.h>
+#include "dhtSampler.h"
+#include "../../bench/dhtTraces.h"
+
+#define TEST_DHT_PIN 9
+
+static const size_t dht11Edges = sizeof(dht11Trace) / sizeof(dht11Trace[0]);
+static const size_t dht22Edges = sizeof(dht22Trace) / sizeof(dht22Trace[0]);
+static uint32_t edges[DHT_MAX_EDGES];
+
+static SensorData sample;
+static int samples;
+static void onSample(const SensorData &data)
+{
+    sample = data;
+    samples++;
+}
+
+// Runs one measurement on a frozen clock, count edges of the trace arrive as interrupts
+static void replay(DhtSampler &sampler, const uint32_t *trace, size_t count)
+{
+    hostFreezeClock(true);
+    TEST_ASSERT_TRUE(sampler.start());
+    hostAdvanceMillis(DHT_START_LOW_MS_DHT11);
+    sampler.service();
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i > 0)
+            hostAdvanceMicros(trace[i] - trace[i - 1]);
+        hostTriggerInterrupt(TEST_DHT_PIN);
+    }
+    sampler.service();
+}
+
+void setUp()
+{
+    samples = 0;
+}
+
+void tearDown()
+{
+    hostFreezeClock(false);
+}
+
+void test_dht11_trace()
+{
+    uint8_t frame[5];
+    TEST_ASSERT_EQUAL(DHT_OK, dhtDecodeBits(dht11Trace, dht11Edges, frame));
+    TEST_ASSERT_EQUAL_UINT8(45, frame[0]);
+    TEST_ASSERT_EQUAL_UINT8(23, frame[2]);
+    TEST_ASSERT_EQUAL_UINT8(4, frame[3]);
+    TEST_ASSERT_EQUAL_UINT8((frame[0] + frame[1] + frame[2] + frame[3]) & 0xFF, frame[4]);
+
+    DhtReading reading;
+    TEST_ASSERT_EQUAL(DHT_OK, dhtDecode(dht11Trace, dht11Edges, DHT_TYPE_11, reading));
+    TEST_ASSERT_EQUAL_INT16(2340, reading.temperature);
+    TEST_ASSERT_EQUAL_INT16(4500, reading.humidity);
+}
+
+void test_dht22_trace_across_micros_wrap()
+{
+    DhtReading reading;
+    TEST_ASSERT_EQUAL(DHT_OK, dhtDecode(dht22Trace, dht22Edges, DHT_TYPE_22, reading));
+    TEST_ASSERT_EQUAL_INT16(-1010, reading.temperature);
+    TEST_ASSERT_EQUAL_INT16(6520, reading.humidity);
+}
+
+void test_lost_response_edge_still_decodes()
+{
+    // Only the last 41 edges carry bits
+    DhtReading reading;
+    TEST_ASSERT_EQUAL(DHT_OK, dhtDecode(dht11Trace + 1, dht11Edges - 1, DHT_TYPE_11, reading));
+    TEST_ASSERT_EQUAL_INT16(2340, reading.temperature);
+}
+
+void test_lost_edge_mid_frame_is_timing_error()
+{
+    memcpy(edges, dht11Trace, sizeof(dht11Trace));
+    memmove(edges + 20, edges + 21, (dht11Edges - 21) * sizeof(uint32_t));
+    DhtReading reading;
+    TEST_ASSERT_EQUAL(DHT_ERR_TIMING, dhtDecode(edges, dht11Edges - 1, DHT_TYPE_11, reading));
+
+    // A glitch between two edges makes a bit too short
+    memcpy(edges, dht11Trace, sizeof(dht11Trace));
+    edges[30] = edges[29] + 20;
+    TEST_ASSERT_EQUAL(DHT_ERR_TIMING, dhtDecode(edges, dht11Edges, DHT_TYPE_11, reading));
+}
+
+void test_flipped_bit_is_checksum_error()
+{
+    // Stretch the first 0 bit of the humidity byte into a 1, every later edge moves with it
+    uint8_t frame[5];
+    TEST_ASSERT_EQUAL(DHT_OK, dhtDecodeBits(dht11Trace, dht11Edges, frame));
+    size_t first = dht11Edges - DHT_FRAME_EDGES;
+    size_t bit = 0;
+    while (frame[0] & (0x80 >> bit))
+        bit++;
+
+    memcpy(edges, dht11Trace, sizeof(dht11Trace));
+    for (size_t i = first + bit + 1; i < dht11Edges; i++)
+        edges[i] += 43;
+    TEST_ASSERT_EQUAL(DHT_ERR_CHECKSUM, dhtDecodeBits(edges, dht11Edges, frame));
+    TEST_ASSERT_EQUAL_UINT8(45 | (0x80 >> bit), frame[0]);
+
+    DhtReading reading;
+    TEST_ASSERT_EQUAL(DHT_ERR_CHECKSUM, dhtDecode(edges, dht11Edges, DHT_TYPE_11, reading));
+}
+
+void test_too_few_edges_is_no_response()
+{
+    DhtReading reading;
+    TEST_ASSERT_EQUAL(DHT_ERR_NO_RESPONSE, dhtDecode(dht11Trace, 0, DHT_TYPE_11, reading));
+    TEST_ASSERT_EQUAL(DHT_ERR_NO_RESPONSE, dhtDecode(dht11Trace, DHT_FRAME_EDGES - 1, DHT_TYPE_11, reading));
+    TEST_ASSERT_NOT_NULL(dhtDecodeError(DHT_ERR_NO_RESPONSE));
+}
+
+void test_sampler_replays_trace_and_times_out()
+{
+    DhtSampler sampler(TEST_DHT_PIN, DHT_TYPE_11);
+    TEST_ASSERT_TRUE(sampler.begin(onSample));
+
+    replay(sampler, dht11Trace, dht11Edges);
+    TEST_ASSERT_EQUAL(1, samples);
+    TEST_ASSERT_FALSE(sample.error);
+    TEST_ASSERT_EQUAL_INT16(2340, sample.tempCenti);
+    TEST_ASSERT_EQUAL_INT16(4500, sample.humCenti);
+    TEST_ASSERT_FALSE(sampler.busy());
+
+    // A sensor that stops half way is given up on after the capture timeout
+    replay(sampler, dht11Trace, dht11Edges / 2);
+    TEST_ASSERT_EQUAL(1, samples);
+    TEST_ASSERT_TRUE(sampler.busy());
+    hostAdvanceMillis(DHT_CAPTURE_TIMEOUT_MS);
+    sampler.service();
+    TEST_ASSERT_EQUAL(2, samples);
+    TEST_ASSERT_TRUE(sample.error);
+    TEST_ASSERT_EQUAL(DHT_ERR_NO_RESPONSE, sampler.lastResult());
+    TEST_ASSERT_EQUAL(1, sampler.failures());
+
+    // No answer at all
+    replay(sampler, dht11Trace, 0);
+    hostAdvanceMillis(DHT_CAPTURE_TIMEOUT_MS);
+    sampler.service();
+    TEST_ASSERT_EQUAL(3, samples);
+    TEST_ASSERT_EQUAL(DHT_ERR_NO_RESPONSE, sampler.lastResult());
+    TEST_ASSERT_EQUAL(2, sampler.failures());
+    TEST_ASSERT_FALSE(sampler.busy());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_dht11_trace);
+    RUN_TEST(test_dht22_trace_across_micros_wrap);
+    RUN_TEST(test_lost_response_edge_still_decodes);
+    RUN_TEST(test_lost_edge_mid_frame_is_timing_error);
+    RUN_TEST(test_flipped_bit_is_checksum_error);
+    RUN_TEST(test_too_few_edges_is_no_response);
+    RUN_TEST(test_sampler_replays_trace_and_times_out);
+    return UNITY_END();
+}
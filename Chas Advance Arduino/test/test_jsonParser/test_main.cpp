@@ -0,0 +1,65 @@
+// JSON fallback body of a batch: pio test -e native -f test_jsonParser
+#include <unity.h>
+#include "jsonParser.h"
+
+// Collects what is printed, like the WiFiClient the batch is streamed to
+class StringPrint : public Print
+{
+public:
+    size_t write(uint8_t c) override
+    {
+        text += (char)c;
+        return 1;
+    }
+    String text;
+};
+
+void setUp() {}
+void tearDown() {}
+
+void test_batch_as_json_array()
+{
+    SensorBatch batch;
+    batch.push(makeSensorData(21.5f, 40.25f, false));
+    batch.push(makeSensorData(-3.0f, 88.0f, false));
+    TEST_ASSERT_EQUAL_STRING("[{\"temperature\":21.5,\"humidity\":40.25,\"error\":false},"
+                             "{\"temperature\":-3,\"humidity\":88,\"error\":false}]",
+                             createBatchJson(batch).c_str());
+}
+
+void test_failed_reading_has_zero_values()
+{
+    SensorBatch batch;
+    batch.push(makeSensorData(NAN, 40.0f, false));
+    TEST_ASSERT_EQUAL_STRING("[{\"temperature\":0,\"humidity\":0,\"error\":true}]", createBatchJson(batch).c_str());
+}
+
+void test_empty_batch()
+{
+    SensorBatch batch;
+    TEST_ASSERT_EQUAL_STRING("[]", createBatchJson(batch).c_str());
+    TEST_ASSERT_EQUAL(2, measureBatchJson(batch));
+}
+
+void test_streamed_json_matches()
+{
+    SensorBatch batch;
+    for (int i = 0; i < BATCH_CAPACITY; i++)
+        batch.push(makeSensorData(20.0f + i * 0.25f, 50.0f - i * 0.5f, i % 5 == 0));
+
+    String json = createBatchJson(batch);
+    StringPrint out;
+    TEST_ASSERT_EQUAL(json.length(), writeBatchJson(out, batch));
+    TEST_ASSERT_EQUAL_STRING(json.c_str(), out.text.c_str());
+    TEST_ASSERT_EQUAL(json.length(), measureBatchJson(batch));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_batch_as_json_array);
+    RUN_TEST(test_failed_reading_has_zero_values);
+    RUN_TEST(test_empty_batch);
+    RUN_TEST(test_streamed_json_matches);
+    return UNITY_END();
+}
@@ -0,0 +1,162 @@
+// Deadline scheduler on a simulated clock: pio test -e native -f test_scheduler
+#include <unity.h>
+#include <scheduler.h>
+
+static uint32_t now;
+static uint32_t simClock() { return now; }
+
+// Runs of the task under test, the work it does takes workMs of simulated time
+#define MAX_STARTS 64
+static uint32_t starts[MAX_STARTS];
+static size_t startCount;
+static uint32_t workMs;
+
+static void work()
+{
+    if (startCount < MAX_STARTS)
+        starts[startCount] = now;
+    startCount++;
+    now += workMs;
+}
+
+static void other() {}
+
+// Moves the clock to every due time and runs the scheduler there, like run() with an idle sleep
+static void runUntil(Scheduler &scheduler, uint32_t end)
+{
+    while ((int32_t)(end - now) > 0)
+    {
+        uint32_t wait = scheduler.runDue();
+        uint32_t left = end - now;
+        now += wait < left ? wait : left;
+    }
+}
+
+void setUp()
+{
+    now = 1000;
+    startCount = 0;
+    workMs = 0;
+}
+
+void tearDown() {}
+
+void test_periods_do_not_drift()
+{
+    // 30 ms of work per 100 ms run and another task sharing the loop keep the grid
+    Scheduler scheduler(simClock);
+    workMs = 30;
+    scheduler.add("work", work, 100, 10);
+    scheduler.add("other", other, 7);
+    runUntil(scheduler, now + 5000);
+
+    TEST_ASSERT_EQUAL(50, startCount);
+    for (size_t i = 0; i < 50; i++)
+        TEST_ASSERT_EQUAL_UINT32(1000 + i * 100, starts[i]);
+    TEST_ASSERT_EQUAL(0, scheduler.task(0).missed);
+}
+
+void test_late_start_keeps_grid()
+{
+    Scheduler scheduler(simClock);
+    scheduler.add("work", work, 100, 10);
+    scheduler.runDue();
+
+    // A slow loop: the second run starts 40 ms late, the third is back on time
+    now = 1140;
+    scheduler.runDue();
+    TEST_ASSERT_EQUAL(60, scheduler.runDue());
+    now = 1200;
+    scheduler.runDue();
+
+    TEST_ASSERT_EQUAL(3, startCount);
+    TEST_ASSERT_EQUAL_UINT32(1200, starts[2]);
+    TEST_ASSERT_EQUAL(1, scheduler.task(0).missed);
+    TEST_ASSERT_EQUAL(40, scheduler.task(0).maxLate);
+}
+
+void test_missed_deadlines_counted_without_burst()
+{
+    Scheduler scheduler(simClock);
+    scheduler.add("work", work, 100, 20);
+    scheduler.runDue();
+
+    // Stalled for 3.5 periods: one late run, then a fresh grid instead of catching up
+    now = 1450;
+    scheduler.runDue();
+    scheduler.runDue();
+    TEST_ASSERT_EQUAL(2, startCount);
+    TEST_ASSERT_EQUAL(1, scheduler.task(0).missed);
+    TEST_ASSERT_EQUAL(350, scheduler.task(0).maxLate);
+
+    TEST_ASSERT_EQUAL(100, scheduler.runDue());
+    now = 1550;
+    scheduler.runDue();
+    TEST_ASSERT_EQUAL(3, startCount);
+    TEST_ASSERT_EQUAL(1, scheduler.task(0).missed);
+
+    // Within the deadline is not missed
+    now = 1665;
+    scheduler.runDue();
+    TEST_ASSERT_EQUAL(1, scheduler.task(0).missed);
+    TEST_ASSERT_EQUAL(4, scheduler.task(0).runs);
+}
+
+void test_millis_wraparound()
+{
+    now = 0xFFFFFF00; // 256 ms before millis() overflows
+    Scheduler scheduler(simClock);
+    scheduler.add("work", work, 100, 5);
+    runUntil(scheduler, now + 1000);
+
+    TEST_ASSERT_EQUAL(10, startCount);
+    for (size_t i = 1; i < 10; i++)
+        TEST_ASSERT_EQUAL_UINT32(100, starts[i] - starts[i - 1]);
+    TEST_ASSERT_EQUAL(0, scheduler.task(0).missed);
+    TEST_ASSERT_EQUAL(0, scheduler.task(0).maxLate);
+
+    // The wait until the next run is right across the overflow as well
+    now = 0xFFFFFFF0;
+    Scheduler wrapped(simClock);
+    wrapped.add("work", work, 100);
+    TEST_ASSERT_EQUAL(100, wrapped.runDue());
+    now = 0x50; // 0x60 ms later
+    TEST_ASSERT_EQUAL(0x04, wrapped.runDue());
+}
+
+void test_start_delay()
+{
+    Scheduler scheduler(simClock);
+    scheduler.add("other", other, 250);
+    scheduler.add("work", work, 2000, 50, 3000);
+
+    TEST_ASSERT_EQUAL(250, scheduler.runDue());
+    runUntil(scheduler, 3999);
+    TEST_ASSERT_EQUAL(0, startCount);
+    runUntil(scheduler, 4001);
+    TEST_ASSERT_EQUAL(1, startCount);
+    TEST_ASSERT_EQUAL_UINT32(4000, starts[0]);
+    TEST_ASSERT_EQUAL(0, scheduler.task(1).missed);
+}
+
+void test_table_limit()
+{
+    Scheduler scheduler(simClock);
+    for (int i = 0; i < SCHEDULER_MAX_TASKS; i++)
+        TEST_ASSERT_TRUE(scheduler.add("other", other, 10));
+    TEST_ASSERT_FALSE(scheduler.add("work", work, 10));
+    TEST_ASSERT_FALSE(Scheduler(simClock).add("none", NULL, 10));
+    TEST_ASSERT_EQUAL(0, Scheduler(simClock).runDue());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_periods_do_not_drift);
+    RUN_TEST(test_late_start_keeps_grid);
+    RUN_TEST(test_missed_deadlines_counted_without_burst);
+    RUN_TEST(test_millis_wraparound);
+    RUN_TEST(test_start_delay);
+    RUN_TEST(test_table_limit);
+    return UNITY_END();
+}
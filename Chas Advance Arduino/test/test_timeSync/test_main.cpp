@@ -0,0 +1,130 @@
+// Time sync of the node against the gateway, on the fake millis(): pio test -e native -f test_timeSync
+#include <unity.h>
+#include <Arduino.h>
+#include "timeProvider.h"
+
+#define TEST_EPOCH_MS 1760000000000ULL
+#define TEST_SKEW_PPM 500        // the gateway runs this much faster than the local oscillator
+#define TEST_SYNC_SPAN_MS 600000 // longer than TIME_SYNC_MIN_SPAN_MS
+
+// Gateway time after local ms have passed since the start, with the skew
+static uint64_t gatewayAt(uint64_t local)
+{
+    return TEST_EPOCH_MS + local + local * TEST_SKEW_PPM / 1000000;
+}
+
+static uint64_t start;
+
+void setUp()
+{
+    hostFreezeClock(true);
+    start = uptimeMillis();
+}
+
+void tearDown()
+{
+    hostFreezeClock(false);
+}
+
+void test_drift_corrected_after_two_syncs()
+{
+    TimeSync clock;
+    TEST_ASSERT_FALSE(clock.synced());
+    TEST_ASSERT_EQUAL_UINT64(0, clock.epochMillisAt(uptimeMillis()));
+    TEST_ASSERT_TRUE(clock.sync(gatewayAt(0), uptimeMillis()));
+
+    // Without a drift yet the clock falls behind the gateway by the skew
+    hostAdvanceMillis(TEST_SYNC_SPAN_MS);
+    uint64_t local = uptimeMillis() - start;
+    TEST_ASSERT_EQUAL_UINT64(TEST_EPOCH_MS + local, clock.epochMillisAt(uptimeMillis()));
+
+    // The second sync measures the skew and corrects the offset
+    TEST_ASSERT_TRUE(clock.sync(gatewayAt(local), uptimeMillis()));
+    TEST_ASSERT_EQUAL_INT32(gatewayAt(local) - TEST_EPOCH_MS - local, clock.lastSyncError());
+    TEST_ASSERT_INT_WITHIN(1, TEST_SKEW_PPM, clock.driftPpm());
+
+    // Every sample of the next ten minutes without a sync is within a ms of the gateway
+    for (int i = 0; i < 60; i++)
+    {
+        hostAdvanceMillis(10000);
+        local = uptimeMillis() - start;
+        TEST_ASSERT_INT64_WITHIN(1, (int64_t)gatewayAt(local), (int64_t)clock.epochMillisAt(uptimeMillis()));
+    }
+
+    // Samples taken before the last sync are extrapolated backwards
+    TEST_ASSERT_INT64_WITHIN(1, (int64_t)gatewayAt(TEST_SYNC_SPAN_MS / 2),
+                             (int64_t)clock.epochMillisAt(start + TEST_SYNC_SPAN_MS / 2));
+    TEST_ASSERT_EQUAL_UINT32(2, clock.syncs());
+    TEST_ASSERT_EQUAL_UINT32(0, clock.rejected());
+}
+
+void test_implausible_epoch_rejected()
+{
+    TimeSync clock;
+    // A gateway that has no NTP time yet counts from 1970
+    TEST_ASSERT_FALSE(clock.sync(12345000, uptimeMillis()));
+    TEST_ASSERT_FALSE(clock.synced());
+    TEST_ASSERT_EQUAL_UINT32(1, clock.rejected());
+
+    TEST_ASSERT_TRUE(clock.sync(gatewayAt(0), uptimeMillis()));
+    hostAdvanceMillis(1000);
+    TEST_ASSERT_FALSE(clock.sync((uint64_t)(TIME_SYNC_EPOCH_MIN - 1) * 1000, uptimeMillis()));
+    TEST_ASSERT_EQUAL_UINT64(TEST_EPOCH_MS + 1000, clock.epochMillisAt(uptimeMillis()));
+    TEST_ASSERT_EQUAL_UINT32(1, clock.syncs());
+    TEST_ASSERT_EQUAL_UINT32(2, clock.rejected());
+}
+
+void test_backwards_epoch_rejected_until_confirmed()
+{
+    TimeSync clock;
+    TEST_ASSERT_TRUE(clock.sync(gatewayAt(0), uptimeMillis()));
+
+    // Network jitter behind our time is a normal sync
+    hostAdvanceMillis(1000);
+    TEST_ASSERT_TRUE(clock.sync(TEST_EPOCH_MS + 1000 - TIME_SYNC_STEP_MS / 2, uptimeMillis()));
+    uint64_t expected = TEST_EPOCH_MS + 1000 - TIME_SYNC_STEP_MS / 2;
+    TEST_ASSERT_EQUAL_UINT64(expected, clock.epochMillisAt(uptimeMillis()));
+
+    // One response a minute behind is ignored, the clock keeps running on
+    hostAdvanceMillis(1000);
+    expected += 1000;
+    TEST_ASSERT_FALSE(clock.sync(expected - 60000, uptimeMillis()));
+    TEST_ASSERT_EQUAL_UINT64(expected, clock.epochMillisAt(uptimeMillis()));
+    TEST_ASSERT_EQUAL_UINT32(1, clock.rejected());
+
+    // A good sync in between starts the count again
+    hostAdvanceMillis(1000);
+    expected += 1000;
+    TEST_ASSERT_TRUE(clock.sync(expected, uptimeMillis()));
+
+    // The gateway really stepped back: believed on the TIME_SYNC_BACK_SYNCS'th sync in a row
+    for (int i = 1; i <= TIME_SYNC_BACK_SYNCS; i++)
+    {
+        hostAdvanceMillis(1000);
+        expected += 1000;
+        bool accepted = clock.sync(expected - 60000, uptimeMillis());
+        TEST_ASSERT_EQUAL(i == TIME_SYNC_BACK_SYNCS, accepted);
+    }
+    TEST_ASSERT_EQUAL_UINT64(expected - 60000, clock.epochMillisAt(uptimeMillis()));
+    TEST_ASSERT_EQUAL_UINT32(TIME_SYNC_BACK_SYNCS, clock.rejected());
+    TEST_ASSERT_EQUAL_INT32(-60000, clock.lastSyncError());
+}
+
+void test_parse_rejects_implausible_header()
+{
+    uint64_t epochMs;
+    TEST_ASSERT_TRUE(parseEpochMillis(" 1760000000.25", epochMs));
+    TEST_ASSERT_EQUAL_UINT64(1760000000250ULL, epochMs);
+    TEST_ASSERT_FALSE(parseEpochMillis("12.5", epochMs));
+    TEST_ASSERT_FALSE(parseEpochMillis("soon", epochMs));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_drift_corrected_after_two_syncs);
+    RUN_TEST(test_implausible_epoch_rejected);
+    RUN_TEST(test_backwards_epoch_rejected_until_confirmed);
+    RUN_TEST(test_parse_rejects_implausible_header);
+    return UNITY_END();
+}
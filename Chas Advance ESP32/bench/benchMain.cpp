@@ -0,0 +1,316 @@
+// Host benchmarks for the ESP32 gateway hot paths, built by [env:native]
+#include <Arduino.h>
+#include "espLogger.h"
+#include "networkManager.h"
+
+// Defined in main.cpp and wifiHandler.cpp on the board, the tests in test/ use them as well
+Logger logger;
+static uint32_t stationClock() { return millis(); }
+static SimulatedLink stationLink(stationClock);
+NetworkManager network(stationLink, stationClock);
+
+// The test runner builds the sources with its own main
+#ifndef PIO_UNIT_TESTING
+#include <ArduinoJson.h>
+#include <Preferences.h>
+#include <vector>
+#include <algorithm>
+#include <hostBench.h>
+#include <batchCodec.h>
+#include "ingest.h"
+#include "jsonParser.h"
+#include "sensorDataHandler.h"
+#include "flashStore.h"
+#include "storeForward.h"
+#include "log.h"
+#include "forwarder.h"
+#include "metrics.h"
+
+// One 30 s batch from the Arduino at 2 s sampling
+#define BENCH_BATCH_SIZE 15
+// Bytes per HTTPRaw callback when the body arrives in pieces
+#define BENCH_CHUNK_SIZE 64
+
+static NodeTable nodes;
+static IngestPipeline ingest(nodes);
+
+// calcMedian before sensorStats, two vectors and two full sorts per call, kept as the baseline
+static float vectorMedianOf(std::vector<float> &values)
+{
+    if (values.empty())
+        return NAN;
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    if (n % 2 == 1)
+        return values[n / 2];
+    return (values[n / 2 - 1] + values[n / 2]) / 2.0;
+}
+
+static SensorData vectorMedian(const SensorBatch &batch)
+{
+    std::vector<float> temps;
+    std::vector<float> hums;
+
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        if (!batch.error[i])
+        {
+            temps.push_back(batchFromFixed(batch.tempCenti[i]));
+            hums.push_back(batchFromFixed(batch.humCenti[i]));
+        }
+    }
+
+    return makeSensorData(vectorMedianOf(temps), vectorMedianOf(hums), temps.empty() || hums.empty());
+}
+
+static size_t makeJsonBody(char *out, size_t size)
+{
+    size_t n = snprintf(out, size, "[");
+    for (int i = 0; i < BENCH_BATCH_SIZE; i++)
+        n += snprintf(out + n, size - n, "%s{\"temperature\":%.2f,\"humidity\":%.2f,\"error\":%s}",
+                      i ? "," : "", 21.5 + i * 0.1, 40.0 + (i % 4) * 0.5, i == 7 ? "true" : "false");
+    n += snprintf(out + n, size - n, "]");
+    return n;
+}
+
+// Batch list with four binary batches, like a node flushing its backlog
+static size_t makeBinaryBody(uint8_t *out, size_t size)
+{
+    const size_t frames = 4;
+    size_t n = 0;
+    out[n++] = BATCH_LIST_MAGIC;
+    out[n++] = frames;
+    for (size_t f = 0; f < frames; f++)
+    {
+        BatchEncoder encoder(out + n + BATCH_LIST_LENGTH_SIZE, size - n - BATCH_LIST_LENGTH_SIZE);
+        encoder.begin(1, f);
+        for (int i = 0; i < BENCH_BATCH_SIZE; i++)
+            encoder.add(21.5f + i * 0.1f, 40.0f + (i % 4) * 0.5f, i == 7);
+        size_t length = encoder.finish();
+        out[n++] = length & 0xFF;
+        out[n++] = length >> 8;
+        n += length;
+    }
+    return n;
+}
+
+// Simulated time for the station state machine, advanced by the bench instead of waiting
+static uint32_t netTime = 0;
+static uint32_t netClock() { return netTime; }
+
+// Boots a manager on link and returns the simulated ms until the station is up
+static uint32_t bootStation(SimulatedLink &link)
+{
+    NetworkManager manager(link, netClock);
+    uint32_t start = netTime;
+    manager.begin("upstream", "secret");
+    while (!manager.connected() && netTime - start < 120000)
+    {
+        netTime += NET_SERVICE_PERIOD_MS;
+        manager.service();
+    }
+    return netTime - start;
+}
+
+static void feedChunks(const uint8_t *body, size_t length, size_t chunk)
+{
+    for (size_t pos = 0; pos < length; pos += chunk)
+        ingest.feed(body + pos, min(chunk, length - pos));
+}
+
+int main()
+{
+    static char json[MAX_BODY_SIZE];
+    size_t jsonLength = makeJsonBody(json, sizeof(json));
+    static uint8_t binary[MAX_BODY_SIZE];
+    size_t binaryLength = makeBinaryBody(binary, sizeof(binary));
+    printf("Request bodies: JSON %u bytes, binary list %u bytes (%d readings per batch)\n",
+           (unsigned)jsonLength, (unsigned)binaryLength, BENCH_BATCH_SIZE);
+
+    Serial.mute(true);
+    logger.begin();
+
+    benchHeader("ESP32 ingest (handlePostRequest body path)");
+    benchRun("IngestPipeline JSON, one chunk", [&] {
+        ingest.begin(false, jsonLength);
+        ingest.feed((const uint8_t *)json, jsonLength);
+        IngestStatus status = ingest.finish();
+        benchKeep(status);
+    });
+    benchRun("IngestPipeline JSON, 64 B chunks", [&] {
+        ingest.begin(false, jsonLength);
+        feedChunks((const uint8_t *)json, jsonLength, BENCH_CHUNK_SIZE);
+        IngestStatus status = ingest.finish();
+        benchKeep(status);
+    });
+    benchRun("IngestPipeline binary list (4 batches)", [&] {
+        ingest.begin(true, binaryLength);
+        feedChunks(binary, binaryLength, BENCH_CHUNK_SIZE);
+        IngestStatus status = ingest.finish();
+        benchKeep(status);
+    });
+    // The original request path: whole body as a String, JsonDocument, then
+    // parseJsonArray re-serializing and re-parsing every entry
+    benchRun("deserializeJson + parseJsonArray", [&] {
+        String body(json);
+        JsonDocument doc;
+        deserializeJson(doc, body);
+        parseJsonArray(doc.as<JsonArray>(), getTimeStamp());
+    });
+
+    benchHeader("ESP32 node table");
+    nodes.clear();
+    for (uint16_t id = 1; id <= NODE_TABLE_MAX_NODES; id++)
+        nodes.get(id, 0);
+    uint16_t nextId = 0;
+    benchRun("NodeTable::find, full table", [&] {
+        NodeState *node = nodes.find(nextId++ % NODE_TABLE_MAX_NODES + 1);
+        benchKeep(node);
+    });
+    benchRun("NodeTable::record, 15 readings", [&] {
+        NodeState &node = nodes.get(nextId++ % NODE_TABLE_MAX_NODES + 1, 0);
+        nodes.record(node, ingest.readings(), BENCH_BATCH_SIZE, 0);
+    });
+    uint32_t now = 0;
+    benchRun("NodeTable::get, evicting oldest", [&] {
+        now++;
+        NodeState &node = nodes.get((uint16_t)(NODE_TABLE_MAX_NODES + now), now);
+        benchKeep(node);
+    });
+    nodes.clear();
+
+    benchHeader("ESP32 statistics, logging and storage");
+    ingest.begin(false, jsonLength);
+    ingest.feed((const uint8_t *)json, jsonLength);
+    ingest.finish();
+    static SensorBatch batch;
+    for (size_t i = 0; i < ingest.count(); i++)
+        batch.push(ingest.readings()[i]);
+    benchRun("calcMedian", [&] {
+        SensorData median = calcMedian(batch);
+        benchKeep(median);
+    });
+    benchRun("calcMedian (std::vector baseline)", [&] {
+        SensorData median = vectorMedian(batch);
+        benchKeep(median);
+    });
+    static SensorBatch points;
+    static SensorBatch reconstructed;
+    for (size_t i = 0; i < 8; i++)
+        points.push(makeSensorData(21.5f + i * 0.3f, 40.0f + (i % 3), false, i * 75));
+    benchRun("reconstructBatch (8 points, 10 min)", [&] {
+        reconstructBatch(points, CHANGE_FILTER_SWINGING_DOOR, reconstructed);
+        benchKeep(reconstructed);
+    });
+    benchRun("getTimeStamp", [&] {
+        String timestamp = getTimeStamp();
+        benchKeep(timestamp);
+    });
+    uint32_t formatsBefore = systemClock.formatCount();
+    unsigned long calls = 0;
+    benchRun("ClockService::timestamp (cached)", [&] {
+        const char *timestamp = systemClock.timestamp();
+        benchKeep(timestamp);
+        calls++;
+    });
+    printf("  %lu calls formatted %u times\n", calls, systemClock.formatCount() - formatsBefore);
+    uint32_t second = 1760000000;
+    benchRun("ClockService::format (new second per call)", [&] {
+        const char *timestamp = systemClock.format(second++);
+        benchKeep(timestamp);
+    });
+
+    SensorData logged = makeSensorData(21.5f, 40.0f, false);
+    LogEntry entry;
+    benchRun("logSensorData (queued)", [&] {
+        logSensorData(second, 1, logged);
+        logQueue.pop(entry);
+    });
+    benchRun("logSensorData + serviceLog (text line)", [&] {
+        logSensorData(second, 1, logged);
+        serviceLog();
+    });
+    static const LogMessage espMessages[] = {ESP32_LOG_MESSAGES(LOG_MESSAGE_ENTRY)};
+    uint8_t frame[LOG_FRAME_MAX_SIZE];
+    char text[LOG_LINE_SIZE];
+    logSensorData(second, 1, logged);
+    logQueue.pop(entry);
+    size_t frameLength = logEncodeFrame(entry, frame, sizeof(frame));
+    LogEntry decoded;
+    logDecodeFrame(frame, frameLength, decoded);
+    const char *format = logMessageFormat(espMessages, sizeof(espMessages) / sizeof(espMessages[0]), decoded.id);
+    size_t textLength = logFormat(text, sizeof(text), format, decoded.args, decoded.argc);
+    printf("  reading: %u byte frame instead of %u characters of text \"%s\"\n", (unsigned)frameLength, (unsigned)textLength, text);
+
+    SensorData median = calcMedian(batch);
+    logger.update(false, 1, median); // starts the logger
+    unsigned long writesBefore = Preferences::writeCount();
+    unsigned long bytesBefore = Preferences::bytesWritten();
+    unsigned long updates = 0;
+    benchRun("Logger::update (offline, write-back)", [&] {
+        logger.update(false, 1, median);
+        updates++;
+    });
+    logger.flush();
+    const LoggerStats &loggerStats = logger.stats();
+    printf("  NVS writes per entry: %.2f, bytes per entry: %.1f, flash %.1f B per entry, write amplification %.2f\n",
+           (double)(Preferences::writeCount() - writesBefore) / updates,
+           (double)(Preferences::bytesWritten() - bytesBefore) / updates,
+           (double)loggerStats.flashBytes / loggerStats.entries, loggerStats.writeAmplification());
+    benchRun("Logger::begin (full ring)", [&] { logger.begin(); });
+
+    remove("bench_flash.bin");
+    FileFlash flash("bench_flash.bin", 64 * 4096);
+    StoreForwardQueue queue(flash);
+    queue.begin();
+    StoredReading reading = {0, 0, 1, 2150, 4000, false, 0, 0, 0};
+    benchRun("StoreForwardQueue append + consume", [&] {
+        queue.append(reading);
+        queue.consume(1);
+    });
+    remove("bench_flash.bin");
+
+    // One upstream batch: 8 nodes, 15 readings each 2 s apart, interleaved like they arrive
+    StoredReading upstream[FORWARD_BATCH_READINGS];
+    for (size_t i = 0; i < FORWARD_BATCH_READINGS; i++)
+        upstream[i] = {0, (uint32_t)(1760000000 + (i / 8) * 2), (uint16_t)(1 + i % 8), (int16_t)(2150 + (i % 5) * 3),
+                       (int16_t)(4000 - (i % 3) * 10), i % 40 == 7};
+    static uint8_t upstreamBody[FORWARD_BODY_SIZE];
+    StoredReading shuffled[FORWARD_BATCH_READINGS];
+    size_t upstreamLength = 0;
+    benchRun("encodeUpstreamBody (120 readings, 8 nodes)", [&] {
+        memcpy(shuffled, upstream, sizeof(upstream));
+        upstreamLength = encodeUpstreamBody(shuffled, FORWARD_BATCH_READINGS, upstreamBody, sizeof(upstreamBody), 0);
+        benchKeep(upstreamLength);
+    });
+    printf("  upstream body: %u bytes, %.1f B/reading (%d B per reading in the flash backlog)\n", (unsigned)upstreamLength,
+           (double)upstreamLength / FORWARD_BATCH_READINGS, STORE_RECORD_SIZE);
+
+    // Station join times with a 2.5 s scan and 0.3 s join on the cached BSSID and channel
+    SimulatedLink link(netClock);
+    unsigned long cacheWritesBefore = Preferences::writeCount();
+    uint32_t coldBoot = bootStation(link);
+    uint32_t reboot = bootStation(link);
+    link.setChannel(11);
+    uint32_t moved = bootStation(link);
+    printf("station up: first boot %u ms, reboot with cache %u ms, access point changed channel %u ms (%lu NVS writes)\n",
+           coldBoot, reboot, moved, Preferences::writeCount() - cacheWritesBefore);
+
+    benchHeader("ESP32 metrics");
+    benchRun("metricsStart + metricsRecord", [&] {
+        uint32_t start = metricsStart();
+        metricsRecord(STAGE_MEDIAN, start);
+    });
+    size_t metricsBytes = 0;
+    benchRun("MetricsWriter stage histograms", [&] {
+        MetricsWriter out([](const char *, size_t, void *) {}, NULL);
+        out.stageHistograms("gateway_stage_seconds", "Time spent in each gateway stage");
+        metricsBytes = out.finish();
+    });
+    printf("  /metrics stage histograms: %u bytes in %u B chunks\n", (unsigned)metricsBytes, METRICS_CHUNK_SIZE);
+
+    Serial.mute(false);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef CLOCKSERVICE_H
+#define CLOCKSERVICE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// ==== CONFIG ====
+#define CLOCK_VALID_AFTER 1577836800UL // earlier system times mean SNTP has not synced yet (2020-01-01)
+#define CLOCK_CHECK_MS 1000            // how often an unsynced clock looks for the SNTP time
+#define CLOCK_REANCHOR_MS 600000       // how often a synced clock follows SNTP corrections
+#define CLOCK_TIMESTAMP_SIZE 20        // "YYYY-MM-DD HH:MM:SS" and the terminator
+#define CLOCK_UNSYNCED_TEXT "UNSYNCED"
+
+/* Wall clock that never blocks.
+    The SNTP time is read once as an offset to the monotonic timer, after that the
+    epoch is the timer plus the offset. Before SNTP has set the clock every call
+    returns at once with an unsynced result, nothing waits for the network.
+    Formatted timestamps are cached per task for the last second formatted, so
+    repeated calls within a second neither convert nor format the time again.
+    Safe to call from both cores. */
+class ClockService
+{
+public:
+    ClockService() : offsetUs(0), nextCheckUs(0), formats(0) {}
+
+    bool synced();
+    // Epoch in ms and seconds, 0 while unsynced
+    uint64_t epochMillis();
+    uint32_t epoch() { return epochMillis() / 1000; }
+
+    // Local time of an epoch as "YYYY-MM-DD HH:MM:SS". The text stays valid until the
+    // next call from the same task.
+    const char *format(uint32_t epoch);
+    // Current local time, CLOCK_UNSYNCED_TEXT while unsynced
+    const char *timestamp();
+
+    // Times a timestamp was actually converted and formatted, the rest came from the cache
+    uint32_t formatCount() const { return formats.load(std::memory_order_relaxed); }
+
+private:
+    uint64_t refresh();
+
+    std::atomic<int64_t> offsetUs;     // epoch minus monotonic time, 0 while unsynced
+    std::atomic<uint64_t> nextCheckUs; // monotonic time the system clock is read again
+    std::atomic<uint32_t> formats;
+};
+
+extern ClockService systemClock;
+
+#endif
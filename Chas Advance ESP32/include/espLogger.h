@@ -2,20 +2,56 @@
 #define ESPLOGGER_H
 
 #include <Arduino.h>
-#include <ArduinoJson.h>
+#include <atomic>
+#include "sensorDataHandler.h"
 
 // Max number of log entries
 #define LOGGER_MAX_ENTRIES 20
 // Max length of each log message
 #define LOGGER_MSG_LENGTH 100
+// Entries are collected in RAM and written to NVS together as one blob
+#define LOGGER_FLUSH_MS 60000   // longest a new entry waits in RAM
+#define LOGGER_FLUSH_ENTRIES 10 // unsaved entries that flush before the interval is up
+#define LOGGER_BLOB_MAGIC 0x4C
+#define LOGGER_BLOB_VERSION 1
+#define LOGGER_BLOB_HEADER_SIZE 4
+// Header and every entry with its length byte
+#define LOGGER_BLOB_SIZE (LOGGER_BLOB_HEADER_SIZE + LOGGER_MAX_ENTRIES * LOGGER_MSG_LENGTH)
+// NVS stores everything in 32 byte entries, a blob takes one more for its index
+#define NVS_ENTRY_SIZE 32
 
+// Flash traffic of the logger. The processing task counts, the /metrics handler reads
+// from the other core, so every field is a relaxed atomic.
+struct LoggerStats
+{
+    std::atomic<uint32_t> entries;    // entries logged
+    std::atomic<uint32_t> entryBytes; // text bytes logged
+    std::atomic<uint32_t> flushes;    // blobs written
+    std::atomic<uint32_t> nvsWrites;  // NVS write operations
+    std::atomic<uint32_t> flashBytes; // flash written by those operations, in whole NVS entries
+
+    // Flash bytes written per byte logged
+    float writeAmplification() const
+    {
+        uint32_t bytes = entryBytes.load(std::memory_order_relaxed);
+        return bytes ? (float)flashBytes.load(std::memory_order_relaxed) / bytes : 0.0f;
+    }
+};
+
+/* Ring of the last LOGGER_MAX_ENTRIES log lines, kept in NVS across resets.
+    log() only changes RAM. The ring is written back as a single blob once
+    LOGGER_FLUSH_ENTRIES are unsaved, LOGGER_FLUSH_MS after the oldest unsaved one
+    (see service()), when the logger stops, and on restart. begin() reads that one
+    blob instead of one key per entry. Entries logged since the last flush are lost
+    on a sudden power cut, at most LOGGER_FLUSH_ENTRIES - 1 of them. */
 class Logger {
 public:
     Logger();
     void begin();
 
-    // Add a log entry
-    void log(const String &msg);
+    // Add a log entry, only RAM changes
+    void log(const char *msg);
+    void log(const String &msg) { log(msg.c_str()); }
 
     // Print all log entries to Serial
     void printAll();
@@ -26,17 +62,29 @@ public:
     // Get number of stored log entries
     size_t size();
 
-    void update(bool wifiConnected, JsonArray arr);
+    // Log the median of the latest batch of one node depending on server connection status
+    void update(bool wifiConnected, uint16_t nodeId, const SensorData &medianLog);
+
+    // Writes unsaved entries once they are due, call regularly from the task that logs
+    void service();
+    // Writes unsaved entries now, e.g. before a restart or from a power fail warning
+    void flush();
+
+    const LoggerStats &stats() const { return counters; }
 
 private:
     void load();
-    void saveLastEntry();
+    bool loadLegacy();
     void clearAll();
+    void countWrite(size_t length);
 
     char buffer[LOGGER_MAX_ENTRIES][LOGGER_MSG_LENGTH];
     size_t head;   // index of the next write position
     size_t count;  // number of valid entries
-    bool loggerActive;
+    bool loggerActive; // follows the shared uplink, not a single node
+    size_t unsaved;          // entries not in NVS yet
+    unsigned long unsavedSince; // millis() of the oldest unsaved entry
+    LoggerStats counters;
 };
 
 #endif
@@ -0,0 +1,68 @@
+#ifndef FLASHSTORE_H
+#define FLASHSTORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// ==== CONFIG ====
+#define FLASH_STORE_PARTITION "store" // data partition of the backlog, see partitions.csv
+
+/* Raw flash access used by the store-and-forward queue.
+    Semantics follow NOR flash: erased bytes read 0xFF, writes can only clear bits,
+    and erase works on whole sectors. */
+class FlashDevice
+{
+public:
+    virtual ~FlashDevice() {}
+    virtual bool read(uint32_t address, void *data, size_t len) = 0;
+    virtual bool write(uint32_t address, const void *data, size_t len) = 0;
+    virtual bool eraseSector(uint32_t address) = 0;
+    virtual uint32_t size() const = 0;
+    virtual uint32_t sectorSize() const = 0;
+};
+
+/* Flash emulated in a file, used when running the queue on a host.
+    Writes are ANDed with the existing content to behave like real flash. */
+class FileFlash : public FlashDevice
+{
+public:
+    FileFlash(const char *path, uint32_t size, uint32_t sectorSize = 4096);
+    ~FileFlash();
+
+    bool ok() const { return file != NULL; }
+    bool begin() { return ok(); }
+    bool read(uint32_t address, void *data, size_t len) override;
+    bool write(uint32_t address, const void *data, size_t len) override;
+    bool eraseSector(uint32_t address) override;
+    uint32_t size() const override { return totalSize; }
+    uint32_t sectorSize() const override { return sector; }
+
+private:
+    FILE *file;
+    uint32_t totalSize;
+    uint32_t sector;
+};
+
+#ifdef ESP_PLATFORM
+#include <esp_partition.h>
+
+// Flash backed by a data partition, by default FLASH_STORE_PARTITION
+class PartitionFlash : public FlashDevice
+{
+public:
+    PartitionFlash() : partition(NULL) {}
+
+    bool begin(const char *label = FLASH_STORE_PARTITION);
+    bool read(uint32_t address, void *data, size_t len) override;
+    bool write(uint32_t address, const void *data, size_t len) override;
+    bool eraseSector(uint32_t address) override;
+    uint32_t size() const override { return partition ? partition->size : 0; }
+    uint32_t sectorSize() const override { return 4096; }
+
+private:
+    const esp_partition_t *partition;
+};
+#endif
+
+#endif
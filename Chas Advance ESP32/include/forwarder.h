@@ -0,0 +1,187 @@
+#ifndef FORWARDER_H
+#define FORWARDER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <atomic>
+#include <batchCodec.h>
+#include "storeForward.h"
+
+// ==== CONFIG ====
+#ifndef FORWARD_HOST
+#define FORWARD_HOST "192.168.1.100" // backend address, the simulator points it at tools/upstreamStub
+#endif
+#ifndef FORWARD_PORT
+#define FORWARD_PORT 8090
+#endif
+#define FORWARD_PATH "/readings"
+#define FORWARD_BATCH_READINGS 120        // readings per upstream request, a full batch is sent at once
+#define FORWARD_MAX_AGE_MS 10000          // longest a reading waits for its batch to fill
+#define FORWARD_MAX_IN_FLIGHT 2           // requests sent before the oldest is answered
+#define FORWARD_CONNECT_TIMEOUT_MS 1000   // longest a connect attempt takes, it runs in the connect task
+#define FORWARD_CONNECT_STACK_SIZE 4096
+#define FORWARD_CONNECT_PRIORITY 1
+#define FORWARD_RESPONSE_TIMEOUT_MS 5000  // longest the oldest request waits for its response
+#define FORWARD_RETRY_MIN_MS 1000         // backoff after the first failure, doubles per failure
+#define FORWARD_RETRY_MAX_MS 60000
+#define FORWARD_POLL_MS 20                // how often the processing task services the forwarder while it is busy
+#define FORWARD_SEQUENCE_BLOCK 1024       // batch numbers reserved in flash at once, a restart skips at most this many
+// Worst case body: a batch list with one single reading batch per reading
+#define FORWARD_BODY_SIZE (BATCH_LIST_HEADER_SIZE + FORWARD_BATCH_READINGS * (BATCH_LIST_LENGTH_SIZE + BATCH_HEADER_SIZE + BATCH_TOLERANCE_SIZE + BATCH_EPOCH_SIZE + 9 + 1 + BATCH_CRC_SIZE))
+
+static_assert(FORWARD_BATCH_READINGS <= 255, "a batch list holds at most 255 batches");
+
+/* Encodes readings of any number of nodes as one batch list (see batchCodec.h).
+    Readings are sorted by node and time in place, then every node gets one batch per
+    BATCH_MAX_READINGS with the epoch of its first reading and delta coded values, so
+    a reading costs a few bytes instead of a JSON object. Readings without a time go
+    in batches without BATCH_FLAG_EPOCH. Kept points of a change filtered series go in
+    batches of their own with BATCH_FLAG_HOLD or BATCH_FLAG_LINEAR and the node's
+    tolerances, so the backend gets the points that were measured and rebuilds the rest. The batches are numbered from firstSequence on,
+    wrapping past 0xFFFF, out[1] holds how many there are. Returns the body length, 0 if out is too small. */
+size_t encodeUpstreamBody(StoredReading *readings, size_t count, uint8_t *out, size_t size, uint16_t firstSequence);
+
+// Counters of the upstream forwarder. Only the processing task counts, /metrics reads
+// them from the other core, so every field is a relaxed atomic.
+struct ForwarderStats
+{
+    std::atomic<uint32_t> requests;  // batches sent
+    std::atomic<uint32_t> delivered; // answered 2xx
+    std::atomic<uint32_t> failed;    // no answer, connection lost or 5xx, readings handed back
+    std::atomic<uint32_t> rejected;  // answered 4xx, readings dropped
+    std::atomic<uint32_t> readings;  // readings delivered
+    std::atomic<uint32_t> bytes;     // body bytes delivered
+    std::atomic<uint8_t> maxInFlight;
+};
+
+/* Collects readings of all nodes into upstream batches and posts them to the backend.
+    A batch is sent once it holds FORWARD_BATCH_READINGS or its oldest reading is
+    FORWARD_MAX_AGE_MS old. Requests are pipelined on one keep-alive connection: up to
+    FORWARD_MAX_IN_FLIGHT are written before the first is answered, responses come back
+    in order. Readings of a failed request go to the returned callback so nothing is
+    lost, then the forwarder backs off and reports itself disconnected until it may
+    try again. A 5xx only fails its own request, a timeout or a broken connection
+    fails every unanswered one.
+    Connecting blocks, so it runs in a task of its own: service() starts an attempt and
+    later calls pick up the result, a backend that doesn't answer never stalls the
+    processing task while node batches keep arriving.
+    Every upstream batch gets the next number of one counter, so the backend can tell
+    batches apart across nodes and restarts. Numbers are reserved through the reserve
+    callback FORWARD_SEQUENCE_BLOCK at a time before they are used. The counter and its
+    reservation are 32 bit so they never wrap, but a batch header carries its low 16
+    bits: the backend sees the numbers wrap every 65536 batches and has to compare them
+    with batchSequenceDiff, as tools/upstreamStub does.
+    Only the processing task calls add() and service(); connected() may be read anywhere. */
+class Forwarder
+{
+public:
+    typedef uint32_t (*ClockFunction)();
+    typedef void (*ReturnFunction)(const StoredReading *readings, size_t count);
+    typedef bool (*ReserveFunction)(uint32_t limit);
+
+    Forwarder(const char *host, uint16_t port, ClockFunction clock, ReturnFunction returned, ReserveFunction reserve);
+
+    // Continues the batch numbering at the limit reserved before a restart
+    void resumeSequence(uint32_t next) { sequence = sequenceLimit = next; }
+    uint32_t nextSequence() const { return sequence; }
+
+    // Queues one reading, false if the pending batch is full and has to be sent first
+    bool add(const StoredReading &reading);
+    // Readings that still fit in the pending batch
+    size_t space() const { return FORWARD_BATCH_READINGS - pendingCount; }
+
+    // Sends a due batch and reads responses without waiting for the server.
+    // linkUp is the state of the station, requests are only tried while it is up.
+    void service(bool linkUp);
+
+    // True while requests may be sent: the link is up and no backoff is running
+    bool connected() const { return upstream.load(std::memory_order_relaxed); }
+    // True if a full pending batch would be sent right away
+    bool canSend() const { return inFlight < FORWARD_MAX_IN_FLIGHT; }
+    // True while readings wait or requests are unanswered, service() should run soon
+    bool busy() const { return pendingCount > 0 || inFlight > 0; }
+    size_t waiting() const { return pendingCount + inFlightReadings(); }
+    const ForwarderStats &stats() const { return counters; }
+
+private:
+    // A sent request kept until its response so its readings can be handed back
+    struct Request
+    {
+        StoredReading readings[FORWARD_BATCH_READINGS];
+        size_t count;
+        size_t length; // body bytes
+        uint32_t sentAt;
+    };
+
+    enum ResponseState
+    {
+        RESPONSE_STATUS,
+        RESPONSE_HEADERS,
+        RESPONSE_BODY
+    };
+
+    // The connect task owns the client while an attempt is CONNECT_RUNNING
+    enum ConnectState
+    {
+        CONNECT_IDLE,
+        CONNECT_RUNNING,
+        CONNECT_DONE,
+        CONNECT_FAILED
+    };
+
+    enum Connection
+    {
+        CONNECTION_OPEN,
+        CONNECTION_PENDING,
+        CONNECTION_FAILED
+    };
+
+    static void connectLoop(void *self);
+    Connection connection();
+    bool send();
+    bool readResponses();
+    bool parseLine();
+    bool finishResponse();
+    void fail();
+    void backOff(size_t kept);
+    void handBack();
+    void close();
+    size_t inFlightReadings() const;
+
+    const char *host;
+    uint16_t port;
+    ClockFunction clock;
+    ReturnFunction returned;
+    ReserveFunction reserve;
+    WiFiClient client;
+    bool socketOpen;
+    TaskHandle_t connectTask;
+    std::atomic<uint8_t> connectState;
+
+    StoredReading pending[FORWARD_BATCH_READINGS];
+    size_t pendingCount;
+    uint32_t pendingSince;
+
+    Request requests[FORWARD_MAX_IN_FLIGHT]; // ring, oldest at firstRequest
+    size_t firstRequest;
+    size_t inFlight;
+
+    uint8_t body[FORWARD_BODY_SIZE];
+
+    // Response being read
+    ResponseState responseState;
+    char line[64];
+    size_t lineLength;
+    int responseStatus;
+    long bodyRemaining;
+    bool keepAlive;
+
+    uint32_t sequence;      // number of the next upstream batch
+    uint32_t sequenceLimit; // numbers below this are reserved
+    uint32_t failures;
+    uint32_t retryAt;
+    std::atomic<bool> upstream;
+    ForwarderStats counters;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef HTTPSERVER_H
+#define HTTPSERVER_H
+#include <Arduino.h>
+#include <WebServer.h>
+#include "nodeTable.h"
+
+// Port the /data server listens on, the host builds override it
+#ifndef HTTP_PORT
+#define HTTP_PORT 80
+#endif
+// Response header with our epoch ("seconds.millis"), the nodes keep their clocks in step with it
+#define TIME_HEADER "X-Time"
+
+// Request counters of the /data endpoint
+struct HttpServerStats
+{
+  uint32_t requests;   // POSTs with a finished body
+  uint32_t bytes;      // body bytes received
+  uint32_t accepted;   // answered 200
+  uint32_t rejected;   // answered 400 or 413
+  uint32_t busy;       // answered 503, processing queue full
+  uint32_t readings;   // readings handed to the processing task
+  uint32_t duplicates; // resent batches skipped by sequence number
+};
+
+//Sets up the HTTP server to handle incoming requests
+void setupHttpServer();
+//Streams the raw POST body for /data into the ingest pipeline
+void handleRawBody();
+//Handles incoming POST requests to /data
+void handlePostRequest();
+//Answers GET /metrics with counters and stage latencies in Prometheus text format
+void handleMetrics();
+//Answers GET /memory with heap, stack and allocation figures in one line
+void handleMemory();
+const HttpServerStats &httpServerStats();
+
+extern NodeTable nodes;          // state of every node heard from
+extern WebServer server; // Server listen to port HTTP_PORT
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <Arduino.h>
+#include <batchCodec.h>
+#include "sensorDataHandler.h"
+#include "jsonStreamParser.h"
+#include "nodeTable.h"
+
+// Largest POST body accepted on /data
+#define MAX_BODY_SIZE 2048
+// Most readings kept from one request
+#define INGEST_MAX_READINGS 128
+// Most readings of one batch, what the processing task holds for the median
+#define INGEST_MAX_BATCH_READINGS MEDIAN_MAX_READINGS
+// Most batches in one batch list
+#define INGEST_MAX_FRAMES 16
+
+// One batch of a request, readings [start, end) in readings()
+struct IngestFrame
+{
+    uint16_t nodeId;
+    uint16_t sequence;
+    bool hasSequence;      // JSON bodies carry no sequence number
+    uint8_t series;        // ChangeFilterMode the node reduced the batch with
+    uint8_t tempTolerance; // stated reconstruction error, hundredths
+    uint8_t humTolerance;
+    uint32_t epoch;        // node's epoch seconds of the batch start, 0 if its clock isn't synced
+    size_t start;
+    size_t end;
+};
+
+enum IngestStatus
+{
+    INGEST_OK = 0,
+    INGEST_EMPTY,
+    INGEST_TOO_LARGE,
+    INGEST_TOO_MANY, // more than INGEST_MAX_READINGS, or INGEST_MAX_BATCH_READINGS in one batch
+    INGEST_BAD_JSON,
+    INGEST_BAD_BATCH,
+    INGEST_TOO_MANY_FRAMES
+};
+
+/* Single pass ingest of one /data request body.
+    The body is fed in chunks as it arrives. JSON is parsed incrementally, binary
+    batches are collected into a fixed buffer and decoded once the CRC can be checked.
+    Every reading is decoded exactly once and kept in a fixed array until it is
+    handed over to the processing task. Binary batches already seen from the same node
+    (resent after a lost acknowledgement) are skipped by sequence number, the windows
+    live in the node table together with the rest of the per-node state. */
+class IngestPipeline
+{
+public:
+    IngestPipeline(NodeTable &nodes) : nodes(nodes) {}
+
+    // contentLength is the announced body size, 0 if unknown.
+    // senderId is the node id used for JSON bodies, which don't carry one.
+    void begin(bool binary, size_t contentLength, uint16_t senderId = 0);
+    void feed(const uint8_t *data, size_t len);
+    IngestStatus finish();
+
+    const SensorData *readings() const { return batch; }
+    size_t count() const { return readingCount; }
+    const IngestFrame *frames() const { return frameList; }
+    size_t frameCount() const { return frameTotal; }
+    uint32_t duplicates() const { return duplicateCount; }
+    const char *error() const;
+    BatchDecodeResult batchError() const { return batchResult; }
+
+    // Records the batches of the last request as delivered in the node table,
+    // call once they are queued
+    void commit(uint32_t now);
+
+private:
+    static void onJsonReading(const JsonReading &reading, void *context);
+    void addReading(const SensorData &data);
+    IngestStatus decodeBinary();
+    IngestStatus decodeFrame(const uint8_t *data, size_t len);
+    bool openFrame(uint16_t nodeId, uint16_t sequence, bool hasSequence);
+    void closeFrame();
+
+    NodeTable &nodes;
+    bool binary;
+    bool active;
+    IngestStatus status;
+    size_t received;
+    JsonStreamParser json;
+    uint8_t binaryBody[MAX_BODY_SIZE];
+    size_t binaryLength;
+    SensorData batch[INGEST_MAX_READINGS];
+    size_t readingCount;
+    IngestFrame frameList[INGEST_MAX_FRAMES];
+    size_t frameTotal;
+    BatchDecodeResult batchResult;
+    uint32_t duplicateCount = 0;
+};
+
+#endif
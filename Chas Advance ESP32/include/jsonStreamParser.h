@@ -0,0 +1,65 @@
+#ifndef JSONSTREAMPARSER_H
+#define JSONSTREAMPARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// One reading decoded from a JSON batch
+struct JsonReading
+{
+    float temperature;
+    float humidity;
+    bool error;
+};
+
+typedef void (*JsonReadingCallback)(const JsonReading &reading, void *context);
+
+/* Incremental parser for the JSON batch format sent by the Arduino:
+    [{"temperature":22.5,"humidity":45.0,"error":false}, ...]
+    Input can be fed in arbitrary chunks and every object is reported through the
+    callback as soon as its closing brace is seen. Unknown keys are skipped,
+    nested objects or arrays inside an entry are treated as an error.
+    Uses no heap and only a few small fixed buffers. */
+class JsonStreamParser
+{
+public:
+    void begin(JsonReadingCallback callback, void *context);
+    // Returns false once the input is malformed
+    bool feed(const uint8_t *data, size_t len);
+    // Returns true if a complete array has been parsed
+    bool finish() const { return state == DONE; }
+    bool failed() const { return state == FAILED; }
+
+private:
+    enum State
+    {
+        EXPECT_ARRAY,
+        EXPECT_OBJECT,
+        EXPECT_KEY,
+        IN_KEY,
+        EXPECT_COLON,
+        EXPECT_VALUE,
+        IN_STRING_VALUE,
+        IN_LITERAL_VALUE,
+        AFTER_VALUE,
+        AFTER_OBJECT,
+        DONE,
+        FAILED
+    };
+
+    bool step(char c);
+    bool storeLiteral();
+
+    JsonReadingCallback callback;
+    void *context;
+    State state;
+    bool escaped;
+    bool firstEntry;
+    char key[16];
+    uint8_t keyLen;
+    char literal[24];
+    uint8_t literalLen;
+    JsonReading current;
+};
+
+#endif
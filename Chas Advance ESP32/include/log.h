@@ -2,16 +2,33 @@
 #define LOG_H
 
 #include <Arduino.h>
+#include "nodeTable.h"
+#include "clockService.h"
+#include "sensorDataHandler.h"
+#include <logQueue.h>
+#include <logMessages.h>
+
+// ==== LOG CONFIG ====
+#ifndef LOG_OUTPUT_BINARY
+#define LOG_OUTPUT_BINARY 0 // 1 = binary frames for tools/logDecode instead of text lines
+#endif
+#define LOG_DRAIN_PERIOD_MS 10 // how often serviceLog() runs
+#define LOG_DRAIN_BYTES 96     // most bytes written per run, keeps below 115200 baud
+#define LOG_LINE_SIZE 128
 
 extern const char *ntpServer;
 const long gmtOffset_sec = 3600;
 const int daylightOffset_sec = 3600;
 const int dataReceivedThreshold = 70000; // 70 seconds
 
-void logEvent(String timestamp, String eventType, String description, String status);
-void logSensorData(String timestamp, float temperature, float humidity, bool error);
+// epoch is the time the reading was taken, 0 if unknown
+void logSensorData(uint32_t epoch, uint16_t nodeId, const SensorData &data);
 void logStartup();
-void checkDataTimeout(unsigned long &timeSinceDataReceived);
+// Writes queued log entries to Serial, run from the scheduler
+void serviceLog();
+// Reports every node that has sent nothing for dataReceivedThreshold as offline
+void checkDataTimeout(NodeTable &nodes);
+// Current local time from systemClock, never waits for SNTP ("UNSYNCED" until it has synced)
 String getTimeStamp();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef MEMORYMONITOR_H
+#define MEMORYMONITOR_H
+
+#include <Arduino.h>
+#include <memTelemetry.h>
+
+// ==== CONFIG ====
+#define MEMORY_PATH "/memory"
+
+// Subsystems allocations are counted for (lib/memTelemetry)
+enum MemTag
+{
+    MEM_TAG_OTHER,      // everything outside a scope, also the WiFi and lwIP tasks
+    MEM_TAG_HTTP,       // WebServer and the ingest pipeline
+    MEM_TAG_PROCESSING, // median, forwarding into the upstream batch
+    MEM_TAG_LOGGER,     // offline logger and its NVS writes
+    MEM_TAG_UPSTREAM,   // forwarder requests and backlog replay
+    MEM_TAG_NETWORK,    // station join and reconnect
+    MEM_TAG_COUNT
+};
+
+// Names the tags, call first in setup()
+void memoryBegin();
+// Adds a task to the stack report, NULL is the calling task. Call during setup.
+void memoryWatchTask(const char *name, TaskHandle_t task);
+// Heap figures of the 8 bit capable heap and the stack high-water marks of the watched tasks
+MemSnapshot memorySnapshot();
+
+#endif
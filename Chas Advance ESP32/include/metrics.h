@@ -0,0 +1,100 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// ==== CONFIG ====
+#define METRICS_PATH "/metrics"
+#define METRICS_CONTENT_TYPE "text/plain; version=0.0.4" // Prometheus text format
+#define METRICS_CHUNK_SIZE 512 // text rendered before it is sent, the page is never held whole
+#define METRICS_BUCKETS 12     // latency buckets, +Inf comes on top
+// Upper bounds of the latency buckets in µs
+#define METRICS_BUCKET_BOUNDS_US {10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 100000}
+
+// Timed stages of the gateway, in the order they run for one reading
+enum MetricStage
+{
+    STAGE_INGEST_FEED,   // one body chunk through the ingest pipeline (handleRawBody)
+    STAGE_INGEST_FINISH, // last binary decode and checks (IngestPipeline::finish)
+    STAGE_ENQUEUE,       // readings handed to the processing task
+    STAGE_REPLY,         // response written to the node
+    STAGE_REQUEST,       // all of handlePostRequest
+    STAGE_MEDIAN,        // calcMedian of one batch
+    STAGE_FORWARD,       // batch added to the upstream forwarder or the flash backlog
+    STAGE_LOGGER,        // Logger::update
+    STAGE_LOGGER_FLUSH,  // logger ring written to NVS
+    STAGE_UPSTREAM,      // Forwarder::service while requests are pending
+    STAGE_LOG_DRAIN,     // queued log lines written to Serial
+    STAGE_COUNT
+};
+
+/* Fixed bucket latency histogram. A stage is timed by one task only, the /metrics
+    handler reads it from the other core, so every field is a relaxed atomic. */
+struct LatencyHistogram
+{
+    std::atomic<uint32_t> buckets[METRICS_BUCKETS + 1]; // per bucket, not cumulative, last is +Inf
+    std::atomic<uint32_t> count;
+    std::atomic<uint64_t> sumUs;
+    std::atomic<uint32_t> maxUs;
+
+    void record(uint32_t us);
+};
+
+/* Cycle counter timing, a few instructions per stage:
+        uint32_t start = metricsStart();
+        ...
+        metricsRecord(STAGE_MEDIAN, start);
+    The ESP32 reads the CCOUNT register of the core the task runs on, so a stage has
+    to start and end on the same core (all timed tasks are pinned). Assumes a fixed
+    CPU clock. Host builds count µs instead of cycles. */
+inline uint32_t metricsStart()
+{
+#ifdef ESP_PLATFORM
+    return ESP.getCycleCount();
+#else
+    return micros();
+#endif
+}
+void metricsRecord(MetricStage stage, uint32_t start);
+
+const LatencyHistogram &stageHistogram(MetricStage stage);
+const char *stageName(MetricStage stage);
+
+/* Writes Prometheus text format in METRICS_CHUNK_SIZE pieces through an output
+    function, e.g. WebServer::sendContent. */
+class MetricsWriter
+{
+public:
+    typedef void (*OutputFunction)(const char *text, size_t length, void *context);
+
+    MetricsWriter(OutputFunction output, void *context) : output(output), context(context), length(0), total(0) {}
+
+    // "# HELP" and "# TYPE" lines of a metric family
+    void family(const char *name, const char *type, const char *help);
+    // One sample, labels without braces ("node=\"12\"") or NULL
+    void sample(const char *name, const char *labels, uint64_t value);
+    void sample(const char *name, const char *labels, double value);
+
+    // Family and sample of an unlabelled counter or gauge
+    void counter(const char *name, const char *help, uint64_t value);
+    void gauge(const char *name, const char *help, double value);
+
+    // Every stage as one histogram family with a stage label, in seconds
+    void stageHistograms(const char *name, const char *help);
+
+    // Sends what is left, returns the bytes written in total
+    size_t finish();
+
+private:
+    void print(const char *format, ...);
+    void flush();
+
+    OutputFunction output;
+    void *context;
+    char chunk[METRICS_CHUNK_SIZE];
+    size_t length;
+    size_t total;
+};
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef NETWORKMANAGER_H
+#define NETWORKMANAGER_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// ==== CONFIG ====
+#define NET_SERVICE_PERIOD_MS 100  // how often service() runs
+#define NET_FAST_JOIN_MS 3000      // time a join with the cached BSSID and channel gets before scanning
+#define NET_JOIN_TIMEOUT_MS 20000  // time a join with a full scan gets
+#define NET_RETRY_MIN_MS 1000      // wait after the first failed join, doubles per failure
+#define NET_RETRY_MAX_MS 60000
+#define NET_CACHE_NAMESPACE "net"  // Preferences namespace of the station cache
+#ifndef NET_STATIC_IP
+#define NET_STATIC_IP 0 // 1 = reconnect with the address DHCP gave last time, skips DHCP
+#endif
+
+// Network the station joined last, kept in NVS so a reboot can skip the scan
+struct StationCache
+{
+    uint32_t ssidHash; // FNV-1a of the SSID, a different network invalidates the cache
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t hasAddress; // the address fields below hold the last DHCP lease
+    uint8_t ip[4];
+    uint8_t gateway[4];
+    uint8_t subnet[4];
+    uint8_t dns[4];
+};
+
+enum LinkStatus
+{
+    LINK_IDLE,
+    LINK_JOINING,
+    LINK_UP,
+    LINK_FAILED
+};
+
+/* The station side of the radio, all the manager needs from it.
+    None of the calls may wait for the network: startStation() only starts a join and
+    status() reports how it is going. */
+class NetworkLink
+{
+public:
+    virtual ~NetworkLink() {}
+    // With a cache the join goes straight to its BSSID and channel, and with
+    // cache->hasAddress to its address instead of asking DHCP
+    virtual void startStation(const char *ssid, const char *password, const StationCache *cache) = 0;
+    virtual void stopStation() = 0;
+    virtual LinkStatus status() = 0;
+    // BSSID, channel and address of the current connection, ssidHash is left alone
+    virtual bool readStation(StationCache &cache) = 0;
+};
+
+/* Link for host builds. A join succeeds after joinMs, or fastJoinMs when it was
+    started with a cache matching the simulated access point. Time comes from the
+    same clock as the manager so a bench can run it without waiting. */
+class SimulatedLink : public NetworkLink
+{
+public:
+    typedef uint32_t (*ClockFunction)();
+
+    SimulatedLink(ClockFunction clock, uint32_t joinMs = 2500, uint32_t fastJoinMs = 300);
+
+    void startStation(const char *ssid, const char *password, const StationCache *cache) override;
+    void stopStation() override { joining = up = false; }
+    LinkStatus status() override;
+    bool readStation(StationCache &cache) override;
+
+    // Host only: how long joins take, the access point moves to another channel, is
+    // switched off, or drops us
+    void setJoinTimes(uint32_t join, uint32_t fastJoin)
+    {
+        joinMs = join;
+        fastJoinMs = fastJoin;
+    }
+    void setChannel(uint8_t value) { channel = value; }
+    void setAvailable(bool value) { available = value; }
+    void dropConnection() { up = false; }
+
+private:
+    ClockFunction clock;
+    uint32_t joinMs;
+    uint32_t fastJoinMs;
+    uint32_t joinStart;
+    uint32_t joinTime;
+    uint8_t channel;
+    bool available;
+    bool joining;
+    bool up;
+};
+
+// Counters of the station state machine
+struct NetworkStats
+{
+    uint32_t joins;        // successful joins
+    uint32_t fastJoins;    // joins that used the cache
+    uint32_t fastFailures; // cached joins that timed out and fell back to a scan
+    uint32_t failures;     // joins that failed completely
+    uint32_t losses;       // connections dropped after they were up
+    uint32_t cacheWrites;  // station cache stored to NVS
+    uint32_t lastJoinMs;   // time from the start of the last successful join until it was up
+};
+
+/* Joins the upstream network in the background.
+    begin() returns at once, the access point and /data server don't wait for the
+    station. service() moves through the states:
+      fast join   cached BSSID and channel (and address with NET_STATIC_IP), no scan
+      join        full scan and DHCP, when there is no cache or the fast join failed
+      up          cache refreshed in NVS if the network changed
+      waiting     after a failed join, backoff from NET_RETRY_MIN_MS to NET_RETRY_MAX_MS
+    A lost connection goes straight back to a fast join. */
+class NetworkManager
+{
+public:
+    typedef uint32_t (*ClockFunction)();
+
+    NetworkManager(NetworkLink &link, ClockFunction clock);
+
+    // Loads the station cache and starts the first join
+    void begin(const char *ssid, const char *password);
+    // Run from the scheduler every NET_SERVICE_PERIOD_MS
+    void service();
+
+    // Safe to call from the processing task
+    bool connected() const { return up.load(std::memory_order_relaxed); }
+    const NetworkStats &stats() const { return counters; }
+
+private:
+    enum State
+    {
+        NET_IDLE,
+        NET_FAST_JOIN,
+        NET_JOIN,
+        NET_UP,
+        NET_WAITING
+    };
+
+    void startJoin(bool fast);
+    void joined();
+    void failed();
+    void loadCache();
+    void storeCache(const StationCache &current);
+
+    NetworkLink &link;
+    ClockFunction clock;
+    const char *ssid;
+    const char *password;
+    StationCache cache;
+    bool cacheValid;
+    State state;
+    uint32_t stateStart;
+    uint32_t retryDelay;
+    NetworkStats counters;
+    std::atomic<bool> up;
+};
+
+// The upstream connection, defined in wifiHandler.cpp (gatewaySim.cpp on the host)
+extern NetworkManager network;
+
+// FNV-1a of a string, identifies the network in the cache
+uint32_t ssidHash(const char *ssid);
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef NODETABLE_H
+#define NODETABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sensorDataHandler.h"
+#include "sequenceWindow.h"
+
+// ==== CONFIG ====
+#define NODE_TABLE_SLOTS 64          // hash slots, power of two
+#define NODE_TABLE_MAX_NODES 48      // nodes kept at once, 75% load keeps probe runs short
+#define NODE_AVERAGE_SHIFT 3         // moving averages weigh a new batch 1/8
+#define NODE_ID_FROM_ADDRESS 0xFF00  // senders without a node id get 0xFF00 | last address byte
+
+// Everything the gateway remembers about one sending node
+struct NodeState
+{
+    uint16_t nodeId;
+    bool offline;            // reported offline by checkDataTimeout, cleared by the next batch
+    uint32_t lastSeen;       // millis() of the last accepted batch
+    uint32_t batches;        // accepted batches
+    uint32_t readings;       // accepted readings
+    uint32_t errors;         // readings flagged as sensor errors
+    int16_t averageTemp;     // moving average of batch means, hundredths
+    int16_t averageHum;
+    SensorData lastReading;  // newest valid reading
+    uint8_t series;          // ChangeFilterMode of the latest batch
+    uint8_t tempTolerance;   // its stated reconstruction error, hundredths
+    uint8_t humTolerance;
+    SequenceWindow window;   // batch sequence numbers already delivered
+};
+
+/* Per-node state of the gateway, indexed by node id.
+    Open addressing with linear probing over a fixed slot array, so finding a node
+    is O(1) on average and nothing is allocated as nodes come and go. Removal shifts
+    the following entries back instead of leaving tombstones. When NODE_TABLE_MAX_NODES
+    nodes are known the one seen least recently makes room for a new node.
+    Used from the receive side only (loop() and the HTTP handlers on one core). */
+class NodeTable
+{
+public:
+    NodeTable();
+
+    // Returns the node or NULL if it isn't known
+    NodeState *find(uint16_t nodeId);
+    // Returns the node, adding it first if it is new
+    NodeState &get(uint16_t nodeId, uint32_t now);
+    void remove(uint16_t nodeId);
+    void clear();
+
+    // Updates last-seen and statistics with one accepted batch
+    void record(NodeState &node, const SensorData *readings, size_t count, uint32_t now);
+
+    size_t size() const { return count; }
+    // Slot access for iterating, unused slots return NULL
+    NodeState *slot(size_t index) { return used[index] ? &slots[index] : NULL; }
+    uint32_t evictions() const { return evicted; }
+
+private:
+    size_t home(uint16_t nodeId) const;
+    int lookup(uint16_t nodeId) const;
+    void removeSlot(size_t index);
+    void evictOldest(uint32_t now);
+
+    NodeState slots[NODE_TABLE_SLOTS];
+    bool used[NODE_TABLE_SLOTS];
+    size_t count;
+    uint32_t evicted;
+};
+
+// Node id of a sender that doesn't put one in its payload (JSON bodies)
+inline uint16_t nodeIdFromAddress(uint8_t lastAddressByte)
+{
+    return NODE_ID_FROM_ADDRESS | lastAddressByte;
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef PROCESSING_H
+#define PROCESSING_H
+
+#include <Arduino.h>
+#include "sensorDataHandler.h"
+#include "forwarder.h"
+
+// ==== CONFIG ====
+#define PROCESSING_QUEUE_SIZE 256 // readings buffered between the cores, power of two
+#define PROCESSING_CORE 0         // loop() and the HTTP server run on core 1
+#define PROCESSING_STACK_SIZE 8192
+#define PROCESSING_PRIORITY 1
+#define REPLAY_INTERVAL_MS 1000     // how often an idle task checks whether stored readings can be replayed
+
+// One decoded reading handed from the receive side to the processing task
+struct QueuedReading
+{
+    SensorData data;
+    uint16_t nodeId;  // sender of the batch
+    uint32_t epoch;   // batch start on the node's synced clock, 0 if it had no time
+    bool lastInBatch; // marks the end of one POST so batch statistics can be computed
+    uint8_t tempTolerance; // reconstruction error of a change filtered batch (data.flags), hundredths
+    uint8_t humTolerance;
+};
+
+// Starts the processing task pinned to PROCESSING_CORE
+void startProcessingTask();
+
+/* Queues a whole batch for processing. Called from the receive side only.
+    With an epoch every reading is stamped epoch + its timeOffset, without one the
+    batch ends at the time it is processed.
+    The tolerances are the ones a change filtered batch was sent with.
+    Returns false without queuing anything if the batch doesn't fit, the caller should
+    then reject the request so the sender retries later. */
+bool enqueueBatch(uint16_t nodeId, uint32_t epoch, const SensorData *readings, size_t count,
+                  uint8_t tempTolerance = 0, uint8_t humTolerance = 0);
+
+// True if count readings fit in the queue, counts a dropped request otherwise.
+// Called from the receive side only, so the space can't shrink before enqueueBatch.
+bool processingHasSpace(size_t count);
+
+// Number of batches rejected because the queue was full
+uint32_t droppedBatches();
+
+// Readings waiting in the flash backlog for the uplink
+size_t backlogSize();
+
+// Counters of the upstream forwarder, updated by the processing task
+const ForwarderStats &forwarderStats();
+
+#endif
@@ -2,17 +2,19 @@
 #define SENSORDATAHANDLER_H
 
 #include <Arduino.h>
-#include <ArduinoJson.h>
-#include <vector>
+#include <sensorRecord.h>
+#include <changeFilter.h>
 
-struct SensorData
-{
-    float temperature;
-    float humidity;
-    bool error;
-};
+// Most readings the median is computed over
+#define MEDIAN_MAX_READINGS 64
 
-float median(std::vector<float>& values);
-SensorData calcMedian(JsonArray& arr);
+// Readings of one received batch, stored column by column
+typedef SensorColumns<MEDIAN_MAX_READINGS> SensorBatch;
+
+SensorData calcMedian(const SensorBatch &batch);
+
+// Turns the kept points of a change filtered batch back into evenly spaced samples,
+// as many as fit in out, within the tolerance the node sent
+void reconstructBatch(const SensorBatch &points, ChangeFilterMode mode, SensorBatch &out);
 
 #endif
\ No newline at end of file
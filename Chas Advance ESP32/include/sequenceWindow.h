@@ -0,0 +1,58 @@
+#ifndef SEQUENCEWINDOW_H
+#define SEQUENCEWINDOW_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <batchCodec.h>
+
+#define SEQUENCE_WINDOW_SIZE 64 // how far back duplicates are recognised
+
+/* Remembers which batch sequence numbers of one node have been accepted.
+    A bit per sequence number is kept for the last SEQUENCE_WINDOW_SIZE numbers below
+    the highest one seen. Numbers far behind the window are taken as a node restart. */
+struct SequenceWindow
+{
+    uint16_t highest;
+    uint64_t seen; // bit n = highest - n was accepted
+    bool valid;
+
+    void reset()
+    {
+        highest = 0;
+        seen = 0;
+        valid = false;
+    }
+
+    bool isDuplicate(uint16_t sequence) const
+    {
+        if (!valid)
+            return false;
+        int16_t diff = batchSequenceDiff(highest, sequence);
+        if (diff < 0 || diff >= SEQUENCE_WINDOW_SIZE)
+            return false;
+        return (seen >> diff) & 1;
+    }
+
+    void accept(uint16_t sequence)
+    {
+        int16_t diff = batchSequenceDiff(highest, sequence);
+        if (!valid || diff <= -SEQUENCE_WINDOW_SIZE || diff >= SEQUENCE_WINDOW_SIZE)
+        {
+            // First batch or the node restarted with a new sequence range
+            highest = sequence;
+            seen = 1;
+            valid = true;
+        }
+        else if (diff < 0)
+        {
+            seen = (seen << -diff) | 1;
+            highest = sequence;
+        }
+        else
+        {
+            seen |= (uint64_t)1 << diff;
+        }
+    }
+};
+
+#endif
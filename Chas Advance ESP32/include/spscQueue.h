@@ -0,0 +1,60 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <stddef.h>
+#include <atomic>
+
+/* Lock-free single-producer/single-consumer ring buffer.
+    Exactly one thread may call push/freeSpace and exactly one other thread pop.
+    Head and tail are free running counters, so all N slots can be used.
+    Only uses std::atomic, the same header builds on the ESP32 and on a host. */
+template <typename T, size_t N>
+class SpscQueue
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    // Producer side, returns false if the queue is full
+    bool push(const T &item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= N)
+            return false;
+        items[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, returns false if the queue is empty
+    bool pop(T &item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == t)
+            return false;
+        item = items[t & (N - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Producer side: space only grows until the next push, so this is a safe lower bound
+    size_t freeSpace() const
+    {
+        return N - (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire));
+    }
+
+    size_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    static size_t capacity() { return N; }
+
+private:
+    T items[N];
+    std::atomic<size_t> head; // next slot to write, owned by the producer
+    std::atomic<size_t> tail; // next slot to read, owned by the consumer
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef STOREFORWARD_H
+#define STOREFORWARD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "flashStore.h"
+
+#define STORE_RECORD_SIZE 20
+#define STORE_HUM_TOLERANCE_STEP 10 // hundredths, the humidity tolerance has 5 bits of the flags byte
+
+// One reading as kept in the on-flash queue
+struct StoredReading
+{
+    uint32_t sequence;  // assigned by the queue, increases by one per append
+    uint32_t timestamp; // epoch seconds, 0 if the clock wasn't synced
+    uint16_t nodeId;
+    int16_t temperature; // hundredths, see batchCodec
+    int16_t humidity;
+    bool error;
+    uint8_t series;        // ChangeFilterMode if this is a kept point of a reduced series
+    uint8_t tempTolerance; // the series' reconstruction error, hundredths
+    uint8_t humTolerance;  // kept in steps of STORE_HUM_TOLERANCE_STEP, rounded up
+};
+
+/* Append-only queue of readings in flash, used to keep data while the uplink is down.
+    Every sector is a segment: slot 0 holds a header with the segment sequence number,
+    the other slots hold fixed-size CRC-checked records. Delivered records are marked by
+    clearing their state byte, so no sector is rewritten until it is reused.
+    When the queue is full the oldest segment is dropped. begin() rebuilds read and
+    write positions by scanning the segments.
+    The upstream sequence reservation lives in the newest segment: every segment header
+    repeats it and raising it adds a reservation record. */
+class StoreForwardQueue
+{
+public:
+    StoreForwardQueue(FlashDevice &flash) : flash(flash) {}
+
+    // Recovers the queue from flash, formats it if nothing valid is found
+    bool begin();
+
+    bool append(StoredReading reading);
+
+    // Copies up to max pending readings (oldest first) without removing them
+    size_t peek(StoredReading *out, size_t max);
+
+    // Marks the n oldest pending readings as delivered
+    void consume(size_t n);
+
+    size_t size() const { return pending.load(std::memory_order_relaxed); }
+    uint32_t dropped() const { return droppedCount; }
+
+    // Persists that upstream batch sequence numbers below limit may be in use, so a
+    // restarted forwarder continues above them (see Forwarder)
+    bool reserveSequences(uint32_t limit);
+    // Highest limit persisted so far, 0 on a fresh queue
+    uint32_t reservedSequences() const { return reserved; }
+
+private:
+    struct Position
+    {
+        uint32_t sector;
+        uint32_t slot;
+    };
+
+    uint32_t address(const Position &p) const { return p.sector * flash.sectorSize() + p.slot * STORE_RECORD_SIZE; }
+    bool same(const Position &a, const Position &b) const { return a.sector == b.sector && a.slot == b.slot; }
+    void advance(Position &p) const;
+    bool readSegmentSeq(uint32_t sector, uint32_t &seq);
+    bool startSegment(uint32_t sector);
+    // Moves writePos to the next free slot, starting a new segment if needed
+    bool nextSlot();
+    bool readReservation(const Position &p, uint32_t &limit);
+    // 1 = pending record, 0 = delivered or invalid, -1 = erased slot
+    int readRecord(const Position &p, StoredReading *out);
+    void dropSegment(uint32_t sector);
+
+    FlashDevice &flash;
+    uint32_t sectors;
+    uint32_t slotsPerSector;
+    uint32_t segmentSeq;
+    uint32_t nextSequence;
+    uint32_t reserved;
+    Position readPos;
+    Position writePos;
+    std::atomic<size_t> pending; // also read by /metrics on the other core
+    uint32_t droppedCount;
+};
+
+#endif
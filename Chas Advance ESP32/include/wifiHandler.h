@@ -2,24 +2,20 @@
 #define WIFIHANDLER_H
 #include <Arduino.h>
 #include <ArduinoJson.h>
-#include <WebServer.h>
 #include <NTPClient.h>
 #include <WiFiUdp.h>
 #include "jsonParser.h"
+#include "httpServer.h"
+#include "networkManager.h"
 #include <time.h>
 
-//initialize wifi setup
+//initialize wifi setup, starts the AP and server at once and joins the station network in the background
 void initWifi();
-//Connects the ESP32 to the WiFi network
+//Starts joining the upstream WiFi network, returns without waiting for it
 void connectToWiFi();
 //Sets up the Access Point for the Arduino to connect to
 void setupAccessPoint();
-//Sets up the HTTP server to handle incoming requests
-void setupHttpServer();
-//Handles incoming POST requests to /data
-void handlePostRequest();
+//Advances the station connection, run from the scheduler every NET_SERVICE_PERIOD_MS
+void serviceNetwork();
 
-extern unsigned long timeSinceDataReceived;
-extern WebServer server; // Server listen to port 80
-
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,135 @@
+// Host gateway for the load simulator, built by [env:simulator].
+// Runs the real /data server, ingest pipeline and processing task on HTTP_PORT,
+// with the upstream station joining a simulated network in the background.
+// Readings are forwarded to FORWARD_HOST:FORWARD_PORT, start tools/upstreamStub
+// there or they pile up in the flash backlog.
+//   program [-t seconds] [-w station join ms] [-v]
+#include <Arduino.h>
+#include <signal.h>
+#include <unistd.h>
+#include <scheduler.h>
+#include "httpServer.h"
+#include "processing.h"
+#include "espLogger.h"
+#include "log.h"
+#include "networkManager.h"
+#include "memoryMonitor.h"
+
+#define HTTP_PERIOD_MS 2 // same as main.cpp
+#define TIMEOUT_CHECK_PERIOD_MS 1000
+#define REPORT_PERIOD_MS 5000
+
+// Defined in main.cpp and wifiHandler.cpp on the board
+Logger logger;
+static uint32_t clockMillis() { return millis(); }
+static SimulatedLink stationLink(clockMillis);
+NetworkManager network(stationLink, clockMillis);
+
+static volatile sig_atomic_t stopRequested = 0;
+static HttpServerStats lastStats;
+static unsigned long startTime = 0;
+
+static void idleDelay(uint32_t waitMs) { delay(waitMs); }
+static Scheduler scheduler(clockMillis, idleDelay);
+
+static void onSignal(int) { stopRequested = 1; }
+
+static void serviceHttp()
+{
+    MemScope scope(MEM_TAG_HTTP);
+    server.handleClient();
+}
+static void checkTimeout() { checkDataTimeout(nodes); }
+static void serviceNetwork()
+{
+    MemScope scope(MEM_TAG_NETWORK);
+    network.service();
+}
+
+static void report()
+{
+    const HttpServerStats &s = httpServerStats();
+    printf("%6.1fs  requests %7u (%6.1f/s)  accepted %7u  busy %5u  rejected %4u  readings %8u  duplicates %5u  queue drops %5u  nodes %3zu\n",
+           (millis() - startTime) / 1000.0, s.requests, (s.requests - lastStats.requests) * 1000.0 / REPORT_PERIOD_MS,
+           s.accepted, s.busy, s.rejected, s.readings, s.duplicates, droppedBatches(), nodes.size());
+    fflush(stdout);
+    lastStats = s;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long runSeconds = 0;
+    unsigned long joinMs = 2500;
+    bool verbose = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:w:v")) != -1)
+    {
+        if (opt == 't')
+            runSeconds = strtoul(optarg, NULL, 10);
+        else if (opt == 'w')
+            joinMs = strtoul(optarg, NULL, 10);
+        else if (opt == 'v')
+            verbose = true;
+        else
+        {
+            fprintf(stderr, "usage: %s [-t seconds] [-w station join ms] [-v]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    Serial.mute(!verbose);
+
+    // Start from an empty flash backlog every run
+    remove("backlog_flash.bin");
+    startTime = millis();
+    memoryBegin();
+    logger.begin();
+    startProcessingTask();
+    // Same order as initWifi(): the server doesn't wait for the station
+    setupHttpServer();
+    stationLink.setJoinTimes(joinMs, joinMs / 8);
+    network.begin("upstream", "");
+    // The host sockets are always there, the simulated station decides when they are used
+    WiFi.begin("upstream", "");
+    printf("Gateway listening on port %d after %lu ms\n", HTTP_PORT, millis() - startTime);
+
+    scheduler.add("http", serviceHttp, HTTP_PERIOD_MS, 5);
+    scheduler.add("network", serviceNetwork, NET_SERVICE_PERIOD_MS, 50);
+    scheduler.add("timeout", checkTimeout, TIMEOUT_CHECK_PERIOD_MS, 100);
+    scheduler.add("log", serviceLog, LOG_DRAIN_PERIOD_MS, 50);
+    scheduler.add("report", report, REPORT_PERIOD_MS);
+    unsigned long firstAccepted = 0;
+    while (!stopRequested && (runSeconds == 0 || millis() - startTime < runSeconds * 1000))
+    {
+        scheduler.run();
+        if (firstAccepted == 0 && httpServerStats().accepted > 0)
+            firstAccepted = millis() - startTime;
+    }
+
+    report();
+    const NetworkStats &net = network.stats();
+    printf("first batch accepted after %lu ms, station joined in %u ms (%u joins, %u lost)\n", firstAccepted,
+           net.lastJoinMs, net.joins, net.losses);
+    const ForwarderStats &up = forwarderStats();
+    printf("upstream: %u requests (%u delivered, %u failed, %u rejected, at most %u in flight), %u readings, %.1f B/reading, backlog %zu\n",
+           up.requests.load(), up.delivered.load(), up.failed.load(), up.rejected.load(), up.maxInFlight.load(),
+           up.readings.load(), up.readings ? (double)up.bytes / up.readings : 0.0, backlogSize());
+    for (size_t i = 0; verbose && i < NODE_TABLE_SLOTS; i++)
+    {
+        const NodeState *node = nodes.slot(i);
+        if (node != NULL)
+            printf("node %5u: %6u batches %7u readings %5u errors  avg %.2f C %.2f %%\n", node->nodeId, node->batches,
+                   node->readings, node->errors, batchFromFixed(node->averageTemp), batchFromFixed(node->averageHum));
+    }
+    if (verbose)
+        printf("log: %u entries dropped, at most %u queued\n", logQueue.dropped(), logQueue.highWater());
+    const SchedulerTask &http = scheduler.task(0);
+    printf("http task: %u runs, %u late, worst start delay %u ms\n", http.runs, http.missed, http.maxLate);
+    // Only the allocation counts mean something on the host, heap and stacks read 0
+    char memory[MEM_REPORT_SIZE];
+    memFormatReport(memorySnapshot(), memory, sizeof(memory));
+    printf("memory: %s\n", memory);
+    return 0;
+}
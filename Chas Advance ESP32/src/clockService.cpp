@@ -0,0 +1,77 @@
+#include "clockService.h"
+#include <sys/time.h>
+#include <time.h>
+#ifdef ESP_PLATFORM
+#include <esp_timer.h>
+#endif
+
+ClockService systemClock;
+
+// Microseconds since boot, 64 bit so it never wraps
+static uint64_t monotonicMicros()
+{
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time();
+#else
+    return micros();
+#endif
+}
+
+// Reads the system clock when a check is due and returns the monotonic time
+uint64_t ClockService::refresh()
+{
+    uint64_t now = monotonicMicros();
+    if (now < nextCheckUs.load(std::memory_order_relaxed))
+        return now;
+
+    // gettimeofday() only reads the clock SNTP sets, unlike getLocalTime() it never waits
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    bool valid = tv.tv_sec >= (time_t)CLOCK_VALID_AFTER;
+    if (valid)
+    {
+        int64_t offset = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - (int64_t)now;
+        offsetUs.store(offset != 0 ? offset : 1, std::memory_order_relaxed);
+    }
+    nextCheckUs.store(now + (uint64_t)(valid ? CLOCK_REANCHOR_MS : CLOCK_CHECK_MS) * 1000, std::memory_order_relaxed);
+    return now;
+}
+
+bool ClockService::synced()
+{
+    refresh();
+    return offsetUs.load(std::memory_order_relaxed) != 0;
+}
+
+uint64_t ClockService::epochMillis()
+{
+    uint64_t now = refresh();
+    int64_t offset = offsetUs.load(std::memory_order_relaxed);
+    if (offset == 0)
+        return 0;
+    return (now + offset) / 1000;
+}
+
+const char *ClockService::format(uint32_t epoch)
+{
+    // One cache per task, the two cores never write the same buffer
+    static thread_local uint32_t cachedEpoch = 0;
+    static thread_local char cached[CLOCK_TIMESTAMP_SIZE] = "";
+
+    if (epoch != cachedEpoch || cached[0] == '\0')
+    {
+        time_t t = epoch;
+        struct tm timeinfo;
+        localtime_r(&t, &timeinfo);
+        strftime(cached, sizeof(cached), "%Y-%m-%d %H:%M:%S", &timeinfo);
+        cachedEpoch = epoch;
+        formats.fetch_add(1, std::memory_order_relaxed);
+    }
+    return cached;
+}
+
+const char *ClockService::timestamp()
+{
+    uint32_t now = epoch();
+    return now != 0 ? format(now) : CLOCK_UNSYNCED_TEXT;
+}
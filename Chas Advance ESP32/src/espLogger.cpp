@@ -2,12 +2,28 @@
 #include <Preferences.h>
 #include "sensorDataHandler.h"
 #include "log.h"
+#include "metrics.h"
+#ifdef ESP_PLATFORM
+#include <esp_system.h>
+#endif
+
+#define LOGGER_BLOB_KEY "ring"
 
 // Create a global Preferences object for ESP32 non-volatile storage
 Preferences prefs;
 
 // Constructor initializes internal buffer counters
-Logger::Logger() : head(0), count(0) {}
+Logger::Logger() : head(0), count(0), loggerActive(false), unsaved(0), unsavedSince(0), counters() {}
+
+#ifdef ESP_PLATFORM
+// esp_restart() runs the shutdown handlers, unsaved entries are written before the reset
+static Logger *restartLogger = NULL;
+static void flushOnRestart()
+{
+    if (restartLogger != NULL)
+        restartLogger->flush();
+}
+#endif
 
 // Initialize the logger
 void Logger::begin()
@@ -24,15 +40,22 @@ void Logger::begin()
 
     // Load existing logs from flash into RAM buffer
     load();
+
+#ifdef ESP_PLATFORM
+    if (restartLogger == NULL)
+        esp_register_shutdown_handler(flushOnRestart);
+    restartLogger = this;
+#endif
 }
 
-// Add a new log entry
-void Logger::log(const String &msg)
+// Add a new log entry. Only the RAM ring changes here, what reaches Serial goes
+// through the log queue.
+void Logger::log(const char *msg)
 {
-    Serial.println("Logging on ESP32: " + msg);
-    // Copy the String message into the fixed-size char buffer
-    // Truncate if longer than LOGGER_MSG_LENGTH - 1
-    msg.substring(0, LOGGER_MSG_LENGTH - 1).toCharArray(buffer[head], LOGGER_MSG_LENGTH);
+    // Truncated to LOGGER_MSG_LENGTH - 1 characters
+    strncpy(buffer[head], msg, LOGGER_MSG_LENGTH - 1);
+    buffer[head][LOGGER_MSG_LENGTH - 1] = '\0';
+    size_t length = strlen(buffer[head]);
 
     // Advance the head pointer (circular buffer)
     head = (head + 1) % LOGGER_MAX_ENTRIES;
@@ -41,8 +64,14 @@ void Logger::log(const String &msg)
     if (count < LOGGER_MAX_ENTRIES)
         count++;
 
-    // Persist only the latest entry and update metadata
-    saveLastEntry();
+    counters.entries.fetch_add(1, std::memory_order_relaxed);
+    counters.entryBytes.fetch_add(length, std::memory_order_relaxed);
+
+    // Entries reach NVS together
+    if (unsaved++ == 0)
+        unsavedSince = millis();
+    if (unsaved >= LOGGER_FLUSH_ENTRIES)
+        flush();
 }
 
 // Print all stored logs to Serial in order from oldest to newest
@@ -75,78 +104,146 @@ size_t Logger::size()
     return count;
 }
 
+/* Blob layout:
+    0     LOGGER_BLOB_MAGIC
+    1     LOGGER_BLOB_VERSION
+    2     number of entries
+    3     reserved
+    ..    per entry, oldest first: length byte, then the text without terminator */
+
 // Load logs from non-volatile storage into RAM buffer
 void Logger::load()
 {
-    // Read stored count and head from Preferences
-    count = prefs.getUInt("count", 0);
-    if (count > LOGGER_MAX_ENTRIES)
-        count = LOGGER_MAX_ENTRIES; // Ensure we don't exceed buffer
+    head = 0;
+    count = 0;
+    unsaved = 0;
 
-    head = prefs.getUInt("head", 0);
+    static uint8_t blob[LOGGER_BLOB_SIZE];
+    size_t length = prefs.getBytes(LOGGER_BLOB_KEY, blob, sizeof(blob));
+    if (length < LOGGER_BLOB_HEADER_SIZE || blob[0] != LOGGER_BLOB_MAGIC || blob[1] != LOGGER_BLOB_VERSION)
+    {
+        // Nothing stored yet, or the ring is still in the old one key per entry layout
+        if (loadLegacy())
+            flush();
+        return;
+    }
 
-    // Load each stored log into RAM buffer
-    for (size_t i = 0; i < count; i++)
+    size_t pos = LOGGER_BLOB_HEADER_SIZE;
+    for (uint8_t i = 0; i < blob[2] && count < LOGGER_MAX_ENTRIES; i++)
     {
-        String s = prefs.getString(("log" + String(i)).c_str(), ""); // default to empty
-        s.toCharArray(buffer[i], LOGGER_MSG_LENGTH);                 // store as fixed-size char array
+        size_t textLength = blob[pos];
+        if (pos + 1 + textLength > length || textLength >= LOGGER_MSG_LENGTH)
+            break; // cut short, keep what was complete
+        memcpy(buffer[count], blob + pos + 1, textLength);
+        buffer[count][textLength] = '\0';
+        count++;
+        pos += 1 + textLength;
     }
+    head = count % LOGGER_MAX_ENTRIES;
 }
 
-// Persist only the most recently added entry to Preferences
-void Logger::saveLastEntry()
+// Reads the ring written before the blob: count, head and one string key per slot.
+// The old keys are removed, the caller writes the entries as a blob.
+bool Logger::loadLegacy()
 {
-    // Save metadata: total count and head pointer
-    prefs.putUInt("count", count);
-    prefs.putUInt("head", head);
+    if (!prefs.isKey("count"))
+        return false;
 
-    // Calculate index of the last added log (circular buffer)
-    size_t lastIndex = (head + LOGGER_MAX_ENTRIES - 1) % LOGGER_MAX_ENTRIES;
+    count = min((size_t)prefs.getUInt("count", 0), (size_t)LOGGER_MAX_ENTRIES);
+    head = prefs.getUInt("head", 0) % LOGGER_MAX_ENTRIES;
+    // Slots were written at their ring position, count < max means they start at 0
+    for (size_t i = 0; i < LOGGER_MAX_ENTRIES; i++)
+    {
+        String key = "log" + String(i);
+        if (i < count || count == LOGGER_MAX_ENTRIES)
+            prefs.getString(key.c_str(), "").toCharArray(buffer[i], LOGGER_MSG_LENGTH);
+        prefs.remove(key.c_str());
+    }
+    prefs.remove("count");
+    prefs.remove("head");
+    unsaved = count;
+    return count > 0;
+}
 
-    // Save only the latest log entry to NVS
-    prefs.putString(("log" + String(lastIndex)).c_str(), buffer[lastIndex]);
+void Logger::service()
+{
+    if (unsaved > 0 && millis() - unsavedSince >= LOGGER_FLUSH_MS)
+        flush();
 }
 
-// Clear all logs from RAM and non-volatile storage
-void Logger::clearAll()
+// Writes the whole ring as one blob, oldest entry first
+void Logger::flush()
 {
+    if (unsaved == 0)
+        return;
+
+    uint32_t start = metricsStart();
+    static uint8_t blob[LOGGER_BLOB_SIZE];
+    blob[0] = LOGGER_BLOB_MAGIC;
+    blob[1] = LOGGER_BLOB_VERSION;
+    blob[2] = count;
+    blob[3] = 0;
+    size_t length = LOGGER_BLOB_HEADER_SIZE;
     for (size_t i = 0; i < count; i++)
     {
-        // Remove each log key from Preferences
-        prefs.remove(("log" + String(i)).c_str());
-
-        // Clear the RAM buffer
-        memset(buffer[i], 0, LOGGER_MSG_LENGTH);
+        size_t realIndex = (head + LOGGER_MAX_ENTRIES - count + i) % LOGGER_MAX_ENTRIES;
+        size_t textLength = strlen(buffer[realIndex]);
+        blob[length] = textLength;
+        memcpy(blob + length + 1, buffer[realIndex], textLength);
+        length += 1 + textLength;
     }
 
+    prefs.putBytes(LOGGER_BLOB_KEY, blob, length);
+    countWrite(length);
+    counters.flushes.fetch_add(1, std::memory_order_relaxed);
+    unsaved = 0;
+    metricsRecord(STAGE_LOGGER_FLUSH, start);
+}
+
+// Flash written by one NVS write: the data in 32 byte entries, one header entry and
+// the blob index entry
+void Logger::countWrite(size_t length)
+{
+    counters.nvsWrites.fetch_add(1, std::memory_order_relaxed);
+    counters.flashBytes.fetch_add(((length + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE + 2) * NVS_ENTRY_SIZE, std::memory_order_relaxed);
+}
+
+// Clear all logs from RAM and non-volatile storage
+void Logger::clearAll()
+{
+    memset(buffer, 0, sizeof(buffer));
+
     // Reset counters
     count = 0;
     head = 0;
+    unsaved = 0;
 
-    // Update metadata in Preferences
-    prefs.putUInt("count", count);
-    prefs.putUInt("head", head);
+    prefs.remove(LOGGER_BLOB_KEY);
 }
 
-void Logger::update(bool Connected, JsonArray arr)
+void Logger::update(bool Connected, uint16_t nodeId, const SensorData &medianLog)
 {
-    // Compute median of the entire array
-    SensorData medianLog = calcMedian(arr);
-    String timeStamp = getTimeStamp();
-
     if(!Connected && !loggerActive)
     {
+        LOG_INFO(LOG_ESP_LOGGER_STARTED);
         log("Server disconnected, starting logger");
         loggerActive = true;
     }
     else if(!Connected && loggerActive)
     {
-        String logEntry = timeStamp + " Temp: " + String(medianLog.temperature, 2) + " C, Humidity: " + String(medianLog.humidity, 2) + " %";
-        log(logEntry);
+        // The queue gets the raw hundredths, the ring entry is formatted in place
+        LOG_INFO(LOG_ESP_LOGGED, nodeId, systemClock.epoch(), medianLog.tempCenti, medianLog.humCenti);
+        char entry[LOGGER_MSG_LENGTH];
+        snprintf(entry, sizeof(entry), "%s Node %u Temp: %.2f C, Humidity: %.2f %%", systemClock.timestamp(),
+                 nodeId, medianLog.temperature(), medianLog.humidity());
+        log(entry);
     }
     else if(Connected && loggerActive)
     {
+        LOG_INFO(LOG_ESP_LOGGER_STOPPED);
         log("Server connected, stopping logger");
         loggerActive = false;
+        // Nothing more is logged for a while, don't leave the outage in RAM
+        flush();
     }
 }
@@ -0,0 +1,99 @@
+#include "flashStore.h"
+#include <string.h>
+
+// ==== FILE FLASH ====
+
+FileFlash::FileFlash(const char *path, uint32_t size, uint32_t sectorSize)
+    : file(NULL), totalSize(size), sector(sectorSize)
+{
+    // Reuse an existing image so data survives a restart, like real flash
+    file = fopen(path, "r+b");
+    if (file != NULL)
+        return;
+
+    file = fopen(path, "w+b");
+    if (file == NULL)
+        return;
+
+    uint8_t erased[64];
+    memset(erased, 0xFF, sizeof(erased));
+    for (uint32_t i = 0; i < totalSize; i += sizeof(erased))
+        fwrite(erased, 1, sizeof(erased), file);
+    fflush(file);
+}
+
+FileFlash::~FileFlash()
+{
+    if (file != NULL)
+        fclose(file);
+}
+
+bool FileFlash::read(uint32_t address, void *data, size_t len)
+{
+    if (file == NULL || address + len > totalSize)
+        return false;
+    fseek(file, address, SEEK_SET);
+    return fread(data, 1, len, file) == len;
+}
+
+bool FileFlash::write(uint32_t address, const void *data, size_t len)
+{
+    if (file == NULL || address + len > totalSize)
+        return false;
+
+    const uint8_t *in = (const uint8_t *)data;
+    uint8_t chunk[64];
+    for (size_t done = 0; done < len;)
+    {
+        size_t n = len - done < sizeof(chunk) ? len - done : sizeof(chunk);
+        if (!read(address + done, chunk, n))
+            return false;
+        for (size_t i = 0; i < n; i++)
+            chunk[i] &= in[done + i];
+        fseek(file, address + done, SEEK_SET);
+        if (fwrite(chunk, 1, n, file) != n)
+            return false;
+        done += n;
+    }
+    fflush(file);
+    return true;
+}
+
+bool FileFlash::eraseSector(uint32_t address)
+{
+    if (file == NULL || address % sector != 0 || address + sector > totalSize)
+        return false;
+
+    uint8_t erased[64];
+    memset(erased, 0xFF, sizeof(erased));
+    fseek(file, address, SEEK_SET);
+    for (uint32_t i = 0; i < sector; i += sizeof(erased))
+        fwrite(erased, 1, sizeof(erased), file);
+    fflush(file);
+    return true;
+}
+
+// ==== PARTITION FLASH ====
+
+#ifdef ESP_PLATFORM
+bool PartitionFlash::begin(const char *label)
+{
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    return partition != NULL;
+}
+
+bool PartitionFlash::read(uint32_t address, void *data, size_t len)
+{
+    return partition && esp_partition_read(partition, address, data, len) == ESP_OK;
+}
+
+bool PartitionFlash::write(uint32_t address, const void *data, size_t len)
+{
+    return partition && esp_partition_write(partition, address, data, len) == ESP_OK;
+}
+
+bool PartitionFlash::eraseSector(uint32_t address)
+{
+    return partition && esp_partition_erase_range(partition, address, sectorSize()) == ESP_OK;
+}
+#endif
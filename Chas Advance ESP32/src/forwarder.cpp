@@ -0,0 +1,409 @@
+#include "forwarder.h"
+#include <changeFilter.h>
+#include "log.h"
+#include "memoryMonitor.h"
+
+// ==== BODY ====
+
+// Batch flags of a reading: kept points of a reduced series only mean something with times
+static uint8_t batchFlags(const StoredReading &r)
+{
+    if (r.timestamp == 0)
+        return 0;
+    uint8_t flags = BATCH_FLAG_TIMES | BATCH_FLAG_EPOCH;
+    if (r.series == CHANGE_FILTER_DEADBAND)
+        flags |= BATCH_FLAG_HOLD;
+    else if (r.series == CHANGE_FILTER_SWINGING_DOOR)
+        flags |= BATCH_FLAG_LINEAR;
+    return flags;
+}
+
+static bool sameBatch(const StoredReading &a, const StoredReading &b)
+{
+    return a.nodeId == b.nodeId && batchFlags(a) == batchFlags(b) && a.tempTolerance == b.tempTolerance &&
+           a.humTolerance == b.humTolerance;
+}
+
+static bool readingBefore(const StoredReading &a, const StoredReading &b)
+{
+    if (a.nodeId != b.nodeId)
+        return a.nodeId < b.nodeId;
+    return a.timestamp < b.timestamp;
+}
+
+size_t encodeUpstreamBody(StoredReading *readings, size_t count, uint8_t *out, size_t size, uint16_t firstSequence)
+{
+    if (size < BATCH_LIST_HEADER_SIZE)
+        return 0;
+
+    // Batch times only go forward, so every node's readings have to be in time order.
+    // Insertion sort: stable, no heap, and the readings of one node mostly arrive in order.
+    for (size_t i = 1; i < count; i++)
+    {
+        StoredReading r = readings[i];
+        size_t j = i;
+        for (; j > 0 && readingBefore(r, readings[j - 1]); j--)
+            readings[j] = readings[j - 1];
+        readings[j] = r;
+    }
+
+    size_t n = BATCH_LIST_HEADER_SIZE;
+    uint8_t frames = 0;
+    size_t i = 0;
+    while (i < count)
+    {
+        const StoredReading &first = readings[i];
+        uint8_t flags = batchFlags(first);
+        bool timed = flags != 0;
+        bool series = flags & (BATCH_FLAG_HOLD | BATCH_FLAG_LINEAR);
+        if (n + BATCH_LIST_LENGTH_SIZE >= size)
+            return 0;
+
+        BatchEncoder encoder(out + n + BATCH_LIST_LENGTH_SIZE, size - n - BATCH_LIST_LENGTH_SIZE);
+        encoder.begin(first.nodeId, (uint16_t)(firstSequence + frames), flags, series ? first.tempTolerance : 0,
+                      series ? first.humTolerance : 0, first.timestamp);
+
+        // One batch per node and kind of series, split where it is full or the offset would not fit in 16 bits
+        for (; i < count; i++)
+        {
+            const StoredReading &r = readings[i];
+            if (!sameBatch(r, first) || r.timestamp - first.timestamp > UINT16_MAX)
+                break;
+            if (!encoder.addFixed(r.temperature, r.humidity, r.error, timed ? r.timestamp - first.timestamp : 0))
+                break;
+        }
+
+        size_t length = encoder.finish();
+        if (length == 0 || encoder.count() == 0)
+            return 0;
+        out[n] = length & 0xFF;
+        out[n + 1] = length >> 8;
+        n += BATCH_LIST_LENGTH_SIZE + length;
+        frames++;
+    }
+
+    out[0] = BATCH_LIST_MAGIC;
+    out[1] = frames;
+    return n;
+}
+
+// ==== FORWARDER ====
+
+Forwarder::Forwarder(const char *host, uint16_t port, ClockFunction clock, ReturnFunction returned, ReserveFunction reserve)
+    : host(host), port(port), clock(clock), returned(returned), reserve(reserve), socketOpen(false), connectTask(NULL),
+      connectState(CONNECT_IDLE), pendingCount(0),
+      pendingSince(0), firstRequest(0), inFlight(0), responseState(RESPONSE_STATUS), lineLength(0), responseStatus(0),
+      bodyRemaining(0), keepAlive(false), sequence(0), sequenceLimit(0), failures(0), retryAt(0), upstream(false),
+      counters()
+{
+}
+
+bool Forwarder::add(const StoredReading &reading)
+{
+    if (pendingCount >= FORWARD_BATCH_READINGS)
+        return false;
+    if (pendingCount == 0)
+        pendingSince = clock();
+    pending[pendingCount++] = reading;
+    return true;
+}
+
+size_t Forwarder::inFlightReadings() const
+{
+    size_t total = 0;
+    for (size_t i = 0; i < inFlight; i++)
+        total += requests[(firstRequest + i) % FORWARD_MAX_IN_FLIGHT].count;
+    return total;
+}
+
+void Forwarder::service(bool linkUp)
+{
+    uint32_t now = clock();
+    if (!linkUp)
+    {
+        // Nothing gets through without the station, keep the readings in flash meanwhile
+        if (busy())
+            handBack();
+        close();
+        upstream.store(false, std::memory_order_relaxed);
+        return;
+    }
+
+    // Responses are read during a backoff too, the requests behind a 5xx may still get through
+    if (inFlight > 0)
+    {
+        bool broken = !readResponses();
+        bool late = inFlight > 0 && now - requests[firstRequest].sentAt >= FORWARD_RESPONSE_TIMEOUT_MS;
+        if (broken || late)
+        {
+            fail();
+            return;
+        }
+    }
+
+    // Signed difference keeps this correct across millis() overflow
+    bool ready = failures == 0 || (int32_t)(now - retryAt) >= 0;
+    upstream.store(ready, std::memory_order_relaxed);
+    if (!ready)
+        return;
+
+    bool due = pendingCount >= FORWARD_BATCH_READINGS || (pendingCount > 0 && now - pendingSince >= FORWARD_MAX_AGE_MS);
+    if (!due || inFlight >= FORWARD_MAX_IN_FLIGHT)
+        return;
+
+    // While the connect task is still trying the batch waits, readings keep being added
+    Connection state = connection();
+    if (state == CONNECTION_FAILED || (state == CONNECTION_OPEN && !send()))
+        fail();
+}
+
+// Runs the blocking connects, one per notification
+void Forwarder::connectLoop(void *self)
+{
+    Forwarder *forwarder = (Forwarder *)self;
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        bool ok = forwarder->client.connect(forwarder->host, forwarder->port, FORWARD_CONNECT_TIMEOUT_MS);
+        forwarder->connectState.store(ok ? CONNECT_DONE : CONNECT_FAILED, std::memory_order_release);
+    }
+}
+
+// Reuses the open connection, or picks up the result of a connect attempt or starts one
+Forwarder::Connection Forwarder::connection()
+{
+    switch (connectState.load(std::memory_order_acquire))
+    {
+    case CONNECT_RUNNING:
+        return CONNECTION_PENDING;
+    case CONNECT_FAILED:
+        connectState.store(CONNECT_IDLE, std::memory_order_relaxed);
+        return CONNECTION_FAILED;
+    case CONNECT_DONE:
+        connectState.store(CONNECT_IDLE, std::memory_order_relaxed);
+        socketOpen = true;
+        responseState = RESPONSE_STATUS;
+        lineLength = 0;
+        break;
+    }
+    if (socketOpen && client.connected())
+        return CONNECTION_OPEN;
+
+    // Responses of a dropped socket never arrive
+    if (inFlight > 0)
+        return CONNECTION_FAILED;
+    close();
+
+    if (connectTask == NULL)
+    {
+        if (xTaskCreate(connectLoop, "upstream", FORWARD_CONNECT_STACK_SIZE, this, FORWARD_CONNECT_PRIORITY,
+                        &connectTask) != pdPASS)
+        {
+            connectTask = NULL;
+            return CONNECTION_FAILED;
+        }
+        memoryWatchTask("upstream", connectTask);
+    }
+    connectState.store(CONNECT_RUNNING, std::memory_order_release);
+    xTaskNotifyGive(connectTask);
+    return CONNECTION_PENDING;
+}
+
+bool Forwarder::send()
+{
+    // The request owns the readings from here on, a failure hands them back
+    Request &request = requests[(firstRequest + inFlight) % FORWARD_MAX_IN_FLIGHT];
+    memcpy(request.readings, pending, pendingCount * sizeof(StoredReading));
+    request.count = pendingCount;
+    request.sentAt = clock();
+    pendingCount = 0;
+    inFlight++;
+
+    // A request holds at most one batch per reading, their numbers are reserved before
+    // use so a restart never hands them out again. Without the reservation the numbers
+    // still go up for this run.
+    if (sequence + FORWARD_BATCH_READINGS > sequenceLimit)
+    {
+        sequenceLimit = sequence + FORWARD_BATCH_READINGS + FORWARD_SEQUENCE_BLOCK;
+        reserve(sequenceLimit);
+    }
+
+    // The header holds the low 16 bits, the backend compares them across the wrap
+    size_t length = encodeUpstreamBody(request.readings, request.count, body, sizeof(body), (uint16_t)sequence);
+    if (length == 0)
+        return false;
+    sequence += body[1];
+
+    char header[160];
+    int headerLength = snprintf(header, sizeof(header),
+                                "POST " FORWARD_PATH " HTTP/1.1\r\nHost: %s\r\nContent-Type: " BATCH_CONTENT_TYPE
+                                "\r\nContent-Length: %u\r\nConnection: keep-alive\r\n\r\n",
+                                host, (unsigned)length);
+    if (client.write((const uint8_t *)header, headerLength) != (size_t)headerLength || client.write(body, length) != length)
+        return false;
+
+    request.length = length;
+    counters.requests.fetch_add(1, std::memory_order_relaxed);
+    if (inFlight > counters.maxInFlight.load(std::memory_order_relaxed))
+        counters.maxInFlight.store(inFlight, std::memory_order_relaxed);
+    return true;
+}
+
+// Reads whatever part of the responses has arrived, false if the connection broke
+bool Forwarder::readResponses()
+{
+    while (inFlight > 0 && client.available() > 0)
+    {
+        int c = client.read();
+        if (c < 0)
+            break;
+
+        if (responseState == RESPONSE_BODY)
+        {
+            if (--bodyRemaining <= 0 && !finishResponse())
+                return false;
+            continue;
+        }
+        if (c != '\n')
+        {
+            // Long header lines are cut, only the start of a line matters here
+            if (lineLength < sizeof(line) - 1)
+                line[lineLength++] = c;
+            continue;
+        }
+        if (lineLength > 0 && line[lineLength - 1] == '\r')
+            lineLength--;
+        line[lineLength] = '\0';
+        lineLength = 0;
+        if (!parseLine())
+            return false;
+    }
+    return inFlight == 0 || client.connected();
+}
+
+bool Forwarder::parseLine()
+{
+    if (responseState == RESPONSE_STATUS)
+    {
+        // "HTTP/1.1 200 OK"
+        char *space = strchr(line, ' ');
+        if (strncmp(line, "HTTP/1.", 7) != 0 || space == NULL)
+            return false;
+        responseStatus = atoi(space + 1);
+        keepAlive = line[7] == '1';
+        bodyRemaining = -1;
+        responseState = RESPONSE_HEADERS;
+        return true;
+    }
+
+    if (line[0] != '\0')
+    {
+        if (strncasecmp(line, "Content-Length:", 15) == 0)
+            bodyRemaining = atol(line + 15);
+        else if (strncasecmp(line, "Connection:", 11) == 0)
+            keepAlive = strstr(line + 11, "close") == NULL;
+        return true;
+    }
+
+    // End of headers, without a length the body ends when the server closes
+    if (bodyRemaining < 0)
+    {
+        keepAlive = false;
+        bodyRemaining = 0;
+    }
+    if (bodyRemaining > 0)
+    {
+        responseState = RESPONSE_BODY;
+        return true;
+    }
+    return finishResponse();
+}
+
+// Settles the oldest request, false if the rest of the pipeline is lost
+bool Forwarder::finishResponse()
+{
+    Request &request = requests[firstRequest];
+    responseState = RESPONSE_STATUS;
+
+    if (responseStatus >= 500 || responseStatus < 200)
+    {
+        // The backend is struggling: keep the readings and back off, but read on, the
+        // requests behind this one have their own answers
+        counters.failed.fetch_add(1, std::memory_order_relaxed);
+        returned(request.readings, request.count);
+        backOff(request.count);
+    }
+    else if (responseStatus >= 300)
+    {
+        // Sending the same body again would be rejected again
+        counters.rejected.fetch_add(1, std::memory_order_relaxed);
+        LOG_WARN(LOG_ESP_UPSTREAM_REJECTED, responseStatus, request.count);
+    }
+    else
+    {
+        counters.delivered.fetch_add(1, std::memory_order_relaxed);
+        counters.readings.fetch_add(request.count, std::memory_order_relaxed);
+        counters.bytes.fetch_add(request.length, std::memory_order_relaxed);
+        failures = 0;
+    }
+    firstRequest = (firstRequest + 1) % FORWARD_MAX_IN_FLIGHT;
+    inFlight--;
+
+    if (!keepAlive)
+    {
+        // The requests behind this one were written to a socket that is closing
+        if (inFlight > 0)
+            return false;
+        close();
+    }
+    return true;
+}
+
+void Forwarder::fail()
+{
+    counters.failed.fetch_add(inFlight, std::memory_order_relaxed);
+    size_t kept = pendingCount + inFlightReadings();
+    handBack();
+    close();
+    backOff(kept);
+}
+
+void Forwarder::backOff(size_t kept)
+{
+    if (failures < 16)
+        failures++;
+    uint32_t wait = min((uint32_t)FORWARD_RETRY_MIN_MS << (failures - 1), (uint32_t)FORWARD_RETRY_MAX_MS);
+    retryAt = clock() + wait;
+    upstream.store(false, std::memory_order_relaxed);
+    LOG_WARN(LOG_ESP_UPSTREAM_FAILED, kept, wait);
+}
+
+// Returns the readings of every unanswered request and the pending batch
+void Forwarder::handBack()
+{
+    for (; inFlight > 0; inFlight--)
+    {
+        Request &request = requests[firstRequest];
+        returned(request.readings, request.count);
+        firstRequest = (firstRequest + 1) % FORWARD_MAX_IN_FLIGHT;
+    }
+    if (pendingCount > 0)
+        returned(pending, pendingCount);
+    pendingCount = 0;
+    firstRequest = 0;
+}
+
+void Forwarder::close()
+{
+    // A running attempt still owns the client, its connection is picked up later
+    uint8_t state = connectState.load(std::memory_order_acquire);
+    if (state != CONNECT_RUNNING)
+    {
+        if (socketOpen || state == CONNECT_DONE)
+            client.stop();
+        connectState.store(CONNECT_IDLE, std::memory_order_relaxed);
+    }
+    socketOpen = false;
+    responseState = RESPONSE_STATUS;
+    lineLength = 0;
+}
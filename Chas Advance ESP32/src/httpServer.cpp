@@ -0,0 +1,226 @@
+#include "httpServer.h"
+#include "sensorDataHandler.h"
+#include "ingest.h"
+#include "processing.h"
+#include "networkManager.h"
+#include "espLogger.h"
+#include "metrics.h"
+#include "memoryMonitor.h"
+#include "log.h"
+
+extern Logger logger;
+
+NodeTable nodes;
+WebServer server;
+
+static IngestPipeline ingest(nodes);
+static HttpServerStats stats;
+
+void setupHttpServer()
+{
+  // Content-Type decides which decoder handles the body, Content-Length lets us reject early
+  const char *headerKeys[] = {"Content-Type", "Content-Length"};
+  server.collectHeaders(headerKeys, 2);
+
+  // Define route, the body is streamed through handleRawBody before handlePostRequest runs
+  server.on("/data", HTTP_POST, [&]()
+            { handlePostRequest(); }, [&]()
+            { handleRawBody(); });
+  server.on(METRICS_PATH, HTTP_GET, [&]()
+            { handleMetrics(); });
+  server.on(MEMORY_PATH, HTTP_GET, [&]()
+            { handleMemory(); });
+
+  server.begin(HTTP_PORT);
+  Serial.println("HTTP server started");
+}
+
+/* Feeds the POST body chunk by chunk into the ingest pipeline.
+    Each chunk is decoded as it arrives, nothing is copied into a String or JSON document.*/
+void handleRawBody()
+{
+  HTTPRaw &raw = server.raw();
+  if (raw.status == RAW_START)
+  {
+    bool binary = server.header("Content-Type").startsWith(BATCH_CONTENT_TYPE);
+    // JSON bodies carry no node id, the sender is told apart by its address
+    uint16_t senderId = nodeIdFromAddress(server.client().remoteIP()[3]);
+    ingest.begin(binary, server.header("Content-Length").toInt(), senderId);
+  }
+  else if (raw.status == RAW_WRITE)
+  {
+    uint32_t start = metricsStart();
+    ingest.feed(raw.buf, raw.currentSize);
+    metricsRecord(STAGE_INGEST_FEED, start);
+    stats.bytes += raw.currentSize;
+  }
+}
+
+// Every reply carries our time once NTP has set it, so nodes sync without an extra request
+static void reply(int code, const char *text)
+{
+  uint32_t start = metricsStart();
+  uint64_t now = systemClock.epochMillis();
+  if (now != 0)
+  {
+    char value[24];
+    snprintf(value, sizeof(value), "%lu.%03u", (unsigned long)(now / 1000), (unsigned)(now % 1000));
+    server.sendHeader(TIME_HEADER, value);
+  }
+  server.send(code, "text/plain", text);
+  metricsRecord(STAGE_REPLY, start);
+}
+
+// Hands the decoded readings of one request to the processing task and replies
+static void answerRequest()
+{
+  uint32_t start = metricsStart();
+  IngestStatus status = ingest.finish();
+  metricsRecord(STAGE_INGEST_FINISH, start);
+  stats.requests++;
+
+  if (status != INGEST_OK)
+  {
+    LOG_WARN(LOG_ESP_INGEST_ERROR, status, ingest.batchError());
+    reply(status == INGEST_TOO_LARGE || status == INGEST_TOO_MANY ? 413 : 400, ingest.error());
+    stats.rejected++;
+    return;
+  }
+
+  // Backpressure: the sender keeps the batches and retries when the processing side is behind
+  if (!processingHasSpace(ingest.count()))
+  {
+    reply(503, "Busy");
+    stats.busy++;
+    return;
+  }
+
+  start = metricsStart();
+  for (size_t i = 0; i < ingest.frameCount(); i++)
+  {
+    const IngestFrame &frame = ingest.frames()[i];
+    enqueueBatch(frame.nodeId, frame.epoch, ingest.readings() + frame.start, frame.end - frame.start,
+                 frame.tempTolerance, frame.humTolerance);
+  }
+  // Only now are the sequence numbers known as delivered, a resend will be skipped
+  ingest.commit(millis());
+  metricsRecord(STAGE_ENQUEUE, start);
+
+  reply(200, "OK");
+  stats.accepted++;
+  stats.readings += ingest.count();
+  stats.duplicates = ingest.duplicates();
+}
+
+/* Function to handle POST requests to /data
+    The body has already been decoded by the ingest pipeline, this hands the readings to the
+    processing task on the other core and sends the reply.*/
+void handlePostRequest()
+{
+  uint32_t start = metricsStart();
+  answerRequest();
+  metricsRecord(STAGE_REQUEST, start);
+}
+
+const HttpServerStats &httpServerStats()
+{
+  return stats;
+}
+
+static void sendMetricsChunk(const char *text, size_t length, void *)
+{
+  server.sendContent(text, length);
+}
+
+/* GET /metrics in Prometheus text format.
+    Counters are read while the other core updates them, a scrape may be a few events
+    behind but every value is whole. The page is sent in chunks as it is rendered. */
+void handleMetrics()
+{
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, METRICS_CONTENT_TYPE, "");
+  MetricsWriter out(sendMetricsChunk, NULL);
+
+  out.gauge("gateway_uptime_seconds", "Time since boot", millis() / 1000.0);
+  out.gauge("gateway_clock_synced", "1 once SNTP has set the clock", systemClock.synced() ? 1 : 0);
+
+  out.counter("gateway_http_requests_total", "POST /data requests with a finished body", stats.requests);
+  out.counter("gateway_http_body_bytes_total", "POST /data body bytes received", stats.bytes);
+  out.counter("gateway_http_accepted_total", "Requests answered 200", stats.accepted);
+  out.counter("gateway_http_parse_errors_total", "Requests answered 400 or 413", stats.rejected);
+  out.counter("gateway_http_busy_total", "Requests dropped with 503, processing queue full", stats.busy);
+  out.counter("gateway_readings_total", "Readings handed to the processing task", stats.readings);
+  out.counter("gateway_duplicate_batches_total", "Resent batches skipped by sequence number", stats.duplicates);
+  out.counter("gateway_log_dropped_total", "Log entries lost because the log queue was full", logQueue.dropped());
+  out.gauge("gateway_log_queue_high_water", "Most log entries queued at once", logQueue.highWater());
+
+  out.gauge("gateway_nodes", "Nodes in the node table", nodes.size());
+  out.counter("gateway_node_evictions_total", "Nodes evicted from a full node table", nodes.evictions());
+  out.family("gateway_node_readings_total", "counter", "Readings accepted per node");
+  char labels[32];
+  for (size_t i = 0; i < NODE_TABLE_SLOTS; i++)
+  {
+    const NodeState *node = nodes.slot(i);
+    if (node == NULL)
+      continue;
+    snprintf(labels, sizeof(labels), "node=\"%u\"", node->nodeId);
+    out.sample("gateway_node_readings_total", labels, (uint64_t)node->readings);
+  }
+
+  const NetworkStats &net = network.stats();
+  out.gauge("gateway_station_connected", "1 while the upstream station is up", network.connected() ? 1 : 0);
+  out.counter("gateway_station_joins_total", "Successful station joins", net.joins);
+  out.counter("gateway_station_losses_total", "Station connections lost", net.losses);
+  out.gauge("gateway_station_last_join_seconds", "Duration of the last successful join", net.lastJoinMs / 1000.0);
+
+  const ForwarderStats &upstream = forwarderStats();
+  out.counter("gateway_upstream_requests_total", "Upstream batches sent", upstream.requests);
+  out.counter("gateway_upstream_failed_total", "Upstream batches that failed, readings kept", upstream.failed);
+  out.counter("gateway_upstream_rejected_total", "Upstream batches answered 4xx, readings dropped", upstream.rejected);
+  out.counter("gateway_upstream_readings_total", "Readings delivered upstream", upstream.readings);
+  out.counter("gateway_upstream_bytes_total", "Upstream body bytes delivered", upstream.bytes);
+  out.gauge("gateway_backlog_readings", "Readings waiting in the flash backlog", backlogSize());
+
+  const LoggerStats &offline = logger.stats();
+  out.counter("gateway_logger_entries_total", "Offline logger entries", offline.entries);
+  out.counter("gateway_logger_nvs_writes_total", "NVS writes of the offline logger", offline.nvsWrites);
+  out.counter("gateway_logger_flash_bytes_total", "Flash bytes written by the offline logger", offline.flashBytes);
+  out.gauge("gateway_logger_write_amplification", "Flash bytes written per byte logged", offline.writeAmplification());
+
+  MemSnapshot memory = memorySnapshot();
+  out.gauge("gateway_heap_free_bytes", "Free heap", memory.heapFree);
+  out.gauge("gateway_heap_largest_free_block_bytes", "Largest block one allocation can get", memory.heapLargest);
+  out.gauge("gateway_heap_min_free_bytes", "Lowest free heap since boot", memory.heapMinFree);
+  out.gauge("gateway_heap_fragmentation_percent", "Free heap a single allocation can't reach", memFragmentation(memory));
+  out.family("gateway_stack_free_bytes", "gauge", "Stack never used by the task since it started");
+  for (size_t i = 0; i < memory.stackCount; i++)
+  {
+    snprintf(labels, sizeof(labels), "task=\"%s\"", memory.stackNames[i]);
+    out.sample("gateway_stack_free_bytes", labels, (uint64_t)memory.stackFree[i]);
+  }
+  out.family("gateway_allocations_total", "counter", "Heap allocations per subsystem");
+  for (uint8_t tag = 0; tag < memTagCount(); tag++)
+  {
+    snprintf(labels, sizeof(labels), "subsystem=\"%s\"", memTagName(tag));
+    out.sample("gateway_allocations_total", labels, (uint64_t)memAllocations(tag).allocations);
+  }
+  out.family("gateway_allocated_bytes_total", "counter", "Heap bytes requested per subsystem");
+  for (uint8_t tag = 0; tag < memTagCount(); tag++)
+  {
+    snprintf(labels, sizeof(labels), "subsystem=\"%s\"", memTagName(tag));
+    out.sample("gateway_allocated_bytes_total", labels, (uint64_t)memAllocations(tag).bytes);
+  }
+
+  out.stageHistograms("gateway_stage_seconds", "Time spent in each gateway stage");
+  out.finish();
+}
+
+// GET /memory: the one line memory report, for a quick look without a Prometheus server
+void handleMemory()
+{
+  char text[MEM_REPORT_SIZE + 1];
+  size_t n = memFormatReport(memorySnapshot(), text, sizeof(text) - 1);
+  text[n++] = '\n';
+  text[n] = '\0';
+  server.send(200, "text/plain", text);
+}
@@ -0,0 +1,240 @@
+#include "ingest.h"
+
+void IngestPipeline::begin(bool isBinary, size_t contentLength, uint16_t senderId)
+{
+    binary = isBinary;
+    active = true;
+    status = INGEST_OK;
+    received = 0;
+    binaryLength = 0;
+    readingCount = 0;
+    frameTotal = 0;
+    batchResult = BATCH_OK;
+
+    // Reject oversized bodies before reading them
+    size_t limit = binary ? sizeof(binaryBody) : MAX_BODY_SIZE;
+    if (contentLength > limit)
+        status = INGEST_TOO_LARGE;
+
+    if (!binary)
+    {
+        // A JSON body is one batch without sequence number
+        json.begin(onJsonReading, this);
+        openFrame(senderId, 0, false);
+    }
+}
+
+void IngestPipeline::feed(const uint8_t *data, size_t len)
+{
+    if (!active || status != INGEST_OK)
+        return;
+
+    received += len;
+
+    if (binary)
+    {
+        if (binaryLength + len > sizeof(binaryBody))
+        {
+            status = INGEST_TOO_LARGE;
+            return;
+        }
+        memcpy(binaryBody + binaryLength, data, len);
+        binaryLength += len;
+        return;
+    }
+
+    if (received > MAX_BODY_SIZE)
+    {
+        status = INGEST_TOO_LARGE;
+        return;
+    }
+    if (!json.feed(data, len) && status == INGEST_OK)
+        status = INGEST_BAD_JSON;
+}
+
+IngestStatus IngestPipeline::finish()
+{
+    if (!active)
+        return status = INGEST_EMPTY;
+    active = false;
+
+    if (status != INGEST_OK)
+        return status;
+    if (received == 0)
+        return status = INGEST_EMPTY;
+
+    if (binary)
+        return status = decodeBinary();
+
+    if (!json.finish())
+        status = INGEST_BAD_JSON;
+    closeFrame();
+    return status;
+}
+
+IngestStatus IngestPipeline::decodeBinary()
+{
+    if (binaryLength == 0 || binaryBody[0] != BATCH_LIST_MAGIC)
+        return decodeFrame(binaryBody, binaryLength);
+
+    // Batch list: [magic][count] then [length][batch] per batch
+    if (binaryLength < BATCH_LIST_HEADER_SIZE)
+        return INGEST_BAD_BATCH;
+
+    size_t pos = BATCH_LIST_HEADER_SIZE;
+    for (uint8_t i = 0; i < binaryBody[1]; i++)
+    {
+        if (pos + BATCH_LIST_LENGTH_SIZE > binaryLength)
+            return INGEST_BAD_BATCH;
+        size_t len = binaryBody[pos] | (binaryBody[pos + 1] << 8);
+        pos += BATCH_LIST_LENGTH_SIZE;
+        if (pos + len > binaryLength)
+            return INGEST_BAD_BATCH;
+
+        IngestStatus result = decodeFrame(binaryBody + pos, len);
+        if (result != INGEST_OK)
+            return result;
+        pos += len;
+    }
+
+    // Bytes after the last batch mean a wrong count or a body that isn't ours
+    if (pos != binaryLength)
+    {
+        batchResult = BATCH_ERR_CORRUPT;
+        return INGEST_BAD_BATCH;
+    }
+    return status;
+}
+
+IngestStatus IngestPipeline::decodeFrame(const uint8_t *data, size_t len)
+{
+    BatchDecoder decoder;
+    batchResult = decoder.begin(data, len);
+    if (batchResult != BATCH_OK)
+        return INGEST_BAD_BATCH;
+
+    const BatchHeader &header = decoder.header();
+    const NodeState *node = nodes.find(header.nodeId);
+    if (node != NULL && node->window.isDuplicate(header.sequence))
+    {
+        // Already delivered, the sender only missed our reply
+        duplicateCount++;
+        return status;
+    }
+
+    if (!openFrame(header.nodeId, header.sequence, true))
+        return status = INGEST_TOO_MANY_FRAMES;
+
+    // Change filtered batches keep their kept points, processing reconstructs the series
+    IngestFrame &frame = frameList[frameTotal];
+    if (header.flags & BATCH_FLAG_LINEAR)
+        frame.series = CHANGE_FILTER_SWINGING_DOOR;
+    else if (header.flags & BATCH_FLAG_HOLD)
+        frame.series = CHANGE_FILTER_DEADBAND;
+    frame.tempTolerance = header.tempTolerance;
+    frame.humTolerance = header.humTolerance;
+    frame.epoch = header.epoch;
+
+    // The wire format is fixed point as well, values are copied without conversion
+    SensorData record = makeSensorData(0.0f, 0.0f, false);
+    record.flags = frame.series;
+    BatchReading reading;
+    while (decoder.next(reading))
+    {
+        record.tempCenti = reading.temperature;
+        record.humCenti = reading.humidity;
+        record.error = reading.error;
+        record.timeOffset = reading.timeOffset;
+        addReading(record);
+    }
+
+    if (decoder.corrupt())
+    {
+        batchResult = BATCH_ERR_CORRUPT;
+        return INGEST_BAD_BATCH;
+    }
+
+    closeFrame();
+    return status;
+}
+
+bool IngestPipeline::openFrame(uint16_t nodeId, uint16_t sequence, bool hasSequence)
+{
+    if (frameTotal >= INGEST_MAX_FRAMES)
+        return false;
+
+    IngestFrame &frame = frameList[frameTotal];
+    frame.nodeId = nodeId;
+    frame.sequence = sequence;
+    frame.hasSequence = hasSequence;
+    frame.series = CHANGE_FILTER_OFF;
+    frame.tempTolerance = 0;
+    frame.humTolerance = 0;
+    frame.epoch = 0;
+    frame.start = readingCount;
+    frame.end = readingCount;
+    return true;
+}
+
+void IngestPipeline::closeFrame()
+{
+    IngestFrame &frame = frameList[frameTotal];
+    frame.end = readingCount;
+    // Empty batches don't need processing
+    if (frame.end > frame.start)
+        frameTotal++;
+}
+
+void IngestPipeline::commit(uint32_t now)
+{
+    for (size_t i = 0; i < frameTotal; i++)
+    {
+        const IngestFrame &frame = frameList[i];
+        NodeState &node = nodes.get(frame.nodeId, now);
+        if (frame.hasSequence)
+            node.window.accept(frame.sequence);
+        node.series = frame.series;
+        node.tempTolerance = frame.tempTolerance;
+        node.humTolerance = frame.humTolerance;
+        nodes.record(node, batch + frame.start, frame.end - frame.start, now);
+    }
+}
+
+void IngestPipeline::onJsonReading(const JsonReading &reading, void *context)
+{
+    IngestPipeline *self = static_cast<IngestPipeline *>(context);
+    self->addReading(makeSensorData(reading.temperature, reading.humidity, reading.error));
+}
+
+void IngestPipeline::addReading(const SensorData &data)
+{
+    // The open frame is the batch the reading belongs to
+    if (readingCount >= INGEST_MAX_READINGS || readingCount - frameList[frameTotal].start >= INGEST_MAX_BATCH_READINGS)
+    {
+        status = INGEST_TOO_MANY;
+        return;
+    }
+
+    batch[readingCount++] = data;
+}
+
+const char *IngestPipeline::error() const
+{
+    switch (status)
+    {
+    case INGEST_OK:
+        return "OK";
+    case INGEST_EMPTY:
+        return "No data received";
+    case INGEST_TOO_LARGE:
+        return "Body too large";
+    case INGEST_TOO_MANY:
+        return "Too many readings";
+    case INGEST_BAD_JSON:
+        return "Bad JSON";
+    case INGEST_TOO_MANY_FRAMES:
+        return "Too many batches";
+    default:
+        return batchDecodeError(batchResult);
+    }
+}
@@ -14,12 +14,12 @@ void parseJson(String json)
         return;
     }
 
-    String timestamp = doc["timestamp"] | "";
     float temperature = doc["temperature"] | 0.0;
     float humidity = doc["humidity"] | 0.0;
     bool error = doc["error"] | false;
+    uint16_t nodeId = doc["node"] | 0;
 
-    logSensorData(timestamp, temperature, humidity, error);
+    logSensorData(systemClock.epoch(), nodeId, makeSensorData(temperature, humidity, error));
 }
 
 void parseJsonArray(JsonArray arr, const String &timestamp)
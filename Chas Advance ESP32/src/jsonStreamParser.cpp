@@ -0,0 +1,206 @@
+#include "jsonStreamParser.h"
+#include <stdlib.h>
+#include <string.h>
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+void JsonStreamParser::begin(JsonReadingCallback cb, void *ctx)
+{
+    callback = cb;
+    context = ctx;
+    state = EXPECT_ARRAY;
+    escaped = false;
+    firstEntry = true;
+    keyLen = 0;
+    literalLen = 0;
+}
+
+bool JsonStreamParser::feed(const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len && state != FAILED; i++)
+    {
+        if (!step((char)data[i]))
+            state = FAILED;
+    }
+    return state != FAILED;
+}
+
+// Converts the collected literal and stores it in the field named by key
+bool JsonStreamParser::storeLiteral()
+{
+    literal[literalLen] = '\0';
+
+    bool isBool = false;
+    bool boolValue = false;
+    float number = 0.0f;
+
+    if (strcmp(literal, "true") == 0)
+    {
+        isBool = true;
+        boolValue = true;
+    }
+    else if (strcmp(literal, "false") == 0 || strcmp(literal, "null") == 0)
+    {
+        isBool = true;
+    }
+    else
+    {
+        char *end;
+        number = strtof(literal, &end);
+        if (end == literal || *end != '\0')
+            return false;
+    }
+
+    if (strcmp(key, "temperature") == 0)
+        current.temperature = isBool ? 0.0f : number;
+    else if (strcmp(key, "humidity") == 0)
+        current.humidity = isBool ? 0.0f : number;
+    else if (strcmp(key, "error") == 0)
+        current.error = isBool ? boolValue : number != 0.0f;
+
+    return true;
+}
+
+bool JsonStreamParser::step(char c)
+{
+    switch (state)
+    {
+    case EXPECT_ARRAY:
+        if (isSpace(c))
+            return true;
+        state = EXPECT_OBJECT;
+        return c == '[';
+
+    case EXPECT_OBJECT:
+        if (isSpace(c))
+            return true;
+        if (c == ']' && firstEntry)
+        {
+            state = DONE;
+            return true;
+        }
+        if (c != '{')
+            return false;
+        current.temperature = 0.0f;
+        current.humidity = 0.0f;
+        current.error = false;
+        firstEntry = true;
+        state = EXPECT_KEY;
+        return true;
+
+    case EXPECT_KEY:
+        if (isSpace(c))
+            return true;
+        if (c == '}' && firstEntry)
+        {
+            state = AFTER_OBJECT;
+            callback(current, context);
+            return true;
+        }
+        if (c != '"')
+            return false;
+        keyLen = 0;
+        state = IN_KEY;
+        return true;
+
+    case IN_KEY:
+        if (c == '"')
+        {
+            key[keyLen] = '\0';
+            state = EXPECT_COLON;
+            return true;
+        }
+        // Keys longer than the buffer can't match any known field
+        if (keyLen < sizeof(key) - 1)
+            key[keyLen++] = c;
+        return true;
+
+    case EXPECT_COLON:
+        if (isSpace(c))
+            return true;
+        state = EXPECT_VALUE;
+        return c == ':';
+
+    case EXPECT_VALUE:
+        if (isSpace(c))
+            return true;
+        if (c == '"')
+        {
+            escaped = false;
+            state = IN_STRING_VALUE;
+            return true;
+        }
+        if (c == '{' || c == '[' || c == ',' || c == '}')
+            return false;
+        literalLen = 0;
+        literal[literalLen++] = c;
+        state = IN_LITERAL_VALUE;
+        return true;
+
+    case IN_STRING_VALUE:
+        // String values (e.g. timestamp) are skipped
+        if (escaped)
+            escaped = false;
+        else if (c == '\\')
+            escaped = true;
+        else if (c == '"')
+            state = AFTER_VALUE;
+        return true;
+
+    case IN_LITERAL_VALUE:
+        if (c == ',' || c == '}' || isSpace(c))
+        {
+            if (!storeLiteral())
+                return false;
+            state = AFTER_VALUE;
+            return step(c);
+        }
+        if (literalLen >= sizeof(literal) - 1)
+            return false;
+        literal[literalLen++] = c;
+        return true;
+
+    case AFTER_VALUE:
+        if (isSpace(c))
+            return true;
+        if (c == ',')
+        {
+            firstEntry = false;
+            state = EXPECT_KEY;
+            return true;
+        }
+        if (c == '}')
+        {
+            state = AFTER_OBJECT;
+            callback(current, context);
+            return true;
+        }
+        return false;
+
+    case AFTER_OBJECT:
+        if (isSpace(c))
+            return true;
+        if (c == ',')
+        {
+            firstEntry = false;
+            state = EXPECT_OBJECT;
+            return true;
+        }
+        if (c == ']')
+        {
+            state = DONE;
+            return true;
+        }
+        return false;
+
+    case DONE:
+        // Only trailing whitespace is allowed after the array
+        return isSpace(c);
+
+    default:
+        return false;
+    }
+}
@@ -1,66 +1,104 @@
 #include "log.h"
+#include "metrics.h"
 
 const char *ntpServer = "pool.ntp.org";
 
-void logEvent(String timestamp, String eventType, String description, String status)
-{
-    Serial.print(timestamp);
-    Serial.print(" ");
-    Serial.print(eventType);
-    Serial.print(" ");
-    Serial.print(description);
-    Serial.print(" ");
-    Serial.println(status);
-}
+static uint32_t logClock() { return millis(); }
+LogQueue logQueue(logClock);
+
+#if !LOG_OUTPUT_BINARY
+static const LogMessage messages[] = {ESP32_LOG_MESSAGES(LOG_MESSAGE_ENTRY)};
+#endif
 
-void logSensorData(String timestamp, float temperature, float humidity, bool error)
+void logSensorData(uint32_t epoch, uint16_t nodeId, const SensorData &data)
 {
-    if (error)
-    {
-        logEvent(timestamp, "ERROR", "No data", "FAIL");
-    }
+    if (data.error)
+        LOG_ERROR(LOG_ESP_READING_ERROR, nodeId, epoch);
     else
-    {
-        char buffer[50];
-        snprintf(buffer, sizeof(buffer), "Temp=%.1f Hum=%.1f", temperature, humidity);
-        logEvent(timestamp, "INFO", buffer, "OK");
-    }
+        LOG_INFO(LOG_ESP_READING, nodeId, epoch, data.temperature(), data.humidity());
 }
 
-// OBS - Innehåller mockdata
 void logStartup()
 {
-    String timeStamp = getTimeStamp();
-    logEvent(timeStamp, "SYSTEM", "RESET", "OK");
+    LOG_INFO(LOG_ESP_RESET);
 }
 
-void checkDataTimeout(unsigned long &timeSinceDataReceived)
+// Writes one entry, returns the bytes written
+static size_t writeEntry(const LogEntry &entry)
 {
-    if ((millis() - timeSinceDataReceived) > dataReceivedThreshold)
+#if LOG_OUTPUT_BINARY
+    uint8_t frame[LOG_FRAME_MAX_SIZE];
+    size_t n = logEncodeFrame(entry, frame, sizeof(frame));
+    return Serial.write(frame, n);
+#else
+    // The entry was queued a moment ago, its wall time is now minus its age
+    char line[LOG_LINE_SIZE];
+    uint64_t now = systemClock.epochMillis();
+    const char *timestamp = now != 0 ? systemClock.format((now - (millis() - entry.time)) / 1000) : CLOCK_UNSYNCED_TEXT;
+    size_t n = snprintf(line, sizeof(line), "%s %s ", timestamp, logLevelName(entry.level));
+
+    const char *format = logMessageFormat(messages, sizeof(messages) / sizeof(messages[0]), entry.id);
+    if (format != NULL)
+        n += logFormat(line + n, sizeof(line) - n, format, entry.args, entry.argc);
+    else
+        n += snprintf(line + n, sizeof(line) - n, "message 0x%04x", entry.id);
+    n = min(n, sizeof(line) - 3);
+    line[n++] = '\r';
+    line[n++] = '\n';
+    return Serial.write((const uint8_t *)line, n);
+#endif
+}
+
+void serviceLog()
+{
+    LogEntry entry;
+    size_t written = 0;
+    uint32_t start = metricsStart();
+    while (written < LOG_DRAIN_BYTES && logQueue.pop(entry))
+        written += writeEntry(entry);
+    // Idle runs would bury the Serial time in the lowest bucket
+    if (written > 0)
+        metricsRecord(STAGE_LOG_DRAIN, start);
+
+    // Lost entries are reported once the queue has room again
+    static uint32_t reported = 0;
+    uint32_t dropped = logQueue.dropped();
+    if (dropped != reported && written < LOG_DRAIN_BYTES)
     {
-        // Generate warning if no data received for the configured threshold
-        logEvent(getTimeStamp(), "ERROR", "No data received for " + String(dataReceivedThreshold / 1000) + " seconds", "FAIL");
-        timeSinceDataReceived = millis(); // Reset timer
+        LOG_WARN(LOG_ESP_LOG_DROPPED, dropped - reported);
+        reported = dropped;
     }
 }
 
-String getTimeStamp()
+void checkDataTimeout(NodeTable &nodes)
 {
-    String timeStamp = "TIME_ERROR";
+    unsigned long now = millis();
 
-    // Get current time
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo))
+    if (nodes.size() == 0)
     {
-        Serial.println("Failed to obtain time");
-        return timeStamp;
+        // No node has reported yet, warn once per threshold
+        static unsigned long lastWarning = 0;
+        if ((now - lastWarning) > dataReceivedThreshold)
+        {
+            LOG_ERROR(LOG_ESP_NO_DATA, dataReceivedThreshold / 1000);
+            lastWarning = now;
+        }
+        return;
     }
-    else
+
+    for (size_t i = 0; i < NODE_TABLE_SLOTS; i++)
     {
-        char buffer[20];
-        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &timeinfo);
+        NodeState *node = nodes.slot(i);
+        if (node == NULL || node->offline || (now - node->lastSeen) <= dataReceivedThreshold)
+            continue;
 
-        timeStamp = String(buffer);
+        // Warned once per node, the flag is cleared when the node sends again
+        LOG_ERROR(LOG_ESP_NODE_OFFLINE, node->nodeId, dataReceivedThreshold / 1000);
+        node->offline = true;
     }
-    return timeStamp;
-}
\ No newline at end of file
+}
+
+String getTimeStamp()
+{
+    return String(systemClock.timestamp());
+}
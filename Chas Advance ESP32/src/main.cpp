@@ -2,30 +2,61 @@
 #include "mockJson.h"
 #include "wifiHandler.h"
 #include "espLogger.h"
+#include "processing.h"
+#include "log.h"
+#include "memoryMonitor.h"
+#include <scheduler.h>
+
+#define HTTP_PERIOD_MS 2
+#define TIMEOUT_CHECK_PERIOD_MS 1000
 
 Logger logger;
 
+static uint32_t clockMillis() { return millis(); }
+// delay() hands the time to FreeRTOS so the idle task can sleep the CPU
+static void idleDelay(uint32_t waitMs) { delay(waitMs); }
+Scheduler scheduler(clockMillis, idleDelay);
+
+static void serviceHttp()
+{
+  MemScope scope(MEM_TAG_HTTP);
+  server.handleClient();
+}
+static void checkTimeout() { checkDataTimeout(nodes); }
+
 void setup()
 {
+  // Before anything else allocates
+  memoryBegin();
+  memoryWatchTask("loop", NULL);
+
+  // No wait for a serial monitor, the gateway should take data as soon as it can
   Serial.begin(115200);
-  delay(3000);
   Serial.println("Starting ESP32...");
 
   //Initialize logger
   logger.begin();
   logStartup();
 
+  // Decoded readings are processed on the other core
+  startProcessingTask();
+
+  // AP and /data server come up at once, the station joins in the background
+  initWifi();
+
   // Print all previous log entries
   logger.printAll();
 
-  initWifi();
+  // Incoming POSTs are serviced every few ms instead of once per second
+  scheduler.add("http", serviceHttp, HTTP_PERIOD_MS, 5);
+  scheduler.add("network", serviceNetwork, NET_SERVICE_PERIOD_MS, 50);
+  scheduler.add("timeout", checkTimeout, TIMEOUT_CHECK_PERIOD_MS, 100);
+  // Log lines are written in the background, a few at a time
+  scheduler.add("log", serviceLog, LOG_DRAIN_PERIOD_MS, 50);
 }
 
 void loop()
 {
-  checkDataTimeout(timeSinceDataReceived);
-
-  server.handleClient();
-  delay(1000);
+  scheduler.run();
 }
 
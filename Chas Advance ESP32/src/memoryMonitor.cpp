@@ -0,0 +1,58 @@
+#include "memoryMonitor.h"
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#else
+#include <hostAlloc.h>
+#endif
+
+static const char *const tagNames[MEM_TAG_COUNT] = {"other", "http", "processing", "logger", "upstream", "network"};
+
+#ifdef ESP_PLATFORM
+// Host tasks are threads without a stack watermark, only the boards report stacks
+static const char *taskNames[MEM_MAX_STACKS];
+static TaskHandle_t tasks[MEM_MAX_STACKS];
+static size_t taskCount = 0;
+#endif
+
+void memoryBegin()
+{
+    memSetTagNames(tagNames, MEM_TAG_COUNT);
+#ifndef ESP_PLATFORM
+    hostSetAllocationHook(memCountAllocation);
+#endif
+}
+
+void memoryWatchTask(const char *name, TaskHandle_t task)
+{
+#ifdef ESP_PLATFORM
+    if (taskCount >= MEM_MAX_STACKS)
+        return;
+    taskNames[taskCount] = name;
+    tasks[taskCount] = task != NULL ? task : xTaskGetCurrentTaskHandle();
+    taskCount++;
+#else
+    // Host tasks are threads without a stack high-water mark
+    (void)name;
+    (void)task;
+#endif
+}
+
+MemSnapshot memorySnapshot()
+{
+    MemSnapshot snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+#ifdef ESP_PLATFORM
+    // IDF tracks the low-water mark of every heap itself
+    snapshot.heapFree = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    snapshot.heapLargest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    snapshot.heapMinFree = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    for (size_t i = 0; i < taskCount; i++)
+    {
+        // In bytes on the ESP32, FreeRTOS counts stack words elsewhere
+        snapshot.stackNames[i] = taskNames[i];
+        snapshot.stackFree[i] = uxTaskGetStackHighWaterMark(tasks[i]);
+    }
+    snapshot.stackCount = taskCount;
+#endif
+    return snapshot;
+}
@@ -0,0 +1,143 @@
+#include "metrics.h"
+#include <stdarg.h>
+
+static const uint32_t bucketBounds[METRICS_BUCKETS] = METRICS_BUCKET_BOUNDS_US;
+
+static const char *const stageNames[STAGE_COUNT] = {
+    "ingest_feed", "ingest_finish", "enqueue",      "reply",    "request",  "median",
+    "forward",     "logger",        "logger_flush", "upstream", "log_drain"};
+
+static LatencyHistogram histograms[STAGE_COUNT];
+
+// ==== RECORDING ====
+
+void LatencyHistogram::record(uint32_t us)
+{
+    size_t bucket = 0;
+    while (bucket < METRICS_BUCKETS && us > bucketBounds[bucket])
+        bucket++;
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sumUs.fetch_add(us, std::memory_order_relaxed);
+    // Single writer per stage, no compare and swap needed
+    if (us > maxUs.load(std::memory_order_relaxed))
+        maxUs.store(us, std::memory_order_relaxed);
+}
+
+void metricsRecord(MetricStage stage, uint32_t start)
+{
+    uint32_t elapsed = metricsStart() - start;
+#ifdef ESP_PLATFORM
+    // Read once, the CPU clock does not change at runtime
+    static uint32_t cyclesPerUs = getCpuFrequencyMhz();
+    elapsed /= cyclesPerUs;
+#endif
+    histograms[stage].record(elapsed);
+}
+
+const LatencyHistogram &stageHistogram(MetricStage stage)
+{
+    return histograms[stage];
+}
+
+const char *stageName(MetricStage stage)
+{
+    return stage < STAGE_COUNT ? stageNames[stage] : "unknown";
+}
+
+// ==== TEXT FORMAT ====
+
+void MetricsWriter::print(const char *format, ...)
+{
+    // Render into the free part of the chunk, send the chunk and retry if it did not fit
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(chunk + length, sizeof(chunk) - length, format, args);
+        va_end(args);
+        if (n < 0)
+            return;
+        if (length + n < sizeof(chunk))
+        {
+            length += n;
+            return;
+        }
+        flush();
+    }
+}
+
+void MetricsWriter::flush()
+{
+    if (length == 0)
+        return;
+    output(chunk, length, context);
+    total += length;
+    length = 0;
+}
+
+void MetricsWriter::family(const char *name, const char *type, const char *help)
+{
+    print("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void MetricsWriter::sample(const char *name, const char *labels, uint64_t value)
+{
+    if (labels != NULL)
+        print("%s{%s} %llu\n", name, labels, (unsigned long long)value);
+    else
+        print("%s %llu\n", name, (unsigned long long)value);
+}
+
+void MetricsWriter::sample(const char *name, const char *labels, double value)
+{
+    if (labels != NULL)
+        print("%s{%s} %.9g\n", name, labels, value);
+    else
+        print("%s %.9g\n", name, value);
+}
+
+void MetricsWriter::counter(const char *name, const char *help, uint64_t value)
+{
+    family(name, "counter", help);
+    sample(name, NULL, value);
+}
+
+void MetricsWriter::gauge(const char *name, const char *help, double value)
+{
+    family(name, "gauge", help);
+    sample(name, NULL, value);
+}
+
+void MetricsWriter::stageHistograms(const char *name, const char *help)
+{
+    family(name, "histogram", help);
+    for (size_t s = 0; s < STAGE_COUNT; s++)
+    {
+        const LatencyHistogram &h = histograms[s];
+        // Buckets are cumulative in the text format
+        uint32_t cumulative = 0;
+        for (size_t b = 0; b < METRICS_BUCKETS; b++)
+        {
+            cumulative += h.buckets[b].load(std::memory_order_relaxed);
+            print("%s_bucket{stage=\"%s\",le=\"%g\"} %lu\n", name, stageNames[s], bucketBounds[b] / 1e6,
+                  (unsigned long)cumulative);
+        }
+        cumulative += h.buckets[METRICS_BUCKETS].load(std::memory_order_relaxed);
+        print("%s_bucket{stage=\"%s\",le=\"+Inf\"} %lu\n", name, stageNames[s], (unsigned long)cumulative);
+        // Count from the buckets, so it matches +Inf even while a stage is being recorded
+        print("%s_sum{stage=\"%s\"} %.6f\n%s_count{stage=\"%s\"} %lu\n", name, stageNames[s],
+              h.sumUs.load(std::memory_order_relaxed) / 1e6, name, stageNames[s], (unsigned long)cumulative);
+    }
+
+    // The slowest run hides in the +Inf bucket otherwise
+    print("# HELP %s_max Slowest run of each stage since boot\n# TYPE %s_max gauge\n", name, name);
+    for (size_t s = 0; s < STAGE_COUNT; s++)
+        print("%s_max{stage=\"%s\"} %.6f\n", name, stageNames[s], histograms[s].maxUs.load(std::memory_order_relaxed) / 1e6);
+}
+
+size_t MetricsWriter::finish()
+{
+    flush();
+    return total;
+}
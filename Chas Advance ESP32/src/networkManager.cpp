@@ -0,0 +1,218 @@
+#include "networkManager.h"
+#include "log.h"
+#include <Preferences.h>
+
+#define NET_CACHE_KEY "station"
+
+uint32_t ssidHash(const char *ssid)
+{
+    uint32_t hash = 2166136261UL;
+    for (const char *c = ssid; *c != '\0'; c++)
+    {
+        hash ^= (uint8_t)*c;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+// ==== SIMULATED LINK ====
+
+SimulatedLink::SimulatedLink(ClockFunction clock, uint32_t joinMs, uint32_t fastJoinMs)
+    : clock(clock), joinMs(joinMs), fastJoinMs(fastJoinMs), joinStart(0), joinTime(0), channel(6),
+      available(true), joining(false), up(false)
+{
+}
+
+void SimulatedLink::startStation(const char *, const char *, const StationCache *cache)
+{
+    // A cache pointing at the wrong channel never finds the access point
+    bool fast = cache != NULL && cache->channel == channel;
+    joinTime = cache == NULL ? joinMs : fast ? fastJoinMs : UINT32_MAX;
+    joinStart = clock();
+    joining = true;
+    up = false;
+}
+
+LinkStatus SimulatedLink::status()
+{
+    if (up)
+        return LINK_UP;
+    if (!joining)
+        return LINK_IDLE;
+    if (!available)
+        return LINK_JOINING;
+    if (joinTime != UINT32_MAX && clock() - joinStart >= joinTime)
+    {
+        joining = false;
+        up = true;
+        return LINK_UP;
+    }
+    return LINK_JOINING;
+}
+
+bool SimulatedLink::readStation(StationCache &cache)
+{
+    if (!up)
+        return false;
+    const uint8_t bssid[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    memcpy(cache.bssid, bssid, sizeof(bssid));
+    cache.channel = channel;
+    cache.hasAddress = 1;
+    const uint8_t ip[4] = {192, 168, 1, 50}, gateway[4] = {192, 168, 1, 1}, subnet[4] = {255, 255, 255, 0};
+    memcpy(cache.ip, ip, 4);
+    memcpy(cache.gateway, gateway, 4);
+    memcpy(cache.subnet, subnet, 4);
+    memcpy(cache.dns, gateway, 4);
+    return true;
+}
+
+// ==== MANAGER ====
+
+NetworkManager::NetworkManager(NetworkLink &link, ClockFunction clock)
+    : link(link), clock(clock), ssid(""), password(""), cacheValid(false), state(NET_IDLE), stateStart(0),
+      retryDelay(NET_RETRY_MIN_MS), counters(), up(false)
+{
+    memset(&cache, 0, sizeof(cache));
+}
+
+void NetworkManager::begin(const char *networkSsid, const char *networkPassword)
+{
+    ssid = networkSsid;
+    password = networkPassword;
+    loadCache();
+    startJoin(cacheValid);
+}
+
+void NetworkManager::startJoin(bool fast)
+{
+    if (fast)
+    {
+#if NET_STATIC_IP
+        link.startStation(ssid, password, &cache);
+#else
+        // Skip the scan but still ask DHCP for an address
+        StationCache noAddress = cache;
+        noAddress.hasAddress = 0;
+        link.startStation(ssid, password, &noAddress);
+#endif
+    }
+    else
+    {
+        link.startStation(ssid, password, NULL);
+    }
+    state = fast ? NET_FAST_JOIN : NET_JOIN;
+    stateStart = clock();
+}
+
+void NetworkManager::service()
+{
+    uint32_t now = clock();
+    LinkStatus status = link.status();
+
+    switch (state)
+    {
+    case NET_IDLE:
+        break;
+
+    case NET_FAST_JOIN:
+    case NET_JOIN:
+        if (status == LINK_UP)
+        {
+            if (state == NET_FAST_JOIN)
+                counters.fastJoins++;
+            counters.lastJoinMs = now - stateStart;
+            joined();
+        }
+        else if (state == NET_FAST_JOIN && (status == LINK_FAILED || now - stateStart >= NET_FAST_JOIN_MS))
+        {
+            // The access point may have changed channel, look for it properly
+            counters.fastFailures++;
+            LOG_INFO(LOG_ESP_STATION_SCAN);
+            link.stopStation();
+            startJoin(false);
+        }
+        else if (status == LINK_FAILED || now - stateStart >= NET_JOIN_TIMEOUT_MS)
+        {
+            failed();
+        }
+        break;
+
+    case NET_UP:
+        if (status != LINK_UP)
+        {
+            counters.losses++;
+            up.store(false, std::memory_order_relaxed);
+            LOG_WARN(LOG_ESP_STATION_LOST);
+            link.stopStation();
+            startJoin(cacheValid);
+        }
+        break;
+
+    case NET_WAITING:
+        if (now - stateStart >= retryDelay)
+        {
+            retryDelay = min(retryDelay * 2, (uint32_t)NET_RETRY_MAX_MS);
+            startJoin(cacheValid);
+        }
+        break;
+    }
+}
+
+void NetworkManager::joined()
+{
+    counters.joins++;
+    state = NET_UP;
+    retryDelay = NET_RETRY_MIN_MS;
+    up.store(true, std::memory_order_relaxed);
+
+    StationCache current = cache;
+    current.ssidHash = ssidHash(ssid);
+    if (link.readStation(current))
+    {
+        LOG_INFO(LOG_ESP_STATION_UP, current.channel, counters.lastJoinMs);
+        LOG_INFO(LOG_ESP_STATION_IP, current.ip[0], current.ip[1], current.ip[2], current.ip[3]);
+        storeCache(current);
+    }
+}
+
+void NetworkManager::failed()
+{
+    counters.failures++;
+    link.stopStation();
+    state = NET_WAITING;
+    stateStart = clock();
+    LOG_WARN(LOG_ESP_STATION_RETRY, retryDelay);
+}
+
+void NetworkManager::loadCache()
+{
+    Preferences prefs;
+    cacheValid = false;
+    if (!prefs.begin(NET_CACHE_NAMESPACE, true))
+        return;
+    StationCache stored;
+    if (prefs.getBytes(NET_CACHE_KEY, &stored, sizeof(stored)) == sizeof(stored) && stored.ssidHash == ssidHash(ssid) &&
+        stored.channel != 0)
+    {
+        cache = stored;
+        cacheValid = true;
+    }
+    prefs.end();
+}
+
+// Writes the cache only when the network or lease changed, reconnects to the same
+// access point cost no NVS write
+void NetworkManager::storeCache(const StationCache &current)
+{
+    if (cacheValid && memcmp(&current, &cache, sizeof(cache)) == 0)
+        return;
+    cache = current;
+    cacheValid = true;
+
+    Preferences prefs;
+    if (!prefs.begin(NET_CACHE_NAMESPACE, false))
+        return;
+    prefs.putBytes(NET_CACHE_KEY, &cache, sizeof(cache));
+    prefs.end();
+    counters.cacheWrites++;
+}
@@ -0,0 +1,155 @@
+#include "nodeTable.h"
+#include <string.h>
+
+NodeTable::NodeTable()
+{
+    clear();
+}
+
+void NodeTable::clear()
+{
+    memset(used, 0, sizeof(used));
+    count = 0;
+    evicted = 0;
+}
+
+// Fibonacci hashing spreads consecutive node ids over the table
+size_t NodeTable::home(uint16_t nodeId) const
+{
+    return ((uint16_t)(nodeId * 40503u)) & (NODE_TABLE_SLOTS - 1);
+}
+
+int NodeTable::lookup(uint16_t nodeId) const
+{
+    size_t index = home(nodeId);
+    // The table is never full, so every run ends at an unused slot
+    while (used[index])
+    {
+        if (slots[index].nodeId == nodeId)
+            return index;
+        index = (index + 1) & (NODE_TABLE_SLOTS - 1);
+    }
+    return -1;
+}
+
+NodeState *NodeTable::find(uint16_t nodeId)
+{
+    int index = lookup(nodeId);
+    return index < 0 ? NULL : &slots[index];
+}
+
+NodeState &NodeTable::get(uint16_t nodeId, uint32_t now)
+{
+    int found = lookup(nodeId);
+    if (found >= 0)
+        return slots[found];
+
+    if (count >= NODE_TABLE_MAX_NODES)
+        evictOldest(now);
+
+    size_t index = home(nodeId);
+    while (used[index])
+        index = (index + 1) & (NODE_TABLE_SLOTS - 1);
+
+    NodeState &node = slots[index];
+    memset(&node, 0, sizeof(node));
+    node.nodeId = nodeId;
+    node.lastSeen = now;
+    node.lastReading = makeSensorData(0.0f, 0.0f, true);
+    node.window.reset();
+    used[index] = true;
+    count++;
+    return node;
+}
+
+void NodeTable::remove(uint16_t nodeId)
+{
+    int index = lookup(nodeId);
+    if (index >= 0)
+        removeSlot(index);
+}
+
+// Backward shift deletion: entries after the hole move up unless that
+// would put them before their home slot
+void NodeTable::removeSlot(size_t hole)
+{
+    used[hole] = false;
+    count--;
+
+    size_t index = (hole + 1) & (NODE_TABLE_SLOTS - 1);
+    while (used[index])
+    {
+        size_t want = home(slots[index].nodeId);
+        // Distance from the home slot to the hole vs. to the current slot
+        if (((hole - want) & (NODE_TABLE_SLOTS - 1)) < ((index - want) & (NODE_TABLE_SLOTS - 1)))
+        {
+            slots[hole] = slots[index];
+            used[hole] = true;
+            used[index] = false;
+            hole = index;
+        }
+        index = (index + 1) & (NODE_TABLE_SLOTS - 1);
+    }
+}
+
+// Only runs when the table is full, so the linear scan is rare
+void NodeTable::evictOldest(uint32_t now)
+{
+    size_t oldest = NODE_TABLE_SLOTS;
+    uint32_t oldestAge = 0;
+    for (size_t i = 0; i < NODE_TABLE_SLOTS; i++)
+    {
+        if (used[i] && (oldest == NODE_TABLE_SLOTS || now - slots[i].lastSeen > oldestAge))
+        {
+            oldest = i;
+            oldestAge = now - slots[i].lastSeen;
+        }
+    }
+    if (oldest < NODE_TABLE_SLOTS)
+    {
+        removeSlot(oldest);
+        evicted++;
+    }
+}
+
+void NodeTable::record(NodeState &node, const SensorData *readings, size_t count, uint32_t now)
+{
+    // The averages start from the first batch with a valid reading
+    bool firstValid = node.lastReading.error;
+    int32_t tempSum = 0;
+    int32_t humSum = 0;
+    size_t valid = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (readings[i].error)
+        {
+            node.errors++;
+            continue;
+        }
+        tempSum += readings[i].tempCenti;
+        humSum += readings[i].humCenti;
+        node.lastReading = readings[i];
+        valid++;
+    }
+
+    if (valid > 0)
+    {
+        int16_t tempMean = tempSum / (int32_t)valid;
+        int16_t humMean = humSum / (int32_t)valid;
+        if (firstValid)
+        {
+            node.averageTemp = tempMean;
+            node.averageHum = humMean;
+        }
+        else
+        {
+            node.averageTemp += (tempMean - node.averageTemp) / (1 << NODE_AVERAGE_SHIFT);
+            node.averageHum += (humMean - node.averageHum) / (1 << NODE_AVERAGE_SHIFT);
+        }
+    }
+
+    node.lastSeen = now;
+    node.offline = false;
+    node.batches++;
+    node.readings += count;
+}
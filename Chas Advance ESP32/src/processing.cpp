@@ -0,0 +1,290 @@
+#include "processing.h"
+#include "spscQueue.h"
+#include "espLogger.h"
+#include "log.h"
+#include "networkManager.h"
+#include <time.h>
+#include "flashStore.h"
+#include "storeForward.h"
+#include "forwarder.h"
+#include "metrics.h"
+#include "memoryMonitor.h"
+#include "nodeTable.h"
+
+extern Logger logger;
+
+static SpscQueue<QueuedReading, PROCESSING_QUEUE_SIZE> queue;
+static TaskHandle_t processingTask = NULL;
+static volatile uint32_t dropped = 0;
+
+#ifdef ESP_PLATFORM
+static PartitionFlash backlogFlash;
+#else
+// Host builds keep the backlog in a file
+static FileFlash backlogFlash("backlog_flash.bin", 64 * 4096);
+#endif
+static StoreForwardQueue backlog(backlogFlash);
+static bool backlogReady = false;
+
+// Readings of failed upstream requests go back to flash
+static void keepReadings(const StoredReading *readings, size_t count)
+{
+    for (size_t i = 0; backlogReady && i < count; i++)
+        backlog.append(readings[i]);
+}
+
+// Upstream batch numbers are reserved in the backlog flash so they survive a restart
+static bool reserveSequences(uint32_t limit)
+{
+    return backlogReady && backlog.reserveSequences(limit);
+}
+
+static uint32_t forwardClock() { return millis(); }
+static Forwarder forwarder(FORWARD_HOST, FORWARD_PORT, forwardClock, keepReadings, reserveSequences);
+
+// Last kept point of every node's series that went upstream
+struct SeriesEnd
+{
+    uint16_t nodeId;
+    StoredReading point;
+};
+static SeriesEnd seriesEnds[NODE_TABLE_MAX_NODES];
+static size_t seriesEndCount = 0;
+
+static SeriesEnd &seriesEnd(uint16_t nodeId)
+{
+    for (size_t i = 0; i < seriesEndCount; i++)
+    {
+        if (seriesEnds[i].nodeId == nodeId)
+            return seriesEnds[i];
+    }
+    // More nodes than the table holds only costs a repeated point now and then
+    SeriesEnd &end = seriesEnds[seriesEndCount < NODE_TABLE_MAX_NODES ? seriesEndCount++ : nodeId % NODE_TABLE_MAX_NODES];
+    end.nodeId = nodeId;
+    end.point.series = CHANGE_FILTER_OFF;
+    return end;
+}
+
+/* A node starts every filtered batch with the point its previous batch ended with.
+    A series only starts with a new point after the node restarted, so equal values
+    are the repeat. Times can't tell: the repeat is stamped again, after a clock sync
+    of the node or the time the gateway received an unsynced batch at. */
+static bool repeatsSeriesEnd(const StoredReading &end, const StoredReading &r)
+{
+    return r.series != CHANGE_FILTER_OFF && end.series == r.series && end.error == r.error &&
+           end.temperature == r.temperature && end.humidity == r.humidity;
+}
+
+/* Forwards a batch upstream, or keeps it in flash while the upstream is unreachable.
+    A change filtered batch goes as its kept points with the node's tolerances, the
+    backend rebuilds the series the way reconstructBatch does here. */
+static void forwardBatch(const QueuedReading &item, const SensorBatch &batch, bool connected)
+{
+    if (batch.size() == 0)
+        return;
+
+    // Without the node's time the batch ends now, a series keeps its spacing
+    uint32_t now = systemClock.epochMillis() / 1000;
+    uint16_t last = batch.timeOffset[batch.size() - 1];
+    SeriesEnd &end = seriesEnd(item.nodeId);
+    StoredReading r;
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        if (item.epoch != 0)
+            r.timestamp = item.epoch + batch.timeOffset[i];
+        else
+            r.timestamp = now != 0 ? now - (last - batch.timeOffset[i]) : 0;
+        r.nodeId = item.nodeId;
+        r.temperature = batch.tempCenti[i];
+        r.humidity = batch.humCenti[i];
+        r.error = batch.error[i];
+        r.series = item.data.flags;
+        r.tempTolerance = r.series != CHANGE_FILTER_OFF ? item.tempTolerance : 0;
+        r.humTolerance = r.series != CHANGE_FILTER_OFF ? item.humTolerance : 0;
+
+        // The repeat only let the node's batch be rebuilt on its own, upstream has the point
+        if (i == 0 && repeatsSeriesEnd(end.point, r))
+            continue;
+
+        // A full batch goes out before the next reading is added, while the pipeline has room
+        if (connected && forwarder.space() == 0)
+            forwarder.service(network.connected());
+        if (!connected || !forwarder.add(r))
+            keepReadings(&r, 1);
+    }
+    end.point = r;
+}
+
+// Tops up the pending upstream batch from the backlog whenever the forwarder could send it at once
+static void replayBacklog()
+{
+    if (!backlogReady || !forwarder.connected() || !forwarder.canSend() || backlog.size() == 0)
+        return;
+
+    static StoredReading chunk[FORWARD_BATCH_READINGS];
+    size_t n = backlog.peek(chunk, forwarder.space());
+    for (size_t i = 0; i < n; i++)
+        forwarder.add(chunk[i]);
+    if (n > 0)
+    {
+        backlog.consume(n);
+        LOG_INFO(LOG_ESP_REPLAYED, n);
+    }
+}
+
+// Processes one completed batch of one node: forwarding, median and logger (NVS writes happen here, off the receive path).
+// samples is the batch itself, or the series rebuilt from its kept points.
+static void processBatch(const QueuedReading &item, const SensorBatch &batch, const SensorBatch &samples)
+{
+    // The logger keeps data locally while the upstream server can't be reached
+    MemScope scope(MEM_TAG_PROCESSING);
+    bool connected = forwarder.connected();
+    uint32_t start = metricsStart();
+    forwardBatch(item, batch, connected);
+    metricsRecord(STAGE_FORWARD, start);
+
+    start = metricsStart();
+    SensorData median = calcMedian(samples);
+    metricsRecord(STAGE_MEDIAN, start);
+
+    MemScope loggerScope(MEM_TAG_LOGGER);
+    start = metricsStart();
+    logger.update(connected, item.nodeId, median);
+    metricsRecord(STAGE_LOGGER, start);
+}
+
+// Processes the readings collected for one batch and empties it
+static void finishBatch(const QueuedReading &item, SensorBatch &batch)
+{
+    static SensorBatch reconstructed;
+
+    // A change filtered batch only holds the kept points, the median needs the series
+    ChangeFilterMode series = (ChangeFilterMode)item.data.flags;
+    if (series != CHANGE_FILTER_OFF)
+    {
+        reconstructBatch(batch, series, reconstructed);
+        processBatch(item, batch, reconstructed);
+    }
+    else
+    {
+        processBatch(item, batch, batch);
+    }
+    batch.clear();
+}
+
+static void processingLoop(void *)
+{
+    static SensorBatch batch;
+    uint32_t arrival = 0;
+    QueuedReading item;
+
+    while (true)
+    {
+        // Sleep until the receive side signals new data, a response may have arrived or it is time to replay
+        bool replaying = forwarder.connected() && backlogSize() > 0;
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(forwarder.busy() || replaying ? FORWARD_POLL_MS : REPLAY_INTERVAL_MS));
+
+        while (queue.pop(item))
+        {
+            // Readings from a synced node carry their own time, others share the arrival time
+            if (batch.size() == 0)
+                arrival = systemClock.epoch();
+            logSensorData(item.epoch != 0 ? item.epoch + item.data.timeOffset : arrival, item.nodeId, item.data);
+
+            // Ingest keeps a batch within the capacity, should one still be longer it is
+            // processed in parts rather than losing the rest
+            if (batch.full())
+                finishBatch(item, batch);
+            batch.push(item.data);
+
+            if (item.lastInBatch)
+                finishBatch(item, batch);
+        }
+
+        {
+            MemScope scope(MEM_TAG_UPSTREAM);
+            replayBacklog();
+            // Idle calls return at once, only calls with work are timed
+            bool pending = forwarder.busy();
+            uint32_t start = metricsStart();
+            forwarder.service(network.connected());
+            if (pending)
+                metricsRecord(STAGE_UPSTREAM, start);
+        }
+        MemScope scope(MEM_TAG_LOGGER);
+        logger.service();
+    }
+}
+
+void startProcessingTask()
+{
+    // Without the partition of partitions.csv readings are lost while upstream is down
+    bool flashFound = backlogFlash.begin();
+    backlogReady = flashFound && backlog.begin();
+    if (backlogReady)
+    {
+        forwarder.resumeSequence(backlog.reservedSequences());
+        Serial.print("Backlog readings in flash: ");
+        Serial.println(backlog.size());
+    }
+    else if (!flashFound)
+    {
+        Serial.println("ERROR: no \"" FLASH_STORE_PARTITION "\" partition, flash with partitions.csv. Backlog disabled");
+        LOG_ERROR(LOG_ESP_BACKLOG_MISSING);
+    }
+    else
+    {
+        Serial.println("Backlog flash not available");
+    }
+
+    xTaskCreatePinnedToCore(processingLoop, "processing", PROCESSING_STACK_SIZE, NULL,
+                            PROCESSING_PRIORITY, &processingTask, PROCESSING_CORE);
+    memoryWatchTask("processing", processingTask);
+}
+
+bool processingHasSpace(size_t count)
+{
+    if (queue.freeSpace() >= count)
+        return true;
+    dropped++;
+    return false;
+}
+
+bool enqueueBatch(uint16_t nodeId, uint32_t epoch, const SensorData *readings, size_t count,
+                  uint8_t tempTolerance, uint8_t humTolerance)
+{
+    if (count == 0)
+        return true;
+
+    // Only this side pushes, so once the space is there the whole batch fits
+    if (queue.freeSpace() < count)
+    {
+        dropped++;
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        QueuedReading item = {readings[i], nodeId, epoch, i == count - 1, tempTolerance, humTolerance};
+        queue.push(item);
+    }
+
+    if (processingTask != NULL)
+        xTaskNotifyGive(processingTask);
+    return true;
+}
+
+uint32_t droppedBatches()
+{
+    return dropped;
+}
+
+size_t backlogSize()
+{
+    return backlogReady ? backlog.size() : 0;
+}
+
+const ForwarderStats &forwarderStats()
+{
+    return forwarder.stats();
+}
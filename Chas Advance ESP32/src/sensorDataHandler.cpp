@@ -1,29 +1,40 @@
 #include "sensorDataHandler.h"
+#include <sensorStats.h>
 
-float median(std::vector<float>& values) {
-    if (values.empty()) return NAN;
-    std::sort(values.begin(), values.end());
-    size_t n = values.size();
-    if (n % 2 == 1) return values[n / 2];
-    return (values[n / 2 - 1] + values[n / 2]) / 2.0;
-}
+SensorData calcMedian(const SensorBatch &batch) {
+    // Fixed stack storage, no heap use per call
+    int16_t temps[MEDIAN_MAX_READINGS];
+    int16_t hums[MEDIAN_MAX_READINGS];
+    size_t n = batch.validTemperatures(temps);
+    batch.validHumidities(hums);
 
-SensorData calcMedian(JsonArray& arr) {
-    std::vector<float> temps;
-    std::vector<float> hums;
+    // Medians are in hundredths already, only the even-count average needs rounding
+    return makeSensorData(batchFromFixed(lroundf(statsMedian(temps, n))),
+                          batchFromFixed(lroundf(statsMedian(hums, n))), n == 0);
+}
 
-    for (JsonObject obj : arr) {
-        bool error = obj["error"] | false;
-        if (!error) {
-            temps.push_back(obj["temperature"] | 0.0);
-            hums.push_back(obj["humidity"] | 0.0);
-        }
+void reconstructBatch(const SensorBatch &points, ChangeFilterMode mode, SensorBatch &out) {
+    SeriesPoint kept[MEDIAN_MAX_READINGS];
+    for (size_t i = 0; i < points.size(); i++) {
+        kept[i].time = points.timeOffset[i];
+        kept[i].temperature = points.tempCenti[i];
+        kept[i].humidity = points.humCenti[i];
+        kept[i].error = points.error[i];
     }
 
-    SensorData medianData;
-    medianData.temperature = median(temps);
-    medianData.humidity = median(hums);
-    medianData.error = temps.empty() || hums.empty();
+    // Spread the samples over the whole batch, at least a second apart
+    out.clear();
+    if (points.size() == 0)
+        return;
+    uint32_t span = kept[points.size() - 1].time - kept[0].time;
+    uint32_t step = max((uint32_t)1, (span + MEDIAN_MAX_READINGS - 2) / (MEDIAN_MAX_READINGS - 1));
 
-    return medianData;
-}
\ No newline at end of file
+    SeriesPoint samples[MEDIAN_MAX_READINGS];
+    size_t n = changeFilterExpand(mode, kept, points.size(), step, samples, MEDIAN_MAX_READINGS);
+    for (size_t i = 0; i < n; i++) {
+        SensorData data = makeSensorData(0.0f, 0.0f, samples[i].error, samples[i].time);
+        data.tempCenti = samples[i].temperature;
+        data.humCenti = samples[i].humidity;
+        out.push(data);
+    }
+}
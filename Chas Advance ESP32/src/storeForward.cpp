@@ -0,0 +1,343 @@
+#include "storeForward.h"
+#include <string.h>
+#include <batchCodec.h>
+
+#define RECORD_MAGIC 0xA5
+#define SEGMENT_MAGIC 0x5E
+#define RESERVE_MAGIC 0xA6
+#define SEGMENT_HEADER_SIZE 14
+#define STATE_PENDING 0xFF
+#define STATE_DELIVERED 0x00
+
+// Record layout:
+//   0 magic, 1 state (not covered by the CRC so it can be cleared later),
+//   2-3 CRC over bytes 4-19, 4-7 sequence, 8-11 timestamp, 12-13 node id,
+//   14-15 temperature, 16-17 humidity, 18 flags, 19 temperature tolerance
+// Flags: bit 0 error, bits 1-2 series (ChangeFilterMode), bits 3-7 humidity tolerance
+// in STORE_HUM_TOLERANCE_STEP. Older records have 0 or 1 there and 0xFF in byte 19,
+// they read as plain samples.
+// Reservation records use the same layout with their own magic, the state is always
+// delivered and 4-7 hold the sequence reservation.
+// Segment header layout:
+//   0 magic, 2-3 CRC over 4-7, 4-7 segment sequence,
+//   8-11 sequence reservation, 12-13 CRC over 8-11 (erased in older queues)
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    put16(p, v & 0xFFFF);
+    put16(p + 2, v >> 16);
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+void StoreForwardQueue::advance(Position &p) const
+{
+    // A full write segment ends at writePos instead of wrapping into the next sector
+    if (++p.slot >= slotsPerSector && p.sector != writePos.sector)
+    {
+        p.sector = (p.sector + 1) % sectors;
+        p.slot = 1;
+    }
+}
+
+bool StoreForwardQueue::readSegmentSeq(uint32_t sector, uint32_t &seq)
+{
+    uint8_t header[8];
+    if (!flash.read(sector * flash.sectorSize(), header, sizeof(header)))
+        return false;
+    if (header[0] != SEGMENT_MAGIC || get16(header + 2) != batchCrc16(header + 4, 4))
+        return false;
+    seq = get32(header + 4);
+    return true;
+}
+
+bool StoreForwardQueue::startSegment(uint32_t sector)
+{
+    uint8_t header[SEGMENT_HEADER_SIZE];
+    memset(header, 0xFF, sizeof(header));
+    header[0] = SEGMENT_MAGIC;
+    put32(header + 4, ++segmentSeq);
+    put16(header + 2, batchCrc16(header + 4, 4));
+    put32(header + 8, reserved);
+    put16(header + 12, batchCrc16(header + 8, 4));
+
+    uint32_t base = sector * flash.sectorSize();
+    return flash.eraseSector(base) && flash.write(base, header, sizeof(header));
+}
+
+bool StoreForwardQueue::readReservation(const Position &p, uint32_t &limit)
+{
+    uint8_t rec[STORE_RECORD_SIZE];
+    if (!flash.read(address(p), rec, sizeof(rec)))
+        return false;
+    if (rec[0] != RESERVE_MAGIC || get16(rec + 2) != batchCrc16(rec + 4, STORE_RECORD_SIZE - 4))
+        return false;
+    limit = get32(rec + 4);
+    return true;
+}
+
+int StoreForwardQueue::readRecord(const Position &p, StoredReading *out)
+{
+    uint8_t rec[STORE_RECORD_SIZE];
+    if (!flash.read(address(p), rec, sizeof(rec)))
+        return 0;
+
+    if (rec[0] == 0xFF)
+        return -1;
+    // Torn writes and other corruption are skipped
+    if (rec[0] != RECORD_MAGIC || get16(rec + 2) != batchCrc16(rec + 4, STORE_RECORD_SIZE - 4))
+        return 0;
+    if (rec[1] != STATE_PENDING)
+        return 0;
+
+    if (out != NULL)
+    {
+        out->sequence = get32(rec + 4);
+        out->timestamp = get32(rec + 8);
+        out->nodeId = get16(rec + 12);
+        out->temperature = (int16_t)get16(rec + 14);
+        out->humidity = (int16_t)get16(rec + 16);
+        out->error = rec[18] & 1;
+        out->series = (rec[18] >> 1) & 3;
+        out->tempTolerance = out->series != 0 ? rec[19] : 0;
+        unsigned humTolerance = (rec[18] >> 3) * STORE_HUM_TOLERANCE_STEP;
+        out->humTolerance = humTolerance > 255 ? 255 : humTolerance;
+    }
+    return 1;
+}
+
+bool StoreForwardQueue::begin()
+{
+    sectors = flash.size() / flash.sectorSize();
+    slotsPerSector = flash.sectorSize() / STORE_RECORD_SIZE;
+    segmentSeq = 0;
+    nextSequence = 0;
+    reserved = 0;
+    pending = 0;
+    droppedCount = 0;
+
+    if (sectors < 2)
+        return false;
+
+    // Find the newest and oldest valid segments
+    bool found = false;
+    uint32_t newest = 0, oldest = 0, oldestSeq = 0;
+    for (uint32_t s = 0; s < sectors; s++)
+    {
+        uint32_t seq;
+        if (!readSegmentSeq(s, seq))
+            continue;
+        if (!found || seq > segmentSeq)
+        {
+            segmentSeq = seq;
+            newest = s;
+        }
+        if (!found || seq < oldestSeq)
+        {
+            oldestSeq = seq;
+            oldest = s;
+        }
+        found = true;
+    }
+
+    if (!found)
+    {
+        // Empty or foreign content, format the first segment
+        writePos = {0, 1};
+        readPos = writePos;
+        return startSegment(0);
+    }
+
+    // The reservation is in the newest segment header, raised by records after it
+    uint8_t header[SEGMENT_HEADER_SIZE];
+    if (flash.read(newest * flash.sectorSize(), header, sizeof(header)) && get16(header + 12) == batchCrc16(header + 8, 4))
+        reserved = get32(header + 8);
+
+    // Write position: first erased slot in the newest segment
+    writePos = {newest, 1};
+    StoredReading r;
+    while (writePos.slot < slotsPerSector)
+    {
+        int state = readRecord(writePos, &r);
+        uint32_t limit;
+        if (state == -1)
+            break;
+        if (state == 1)
+            nextSequence = r.sequence + 1;
+        else if (readReservation(writePos, limit) && limit > reserved)
+            reserved = limit;
+        writePos.slot++;
+    }
+
+    // Read position: first pending record from the oldest segment on.
+    // Segments that are not valid (e.g. erased mid-drop) are skipped.
+    readPos = {oldest, 1};
+    bool readFound = false;
+    for (Position p = readPos; !same(p, writePos);)
+    {
+        uint32_t seq;
+        if (p.slot == 1 && p.sector != newest && !readSegmentSeq(p.sector, seq))
+        {
+            p.sector = (p.sector + 1) % sectors;
+            continue;
+        }
+
+        int state = readRecord(p, &r);
+        if (state == 1)
+        {
+            if (!readFound)
+                readPos = p;
+            readFound = true;
+            pending++;
+            if (r.sequence >= nextSequence)
+                nextSequence = r.sequence + 1;
+        }
+        else if (state == -1 && p.sector != newest)
+        {
+            // Rest of an older segment was never written
+            p.sector = (p.sector + 1) % sectors;
+            p.slot = 1;
+            continue;
+        }
+        advance(p);
+    }
+
+    if (!readFound)
+        readPos = writePos;
+    return true;
+}
+
+void StoreForwardQueue::dropSegment(uint32_t sector)
+{
+    // Only the segment holding the read position can still have pending records
+    if (pending == 0 || readPos.sector != sector)
+        return;
+
+    Position p = readPos;
+    while (p.sector == sector && !same(p, writePos))
+    {
+        if (readRecord(p, NULL) == 1)
+        {
+            pending--;
+            droppedCount++;
+        }
+        advance(p);
+    }
+    readPos = p;
+}
+
+bool StoreForwardQueue::nextSlot()
+{
+    if (writePos.slot < slotsPerSector)
+        return true;
+
+    uint32_t next = (writePos.sector + 1) % sectors;
+    dropSegment(next);
+
+    bool wasEmpty = same(readPos, writePos);
+    if (!startSegment(next))
+        return false;
+    writePos = {next, 1};
+    if (wasEmpty || readPos.sector == next)
+        readPos = writePos;
+    return true;
+}
+
+bool StoreForwardQueue::append(StoredReading reading)
+{
+    if (!nextSlot())
+        return false;
+
+    reading.sequence = nextSequence++;
+
+    uint8_t rec[STORE_RECORD_SIZE];
+    memset(rec, 0xFF, sizeof(rec));
+    rec[0] = RECORD_MAGIC;
+    rec[1] = STATE_PENDING;
+    put32(rec + 4, reading.sequence);
+    put32(rec + 8, reading.timestamp);
+    put16(rec + 12, reading.nodeId);
+    put16(rec + 14, (uint16_t)reading.temperature);
+    put16(rec + 16, (uint16_t)reading.humidity);
+    // A rounded up tolerance still bounds the reconstruction error, 255 takes 26 steps
+    unsigned humSteps = (reading.humTolerance + STORE_HUM_TOLERANCE_STEP - 1) / STORE_HUM_TOLERANCE_STEP;
+    rec[18] = (reading.error ? 1 : 0) | (reading.series & 3) << 1 | humSteps << 3;
+    rec[19] = reading.tempTolerance;
+    put16(rec + 2, batchCrc16(rec + 4, STORE_RECORD_SIZE - 4));
+
+    if (!flash.write(address(writePos), rec, sizeof(rec)))
+        return false;
+
+    writePos.slot++;
+    pending++;
+    return true;
+}
+
+size_t StoreForwardQueue::peek(StoredReading *out, size_t max)
+{
+    size_t n = 0;
+    for (Position p = readPos; n < max && !same(p, writePos); advance(p))
+    {
+        if (readRecord(p, &out[n]) == 1)
+            n++;
+    }
+    return n;
+}
+
+void StoreForwardQueue::consume(size_t n)
+{
+    const uint8_t delivered = STATE_DELIVERED;
+    while (n > 0 && !same(readPos, writePos))
+    {
+        if (readRecord(readPos, NULL) == 1)
+        {
+            flash.write(address(readPos) + 1, &delivered, 1);
+            pending--;
+            n--;
+        }
+        advance(readPos);
+    }
+
+    // Skip anything that can't be read so readPos points at the next pending record
+    while (pending > 0 && !same(readPos, writePos) && readRecord(readPos, NULL) != 1)
+        advance(readPos);
+}
+
+bool StoreForwardQueue::reserveSequences(uint32_t limit)
+{
+    if (limit <= reserved)
+        return true;
+
+    // A segment started here already carries the new limit in its header
+    uint32_t previous = reserved;
+    reserved = limit;
+
+    uint8_t rec[STORE_RECORD_SIZE];
+    memset(rec, 0xFF, sizeof(rec));
+    rec[0] = RESERVE_MAGIC;
+    rec[1] = STATE_DELIVERED;
+    put32(rec + 4, limit);
+    put16(rec + 2, batchCrc16(rec + 4, STORE_RECORD_SIZE - 4));
+
+    if (!nextSlot() || !flash.write(address(writePos), rec, sizeof(rec)))
+    {
+        reserved = previous;
+        return false;
+    }
+    writePos.slot++;
+    return true;
+}
@@ -1,35 +1,93 @@
 #include "wifiHandler.h"
 #include "ESPSECRETS.h"
-#include "espLogger.h"
+#include "httpServer.h"
 
-unsigned long timeSinceDataReceived = 0;
-WebServer server;
-extern Logger logger;
+// Station side of the ESP32 radio for the NetworkManager
+class EspLink : public NetworkLink
+{
+public:
+  void startStation(const char *ssid, const char *password, const StationCache *cache) override
+  {
+    if (cache != NULL && cache->hasAddress)
+      WiFi.config(IPAddress(cache->ip[0], cache->ip[1], cache->ip[2], cache->ip[3]),
+                  IPAddress(cache->gateway[0], cache->gateway[1], cache->gateway[2], cache->gateway[3]),
+                  IPAddress(cache->subnet[0], cache->subnet[1], cache->subnet[2], cache->subnet[3]),
+                  IPAddress(cache->dns[0], cache->dns[1], cache->dns[2], cache->dns[3]));
+    else
+      WiFi.config(IPAddress(), IPAddress(), IPAddress()); // back to DHCP
+
+    // A BSSID and channel skip the scan of all channels
+    if (cache != NULL)
+      WiFi.begin(ssid, password, cache->channel, cache->bssid);
+    else
+      WiFi.begin(ssid, password);
+  }
+
+  void stopStation() override { WiFi.disconnect(false); }
+
+  LinkStatus status() override
+  {
+    switch (WiFi.status())
+    {
+    case WL_CONNECTED:
+      return LINK_UP;
+    case WL_NO_SSID_AVAIL:
+    case WL_CONNECT_FAILED:
+    case WL_CONNECTION_LOST:
+      return LINK_FAILED;
+    default:
+      return LINK_JOINING;
+    }
+  }
+
+  bool readStation(StationCache &cache) override
+  {
+    if (WiFi.status() != WL_CONNECTED)
+      return false;
+    memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+    cache.channel = WiFi.channel();
+    cache.hasAddress = 1;
+    IPAddress ip = WiFi.localIP(), gateway = WiFi.gatewayIP(), subnet = WiFi.subnetMask(), dns = WiFi.dnsIP();
+    for (int i = 0; i < 4; i++)
+    {
+      cache.ip[i] = ip[i];
+      cache.gateway[i] = gateway[i];
+      cache.subnet[i] = subnet[i];
+      cache.dns[i] = dns[i];
+    }
+    return true;
+  }
+};
+
+static uint32_t networkClock() { return millis(); }
+static EspLink stationLink;
+NetworkManager network(stationLink, networkClock);
 
 void initWifi()
 {
-  connectToWiFi();
+  WiFi.mode(WIFI_AP_STA);
+  // The manager keeps its own cache and does the reconnects
+  WiFi.persistent(false);
+  WiFi.setAutoReconnect(false);
+
+  // The Arduino can deliver data before the upstream network is there
   setupAccessPoint();
   setupHttpServer();
+  connectToWiFi();
 
-  // Set up NTP time
+  // Set up NTP time, SNTP syncs by itself once the station is up
   configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
 }
 
 void connectToWiFi()
 {
-  WiFi.mode(WIFI_AP_STA);
-  WiFi.begin(sta_ssid, sta_password);
+  network.begin(sta_ssid, sta_password);
+}
 
-  while (WiFi.status() != WL_CONNECTED)
-  {
-    delay(500);
-    Serial.print(".");
-  }
-  // Connect to WiFi
-  Serial.println("\nESP32 connected to WiFi");
-  Serial.print("IP address: ");
-  Serial.println(WiFi.localIP());
+void serviceNetwork()
+{
+  MemScope scope(MEM_TAG_NETWORK);
+  network.service();
 }
 
 void setupAccessPoint()
@@ -40,53 +98,3 @@ void setupAccessPoint()
   Serial.print("AP IP address: ");
   Serial.println(WiFi.softAPIP());
 }
-
-void setupHttpServer()
-{
-  // Define route
-  server.on("/data", HTTP_POST, [&]()
-            { handlePostRequest(); });
-
-  server.begin(80);
-  Serial.println("HTTP server started");
-}
-
-/* Function to handle POST requests to /data
-    It reads the JSON body, parses it, and logs the sensor data.*/
-void handlePostRequest()
-{
-  if (server.hasArg("plain"))
-  { // "plain" contains POST body
-    String body = server.arg("plain");
-
-    StaticJsonDocument<2048> doc;
-    DeserializationError error = deserializeJson(doc, body);
-
-    if (error)
-    {
-      Serial.print("JSON parse error: ");
-      Serial.println(error.c_str());
-      server.send(400, "text/plain", "Bad JSON");
-      return;
-    }
-
-    if (!doc.is<JsonArray>())
-    {
-      server.send(400, "text/plain", "Expected JSON array");
-      return;
-    }
-
-    parseJsonArray(doc.as<JsonArray>(), getTimeStamp());
-    server.send(200, "text/plain", "OK");
-    timeSinceDataReceived = millis();
-
-    // Data received from sensor, check API connection status and update logger
-    bool connected = (WiFi.status() == WL_CONNECTED); // Placeholder for actual server connection status
-    connected = random(0, 2); // Mock connection status for testing
-    logger.update(connected, doc.as<JsonArray>());
-  }
-  else
-  {
-    server.send(400, "text/plain", "No data received");
-  }
-}
@@ -0,0 +1,265 @@
+// Round trip tests of the binary batch codec and of the batch list framing in the
+// ingest pipeline: pio test -e native -f test_batchCodec
+#include <unity.h>
+#include <string.h>
+#include <batchCodec.h>
+#include "ingest.h"
+
+static uint8_t buffer[BATCH_MAX_ENCODED_SIZE];
+static uint8_t copy[BATCH_MAX_ENCODED_SIZE + 8];
+
+void setUp() {}
+void tearDown() {}
+
+// Encodes count readings, temperature and humidity taken from the arrays, errors where error[i] is set
+static size_t encode(uint8_t flags, const int16_t *temps, const int16_t *hums, const bool *errors, size_t count)
+{
+    BatchEncoder encoder(buffer, sizeof(buffer));
+    encoder.begin(0xBEEF, 0x1234, flags, 12, 34, 1700000000);
+    for (size_t i = 0; i < count; i++)
+        TEST_ASSERT_TRUE(encoder.addFixed(temps[i], hums[i], errors[i], i * 3));
+    return encoder.finish();
+}
+
+// Decodes everything, returns the number of readings or -1 if the decoder found the data corrupt
+static int decodeAll(const uint8_t *data, size_t len, BatchReading *out, size_t size)
+{
+    BatchDecoder decoder;
+    if (decoder.begin(data, len) != BATCH_OK)
+        return -1;
+    size_t n = 0;
+    BatchReading reading;
+    while (decoder.next(reading))
+    {
+        if (n < size)
+            out[n] = reading;
+        n++;
+    }
+    return decoder.corrupt() ? -1 : (int)n;
+}
+
+static void writeCrc(uint8_t *data, size_t len)
+{
+    uint16_t crc = batchCrc16(data, len - BATCH_CRC_SIZE);
+    data[len - 2] = crc & 0xFF;
+    data[len - 1] = crc >> 8;
+}
+
+void test_round_trip_header_and_times()
+{
+    int16_t temps[] = {2150, 2160, 2155};
+    int16_t hums[] = {4000, 4010, 3990};
+    bool errors[] = {false, false, false};
+    size_t len = encode(BATCH_FLAG_TIMES | BATCH_FLAG_EPOCH | BATCH_FLAG_LINEAR, temps, hums, errors, 3);
+    TEST_ASSERT_GREATER_THAN(0, len);
+
+    BatchDecoder decoder;
+    TEST_ASSERT_EQUAL(BATCH_OK, decoder.begin(buffer, len));
+    const BatchHeader &header = decoder.header();
+    TEST_ASSERT_EQUAL_UINT16(0xBEEF, header.nodeId);
+    TEST_ASSERT_EQUAL_UINT16(0x1234, header.sequence);
+    TEST_ASSERT_EQUAL_UINT8(3, header.count);
+    TEST_ASSERT_EQUAL_UINT8(12, header.tempTolerance);
+    TEST_ASSERT_EQUAL_UINT8(34, header.humTolerance);
+    TEST_ASSERT_EQUAL_UINT32(1700000000, header.epoch);
+
+    BatchReading reading;
+    for (size_t i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_TRUE(decoder.next(reading));
+        TEST_ASSERT_EQUAL_INT16(temps[i], reading.temperature);
+        TEST_ASSERT_EQUAL_INT16(hums[i], reading.humidity);
+        TEST_ASSERT_EQUAL_UINT16(i * 3, reading.timeOffset);
+    }
+    TEST_ASSERT_FALSE(decoder.next(reading));
+    TEST_ASSERT_FALSE(decoder.corrupt());
+}
+
+void test_round_trip_zigzag_extremes()
+{
+    // Largest possible deltas in both directions, each one a full 16-bit swing
+    int16_t temps[BATCH_MAX_READINGS];
+    int16_t hums[BATCH_MAX_READINGS];
+    bool errors[BATCH_MAX_READINGS] = {};
+    for (size_t i = 0; i < BATCH_MAX_READINGS; i++)
+    {
+        temps[i] = i % 2 ? INT16_MIN : INT16_MAX;
+        hums[i] = i % 2 ? INT16_MAX : INT16_MIN;
+    }
+    temps[5] = 0;
+    temps[6] = -1;
+    hums[7] = 1;
+
+    size_t len = encode(BATCH_FLAG_TIMES, temps, hums, errors, BATCH_MAX_READINGS);
+    TEST_ASSERT_GREATER_THAN(0, len);
+    TEST_ASSERT_LESS_OR_EQUAL(BATCH_MAX_ENCODED_SIZE, len);
+
+    BatchReading out[BATCH_MAX_READINGS];
+    TEST_ASSERT_EQUAL(BATCH_MAX_READINGS, decodeAll(buffer, len, out, BATCH_MAX_READINGS));
+    for (size_t i = 0; i < BATCH_MAX_READINGS; i++)
+    {
+        TEST_ASSERT_EQUAL_INT16(temps[i], out[i].temperature);
+        TEST_ASSERT_EQUAL_INT16(hums[i], out[i].humidity);
+    }
+}
+
+void test_round_trip_error_bitmap()
+{
+    // Errors across byte boundaries of the bitmap, the deltas skip over them
+    const size_t count = 20;
+    int16_t temps[count];
+    int16_t hums[count];
+    bool errors[count];
+    for (size_t i = 0; i < count; i++)
+    {
+        temps[i] = 2000 + i * 7;
+        hums[i] = 5000 - i * 11;
+        errors[i] = i == 0 || i == 7 || i == 8 || i == 15 || i == 19;
+    }
+
+    size_t len = encode(0, temps, hums, errors, count);
+    BatchReading out[count];
+    TEST_ASSERT_EQUAL(count, decodeAll(buffer, len, out, count));
+    for (size_t i = 0; i < count; i++)
+    {
+        TEST_ASSERT_EQUAL(errors[i], out[i].error);
+        TEST_ASSERT_EQUAL_INT16(errors[i] ? 0 : temps[i], out[i].temperature);
+        TEST_ASSERT_EQUAL_INT16(errors[i] ? 0 : hums[i], out[i].humidity);
+        TEST_ASSERT_EQUAL_UINT16(0, out[i].timeOffset);
+    }
+}
+
+void test_crc_corruption_rejected()
+{
+    int16_t temps[] = {2150, 2160, 2155, 2170};
+    int16_t hums[] = {4000, 4010, 3990, 3980};
+    bool errors[] = {false, true, false, false};
+    size_t len = encode(BATCH_FLAG_TIMES, temps, hums, errors, 4);
+
+    // Every single bit flip after the magic and version is caught by the CRC
+    BatchDecoder decoder;
+    for (size_t i = 2; i < len; i++)
+    {
+        for (int bit = 0; bit < 8; bit++)
+        {
+            memcpy(copy, buffer, len);
+            copy[i] ^= 1 << bit;
+            TEST_ASSERT_EQUAL(BATCH_ERR_CRC, decoder.begin(copy, len));
+        }
+    }
+}
+
+void test_truncation_rejected()
+{
+    int16_t temps[] = {2150, 2160, 2155, 2170};
+    int16_t hums[] = {4000, 4010, 3990, 3980};
+    bool errors[] = {false, false, false, false};
+    size_t len = encode(BATCH_FLAG_TIMES | BATCH_FLAG_EPOCH, temps, hums, errors, 4);
+
+    BatchReading out[4];
+    for (size_t cut = 0; cut < len; cut++)
+        TEST_ASSERT_EQUAL(-1, decodeAll(buffer, cut, out, 4));
+
+    // A truncated body with a CRC that matches is caught by the value bytes running out
+    for (size_t cut = BATCH_HEADER_SIZE + BATCH_EPOCH_SIZE + 1 + BATCH_CRC_SIZE; cut < len; cut++)
+    {
+        memcpy(copy, buffer, cut - BATCH_CRC_SIZE);
+        writeCrc(copy, cut);
+        TEST_ASSERT_EQUAL(-1, decodeAll(copy, cut, out, 4));
+    }
+}
+
+void test_trailing_bytes_rejected()
+{
+    int16_t temps[] = {2150, 2160, 2155};
+    int16_t hums[] = {4000, 4010, 3990};
+    bool errors[] = {false, false, true};
+    size_t len = encode(0, temps, hums, errors, 3);
+    size_t valuesEnd = len - BATCH_CRC_SIZE - 1; // one bitmap byte for three readings
+
+    // Garbage between the last value and the bitmap, with a valid CRC over it
+    memcpy(copy, buffer, valuesEnd);
+    copy[valuesEnd] = 0x00;
+    memcpy(copy + valuesEnd + 1, buffer + valuesEnd, len - valuesEnd);
+    writeCrc(copy, len + 1);
+
+    BatchReading out[3];
+    TEST_ASSERT_EQUAL(3, decodeAll(buffer, len, out, 3));
+    TEST_ASSERT_EQUAL(-1, decodeAll(copy, len + 1, out, 3));
+
+    // An empty batch must not carry value bytes either
+    BatchEncoder encoder(buffer, sizeof(buffer));
+    encoder.begin(1, 1);
+    len = encoder.finish();
+    TEST_ASSERT_EQUAL(0, decodeAll(buffer, len, out, 3));
+    memcpy(copy, buffer, BATCH_HEADER_SIZE);
+    copy[BATCH_HEADER_SIZE] = 0x01;
+    writeCrc(copy, len + 1);
+    TEST_ASSERT_EQUAL(-1, decodeAll(copy, len + 1, out, 3));
+}
+
+// Batch list of two batches, optionally with bytes after the last one
+static size_t makeList(uint8_t *out, size_t size, size_t trailing)
+{
+    size_t pos = BATCH_LIST_HEADER_SIZE;
+    out[0] = BATCH_LIST_MAGIC;
+    out[1] = 2;
+    for (uint16_t sequence = 1; sequence <= 2; sequence++)
+    {
+        BatchEncoder encoder(out + pos + BATCH_LIST_LENGTH_SIZE, size - pos - BATCH_LIST_LENGTH_SIZE);
+        encoder.begin(7, sequence);
+        encoder.add(21.5f, 40.0f, false);
+        encoder.add(21.6f, 40.5f, false);
+        size_t len = encoder.finish();
+        out[pos] = len & 0xFF;
+        out[pos + 1] = len >> 8;
+        pos += BATCH_LIST_LENGTH_SIZE + len;
+    }
+    memset(out + pos, 0xAA, trailing);
+    return pos + trailing;
+}
+
+void test_ingest_batch_list()
+{
+    static NodeTable nodes;
+    static IngestPipeline ingest(nodes);
+    uint8_t body[256];
+
+    size_t len = makeList(body, sizeof(body), 0);
+    ingest.begin(true, len);
+    ingest.feed(body, len);
+    TEST_ASSERT_EQUAL(INGEST_OK, ingest.finish());
+    TEST_ASSERT_EQUAL(2, ingest.frameCount());
+    TEST_ASSERT_EQUAL(4, ingest.count());
+    TEST_ASSERT_EQUAL_INT16(2160, ingest.readings()[3].tempCenti);
+
+    len = makeList(body, sizeof(body), 3);
+    ingest.begin(true, len);
+    ingest.feed(body, len);
+    TEST_ASSERT_EQUAL(INGEST_BAD_BATCH, ingest.finish());
+}
+
+void test_sequence_compared_across_the_wrap()
+{
+    TEST_ASSERT_EQUAL_INT16(1, batchSequenceDiff(0x0000, 0xFFFF));
+    TEST_ASSERT_EQUAL_INT16(-1, batchSequenceDiff(0xFFFF, 0x0000));
+    TEST_ASSERT_EQUAL_INT16(1024, batchSequenceDiff(0x0010, 0xFC10));
+    TEST_ASSERT_EQUAL_INT16(0, batchSequenceDiff(0x1234, 0x1234));
+    // A 32 bit sender counter keeps its low 16 bits
+    uint32_t counter = 0x0001FFFF;
+    TEST_ASSERT_EQUAL_INT16(1, batchSequenceDiff((uint16_t)(counter + 1), (uint16_t)counter));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip_header_and_times);
+    RUN_TEST(test_round_trip_zigzag_extremes);
+    RUN_TEST(test_round_trip_error_bitmap);
+    RUN_TEST(test_crc_corruption_rejected);
+    RUN_TEST(test_truncation_rejected);
+    RUN_TEST(test_trailing_bytes_rejected);
+    RUN_TEST(test_ingest_batch_list);
+    RUN_TEST(test_sequence_compared_across_the_wrap);
+    return UNITY_END();
+}
@@ -0,0 +1,189 @@
+// Change filter of the node and its reconstruction on the gateway: pio test -e native -f test_changeFilter
+#include <unity.h>
+#include <stdlib.h>
+#include <changeFilter.h>
+
+#define TEST_SAMPLES 400
+#define TEST_TEMP_TOLERANCE 20 // same as BATCH_TEMP_TOLERANCE of the node
+#define TEST_HUM_TOLERANCE 100
+#define TEST_START 1760000000UL
+
+static SeriesPoint samples[TEST_SAMPLES];
+static SeriesPoint kept[TEST_SAMPLES + 1];
+static SeriesPoint expanded[TEST_SAMPLES];
+
+static SeriesPoint sample(uint32_t i, int temperature, int humidity, bool error = false)
+{
+    SeriesPoint point = {(uint32_t)(TEST_START + i), (int16_t)temperature, (int16_t)humidity, error};
+    return point;
+}
+
+// Small deterministic noise in [-range, range]
+static uint32_t noiseState;
+static int noise(int range)
+{
+    noiseState = noiseState * 1103515245 + 12345;
+    return (int)((noiseState >> 16) % (2 * range + 1)) - range;
+}
+
+/* Runs the series through the filter, flushing every flushEvery samples like the node
+    does at the end of a batch, expands the kept points at the sample period and checks
+    every sample against the tolerances. Returns how many points were kept. */
+static size_t filterAndCheck(ChangeFilterMode mode, size_t count, size_t flushEvery = 0)
+{
+    ChangeFilter filter(mode, TEST_TEMP_TOLERANCE, TEST_HUM_TOLERANCE);
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        n += filter.add(samples[i], kept + n);
+        if (flushEvery > 0 && (i + 1) % flushEvery == 0)
+            n += filter.flush(kept + n);
+    }
+    n += filter.flush(kept + n);
+    TEST_ASSERT_EQUAL_UINT32(count, filter.samples());
+    TEST_ASSERT_EQUAL_UINT32(n, filter.kept());
+
+    // Kept points are in time order, the first and the last sample among them
+    TEST_ASSERT_EQUAL_UINT32(samples[0].time, kept[0].time);
+    TEST_ASSERT_EQUAL_UINT32(samples[count - 1].time, kept[n - 1].time);
+    for (size_t i = 1; i < n; i++)
+        TEST_ASSERT_TRUE(kept[i].time >= kept[i - 1].time);
+
+    size_t m = changeFilterExpand(mode, kept, n, 1, expanded, TEST_SAMPLES);
+    TEST_ASSERT_EQUAL(count, m);
+    for (size_t i = 0; i < count; i++)
+    {
+        char where[48];
+        snprintf(where, sizeof(where), "mode %d sample %u", mode, (unsigned)i);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(samples[i].time, expanded[i].time, where);
+        TEST_ASSERT_EQUAL_MESSAGE(samples[i].error, expanded[i].error, where);
+        if (samples[i].error)
+            continue;
+        TEST_ASSERT_INT_WITHIN_MESSAGE(TEST_TEMP_TOLERANCE, samples[i].temperature, expanded[i].temperature, where);
+        TEST_ASSERT_INT_WITHIN_MESSAGE(TEST_HUM_TOLERANCE, samples[i].humidity, expanded[i].humidity, where);
+    }
+    return n;
+}
+
+static void checkBothModes(size_t count, size_t flushEvery = 0)
+{
+    filterAndCheck(CHANGE_FILTER_DEADBAND, count, flushEvery);
+    filterAndCheck(CHANGE_FILTER_SWINGING_DOOR, count, flushEvery);
+}
+
+void setUp()
+{
+    noiseState = 1;
+}
+
+void tearDown() {}
+
+void test_ramps()
+{
+    // Rising temperature and falling humidity, then both turning around
+    for (uint32_t i = 0; i < TEST_SAMPLES; i++)
+    {
+        int t = i < 200 ? i : 400 - i;
+        samples[i] = sample(i, 2000 + 3 * t, 6000 - 7 * t);
+    }
+    checkBothModes(TEST_SAMPLES);
+
+    // A straight line is a handful of vertices for the swinging door
+    TEST_ASSERT_TRUE(filterAndCheck(CHANGE_FILTER_SWINGING_DOOR, TEST_SAMPLES) <= 6);
+}
+
+void test_steps()
+{
+    for (uint32_t i = 0; i < TEST_SAMPLES; i++)
+        samples[i] = sample(i, i < 100 ? 2000 : i < 250 ? 2500 : 1900, i < 150 ? 4000 : 3000);
+    checkBothModes(TEST_SAMPLES);
+
+    // Constant stretches hold, a deadband series is little more than the steps
+    TEST_ASSERT_TRUE(filterAndCheck(CHANGE_FILTER_DEADBAND, TEST_SAMPLES) <= 8);
+}
+
+void test_noise()
+{
+    // Noise around a slow drift, small and then larger than the tolerances
+    for (uint32_t i = 0; i < TEST_SAMPLES; i++)
+    {
+        int range = i < 200 ? 10 : 60;
+        samples[i] = sample(i, 2200 + i / 4 + noise(range), 5000 - i / 2 + noise(range * 4));
+    }
+    checkBothModes(TEST_SAMPLES);
+}
+
+void test_error_runs()
+{
+    for (uint32_t i = 0; i < TEST_SAMPLES; i++)
+    {
+        bool error = (i >= 50 && i < 55) || i == 120 || (i >= 200 && i < 230) || i == TEST_SAMPLES - 1;
+        samples[i] = sample(i, 2100 + (int)(i % 80) * 2, 4500 - (int)(i % 50) * 5, error);
+    }
+    checkBothModes(TEST_SAMPLES);
+
+    // A series that starts with errors
+    samples[0].error = true;
+    samples[1].error = true;
+    checkBothModes(60);
+}
+
+void test_flush_between_batches()
+{
+    // The node closes the series every 29 samples and sends each part on its own
+    for (uint32_t i = 0; i < TEST_SAMPLES; i++)
+        samples[i] = sample(i, 2000 + (int)(i % 97) * 4 + noise(15), 4000 + noise(150), i == 58 || i == 59);
+    checkBothModes(TEST_SAMPLES, 29);
+
+    // Nothing pending after a flush, a second one keeps nothing
+    ChangeFilter filter(CHANGE_FILTER_SWINGING_DOOR, TEST_TEMP_TOLERANCE, TEST_HUM_TOLERANCE);
+    SeriesPoint out[CHANGE_FILTER_MAX_OUTPUT];
+    TEST_ASSERT_EQUAL(0, filter.flush(out));
+    filter.add(samples[0], out);
+    filter.add(samples[1], out);
+    TEST_ASSERT_EQUAL(1, filter.flush(out));
+    TEST_ASSERT_EQUAL_UINT32(samples[1].time, out[0].time);
+    TEST_ASSERT_EQUAL(0, filter.flush(out));
+}
+
+void test_samples_not_after_the_anchor_ignored()
+{
+    ChangeFilterMode modes[] = {CHANGE_FILTER_DEADBAND, CHANGE_FILTER_SWINGING_DOOR};
+    for (ChangeFilterMode mode : modes)
+    {
+        ChangeFilter filter(mode, TEST_TEMP_TOLERANCE, TEST_HUM_TOLERANCE);
+        SeriesPoint out[CHANGE_FILTER_MAX_OUTPUT];
+        TEST_ASSERT_EQUAL(1, filter.add(sample(10, 2000, 4000), out));
+
+        // Same second, and a clock that went back: nothing is kept and the anchor stays
+        TEST_ASSERT_EQUAL(0, filter.add(sample(10, 3000, 6000), out));
+        TEST_ASSERT_EQUAL(0, filter.add(sample(5, 3000, 6000), out));
+        SeriesPoint anchor;
+        TEST_ASSERT_TRUE(filter.anchor(anchor));
+        TEST_ASSERT_EQUAL_UINT32(TEST_START + 10, anchor.time);
+        TEST_ASSERT_EQUAL_INT16(2000, anchor.temperature);
+        TEST_ASSERT_EQUAL(0, filter.flush(out));
+        TEST_ASSERT_EQUAL_UINT32(1, filter.kept());
+
+        // A time so far back that the unsigned difference wraps is no later sample either
+        SeriesPoint wrapped = sample(0, 3000, 6000);
+        wrapped.time = anchor.time + 0x80000000UL;
+        TEST_ASSERT_EQUAL(0, filter.add(wrapped, out));
+        TEST_ASSERT_EQUAL_UINT32(1, filter.kept());
+
+        // The series goes on from the anchor
+        TEST_ASSERT_EQUAL(mode == CHANGE_FILTER_DEADBAND ? 1 : 0, filter.add(sample(11, 3000, 6000), out));
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_ramps);
+    RUN_TEST(test_steps);
+    RUN_TEST(test_noise);
+    RUN_TEST(test_error_runs);
+    RUN_TEST(test_flush_between_batches);
+    RUN_TEST(test_samples_not_after_the_anchor_ignored);
+    return UNITY_END();
+}
@@ -0,0 +1,179 @@
+// Offline logger ring and its NVS blob: pio test -e native -f test_espLogger
+#include <unity.h>
+#include <Preferences.h>
+#include <logQueue.h>
+#include <logMessages.h>
+#include "espLogger.h"
+
+void setUp()
+{
+    Serial.mute(true);
+    Preferences::eraseAll();
+}
+
+void tearDown()
+{
+    Serial.mute(false);
+}
+
+void test_entries_oldest_first()
+{
+    Logger log;
+    log.begin();
+    log.log("one");
+    log.log("two");
+    TEST_ASSERT_EQUAL(2, log.size());
+    TEST_ASSERT_EQUAL_STRING("one", log.getEntry(0).c_str());
+    TEST_ASSERT_EQUAL_STRING("two", log.getEntry(1).c_str());
+    TEST_ASSERT_EQUAL_STRING("", log.getEntry(2).c_str());
+}
+
+void test_ring_keeps_newest()
+{
+    Logger log;
+    log.begin();
+    for (int i = 0; i < LOGGER_MAX_ENTRIES + 5; i++)
+        log.log("entry " + String(i));
+    TEST_ASSERT_EQUAL(LOGGER_MAX_ENTRIES, log.size());
+    TEST_ASSERT_EQUAL_STRING("entry 5", log.getEntry(0).c_str());
+    TEST_ASSERT_EQUAL_STRING(("entry " + String(LOGGER_MAX_ENTRIES + 4)).c_str(), log.getEntry(LOGGER_MAX_ENTRIES - 1).c_str());
+}
+
+void test_long_message_truncated()
+{
+    Logger log;
+    log.begin();
+    String text;
+    for (int i = 0; i < LOGGER_MSG_LENGTH + 20; i++)
+        text += 'x';
+    log.log(text);
+    TEST_ASSERT_EQUAL(LOGGER_MSG_LENGTH - 1, log.getEntry(0).length());
+}
+
+void test_entries_written_together()
+{
+    Logger log;
+    log.begin();
+    for (int i = 0; i < LOGGER_FLUSH_ENTRIES - 1; i++)
+        log.log("entry");
+    TEST_ASSERT_EQUAL(0, log.stats().nvsWrites);
+
+    // The next entry fills the write back and the whole ring goes out as one blob
+    log.log("entry");
+    TEST_ASSERT_EQUAL(1, log.stats().nvsWrites);
+    TEST_ASSERT_EQUAL(1, log.stats().flushes);
+    TEST_ASSERT_EQUAL(LOGGER_FLUSH_ENTRIES, log.stats().entries);
+}
+
+void test_service_flushes_after_interval()
+{
+    hostFreezeClock(true);
+    Logger log;
+    log.begin();
+    log.log("late");
+    log.service();
+    TEST_ASSERT_EQUAL(0, log.stats().nvsWrites);
+
+    hostAdvanceMillis(LOGGER_FLUSH_MS);
+    log.service();
+    TEST_ASSERT_EQUAL(1, log.stats().nvsWrites);
+    hostFreezeClock(false);
+}
+
+void test_ring_survives_restart()
+{
+    {
+        Logger log;
+        log.begin();
+        log.log("before");
+        log.log("reset");
+        log.flush();
+    }
+
+    Logger restarted;
+    restarted.begin();
+    TEST_ASSERT_EQUAL(2, restarted.size());
+    TEST_ASSERT_EQUAL_STRING("before", restarted.getEntry(0).c_str());
+    TEST_ASSERT_EQUAL_STRING("reset", restarted.getEntry(1).c_str());
+
+    // New entries continue after the loaded ones
+    restarted.log("after");
+    TEST_ASSERT_EQUAL_STRING("after", restarted.getEntry(2).c_str());
+}
+
+void test_legacy_keys_migrated()
+{
+    Preferences old;
+    old.begin("logger");
+    old.putUInt("count", 2);
+    old.putUInt("head", 2);
+    old.putString("log0", "old one");
+    old.putString("log1", "old two");
+    old.end();
+
+    Logger log;
+    log.begin();
+    TEST_ASSERT_EQUAL(2, log.size());
+    TEST_ASSERT_EQUAL_STRING("old two", log.getEntry(1).c_str());
+
+    old.begin("logger");
+    TEST_ASSERT_FALSE(old.isKey("count"));
+    TEST_ASSERT_FALSE(old.isKey("log0"));
+    old.end();
+}
+
+void test_update_logs_only_while_disconnected()
+{
+    Logger log;
+    log.begin();
+    SensorData median = makeSensorData(21.5f, 40.0f, false);
+
+    log.update(true, 3, median);
+    TEST_ASSERT_EQUAL(0, log.size());
+
+    log.update(false, 3, median);
+    TEST_ASSERT_EQUAL(1, log.size());
+    TEST_ASSERT_EQUAL_STRING("Server disconnected, starting logger", log.getEntry(0).c_str());
+
+    LogEntry entry;
+    while (logQueue.pop(entry))
+        ;
+    log.update(false, 3, median);
+    TEST_ASSERT_EQUAL(2, log.size());
+    TEST_ASSERT_TRUE(log.getEntry(1).indexOf("Node 3 Temp: 21.50 C, Humidity: 40.00 %") >= 0);
+
+    // The log queue got the median as raw hundredths, formatted only when drained
+    TEST_ASSERT_TRUE(logQueue.pop(entry));
+    TEST_ASSERT_EQUAL_UINT16(LOG_ESP_LOGGED, entry.id);
+    TEST_ASSERT_EQUAL(4, entry.argc);
+    TEST_ASSERT_EQUAL_UINT32(3, entry.args[0]);
+    TEST_ASSERT_EQUAL_UINT32(2150, entry.args[2]);
+    TEST_ASSERT_EQUAL_UINT32(4000, entry.args[3]);
+    char text[64];
+    logFormat(text, sizeof(text), "%C %C", entry.args + 2, 2);
+    TEST_ASSERT_EQUAL_STRING("21.50 40.00", text);
+    uint32_t negative[] = {(uint32_t)-5};
+    logFormat(text, sizeof(text), "%C", negative, 1);
+    TEST_ASSERT_EQUAL_STRING("-0.05", text);
+
+    // Reconnecting logs once and writes the outage to NVS
+    log.update(true, 3, median);
+    TEST_ASSERT_EQUAL(3, log.size());
+    TEST_ASSERT_EQUAL(1, log.stats().nvsWrites);
+    log.update(true, 3, median);
+    TEST_ASSERT_EQUAL(3, log.size());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_entries_oldest_first);
+    RUN_TEST(test_ring_keeps_newest);
+    RUN_TEST(test_long_message_truncated);
+    RUN_TEST(test_entries_written_together);
+    RUN_TEST(test_service_flushes_after_interval);
+    RUN_TEST(test_ring_survives_restart);
+    RUN_TEST(test_legacy_keys_migrated);
+    RUN_TEST(test_update_logs_only_while_disconnected);
+    return UNITY_END();
+}
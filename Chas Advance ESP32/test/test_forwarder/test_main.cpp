@@ -0,0 +1,180 @@
+// Upstream forwarder against a loopback backend: pio test -e native -f test_forwarder
+#include <unity.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <batchCodec.h>
+#include "forwarder.h"
+
+#define TEST_BACKEND_PORT 8091
+
+static size_t returnedReadings;
+static uint32_t reservedLimit;
+
+static uint32_t testClock() { return millis(); }
+
+static void keep(const StoredReading *, size_t count)
+{
+    returnedReadings += count;
+}
+
+static bool reserve(uint32_t limit)
+{
+    reservedLimit = limit;
+    return true;
+}
+
+static int listenOn(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST_ASSERT_EQUAL(0, bind(fd, (sockaddr *)&addr, sizeof(addr)));
+    TEST_ASSERT_EQUAL(0, listen(fd, 4));
+    return fd;
+}
+
+// Reads one request off the accepted socket and answers it, returns the sequence of its first batch
+static int answer(int fd, const char *reply)
+{
+    static uint8_t request[FORWARD_BODY_SIZE + 256];
+    size_t received = 0;
+    pollfd ready = {fd, POLLIN, 0};
+    const uint8_t *body = NULL;
+    size_t length = 0;
+    while (poll(&ready, 1, 2000) > 0 && received < sizeof(request) - 1)
+    {
+        ssize_t r = recv(fd, request + received, sizeof(request) - 1 - received, 0);
+        if (r <= 0)
+            break;
+        received += r;
+        request[received] = '\0';
+        const char *end = strstr((const char *)request, "\r\n\r\n");
+        const char *header = strstr((const char *)request, "Content-Length: ");
+        if (end != NULL && header != NULL && received >= (size_t)(end + 4 - (const char *)request) + atoi(header + 16))
+        {
+            body = (const uint8_t *)end + 4;
+            length = atoi(header + 16);
+            break;
+        }
+    }
+    if (body == NULL)
+        return -1;
+    send(fd, reply, strlen(reply), 0);
+
+    BatchDecoder decoder;
+    if (length < BATCH_LIST_HEADER_SIZE + BATCH_LIST_LENGTH_SIZE ||
+        decoder.begin(body + BATCH_LIST_HEADER_SIZE + BATCH_LIST_LENGTH_SIZE, body[2] | (body[3] << 8)) != BATCH_OK)
+        return -1;
+    return decoder.header().sequence;
+}
+
+static void fill(Forwarder &forwarder)
+{
+    for (size_t i = 0; i < FORWARD_BATCH_READINGS; i++)
+    {
+        StoredReading r = {0, (uint32_t)(1760000000 + i), (uint16_t)(1 + i % 4), 2150, 4000, false, 0, 0, 0};
+        TEST_ASSERT_TRUE(forwarder.add(r));
+    }
+}
+
+void setUp()
+{
+    WiFi.begin("test", "test");
+    returnedReadings = 0;
+    reservedLimit = 0;
+}
+
+void tearDown() {}
+
+void test_batches_delivered_with_rising_sequence()
+{
+    int listener = listenOn(TEST_BACKEND_PORT);
+    Forwarder forwarder("127.0.0.1", TEST_BACKEND_PORT, testClock, keep, reserve);
+    forwarder.resumeSequence(5000);
+
+    // The connect happens in its own task, service() only starts it
+    fill(forwarder);
+    forwarder.service(true);
+    int fd = accept(listener, NULL, NULL);
+    TEST_ASSERT_TRUE(fd >= 0);
+    for (int i = 0; i < 100 && forwarder.stats().requests == 0; i++)
+    {
+        delay(5);
+        forwarder.service(true);
+    }
+    TEST_ASSERT_EQUAL(1, forwarder.stats().requests);
+    TEST_ASSERT_EQUAL(5000, answer(fd, "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n"));
+    TEST_ASSERT_TRUE(reservedLimit >= 5000 + FORWARD_BATCH_READINGS);
+
+    // Four nodes took four numbers, the next request on the same connection goes on from there
+    TEST_ASSERT_EQUAL(5004, forwarder.nextSequence());
+    fill(forwarder);
+    for (int i = 0; i < 100 && forwarder.stats().requests < 2; i++)
+    {
+        delay(5);
+        forwarder.service(true);
+    }
+    TEST_ASSERT_EQUAL(5004, answer(fd, "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n"));
+    for (int i = 0; i < 100 && forwarder.stats().delivered < 2; i++)
+    {
+        delay(5);
+        forwarder.service(true);
+    }
+    TEST_ASSERT_EQUAL(2, forwarder.stats().delivered);
+    TEST_ASSERT_EQUAL(0, returnedReadings);
+    ::close(fd);
+    ::close(listener);
+}
+
+void test_slow_connect_does_not_block()
+{
+    // A full accept queue leaves further connects hanging until their timeout
+    int listener = listenOn(TEST_BACKEND_PORT + 1);
+    int fillers[8];
+    for (int i = 0; i < 8; i++)
+    {
+        fillers[i] = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(TEST_BACKEND_PORT + 1);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        connect(fillers[i], (sockaddr *)&addr, sizeof(addr));
+    }
+
+    Forwarder forwarder("127.0.0.1", TEST_BACKEND_PORT + 1, testClock, keep, reserve);
+    fill(forwarder);
+    uint32_t start = millis();
+    for (int i = 0; i < 10; i++)
+        forwarder.service(true);
+    TEST_ASSERT_TRUE(millis() - start < 100);
+    TEST_ASSERT_TRUE(forwarder.busy());
+
+    // The failed attempt hands the readings back and backs off
+    for (int i = 0; i < 400 && forwarder.busy(); i++)
+    {
+        delay(5);
+        forwarder.service(true);
+    }
+    TEST_ASSERT_FALSE(forwarder.busy());
+    TEST_ASSERT_FALSE(forwarder.connected());
+    TEST_ASSERT_EQUAL(FORWARD_BATCH_READINGS, returnedReadings);
+
+    for (int i = 0; i < 8; i++)
+        ::close(fillers[i]);
+    ::close(listener);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_batches_delivered_with_rising_sequence);
+    RUN_TEST(test_slow_connect_does_not_block);
+    return UNITY_END();
+}
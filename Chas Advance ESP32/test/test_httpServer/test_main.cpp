@@ -0,0 +1,166 @@
+// POST /data end to end over a loopback socket: pio test -e native -f test_httpServer
+// The processing task is not started, accepted readings stay in its queue.
+#include <unity.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <batchCodec.h>
+#include "httpServer.h"
+#include "ingest.h"
+#include "processing.h"
+
+static char response[512];
+
+// Sends one request and serves it, returns the status code of the reply (0 on failure)
+static int post(const char *contentType, const uint8_t *body, size_t length)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(HTTP_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        ::close(fd);
+        return 0;
+    }
+
+    char head[160];
+    int n = snprintf(head, sizeof(head), "POST /data HTTP/1.1\r\nHost: gateway\r\nContent-Type: %s\r\nContent-Length: %u\r\n\r\n",
+                     contentType, (unsigned)length);
+    send(fd, head, n, 0);
+    send(fd, body, length, 0);
+
+    // The request is in the socket before the server looks, one call serves it
+    size_t received = 0;
+    pollfd ready = {fd, POLLIN, 0};
+    for (int attempt = 0; attempt < 50 && received == 0; attempt++)
+    {
+        server.handleClient();
+        while (poll(&ready, 1, 10) > 0)
+        {
+            ssize_t r = recv(fd, response + received, sizeof(response) - 1 - received, 0);
+            if (r <= 0)
+                break;
+            received += r;
+        }
+    }
+    ::close(fd);
+    response[received] = '\0';
+
+    int code = 0;
+    sscanf(response, "HTTP/1.%*d %d", &code);
+    return code;
+}
+
+static int postJson(const char *json)
+{
+    return post("application/json", (const uint8_t *)json, strlen(json));
+}
+
+// One binary batch of count readings from node 9
+static int postBatch(uint16_t sequence, size_t count)
+{
+    uint8_t body[BATCH_MAX_ENCODED_SIZE];
+    BatchEncoder encoder(body, sizeof(body));
+    encoder.begin(9, sequence);
+    for (size_t i = 0; i < count; i++)
+        encoder.add(21.0f + i * 0.01f, 40.0f, false);
+    return post(BATCH_CONTENT_TYPE, body, encoder.finish());
+}
+
+void setUp()
+{
+    Serial.mute(true);
+}
+
+void tearDown()
+{
+    Serial.mute(false);
+}
+
+void test_json_batch_accepted()
+{
+    HttpServerStats before = httpServerStats();
+    TEST_ASSERT_EQUAL(200, postJson("[{\"temperature\":21.5,\"humidity\":40},{\"temperature\":22,\"humidity\":41}]"));
+    TEST_ASSERT_EQUAL(before.accepted + 1, httpServerStats().accepted);
+    TEST_ASSERT_EQUAL(before.readings + 2, httpServerStats().readings);
+
+    // JSON senders are told apart by their address
+    NodeState *node = nodes.find(nodeIdFromAddress(1));
+    TEST_ASSERT_NOT_NULL(node);
+    TEST_ASSERT_EQUAL(2, node->readings);
+}
+
+void test_binary_batch_and_resend()
+{
+    HttpServerStats before = httpServerStats();
+    TEST_ASSERT_EQUAL(200, postBatch(1, 10));
+    TEST_ASSERT_EQUAL(before.readings + 10, httpServerStats().readings);
+
+    // A resend after a lost reply is acknowledged again but not queued twice
+    TEST_ASSERT_EQUAL(200, postBatch(1, 10));
+    TEST_ASSERT_EQUAL(before.readings + 10, httpServerStats().readings);
+    TEST_ASSERT_EQUAL(before.duplicates + 1, httpServerStats().duplicates);
+}
+
+void test_bad_json_rejected()
+{
+    HttpServerStats before = httpServerStats();
+    TEST_ASSERT_EQUAL(400, postJson("[{\"temperature\":21.5,"));
+    TEST_ASSERT_TRUE(strstr(response, "Bad JSON") != NULL);
+    TEST_ASSERT_EQUAL(before.rejected + 1, httpServerStats().rejected);
+    TEST_ASSERT_EQUAL(before.readings, httpServerStats().readings);
+}
+
+void test_corrupt_batch_rejected()
+{
+    uint8_t body[BATCH_MAX_ENCODED_SIZE];
+    BatchEncoder encoder(body, sizeof(body));
+    encoder.begin(9, 50);
+    encoder.add(21.0f, 40.0f, false);
+    size_t length = encoder.finish();
+    body[length - 1] ^= 0xFF;
+    TEST_ASSERT_EQUAL(400, post(BATCH_CONTENT_TYPE, body, length));
+}
+
+void test_batch_over_capacity_rejected()
+{
+    // One batch longer than the processing task holds
+    String json = "[";
+    for (int i = 0; i <= INGEST_MAX_BATCH_READINGS; i++)
+        json += i > 0 ? ",{\"temperature\":1,\"humidity\":2}" : "{\"temperature\":1,\"humidity\":2}";
+    json += "]";
+    TEST_ASSERT_EQUAL(413, postJson(json.c_str()));
+
+    static uint8_t large[MAX_BODY_SIZE + 1];
+    TEST_ASSERT_EQUAL(413, post(BATCH_CONTENT_TYPE, large, sizeof(large)));
+}
+
+void test_busy_when_processing_is_behind()
+{
+    // Nothing drains the queue, full batches fill it until the gateway pushes back
+    HttpServerStats before = httpServerStats();
+    int code = 200;
+    for (uint16_t sequence = 100; sequence < 110 && code == 200; sequence++)
+        code = postBatch(sequence, BATCH_MAX_READINGS);
+    TEST_ASSERT_EQUAL(503, code);
+    TEST_ASSERT_EQUAL(before.busy + 1, httpServerStats().busy);
+    TEST_ASSERT_LESS_OR_EQUAL(PROCESSING_QUEUE_SIZE, httpServerStats().readings);
+}
+
+int main()
+{
+    setupHttpServer();
+    UNITY_BEGIN();
+    RUN_TEST(test_json_batch_accepted);
+    RUN_TEST(test_binary_batch_and_resend);
+    RUN_TEST(test_bad_json_rejected);
+    RUN_TEST(test_corrupt_batch_rejected);
+    RUN_TEST(test_batch_over_capacity_rejected);
+    RUN_TEST(test_busy_when_processing_is_behind);
+    server.close();
+    return UNITY_END();
+}
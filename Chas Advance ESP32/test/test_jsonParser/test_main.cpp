@@ -0,0 +1,101 @@
+// JSON array readings handed to the log: pio test -e native -f test_jsonParser
+#include <unity.h>
+#include <ArduinoJson.h>
+#include "jsonParser.h"
+
+static float argFloat(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void setUp()
+{
+    // Start from an empty log queue
+    LogEntry entry;
+    while (logQueue.pop(entry))
+    {
+    }
+}
+
+void tearDown() {}
+
+void test_every_reading_logged_in_order()
+{
+    JsonDocument doc;
+    TEST_ASSERT_FALSE(deserializeJson(doc, "[{\"temperature\":21.5,\"humidity\":40.25,\"node\":7},"
+                                           "{\"temperature\":-3.0,\"humidity\":88.0,\"node\":300}]"));
+    parseJsonArray(doc.as<JsonArray>(), "12:00:00");
+
+    LogEntry entry;
+    TEST_ASSERT_TRUE(logQueue.pop(entry));
+    TEST_ASSERT_EQUAL_UINT16(LOG_ESP_READING, entry.id);
+    TEST_ASSERT_EQUAL(4, entry.argc);
+    TEST_ASSERT_EQUAL_UINT32(7, entry.args[0]);
+    TEST_ASSERT_EQUAL_FLOAT(21.5f, argFloat(entry.args[2]));
+    TEST_ASSERT_EQUAL_FLOAT(40.25f, argFloat(entry.args[3]));
+
+    // Node ids are 16 bit
+    TEST_ASSERT_TRUE(logQueue.pop(entry));
+    TEST_ASSERT_EQUAL_UINT32(300, entry.args[0]);
+    TEST_ASSERT_EQUAL_FLOAT(-3.0f, argFloat(entry.args[2]));
+    TEST_ASSERT_FALSE(logQueue.pop(entry));
+}
+
+void test_timestamp_added_to_each_object()
+{
+    JsonDocument doc;
+    deserializeJson(doc, "[{\"temperature\":20.0,\"humidity\":40.0}]");
+    parseJsonArray(doc.as<JsonArray>(), "2024-01-01 12:00:00");
+    JsonObject reading = doc[0];
+    const char *timestamp = reading["timestamp"];
+    TEST_ASSERT_EQUAL_STRING("2024-01-01 12:00:00", timestamp);
+}
+
+void test_error_reading_logged_as_error()
+{
+    JsonDocument doc;
+    deserializeJson(doc, "[{\"temperature\":0,\"humidity\":0,\"error\":true,\"node\":2}]");
+    parseJsonArray(doc.as<JsonArray>(), "");
+
+    LogEntry entry;
+    TEST_ASSERT_TRUE(logQueue.pop(entry));
+    TEST_ASSERT_EQUAL_UINT16(LOG_ESP_READING_ERROR, entry.id);
+    TEST_ASSERT_EQUAL_UINT8(LOG_LEVEL_ERROR, entry.level);
+    TEST_ASSERT_EQUAL_UINT32(2, entry.args[0]);
+}
+
+void test_missing_fields_default()
+{
+    JsonDocument doc;
+    deserializeJson(doc, "[{}]");
+    parseJsonArray(doc.as<JsonArray>(), "");
+
+    LogEntry entry;
+    TEST_ASSERT_TRUE(logQueue.pop(entry));
+    TEST_ASSERT_EQUAL_UINT16(LOG_ESP_READING, entry.id);
+    TEST_ASSERT_EQUAL_UINT32(0, entry.args[0]);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, argFloat(entry.args[2]));
+}
+
+void test_empty_array_logs_nothing()
+{
+    JsonDocument doc;
+    deserializeJson(doc, "[]");
+    parseJsonArray(doc.as<JsonArray>(), "");
+
+    LogEntry entry;
+    TEST_ASSERT_FALSE(logQueue.pop(entry));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_every_reading_logged_in_order);
+    RUN_TEST(test_timestamp_added_to_each_object);
+    RUN_TEST(test_error_reading_logged_as_error);
+    RUN_TEST(test_missing_fields_default);
+    RUN_TEST(test_empty_array_logs_nothing);
+    return UNITY_END();
+}
@@ -0,0 +1,218 @@
+// Deferred log queue, its binary frames and the level filter: pio test -e native -f test_logQueue
+// Only warnings and errors are compiled in this file, see test_level_filter
+#define LOG_LEVEL LOG_LEVEL_WARN
+#include <unity.h>
+#include <thread>
+#include <logQueue.h>
+#include <logMessages.h>
+
+#define TEST_PRODUCERS 3
+#define TEST_ENTRIES_EACH 5000
+
+static uint32_t now;
+static uint32_t testClock() { return now; }
+
+// The same table tools/logDecode formats with
+static const LogMessage messages[] = {
+    ESP32_LOG_MESSAGES(LOG_MESSAGE_ENTRY)
+    ARDUINO_LOG_MESSAGES(LOG_MESSAGE_ENTRY)
+};
+
+static void drainGlobal()
+{
+    LogEntry entry;
+    while (logQueue.pop(entry))
+        ;
+}
+
+void setUp()
+{
+    now = 1000;
+    drainGlobal();
+}
+
+void tearDown() {}
+
+void test_slots_reused_lap_after_lap()
+{
+    LogQueue queue(testClock);
+    LogEntry entry;
+    uint32_t next = 0;
+    uint32_t expected = 0;
+
+    // Three in, three out, so every slot is reused many times at a different offset
+    for (int round = 0; round < LOG_QUEUE_SIZE * 10; round++)
+    {
+        for (int i = 0; i < 3; i++)
+            TEST_ASSERT_TRUE(queue.write(LOG_LEVEL_INFO, LOG_ESP_LOG_DROPPED, next++));
+        for (int i = 0; i < 3; i++)
+        {
+            TEST_ASSERT_TRUE(queue.pop(entry));
+            TEST_ASSERT_EQUAL_UINT32(expected++, entry.args[0]);
+        }
+        TEST_ASSERT_FALSE(queue.pop(entry));
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, queue.dropped());
+    TEST_ASSERT_EQUAL_UINT32(3, queue.highWater());
+}
+
+void test_full_queue_drops_and_counts()
+{
+    LogQueue queue(testClock);
+    LogEntry entry;
+
+    // Start part way into a lap so the full queue wraps the slot array
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        queue.write(LOG_LEVEL_INFO, LOG_ESP_LOG_DROPPED, i);
+        queue.pop(entry);
+    }
+
+    for (uint32_t i = 0; i < LOG_QUEUE_SIZE; i++)
+        TEST_ASSERT_TRUE(queue.write(LOG_LEVEL_INFO, LOG_ESP_LOG_DROPPED, i));
+    TEST_ASSERT_FALSE(queue.write(LOG_LEVEL_INFO, LOG_ESP_LOG_DROPPED, 999));
+    TEST_ASSERT_FALSE(queue.write(LOG_LEVEL_INFO, LOG_ESP_LOG_DROPPED, 999));
+    TEST_ASSERT_EQUAL_UINT32(2, queue.dropped());
+    TEST_ASSERT_EQUAL_UINT32(LOG_QUEUE_SIZE, queue.highWater());
+
+    // The queued entries are untouched and in order, one free slot takes one more
+    TEST_ASSERT_TRUE(queue.pop(entry));
+    TEST_ASSERT_EQUAL_UINT32(0, entry.args[0]);
+    TEST_ASSERT_TRUE(queue.write(LOG_LEVEL_INFO, LOG_ESP_LOG_DROPPED, LOG_QUEUE_SIZE));
+    for (uint32_t i = 1; i <= LOG_QUEUE_SIZE; i++)
+    {
+        TEST_ASSERT_TRUE(queue.pop(entry));
+        TEST_ASSERT_EQUAL_UINT32(i, entry.args[0]);
+    }
+    TEST_ASSERT_FALSE(queue.pop(entry));
+    TEST_ASSERT_EQUAL_UINT32(2, queue.dropped());
+}
+
+static void produce(LogQueue *queue, uint32_t producer)
+{
+    for (uint32_t i = 0; i < TEST_ENTRIES_EACH; i++)
+    {
+        queue->write(LOG_LEVEL_INFO, LOG_ESP_LOG_DROPPED, producer, i);
+        if (i % 64 == 0)
+            std::this_thread::yield();
+    }
+}
+
+void test_producers_on_other_threads()
+{
+    // Whatever the interleaving, nothing is lost without being counted and every
+    // producer's entries come out in the order it wrote them
+    LogQueue queue(testClock);
+    std::thread producers[TEST_PRODUCERS];
+    for (uint32_t p = 0; p < TEST_PRODUCERS; p++)
+        producers[p] = std::thread(produce, &queue, p);
+
+    uint32_t received = 0;
+    int32_t last[TEST_PRODUCERS] = {-1, -1, -1};
+    bool ordered = true;
+    LogEntry entry;
+    while (received + queue.dropped() < TEST_PRODUCERS * TEST_ENTRIES_EACH)
+    {
+        if (!queue.pop(entry))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        uint32_t p = entry.args[0];
+        TEST_ASSERT_TRUE(p < TEST_PRODUCERS);
+        ordered &= (int32_t)entry.args[1] > last[p];
+        last[p] = entry.args[1];
+        received++;
+    }
+    for (uint32_t p = 0; p < TEST_PRODUCERS; p++)
+        producers[p].join();
+
+    TEST_ASSERT_TRUE(ordered);
+    TEST_ASSERT_FALSE(queue.pop(entry));
+    TEST_ASSERT_EQUAL_UINT32(TEST_PRODUCERS * TEST_ENTRIES_EACH, received + queue.dropped());
+    TEST_ASSERT_TRUE(queue.highWater() <= LOG_QUEUE_SIZE);
+}
+
+void test_arguments_survive_the_frame()
+{
+    LogQueue queue(testClock);
+    now = 123456;
+    queue.write(LOG_LEVEL_INFO, LOG_ESP_READING, 7, 0, 21.5f, 40.25f);
+    queue.write(LOG_LEVEL_WARN, LOG_ESP_UPSTREAM_REJECTED, -413, 12u);
+    queue.write(LOG_LEVEL_INFO, LOG_ESP_LOGGED, 3, 0, (int16_t)-5, (int16_t)4025);
+
+    // Frames with text in between and the last one arriving in two parts, as the tool reads them
+    uint8_t stream[128];
+    size_t length = 0;
+    LogEntry entry;
+    while (queue.pop(entry))
+    {
+        stream[length++] = 'x';
+        length += logEncodeFrame(entry, stream + length, sizeof(stream) - length);
+    }
+
+    const char *expected[] = {"Node 7 - Temp=21.5 Hum=40.2", "Upstream rejected batch: -413, 12 readings dropped",
+                              "Logged node 3 - Temp=-0.05 Hum=40.25"};
+    size_t decoded = 0;
+    size_t pos = 0;
+    while (pos < length)
+    {
+        if (stream[pos] != LOG_FRAME_MAGIC)
+        {
+            pos++;
+            continue;
+        }
+        TEST_ASSERT_EQUAL(-1, logDecodeFrame(stream + pos, 5, entry));
+        int n = logDecodeFrame(stream + pos, length - pos, entry);
+        TEST_ASSERT_TRUE(n > 0);
+        TEST_ASSERT_EQUAL_UINT32(123456, entry.time);
+
+        char text[96];
+        const char *format = logMessageFormat(messages, sizeof(messages) / sizeof(messages[0]), entry.id);
+        TEST_ASSERT_NOT_NULL(format);
+        logFormat(text, sizeof(text), format, entry.args, entry.argc);
+        TEST_ASSERT_EQUAL_STRING(expected[decoded], text);
+        decoded++;
+        pos += n;
+    }
+    TEST_ASSERT_EQUAL(3, decoded);
+
+    // A flipped bit fails the CRC and the tool resyncs after the magic byte
+    stream[1 + 4] ^= 0x10;
+    TEST_ASSERT_EQUAL(0, logDecodeFrame(stream + 1, length - 1, entry));
+}
+
+static int evaluated;
+static int sideEffect() { return ++evaluated; }
+
+void test_level_filter()
+{
+    // Below LOG_LEVEL the call and its arguments are gone, not just skipped at run time
+    evaluated = 0;
+    LOG_DEBUG(LOG_ESP_RESET, sideEffect());
+    LOG_INFO(LOG_ESP_RESET, sideEffect());
+    TEST_ASSERT_EQUAL(0, evaluated);
+    LogEntry entry;
+    TEST_ASSERT_FALSE(logQueue.pop(entry));
+
+    LOG_WARN(LOG_ESP_LOG_DROPPED, sideEffect());
+    LOG_ERROR(LOG_ESP_NO_DATA, sideEffect());
+    TEST_ASSERT_EQUAL(2, evaluated);
+    TEST_ASSERT_TRUE(logQueue.pop(entry));
+    TEST_ASSERT_EQUAL_UINT8(LOG_LEVEL_WARN, entry.level);
+    TEST_ASSERT_EQUAL_UINT32(1, entry.args[0]);
+    TEST_ASSERT_TRUE(logQueue.pop(entry));
+    TEST_ASSERT_EQUAL_UINT8(LOG_LEVEL_ERROR, entry.level);
+    TEST_ASSERT_EQUAL_UINT32(2, entry.args[0]);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_slots_reused_lap_after_lap);
+    RUN_TEST(test_full_queue_drops_and_counts);
+    RUN_TEST(test_producers_on_other_threads);
+    RUN_TEST(test_arguments_survive_the_frame);
+    RUN_TEST(test_level_filter);
+    return UNITY_END();
+}
@@ -0,0 +1,193 @@
+// Node table of the gateway and the sequence window of every node: pio test -e native -f test_nodeTable
+#include <unity.h>
+#include "nodeTable.h"
+
+static NodeTable table;
+
+// Same hash as NodeTable::home
+static size_t homeOf(uint16_t nodeId)
+{
+    return ((uint16_t)(nodeId * 40503u)) & (NODE_TABLE_SLOTS - 1);
+}
+
+// Fills ids with count node ids whose home slot is home, from id 1 on
+static void idsAt(size_t home, uint16_t *ids, size_t count)
+{
+    size_t n = 0;
+    for (uint32_t id = 1; id <= 0xFFFF && n < count; id++)
+    {
+        if (homeOf(id) == home)
+            ids[n++] = id;
+    }
+    TEST_ASSERT_EQUAL(count, n);
+}
+
+static void expectSlot(size_t index, uint16_t nodeId)
+{
+    NodeState *node = table.slot(index);
+    TEST_ASSERT_NOT_NULL(node);
+    TEST_ASSERT_EQUAL_UINT16(nodeId, node->nodeId);
+}
+
+static void expectFound(uint16_t nodeId)
+{
+    NodeState *node = table.find(nodeId);
+    TEST_ASSERT_NOT_NULL(node);
+    TEST_ASSERT_EQUAL_UINT16(nodeId, node->nodeId);
+}
+
+void setUp()
+{
+    table.clear();
+}
+
+void tearDown() {}
+
+void test_collisions_wrap_around_the_table_end()
+{
+    // Three nodes that all want the last slot take it and the first two
+    uint16_t ids[3];
+    idsAt(NODE_TABLE_SLOTS - 1, ids, 3);
+    for (uint16_t id : ids)
+        table.get(id, 0);
+    expectSlot(NODE_TABLE_SLOTS - 1, ids[0]);
+    expectSlot(0, ids[1]);
+    expectSlot(1, ids[2]);
+    for (uint16_t id : ids)
+        expectFound(id);
+
+    // Removing the one at the end pulls the run back across the wrap
+    table.remove(ids[0]);
+    expectSlot(NODE_TABLE_SLOTS - 1, ids[1]);
+    expectSlot(0, ids[2]);
+    TEST_ASSERT_NULL(table.slot(1));
+    TEST_ASSERT_NULL(table.find(ids[0]));
+    expectFound(ids[1]);
+    expectFound(ids[2]);
+    TEST_ASSERT_EQUAL(2, table.size());
+}
+
+void test_delete_in_the_middle_of_a_probe_run()
+{
+    // Run from slot 10: a, b and d want 10, c wants 12
+    uint16_t ten[3], twelve[1];
+    idsAt(10, ten, 3);
+    idsAt(12, twelve, 1);
+    uint16_t a = ten[0], b = ten[1], c = twelve[0], d = ten[2];
+    table.get(a, 0);
+    table.get(b, 0);
+    table.get(c, 0);
+    table.get(d, 0);
+    expectSlot(10, a);
+    expectSlot(11, b);
+    expectSlot(12, c);
+    expectSlot(13, d);
+
+    // c is at home and stays, d moves past it into the hole b left
+    table.remove(b);
+    expectSlot(10, a);
+    expectSlot(11, d);
+    expectSlot(12, c);
+    TEST_ASSERT_NULL(table.slot(13));
+    TEST_ASSERT_NULL(table.find(b));
+    expectFound(a);
+    expectFound(c);
+    expectFound(d);
+
+    // The node state moves with its entry
+    table.find(d)->batches = 7;
+    table.remove(a);
+    expectSlot(10, d);
+    TEST_ASSERT_EQUAL_UINT32(7, table.find(d)->batches);
+    expectFound(c);
+    TEST_ASSERT_EQUAL(2, table.size());
+}
+
+void test_full_table_takes_no_more_nodes_than_its_limit()
+{
+    // Every node seen at its own time, node 1 the longest ago
+    for (uint16_t id = 1; id <= NODE_TABLE_MAX_NODES; id++)
+        table.get(id, id * 1000);
+    TEST_ASSERT_EQUAL(NODE_TABLE_MAX_NODES, table.size());
+    table.record(*table.find(1), NULL, 0, 100000);
+
+    // A new node only gets in in place of the node seen least recently, node 2
+    uint32_t now = 200000;
+    table.get(1000, now);
+    TEST_ASSERT_EQUAL(NODE_TABLE_MAX_NODES, table.size());
+    TEST_ASSERT_EQUAL_UINT32(1, table.evictions());
+    TEST_ASSERT_NULL(table.find(2));
+    expectFound(1);
+    expectFound(1000);
+    for (uint16_t id = 3; id <= NODE_TABLE_MAX_NODES; id++)
+        expectFound(id);
+
+    // Many more nodes never fill the slots, a miss still ends at an unused slot
+    for (uint16_t id = 2000; id < 2000 + 4 * NODE_TABLE_SLOTS; id++)
+        table.get(id, ++now);
+    TEST_ASSERT_EQUAL(NODE_TABLE_MAX_NODES, table.size());
+    TEST_ASSERT_NULL(table.find(2));
+    size_t used = 0;
+    for (size_t i = 0; i < NODE_TABLE_SLOTS; i++)
+        used += table.slot(i) != NULL;
+    TEST_ASSERT_EQUAL(NODE_TABLE_MAX_NODES, used);
+}
+
+void test_window_duplicates_and_reordering()
+{
+    SequenceWindow window;
+    window.reset();
+    TEST_ASSERT_FALSE(window.isDuplicate(10));
+    window.accept(10);
+    TEST_ASSERT_TRUE(window.isDuplicate(10));
+
+    // 12 before 11: 11 is still new, then a duplicate
+    window.accept(12);
+    TEST_ASSERT_FALSE(window.isDuplicate(11));
+    TEST_ASSERT_TRUE(window.isDuplicate(12));
+    window.accept(11);
+    TEST_ASSERT_TRUE(window.isDuplicate(11));
+    TEST_ASSERT_FALSE(window.isDuplicate(13));
+
+    // The oldest number the window still knows, and the first one it has forgotten
+    window.accept(10 + SEQUENCE_WINDOW_SIZE - 1);
+    TEST_ASSERT_TRUE(window.isDuplicate(10));
+    window.accept(10 + SEQUENCE_WINDOW_SIZE);
+    TEST_ASSERT_FALSE(window.isDuplicate(10));
+    TEST_ASSERT_TRUE(window.isDuplicate(11));
+}
+
+void test_window_across_the_sequence_wrap()
+{
+    SequenceWindow window;
+    window.reset();
+    window.accept(0xFFFE);
+    window.accept(0x0000);
+    window.accept(0x0001);
+
+    // 0x0001 is the highest, the numbers before the wrap stay in the window
+    TEST_ASSERT_EQUAL_UINT16(0x0001, window.highest);
+    TEST_ASSERT_TRUE(window.isDuplicate(0xFFFE));
+    TEST_ASSERT_FALSE(window.isDuplicate(0xFFFF));
+    TEST_ASSERT_TRUE(window.isDuplicate(0x0000));
+    window.accept(0xFFFF);
+    TEST_ASSERT_TRUE(window.isDuplicate(0xFFFF));
+    TEST_ASSERT_EQUAL_UINT16(0x0001, window.highest);
+
+    // A number far from the window is a node that restarted, not a duplicate
+    TEST_ASSERT_FALSE(window.isDuplicate(0x8000));
+    window.accept(0x8000);
+    TEST_ASSERT_TRUE(window.isDuplicate(0x8000));
+    TEST_ASSERT_FALSE(window.isDuplicate(0x0001));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_collisions_wrap_around_the_table_end);
+    RUN_TEST(test_delete_in_the_middle_of_a_probe_run);
+    RUN_TEST(test_full_table_takes_no_more_nodes_than_its_limit);
+    RUN_TEST(test_window_duplicates_and_reordering);
+    RUN_TEST(test_window_across_the_sequence_wrap);
+    return UNITY_END();
+}
@@ -0,0 +1,91 @@
+// Batch median of the gateway: pio test -e native -f test_sensorDataHandler
+#include <unity.h>
+#include "sensorDataHandler.h"
+
+void setUp() {}
+void tearDown() {}
+
+static void fill(SensorBatch &batch, const float *temps, const float *hums, const bool *errors, size_t count)
+{
+    batch.clear();
+    for (size_t i = 0; i < count; i++)
+        TEST_ASSERT_TRUE(batch.push(makeSensorData(temps[i], hums[i], errors[i])));
+}
+
+void test_median_odd_count()
+{
+    SensorBatch batch;
+    float temps[] = {22.0f, 20.5f, 21.0f, 25.0f, 19.0f};
+    float hums[] = {41.0f, 40.0f, 45.0f, 39.0f, 50.0f};
+    bool errors[] = {false, false, false, false, false};
+    fill(batch, temps, hums, errors, 5);
+
+    SensorData median = calcMedian(batch);
+    TEST_ASSERT_FALSE(median.error);
+    TEST_ASSERT_EQUAL_INT16(2100, median.tempCenti);
+    TEST_ASSERT_EQUAL_INT16(4100, median.humCenti);
+}
+
+void test_median_even_count_rounds_average()
+{
+    SensorBatch batch;
+    float temps[] = {20.01f, 20.04f, 19.0f, 30.0f};
+    float hums[] = {40.0f, 41.0f, 42.0f, 43.0f};
+    bool errors[] = {false, false, false, false};
+    fill(batch, temps, hums, errors, 4);
+
+    // (2001 + 2004) / 2 = 2002.5, rounded away from zero
+    SensorData median = calcMedian(batch);
+    TEST_ASSERT_EQUAL_INT16(2003, median.tempCenti);
+    TEST_ASSERT_EQUAL_INT16(4150, median.humCenti);
+}
+
+void test_median_skips_failed_readings()
+{
+    SensorBatch batch;
+    float temps[] = {21.0f, -40.0f, 23.0f, 22.0f};
+    float hums[] = {40.0f, 0.0f, 44.0f, 42.0f};
+    bool errors[] = {false, true, false, false};
+    fill(batch, temps, hums, errors, 4);
+
+    SensorData median = calcMedian(batch);
+    TEST_ASSERT_FALSE(median.error);
+    TEST_ASSERT_EQUAL_INT16(2200, median.tempCenti);
+    TEST_ASSERT_EQUAL_INT16(4200, median.humCenti);
+}
+
+void test_median_without_valid_readings_is_error()
+{
+    SensorBatch batch;
+    TEST_ASSERT_TRUE(calcMedian(batch).error);
+
+    float temps[] = {21.0f, 22.0f};
+    float hums[] = {40.0f, 41.0f};
+    bool errors[] = {true, true};
+    fill(batch, temps, hums, errors, 2);
+    TEST_ASSERT_TRUE(calcMedian(batch).error);
+}
+
+void test_median_full_batch_negative_values()
+{
+    SensorBatch batch;
+    for (size_t i = 0; i < MEDIAN_MAX_READINGS; i++)
+        TEST_ASSERT_TRUE(batch.push(makeSensorData(-20.0f + i * 0.5f, 10.0f, false)));
+    TEST_ASSERT_FALSE(batch.push(makeSensorData(0.0f, 0.0f, false)));
+
+    // Middle two of -20.0 .. 11.5 in 0.5 steps are -4.5 and -4.0
+    SensorData median = calcMedian(batch);
+    TEST_ASSERT_EQUAL_INT16(-425, median.tempCenti);
+    TEST_ASSERT_EQUAL_INT16(1000, median.humCenti);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_median_odd_count);
+    RUN_TEST(test_median_even_count_rounds_average);
+    RUN_TEST(test_median_skips_failed_readings);
+    RUN_TEST(test_median_without_valid_readings_is_error);
+    RUN_TEST(test_median_full_batch_negative_values);
+    return UNITY_END();
+}
@@ -0,0 +1,160 @@
+// Receive to processing queue under two threads: pio test -e native -f test_spscQueue
+#include <unity.h>
+#include <thread>
+#include <atomic>
+#include "spscQueue.h"
+
+#define STRESS_ITEMS 2000000
+#define STRESS_QUEUE_SIZE 16 // small, so the ring wraps often and runs full
+
+// Two words that must always match, a torn or stale slot breaks the pair
+struct StressItem
+{
+    uint32_t sequence;
+    uint32_t check;
+};
+
+static uint32_t checkOf(uint32_t sequence) { return ~sequence * 2654435761u; }
+
+void setUp() {}
+void tearDown() {}
+
+void test_fill_drain_and_wrap()
+{
+    SpscQueue<int, 4> queue;
+    int value = 0;
+    for (int round = 0; round < 10; round++)
+    {
+        for (int i = 0; i < 4; i++)
+            TEST_ASSERT_TRUE(queue.push(round * 4 + i));
+        TEST_ASSERT_FALSE(queue.push(-1));
+        TEST_ASSERT_EQUAL(0, queue.freeSpace());
+        TEST_ASSERT_EQUAL(4, queue.size());
+
+        for (int i = 0; i < 4; i++)
+        {
+            TEST_ASSERT_TRUE(queue.pop(value));
+            TEST_ASSERT_EQUAL(round * 4 + i, value);
+        }
+        TEST_ASSERT_FALSE(queue.pop(value));
+        TEST_ASSERT_EQUAL(4, queue.freeSpace());
+    }
+}
+
+void test_two_threads_keep_order_without_loss()
+{
+    static SpscQueue<StressItem, STRESS_QUEUE_SIZE> queue;
+    std::atomic<uint32_t> fullRejects(0);
+    std::atomic<uint32_t> spaceLies(0);
+
+    std::thread producer([&]()
+                         {
+        uint32_t rejects = 0;
+        uint32_t lies = 0;
+        for (uint32_t seq = 0; seq < STRESS_ITEMS;)
+        {
+            // freeSpace is a lower bound: with space reported the push has to succeed
+            bool space = queue.freeSpace() > 0;
+            StressItem item = {seq, checkOf(seq)};
+            if (queue.push(item))
+            {
+                seq++;
+                continue;
+            }
+            if (space)
+                lies++;
+            rejects++;
+            std::this_thread::yield();
+        }
+        fullRejects = rejects;
+        spaceLies = lies; });
+
+    uint32_t expected = 0;
+    uint32_t outOfOrder = 0;
+    uint32_t torn = 0;
+    uint32_t oversize = 0;
+    StressItem item;
+    while (expected < STRESS_ITEMS)
+    {
+        if (queue.size() > STRESS_QUEUE_SIZE)
+            oversize++;
+        if (!queue.pop(item))
+        {
+            // Let the producer run, the test host may have a single core
+            std::this_thread::yield();
+            continue;
+        }
+        if (item.sequence != expected)
+            outOfOrder++;
+        if (item.check != checkOf(item.sequence))
+            torn++;
+        expected = item.sequence + 1;
+        // Fall behind now and then so the producer hits a full ring
+        if ((expected & 0x3FFF) == 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    producer.join();
+
+    TEST_ASSERT_EQUAL(0, outOfOrder); // lost, duplicated or reordered
+    TEST_ASSERT_EQUAL(0, torn);
+    TEST_ASSERT_EQUAL(0, oversize);
+    TEST_ASSERT_EQUAL(0, spaceLies.load());
+    TEST_ASSERT_GREATER_THAN(0, fullRejects.load());
+    TEST_ASSERT_FALSE(queue.pop(item));
+}
+
+void test_batches_pushed_whole_after_space_check()
+{
+    // The receive side checks freeSpace once, then pushes a whole batch (enqueueBatch)
+    static SpscQueue<StressItem, STRESS_QUEUE_SIZE> queue;
+    const uint32_t batch = 5;
+    const uint32_t batches = 200000;
+    std::atomic<uint32_t> failedPushes(0);
+
+    std::thread producer([&]()
+                         {
+        uint32_t seq = 0;
+        for (uint32_t b = 0; b < batches;)
+        {
+            if (queue.freeSpace() < batch)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            for (uint32_t i = 0; i < batch; i++, seq++)
+            {
+                StressItem item = {seq, checkOf(seq)};
+                if (!queue.push(item))
+                    failedPushes++;
+            }
+            b++;
+        } });
+
+    uint32_t expected = 0;
+    uint32_t outOfOrder = 0;
+    StressItem item;
+    while (expected < batch * batches)
+    {
+        if (!queue.pop(item))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        if (item.sequence != expected || item.check != checkOf(item.sequence))
+            outOfOrder++;
+        expected = item.sequence + 1;
+    }
+    producer.join();
+
+    TEST_ASSERT_EQUAL(0, failedPushes.load());
+    TEST_ASSERT_EQUAL(0, outOfOrder);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fill_drain_and_wrap);
+    RUN_TEST(test_two_threads_keep_order_without_loss);
+    RUN_TEST(test_batches_pushed_whole_after_space_check);
+    return UNITY_END();
+}
@@ -0,0 +1,311 @@
+// Flash backlog of the gateway on a file backed flash, power cuts are a queue going
+// out of scope without notice: pio test -e native -f test_storeForward
+#include <unity.h>
+#include <stdio.h>
+#include <batchCodec.h>
+#include "flashStore.h"
+#include "storeForward.h"
+#include "forwarder.h"
+#include <changeFilter.h>
+
+#define TEST_FLASH "test_flash.bin"
+#define TEST_SECTORS 4
+#define TEST_SECTOR_SIZE 4096
+#define TEST_RECORDS_PER_SEGMENT (TEST_SECTOR_SIZE / STORE_RECORD_SIZE - 1) // slot 0 is the header
+
+static StoredReading reading(uint32_t i)
+{
+    StoredReading r = {0, 1760000000 + i, (uint16_t)(1 + i % 3), (int16_t)(2000 + i), (int16_t)(4000 - i), false, 0, 0, 0};
+    return r;
+}
+
+// Checks the queue holds the readings first..first+count-1 in order
+static void expectPending(StoreForwardQueue &queue, uint32_t first, size_t count)
+{
+    static StoredReading out[TEST_SECTORS * TEST_RECORDS_PER_SEGMENT];
+    TEST_ASSERT_EQUAL(count, queue.size());
+    TEST_ASSERT_EQUAL(count, queue.peek(out, count + 1));
+    for (size_t i = 0; i < count; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT32(first + i, out[i].sequence);
+        TEST_ASSERT_EQUAL_UINT32(reading(first + i).timestamp, out[i].timestamp);
+        TEST_ASSERT_EQUAL_INT16(reading(first + i).temperature, out[i].temperature);
+    }
+}
+
+void setUp()
+{
+    remove(TEST_FLASH);
+}
+
+void tearDown()
+{
+    remove(TEST_FLASH);
+}
+
+void test_sequence_reservation_survives_restart()
+{
+    {
+        FileFlash flash(TEST_FLASH, TEST_SECTORS * TEST_SECTOR_SIZE, TEST_SECTOR_SIZE);
+        StoreForwardQueue queue(flash);
+        TEST_ASSERT_TRUE(queue.begin());
+        TEST_ASSERT_EQUAL_UINT32(0, queue.reservedSequences());
+        TEST_ASSERT_TRUE(queue.reserveSequences(1000));
+        TEST_ASSERT_TRUE(queue.reserveSequences(2000));
+        // Lower limits change nothing
+        TEST_ASSERT_TRUE(queue.reserveSequences(1500));
+        TEST_ASSERT_TRUE(queue.append(reading(0)));
+    }
+
+    FileFlash flash(TEST_FLASH, TEST_SECTORS * TEST_SECTOR_SIZE, TEST_SECTOR_SIZE);
+    StoreForwardQueue queue(flash);
+    TEST_ASSERT_TRUE(queue.begin());
+    TEST_ASSERT_EQUAL_UINT32(2000, queue.reservedSequences());
+    TEST_ASSERT_EQUAL(1, queue.size());
+
+    // Reservation records are no readings
+    StoredReading out[2];
+    TEST_ASSERT_EQUAL(1, queue.peek(out, 2));
+    TEST_ASSERT_EQUAL_UINT32(reading(0).timestamp, out[0].timestamp);
+}
+
+void test_sequence_reservation_outlives_its_segment()
+{
+    // Enough readings to reuse every sector, the segment with the record is gone by then
+    uint32_t slots = TEST_SECTOR_SIZE / STORE_RECORD_SIZE;
+    {
+        FileFlash flash(TEST_FLASH, TEST_SECTORS * TEST_SECTOR_SIZE, TEST_SECTOR_SIZE);
+        StoreForwardQueue queue(flash);
+        TEST_ASSERT_TRUE(queue.begin());
+        TEST_ASSERT_TRUE(queue.reserveSequences(4242));
+        for (uint32_t i = 0; i < slots * (TEST_SECTORS + 1); i++)
+            TEST_ASSERT_TRUE(queue.append(reading(i)));
+        TEST_ASSERT_TRUE(queue.dropped() > 0);
+    }
+
+    FileFlash flash(TEST_FLASH, TEST_SECTORS * TEST_SECTOR_SIZE, TEST_SECTOR_SIZE);
+    StoreForwardQueue queue(flash);
+    TEST_ASSERT_TRUE(queue.begin());
+    TEST_ASSERT_EQUAL_UINT32(4242, queue.reservedSequences());
+}
+
+void test_upstream_batches_numbered_from_first_sequence()
+{
+    // Three nodes give three batches, numbered on across the 16 bit wrap
+    StoredReading readings[9];
+    for (uint32_t i = 0; i < 9; i++)
+        readings[i] = reading(i);
+    static uint8_t body[FORWARD_BODY_SIZE];
+    size_t length = encodeUpstreamBody(readings, 9, body, sizeof(body), 0xFFFE);
+    TEST_ASSERT_TRUE(length > 0);
+    TEST_ASSERT_EQUAL_UINT8(BATCH_LIST_MAGIC, body[0]);
+    TEST_ASSERT_EQUAL_UINT8(3, body[1]);
+
+    uint16_t expected[] = {0xFFFE, 0xFFFF, 0x0000};
+    size_t pos = BATCH_LIST_HEADER_SIZE;
+    for (int i = 0; i < 3; i++)
+    {
+        size_t frameLength = body[pos] | (body[pos + 1] << 8);
+        pos += BATCH_LIST_LENGTH_SIZE;
+        BatchDecoder decoder;
+        TEST_ASSERT_EQUAL(BATCH_OK, decoder.begin(body + pos, frameLength));
+        TEST_ASSERT_EQUAL_UINT16(1 + i, decoder.header().nodeId);
+        TEST_ASSERT_EQUAL_UINT16(expected[i], decoder.header().sequence);
+        pos += frameLength;
+    }
+    TEST_ASSERT_EQUAL(length, pos);
+}
+
+void test_series_points_keep_their_flags_upstream()
+{
+    // Node 1 sends plain samples, node 2 a swinging door series, node 3 a series without a time
+    StoredReading readings[7];
+    for (uint32_t i = 0; i < 7; i++)
+        readings[i] = reading(i);
+    for (uint32_t i = 0; i < 7; i++)
+        readings[i].nodeId = i < 2 ? 1 : i < 6 ? 2 : 3;
+    for (uint32_t i = 2; i < 7; i++)
+    {
+        readings[i].series = CHANGE_FILTER_SWINGING_DOOR;
+        readings[i].tempTolerance = 20;
+        readings[i].humTolerance = 100;
+    }
+    readings[6].timestamp = 0;
+
+    static uint8_t body[FORWARD_BODY_SIZE];
+    size_t length = encodeUpstreamBody(readings, 7, body, sizeof(body), 0);
+    TEST_ASSERT_TRUE(length > 0);
+    TEST_ASSERT_EQUAL_UINT8(3, body[1]);
+
+    const uint8_t flags[] = {BATCH_FLAG_TIMES | BATCH_FLAG_EPOCH, BATCH_FLAG_TIMES | BATCH_FLAG_EPOCH | BATCH_FLAG_LINEAR, 0};
+    const uint8_t counts[] = {2, 4, 1};
+    const uint8_t tolerances[] = {0, 20, 0};
+    size_t pos = BATCH_LIST_HEADER_SIZE;
+    for (int i = 0; i < 3; i++)
+    {
+        size_t frameLength = body[pos] | (body[pos + 1] << 8);
+        pos += BATCH_LIST_LENGTH_SIZE;
+        BatchDecoder decoder;
+        TEST_ASSERT_EQUAL(BATCH_OK, decoder.begin(body + pos, frameLength));
+        TEST_ASSERT_EQUAL_UINT16(1 + i, decoder.header().nodeId);
+        TEST_ASSERT_EQUAL_HEX8(flags[i], decoder.header().flags);
+        TEST_ASSERT_EQUAL_UINT8(counts[i], decoder.header().count);
+        TEST_ASSERT_EQUAL_UINT8(tolerances[i], decoder.header().tempTolerance);
+        TEST_ASSERT_EQUAL_UINT8(tolerances[i] * 5, decoder.header().humTolerance);
+        pos += frameLength;
+    }
+}
+
+void test_series_points_survive_the_flash()
+{
+    {
+        FileFlash flash(TEST_FLASH, TEST_SECTORS * TEST_SECTOR_SIZE, TEST_SECTOR_SIZE);
+        StoreForwardQueue queue(flash);
+        TEST_ASSERT_TRUE(queue.begin());
+        StoredReading r = reading(0);
+        r.series = CHANGE_FILTER_DEADBAND;
+        r.tempTolerance = 20;
+        r.humTolerance = 95;
+        r.error = true;
+        TEST_ASSERT_TRUE(queue.append(r));
+        TEST_ASSERT_TRUE(queue.append(reading(1)));
+    }
+
+    FileFlash flash(TEST_FLASH, TEST_SECTORS * TEST_SECTOR_SIZE, TEST_SECTOR_SIZE);
+    StoreForwardQueue queue(flash);
+    TEST_ASSERT_TRUE(queue.begin());
+    StoredReading out[2];
+    TEST_ASSERT_EQUAL(2, queue.peek(out, 2));
+    TEST_ASSERT_TRUE(out[0].error);
+    TEST_ASSERT_EQUAL_UINT8(CHANGE_FILTER_DEADBAND, out[0].series);
+    TEST_ASSERT_EQUAL_UINT8(20, out[0].tempTolerance);
+    // The humidity tolerance is kept in coarser steps, rounded up
+    TEST_ASSERT_EQUAL_UINT8(100, out[0].humTolerance);
+
+    TEST_ASSERT_FALSE(out[1].error);
+    TEST_ASSERT_EQUAL_UINT8(CHANGE_FILTER_OFF, out[1].series);
+    TEST_ASSERT_EQUAL_UINT8(0, out[1].tempTolerance);
+    TEST_ASSERT_EQUAL_UINT8(0, out[1].humTolerance);
+}
+
+void test_pending_readings_survive_power_cut()
+{
+    {
+        FileFlash flash(TEST_FLASH, TEST_SECTORS * TEST_SECTOR_SIZE, TEST_SECTOR_SIZE);
+        StoreForwardQueue queue(flash);
+        TEST_ASSERT_TRUE(queue.begin());
+        for (uint32_t i = 0; i < 10; i++)
+            TEST_ASSERT_TRUE(queue.append(reading(i)));
+        queue.consume(3);
+        // Power goes, nothing is flushed or closed on purpose
+    }
+
+    FileFlash flash(TEST_FLASH, TEST_SECTORS * TEST_SECTOR_SIZE, TEST_SECTOR_SIZE);
+    StoreForwardQueue queue(flash);
+    TEST_ASSERT_TRUE(queue.begin());
+    expectPending(queue, 3, 7);
+
+    // Numbering goes on after the recovered records
+    TEST_ASSERT_TRUE(queue.append(reading(10)));
+    expectPending(queue, 3, 8);
+}
+
+void test_segment_wrap_drops_oldest_segment()
+{
+    uint32_t total = TEST_SECTORS * TEST_RECORDS_PER_SEGMENT + 50;
+    {
+        FileFlash flash(TEST_FLASH, TEST_SECTORS * TEST_SECTOR_SIZE, TEST_SECTOR_SIZE);
+        StoreForwardQueue queue(flash);
+        TEST_ASSERT_TRUE(queue.begin());
+        for (uint32_t i = 0; i < total; i++)
+            TEST_ASSERT_TRUE(queue.append(reading(i)));
+
+        // Starting the fifth segment reused the sector of the first
+        TEST_ASSERT_EQUAL_UINT32(TEST_RECORDS_PER_SEGMENT, queue.dropped());
+        expectPending(queue, TEST_RECORDS_PER_SEGMENT, total - TEST_RECORDS_PER_SEGMENT);
+    }
+
+    FileFlash flash(TEST_FLASH, TEST_SECTORS * TEST_SECTOR_SIZE, TEST_SECTOR_SIZE);
+    StoreForwardQueue queue(flash);
+    TEST_ASSERT_TRUE(queue.begin());
+    expectPending(queue, TEST_RECORDS_PER_SEGMENT, total - TEST_RECORDS_PER_SEGMENT);
+
+    // Draining across the wrap leaves an empty queue that still appends
+    queue.consume(total);
+    TEST_ASSERT_EQUAL(0, queue.size());
+    TEST_ASSERT_TRUE(queue.append(reading(total)));
+    expectPending(queue, total, 1);
+}
+
+void test_power_cut_while_reusing_a_segment()
+{
+    // Every sector full, the next append erases sector 0 and the power goes before its header is written
+    uint32_t total = TEST_SECTORS * TEST_RECORDS_PER_SEGMENT;
+    {
+        FileFlash flash(TEST_FLASH, TEST_SECTORS * TEST_SECTOR_SIZE, TEST_SECTOR_SIZE);
+        StoreForwardQueue queue(flash);
+        TEST_ASSERT_TRUE(queue.begin());
+        for (uint32_t i = 0; i < total; i++)
+            TEST_ASSERT_TRUE(queue.append(reading(i)));
+        TEST_ASSERT_TRUE(flash.eraseSector(0));
+    }
+
+    FileFlash flash(TEST_FLASH, TEST_SECTORS * TEST_SECTOR_SIZE, TEST_SECTOR_SIZE);
+    StoreForwardQueue queue(flash);
+    TEST_ASSERT_TRUE(queue.begin());
+    expectPending(queue, TEST_RECORDS_PER_SEGMENT, total - TEST_RECORDS_PER_SEGMENT);
+    TEST_ASSERT_TRUE(queue.append(reading(total)));
+    expectPending(queue, TEST_RECORDS_PER_SEGMENT, total - TEST_RECORDS_PER_SEGMENT + 1);
+}
+
+void test_torn_and_corrupt_records_are_skipped()
+{
+    {
+        FileFlash flash(TEST_FLASH, TEST_SECTORS * TEST_SECTOR_SIZE, TEST_SECTOR_SIZE);
+        StoreForwardQueue queue(flash);
+        TEST_ASSERT_TRUE(queue.begin());
+        for (uint32_t i = 0; i < 5; i++)
+            TEST_ASSERT_TRUE(queue.append(reading(i)));
+
+        // Bits of record 2 drop to 0, as worn flash does
+        const uint8_t flipped = 0x00;
+        TEST_ASSERT_TRUE(flash.write(3 * STORE_RECORD_SIZE + 14, &flipped, 1));
+
+        // The power went half way through writing a sixth record: magic and state made it, the rest didn't
+        const uint8_t torn[] = {0xA5, 0xFF, 0x12};
+        TEST_ASSERT_TRUE(flash.write(6 * STORE_RECORD_SIZE, torn, sizeof(torn)));
+    }
+
+    FileFlash flash(TEST_FLASH, TEST_SECTORS * TEST_SECTOR_SIZE, TEST_SECTOR_SIZE);
+    StoreForwardQueue queue(flash);
+    TEST_ASSERT_TRUE(queue.begin());
+    TEST_ASSERT_EQUAL(4, queue.size());
+    StoredReading out[8];
+    TEST_ASSERT_EQUAL(4, queue.peek(out, 8));
+    TEST_ASSERT_EQUAL_UINT32(0, out[0].sequence);
+    TEST_ASSERT_EQUAL_UINT32(1, out[1].sequence);
+    TEST_ASSERT_EQUAL_UINT32(3, out[2].sequence);
+    TEST_ASSERT_EQUAL_UINT32(4, out[3].sequence);
+
+    // New records go after the torn slot, consuming steps over both bad ones
+    TEST_ASSERT_TRUE(queue.append(reading(5)));
+    queue.consume(3);
+    TEST_ASSERT_EQUAL(2, queue.peek(out, 8));
+    TEST_ASSERT_EQUAL_UINT32(4, out[0].sequence);
+    TEST_ASSERT_EQUAL_UINT32(5, out[1].sequence);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_sequence_reservation_survives_restart);
+    RUN_TEST(test_sequence_reservation_outlives_its_segment);
+    RUN_TEST(test_upstream_batches_numbered_from_first_sequence);
+    RUN_TEST(test_series_points_keep_their_flags_upstream);
+    RUN_TEST(test_series_points_survive_the_flash);
+    RUN_TEST(test_pending_readings_survive_power_cut);
+    RUN_TEST(test_segment_wrap_drops_oldest_segment);
+    RUN_TEST(test_power_cut_while_reusing_a_segment);
+    RUN_TEST(test_torn_and_corrupt_records_are_skipped);
+    return UNITY_END();
+}
@@ -0,0 +1,100 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+/* Host (native) stand-in for the Arduino core.
+    Only the parts the firmware uses are provided: timing, random numbers, Serial,
+    String, Print/Stream, digital pins with interrupts and the FreeRTOS task calls of
+    the ESP32 core. Time comes from the host's monotonic clock and can be moved forward
+    with hostAdvanceMillis() to run timeouts without waiting. */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include "WString.h"
+#include "Print.h"
+#include "hostFreeRTOS.h"
+
+#define HOST_BUILD 1
+
+#define A0 14
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define NOT_AN_INTERRUPT -1
+#define HOST_PINS 32
+
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+int analogRead(uint8_t pin);
+
+// Pins only remember their state, every pin can have an interrupt
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(int interrupt, void (*handler)(), int mode);
+void detachInterrupt(int interrupt);
+void noInterrupts();
+void interrupts();
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+// ESP32 core function, answers from the host clock immediately
+bool getLocalTime(struct tm *info, uint32_t ms = 5000);
+
+// Moves millis()/micros() forward without sleeping
+void hostAdvanceMillis(unsigned long ms);
+void hostAdvanceMicros(unsigned long us);
+// Stops the real time part of the clock, only hostAdvance* moves it while frozen
+void hostFreezeClock(bool frozen);
+// Runs the handler attached to pin as if its edge happened now, false if none is attached
+bool hostTriggerInterrupt(uint8_t pin);
+
+// Serial port writing to stdout
+class HostSerial : public Stream
+{
+public:
+    HostSerial() : muted(false) {}
+
+    void begin(unsigned long) {}
+    operator bool() const { return true; }
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+    void flush() override;
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+
+    // Drops all output, used while benchmarking so the terminal isn't measured
+    void mute(bool on) { muted = on; }
+
+private:
+    bool muted;
+};
+
+extern HostSerial Serial;
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define HOST_EEPROM_SIZE 8192 // same as the Uno R4 data flash
+
+/* Host EEPROM kept in RAM, starts erased (0xFF) like a new board.
+    Counts byte writes so wear can be compared between implementations. */
+class EEPROMClass
+{
+public:
+    EEPROMClass() : byteWrites(0) { memset(data, 0xFF, sizeof(data)); }
+
+    void begin() {}
+    uint16_t length() const { return HOST_EEPROM_SIZE; }
+
+    uint8_t read(int address) const { return inRange(address) ? data[address] : 0xFF; }
+
+    void write(int address, uint8_t value)
+    {
+        if (!inRange(address))
+            return;
+        data[address] = value;
+        byteWrites++;
+    }
+
+    void update(int address, uint8_t value)
+    {
+        if (read(address) != value)
+            write(address, value);
+    }
+
+    template <typename T>
+    T &get(int address, T &value) const
+    {
+        uint8_t *out = (uint8_t *)&value;
+        for (size_t i = 0; i < sizeof(T); i++)
+            out[i] = read(address + i);
+        return value;
+    }
+
+    template <typename T>
+    const T &put(int address, const T &value)
+    {
+        const uint8_t *in = (const uint8_t *)&value;
+        for (size_t i = 0; i < sizeof(T); i++)
+            update(address + i, in[i]);
+        return value;
+    }
+
+    // Host only: bytes written since start, and a way to simulate a new board
+    unsigned long writes() const { return byteWrites; }
+    void erase()
+    {
+        memset(data, 0xFF, sizeof(data));
+        byteWrites = 0;
+    }
+
+private:
+    static bool inRange(int address) { return address >= 0 && address < HOST_EEPROM_SIZE; }
+
+    uint8_t data[HOST_EEPROM_SIZE];
+    unsigned long byteWrites;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
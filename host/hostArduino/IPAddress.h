@@ -0,0 +1,25 @@
+#ifndef IPADDRESS_H
+#define IPADDRESS_H
+
+#include <stdint.h>
+
+// IPv4 address with the byte access of the Arduino class
+class IPAddress
+{
+public:
+    IPAddress() : bytes{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : bytes{a, b, c, d} {}
+
+    uint8_t operator[](int index) const { return bytes[index]; }
+    uint8_t &operator[](int index) { return bytes[index]; }
+    bool operator==(const IPAddress &other) const
+    {
+        return bytes[0] == other.bytes[0] && bytes[1] == other.bytes[1] &&
+               bytes[2] == other.bytes[2] && bytes[3] == other.bytes[3];
+    }
+
+private:
+    uint8_t bytes[4];
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "Preferences.h"
+
+static std::map<std::string, std::map<std::string, std::vector<uint8_t>>> storage;
+static unsigned long writes = 0;
+static unsigned long written = 0;
+
+bool Preferences::begin(const char *ns, bool ro, const char *)
+{
+    name = ns;
+    open = true;
+    readOnly = ro;
+    return true;
+}
+
+std::map<std::string, Preferences::Value> &Preferences::space()
+{
+    return storage[name];
+}
+
+const Preferences::Value *Preferences::find(const char *key)
+{
+    if (!open)
+        return NULL;
+    std::map<std::string, Value> &s = space();
+    std::map<std::string, Value>::const_iterator it = s.find(key);
+    return it == s.end() ? NULL : &it->second;
+}
+
+size_t Preferences::store(const char *key, const void *data, size_t length)
+{
+    if (!open || readOnly)
+        return 0;
+    const uint8_t *bytes = (const uint8_t *)data;
+    space()[key] = Value(bytes, bytes + length);
+    writes++;
+    written += length;
+    return length;
+}
+
+bool Preferences::clear()
+{
+    if (!open || readOnly)
+        return false;
+    space().clear();
+    writes++;
+    return true;
+}
+
+bool Preferences::remove(const char *key)
+{
+    if (!open || readOnly)
+        return false;
+    writes++;
+    return space().erase(key) > 0;
+}
+
+bool Preferences::isKey(const char *key)
+{
+    return find(key) != NULL;
+}
+
+size_t Preferences::putUInt(const char *key, uint32_t value)
+{
+    return store(key, &value, sizeof(value));
+}
+
+uint32_t Preferences::getUInt(const char *key, uint32_t defaultValue)
+{
+    const Value *v = find(key);
+    if (!v || v->size() != sizeof(uint32_t))
+        return defaultValue;
+    uint32_t value;
+    memcpy(&value, v->data(), sizeof(value));
+    return value;
+}
+
+size_t Preferences::putString(const char *key, const char *value)
+{
+    // NVS stores strings with their terminator
+    return store(key, value, strlen(value) + 1);
+}
+
+String Preferences::getString(const char *key, const String &defaultValue)
+{
+    const Value *v = find(key);
+    if (!v || v->empty())
+        return defaultValue;
+    return String((const char *)v->data());
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t length)
+{
+    return store(key, value, length);
+}
+
+size_t Preferences::getBytes(const char *key, void *buffer, size_t maxLength)
+{
+    const Value *v = find(key);
+    if (!v || v->size() > maxLength)
+        return 0;
+    memcpy(buffer, v->data(), v->size());
+    return v->size();
+}
+
+size_t Preferences::getBytesLength(const char *key)
+{
+    const Value *v = find(key);
+    return v ? v->size() : 0;
+}
+
+unsigned long Preferences::writeCount()
+{
+    return writes;
+}
+
+unsigned long Preferences::bytesWritten()
+{
+    return written;
+}
+
+void Preferences::eraseAll()
+{
+    storage.clear();
+    writes = 0;
+    written = 0;
+}
@@ -0,0 +1,49 @@
+#ifndef PREFERENCES_H
+#define PREFERENCES_H
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/* Host version of the ESP32 Preferences (NVS) API.
+    All namespaces live in one process wide map so data survives a new Preferences
+    object like it survives a reboot. Counts write operations and bytes written so
+    NVS traffic can be compared between implementations. */
+class Preferences
+{
+public:
+    Preferences() : open(false), readOnly(false) {}
+
+    bool begin(const char *name, bool readOnly = false, const char *partition = NULL);
+    void end() { open = false; }
+    bool clear();
+    bool remove(const char *key);
+    bool isKey(const char *key);
+
+    size_t putUInt(const char *key, uint32_t value);
+    uint32_t getUInt(const char *key, uint32_t defaultValue = 0);
+    size_t putString(const char *key, const char *value);
+    size_t putString(const char *key, const String &value) { return putString(key, value.c_str()); }
+    String getString(const char *key, const String &defaultValue = String());
+    size_t putBytes(const char *key, const void *value, size_t length);
+    size_t getBytes(const char *key, void *buffer, size_t maxLength);
+    size_t getBytesLength(const char *key);
+
+    // Host only
+    static unsigned long writeCount();
+    static unsigned long bytesWritten();
+    static void eraseAll();
+
+private:
+    typedef std::vector<uint8_t> Value;
+    std::map<std::string, Value> &space();
+    size_t store(const char *key, const void *data, size_t length);
+    const Value *find(const char *key);
+
+    std::string name;
+    bool open;
+    bool readOnly;
+};
+
+#endif
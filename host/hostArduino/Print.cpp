@@ -0,0 +1,86 @@
+#include "Arduino.h"
+#include <stdio.h>
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+    size_t n = 0;
+    while (size--)
+    {
+        if (!write(*buffer++))
+            break;
+        n++;
+    }
+    return n;
+}
+
+// Numbers are formatted on the stack like the core does, printing never allocates
+size_t Print::print(long value, int base)
+{
+    if (base == DEC && value < 0)
+        return print('-') + print(0UL - (unsigned long)value, base);
+    return print((unsigned long)value, base);
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+    char text[8 * sizeof(long) + 1];
+    char *p = text + sizeof(text) - 1;
+    *p = '\0';
+    if (base < 2)
+        base = DEC;
+    do
+    {
+        unsigned long d = value % base;
+        *--p = d < 10 ? '0' + d : 'A' + d - 10;
+        value /= base;
+    } while (value);
+    return write(p);
+}
+
+size_t Print::print(double value, int digits)
+{
+    char text[64];
+    snprintf(text, sizeof(text), "%.*f", digits, value);
+    return write(text);
+}
+
+int Stream::timedRead()
+{
+    unsigned long start = millis();
+    while (true)
+    {
+        int c = read();
+        if (c >= 0)
+            return c;
+        unsigned long waited = millis() - start;
+        if (waited >= timeout)
+            return -1;
+        waitForData(timeout - waited);
+    }
+}
+
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+    size_t count = 0;
+    while (count < length)
+    {
+        int c = timedRead();
+        if (c < 0)
+            break;
+        buffer[count++] = (char)c;
+    }
+    return count;
+}
+
+size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length)
+{
+    size_t count = 0;
+    while (count < length)
+    {
+        int c = timedRead();
+        if (c < 0 || c == terminator)
+            break;
+        buffer[count++] = (char)c;
+    }
+    return count;
+}
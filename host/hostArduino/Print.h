@@ -0,0 +1,65 @@
+#ifndef PRINT_H
+#define PRINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "WString.h"
+
+void delay(unsigned long ms);
+
+#define DEC 10
+#define HEX 16
+
+// Host version of the Arduino Print interface
+class Print
+{
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+    size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+    virtual void flush() {}
+
+    size_t print(const char *str) { return write(str); }
+    size_t print(const String &s) { return write((const uint8_t *)s.c_str(), s.length()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int value, int base = DEC) { return print((long)value, base); }
+    size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T &value) { return print(value) + println(); }
+    template <typename T>
+    size_t println(const T &value, int format) { return print(value, format) + println(); }
+};
+
+// Host version of the Arduino Stream, reads with the same timeout rules as the core
+class Stream : public Print
+{
+public:
+    Stream() : timeout(1000) {}
+
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long ms) { timeout = ms; }
+    size_t readBytes(char *buffer, size_t length);
+    size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+    size_t readBytesUntil(char terminator, char *buffer, size_t length);
+
+protected:
+    int timedRead();
+    // Host only: blocks until data may be available or ms passed, instead of spinning
+    virtual void waitForData(unsigned long ms) { delay(ms < 1 ? ms : 1); }
+
+    unsigned long timeout;
+};
+
+#endif
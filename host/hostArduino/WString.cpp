@@ -0,0 +1,234 @@
+#include "WString.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static void formatInteger(char *out, size_t size, unsigned long value, bool negative, unsigned char base)
+{
+    char digits[40];
+    size_t n = 0;
+    do
+    {
+        unsigned long d = value % base;
+        digits[n++] = d < 10 ? '0' + d : 'A' + d - 10;
+        value /= base;
+    } while (value && n < sizeof(digits));
+
+    size_t pos = 0;
+    if (negative && pos < size - 1)
+        out[pos++] = '-';
+    while (n > 0 && pos < size - 1)
+        out[pos++] = digits[--n];
+    out[pos] = '\0';
+}
+
+String::String(const char *text) : buffer(NULL), capacity(0), len(0)
+{
+    if (text)
+        concat(text);
+}
+
+String::String(const String &other) : buffer(NULL), capacity(0), len(0)
+{
+    *this = other;
+}
+
+String::String(String &&other) : buffer(other.buffer), capacity(other.capacity), len(other.len)
+{
+    other.buffer = NULL;
+    other.capacity = 0;
+    other.len = 0;
+}
+
+String::String(char c) : buffer(NULL), capacity(0), len(0)
+{
+    concat(c);
+}
+
+String::String(int value, unsigned char base) : String((long)value, base) {}
+
+String::String(unsigned int value, unsigned char base) : String((unsigned long)value, base) {}
+
+String::String(long value, unsigned char base) : buffer(NULL), capacity(0), len(0)
+{
+    char text[40];
+    if (base == 10 && value < 0)
+        formatInteger(text, sizeof(text), 0UL - (unsigned long)value, true, base);
+    else
+        formatInteger(text, sizeof(text), (unsigned long)value, false, base);
+    concat(text);
+}
+
+String::String(unsigned long value, unsigned char base) : buffer(NULL), capacity(0), len(0)
+{
+    char text[40];
+    formatInteger(text, sizeof(text), value, false, base);
+    concat(text);
+}
+
+String::String(float value, unsigned char decimals) : String((double)value, decimals) {}
+
+String::String(double value, unsigned char decimals) : buffer(NULL), capacity(0), len(0)
+{
+    char text[64];
+    snprintf(text, sizeof(text), "%.*f", decimals, value);
+    concat(text);
+}
+
+String::~String()
+{
+    delete[] buffer;
+}
+
+void String::invalidate()
+{
+    delete[] buffer;
+    buffer = NULL;
+    capacity = 0;
+    len = 0;
+}
+
+String &String::operator=(const String &other)
+{
+    if (this == &other)
+        return *this;
+    len = 0;
+    if (other.buffer)
+        concat(other.buffer, other.len);
+    else
+        invalidate();
+    return *this;
+}
+
+String &String::operator=(String &&other)
+{
+    if (this != &other)
+    {
+        delete[] buffer;
+        buffer = other.buffer;
+        capacity = other.capacity;
+        len = other.len;
+        other.buffer = NULL;
+        other.capacity = 0;
+        other.len = 0;
+    }
+    return *this;
+}
+
+String &String::operator=(const char *text)
+{
+    // ArduinoJson assigns NULL to reset a String before writing into it
+    if (!text)
+    {
+        invalidate();
+        return *this;
+    }
+    len = 0;
+    concat(text);
+    return *this;
+}
+
+bool String::reserve(unsigned int size)
+{
+    if (buffer && capacity >= size)
+        return true;
+
+    char *grown = new char[size + 1];
+    if (buffer)
+        memcpy(grown, buffer, len + 1);
+    else
+        grown[0] = '\0';
+    delete[] buffer;
+    buffer = grown;
+    capacity = size;
+    return true;
+}
+
+bool String::concat(const char *text, unsigned int length)
+{
+    if (!reserve(len + length))
+        return false;
+    memmove(buffer + len, text, length);
+    len += length;
+    buffer[len] = '\0';
+    return true;
+}
+
+StringSumHelper &operator+(const StringSumHelper &lhs, const String &rhs)
+{
+    StringSumHelper &a = const_cast<StringSumHelper &>(lhs);
+    a.concat(rhs);
+    return a;
+}
+
+StringSumHelper &operator+(const StringSumHelper &lhs, const char *rhs)
+{
+    StringSumHelper &a = const_cast<StringSumHelper &>(lhs);
+    a.concat(rhs);
+    return a;
+}
+
+StringSumHelper &operator+(const StringSumHelper &lhs, char rhs)
+{
+    StringSumHelper &a = const_cast<StringSumHelper &>(lhs);
+    a.concat(rhs);
+    return a;
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+    if (from >= len)
+        return -1;
+    const char *found = strchr(buffer + from, c);
+    return found ? found - buffer : -1;
+}
+
+int String::indexOf(const char *text, unsigned int from) const
+{
+    if (from >= len)
+        return -1;
+    const char *found = strstr(buffer + from, text);
+    return found ? found - buffer : -1;
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+    if (from > to)
+    {
+        unsigned int t = from;
+        from = to;
+        to = t;
+    }
+    String out;
+    if (from >= len)
+        return out;
+    if (to > len)
+        to = len;
+    out.concat(buffer + from, to - from);
+    return out;
+}
+
+void String::toCharArray(char *out, unsigned int size, unsigned int index) const
+{
+    if (size == 0)
+        return;
+    if (index >= len)
+    {
+        out[0] = '\0';
+        return;
+    }
+    unsigned int n = len - index;
+    if (n > size - 1)
+        n = size - 1;
+    memcpy(out, buffer + index, n);
+    out[n] = '\0';
+}
+
+long String::toInt() const
+{
+    return atol(c_str());
+}
+
+float String::toFloat() const
+{
+    return atof(c_str());
+}
@@ -0,0 +1,96 @@
+#ifndef WSTRING_H
+#define WSTRING_H
+
+#include <stddef.h>
+#include <string.h>
+
+class StringSumHelper;
+
+/* Host version of the Arduino String.
+    Grows to the exact length needed like the core implementation, so allocation
+    counts in benchmarks are close to what the boards see. */
+class String
+{
+public:
+    String(const char *text = "");
+    String(const String &other);
+    String(String &&other);
+    explicit String(char c);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(float value, unsigned char decimals = 2);
+    explicit String(double value, unsigned char decimals = 2);
+    ~String();
+
+    String &operator=(const String &other);
+    String &operator=(String &&other);
+    String &operator=(const char *text);
+
+    bool reserve(unsigned int size);
+    unsigned int length() const { return len; }
+    const char *c_str() const { return buffer ? buffer : ""; }
+    bool isEmpty() const { return len == 0; }
+
+    bool concat(const String &other) { return concat(other.c_str(), other.len); }
+    bool concat(const char *text) { return text ? concat(text, strlen(text)) : false; }
+    bool concat(const char *text, unsigned int length);
+    bool concat(char c) { return concat(&c, 1); }
+    bool concat(int value) { return concat(String(value)); }
+    bool concat(unsigned int value) { return concat(String(value)); }
+    bool concat(long value) { return concat(String(value)); }
+    bool concat(unsigned long value) { return concat(String(value)); }
+    bool concat(float value) { return concat(String(value)); }
+    bool concat(double value) { return concat(String(value)); }
+
+    template <typename T>
+    String &operator+=(const T &value)
+    {
+        concat(value);
+        return *this;
+    }
+
+    friend StringSumHelper &operator+(const StringSumHelper &lhs, const String &rhs);
+    friend StringSumHelper &operator+(const StringSumHelper &lhs, const char *rhs);
+    friend StringSumHelper &operator+(const StringSumHelper &lhs, char rhs);
+
+    bool equals(const String &other) const { return len == other.len && strcmp(c_str(), other.c_str()) == 0; }
+    bool equals(const char *text) const { return strcmp(c_str(), text ? text : "") == 0; }
+    bool operator==(const String &other) const { return equals(other); }
+    bool operator==(const char *text) const { return equals(text); }
+    bool operator!=(const String &other) const { return !equals(other); }
+    bool operator!=(const char *text) const { return !equals(text); }
+
+    char operator[](unsigned int index) const { return index < len ? buffer[index] : 0; }
+    char charAt(unsigned int index) const { return (*this)[index]; }
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const char *text, unsigned int from = 0) const;
+    bool startsWith(const char *prefix) const { return strncmp(c_str(), prefix, strlen(prefix)) == 0; }
+    String substring(unsigned int from) const { return substring(from, len); }
+    String substring(unsigned int from, unsigned int to) const;
+    void toCharArray(char *out, unsigned int size, unsigned int index = 0) const;
+    long toInt() const;
+    float toFloat() const;
+
+protected:
+    void invalidate();
+
+    char *buffer;
+    unsigned int capacity;
+    unsigned int len;
+};
+
+class StringSumHelper : public String
+{
+public:
+    StringSumHelper(const String &s) : String(s) {}
+    StringSumHelper(const char *p) : String(p) {}
+    StringSumHelper(char c) : String(c) {}
+    StringSumHelper(int num) : String(num) {}
+    StringSumHelper(unsigned long num) : String(num) {}
+    StringSumHelper(float num) : String(num) {}
+    StringSumHelper(double num) : String(num) {}
+};
+
+#endif
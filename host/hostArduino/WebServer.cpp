@@ -0,0 +1,343 @@
+#include "WebServer.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static const char *statusText(int code)
+{
+    switch (code)
+    {
+    case 200:
+        return "OK";
+    case 400:
+        return "Bad Request";
+    case 404:
+        return "Not Found";
+    case 413:
+        return "Payload Too Large";
+    case 500:
+        return "Internal Server Error";
+    case 503:
+        return "Service Unavailable";
+    default:
+        return "";
+    }
+}
+
+static HTTPMethod parseMethod(const char *name)
+{
+    if (strcmp(name, "GET") == 0)
+        return HTTP_GET;
+    if (strcmp(name, "HEAD") == 0)
+        return HTTP_HEAD;
+    if (strcmp(name, "POST") == 0)
+        return HTTP_POST;
+    if (strcmp(name, "PUT") == 0)
+        return HTTP_PUT;
+    if (strcmp(name, "PATCH") == 0)
+        return HTTP_PATCH;
+    if (strcmp(name, "DELETE") == 0)
+        return HTTP_DELETE;
+    if (strcmp(name, "OPTIONS") == 0)
+        return HTTP_OPTIONS;
+    return HTTP_ANY;
+}
+
+WebServer::WebServer(int port) : port(port), listenFd(-1), clientFd(-1), currentMethod(HTTP_ANY), responded(false), contentLength(0), rxPos(0), rxLen(0)
+{
+    Header length = {"Content-Length", ""};
+    headers.push_back(length);
+}
+
+WebServer::~WebServer()
+{
+    close();
+}
+
+void WebServer::begin(uint16_t listenPort)
+{
+    close();
+    port = listenPort;
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0)
+        return;
+
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(listenFd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listenFd, HOST_WEBSERVER_BACKLOG) != 0)
+    {
+        perror("WebServer");
+        ::close(listenFd);
+        listenFd = -1;
+        return;
+    }
+    fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL) | O_NONBLOCK);
+}
+
+void WebServer::close()
+{
+    finishClient();
+    if (listenFd >= 0)
+        ::close(listenFd);
+    listenFd = -1;
+}
+
+void WebServer::on(const char *uri, HTTPMethod method, THandlerFunction fn, THandlerFunction ufn)
+{
+    Route route = {uri, method, fn, ufn};
+    routes.push_back(route);
+}
+
+void WebServer::collectHeaders(const char *headerKeys[], const size_t headerKeysCount)
+{
+    headers.clear();
+    Header length = {"Content-Length", ""};
+    headers.push_back(length);
+    for (size_t i = 0; i < headerKeysCount; i++)
+    {
+        if (strcasecmp(headerKeys[i], "Content-Length") == 0)
+            continue;
+        Header h = {headerKeys[i], ""};
+        headers.push_back(h);
+    }
+}
+
+String WebServer::header(const char *name) const
+{
+    for (size_t i = 0; i < headers.size(); i++)
+    {
+        if (strcasecmp(headers[i].name.c_str(), name) == 0)
+            return headers[i].value;
+    }
+    return String();
+}
+
+bool WebServer::hasHeader(const char *name) const
+{
+    return header(name).length() > 0;
+}
+
+void WebServer::handleClient()
+{
+    if (listenFd < 0)
+        return;
+
+    sockaddr_in peer;
+    socklen_t peerLength = sizeof(peer);
+    clientFd = accept(listenFd, (sockaddr *)&peer, &peerLength);
+    if (clientFd < 0)
+        return;
+    uint32_t address = ntohl(peer.sin_addr.s_addr);
+    currentClient.remote = IPAddress(address >> 24, address >> 16, address >> 8, address);
+
+    // Blocking reads with the same wait limit as the ESP32 server
+    fcntl(clientFd, F_SETFL, fcntl(clientFd, F_GETFL) & ~O_NONBLOCK);
+    timeval tv = {HTTP_MAX_DATA_WAIT / 1000, (HTTP_MAX_DATA_WAIT % 1000) * 1000};
+    setsockopt(clientFd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    int one = 1;
+    setsockopt(clientFd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    serve();
+    finishClient();
+}
+
+bool WebServer::readLine(char *line, size_t size)
+{
+    size_t n = 0;
+    while (true)
+    {
+        if (rxPos == rxLen)
+        {
+            ssize_t got = recv(clientFd, rx, sizeof(rx), 0);
+            if (got <= 0)
+                return false;
+            rxPos = 0;
+            rxLen = got;
+        }
+        char c = rx[rxPos++];
+        if (c == '\n')
+            break;
+        if (c != '\r' && n < size - 1)
+            line[n++] = c;
+    }
+    line[n] = '\0';
+    return true;
+}
+
+size_t WebServer::readBody(uint8_t *out, size_t size)
+{
+    if (rxPos < rxLen)
+    {
+        size_t n = min(size, rxLen - rxPos);
+        memcpy(out, rx + rxPos, n);
+        rxPos += n;
+        return n;
+    }
+    ssize_t got = recv(clientFd, out, size, 0);
+    return got > 0 ? got : 0;
+}
+
+void WebServer::serve()
+{
+    char line[512];
+    if (!readLine(line, sizeof(line)))
+        return;
+
+    // "POST /data HTTP/1.1"
+    char *uriStart = strchr(line, ' ');
+    if (uriStart == NULL)
+        return;
+    *uriStart++ = '\0';
+    char *uriEnd = strpbrk(uriStart, " ?");
+    if (uriEnd)
+        *uriEnd = '\0';
+    currentMethod = parseMethod(line);
+    currentUri = uriStart;
+
+    for (size_t i = 0; i < headers.size(); i++)
+        headers[i].value = "";
+    while (readLine(line, sizeof(line)) && line[0] != '\0')
+    {
+        char *colon = strchr(line, ':');
+        if (colon == NULL)
+            continue;
+        *colon = '\0';
+        const char *value = colon + 1;
+        while (*value == ' ')
+            value++;
+        for (size_t i = 0; i < headers.size(); i++)
+        {
+            if (strcasecmp(headers[i].name.c_str(), line) == 0)
+                headers[i].value = value;
+        }
+    }
+
+    const Route *route = NULL;
+    for (size_t i = 0; i < routes.size() && route == NULL; i++)
+    {
+        if (routes[i].uri == currentUri && (routes[i].method == HTTP_ANY || routes[i].method == currentMethod))
+            route = &routes[i];
+    }
+
+    responded = false;
+    contentLength = 0;
+    extraHeaders = "";
+    if (route == NULL)
+    {
+        if (notFound)
+            notFound();
+        else
+            send(404, "text/plain", "Not found");
+        return;
+    }
+
+    long remaining = header("Content-Length").toInt();
+    if (route->ufn && remaining > 0)
+    {
+        currentRaw.status = RAW_START;
+        currentRaw.totalSize = 0;
+        currentRaw.currentSize = 0;
+        route->ufn();
+
+        while (remaining > 0)
+        {
+            size_t n = readBody(currentRaw.buf, min((size_t)remaining, sizeof(currentRaw.buf)));
+            if (n == 0)
+            {
+                currentRaw.status = RAW_ABORTED;
+                route->ufn();
+                return;
+            }
+            currentRaw.status = RAW_WRITE;
+            currentRaw.currentSize = n;
+            currentRaw.totalSize += n;
+            remaining -= n;
+            route->ufn();
+        }
+
+        currentRaw.status = RAW_END;
+        route->ufn();
+    }
+
+    route->fn();
+    if (!responded)
+        send(500, "text/plain", "No response");
+}
+
+void WebServer::sendHeader(const String &name, const String &value, bool first)
+{
+    String line = name;
+    line += ": ";
+    line += value;
+    line += "\r\n";
+    if (first)
+    {
+        line += extraHeaders;
+        extraHeaders = line;
+    }
+    else
+        extraHeaders += line;
+}
+
+void WebServer::send(int code, const char *contentType, const char *content)
+{
+    send(code, contentType, String(content));
+}
+
+void WebServer::send(int code, const char *contentType, const String &content)
+{
+    if (clientFd < 0 || responded)
+        return;
+    responded = true;
+
+    char head[256];
+    if (contentLength == CONTENT_LENGTH_UNKNOWN)
+        snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\n", code, statusText(code),
+                 contentType ? contentType : "text/html");
+    else
+        snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n",
+                 code, statusText(code), contentType ? contentType : "text/html", content.length());
+    String response(head);
+    response += extraHeaders;
+    response += "Connection: close\r\n\r\n";
+    response += content;
+    write(response.c_str(), response.length());
+}
+
+void WebServer::sendContent(const char *content, size_t length)
+{
+    if (clientFd >= 0 && responded)
+        write(content, length);
+}
+
+void WebServer::write(const char *data, size_t length)
+{
+    size_t sent = 0;
+    while (sent < length)
+    {
+        ssize_t w = ::send(clientFd, data + sent, length - sent, MSG_NOSIGNAL);
+        if (w <= 0)
+            break;
+        sent += w;
+    }
+}
+
+void WebServer::finishClient()
+{
+    if (clientFd >= 0)
+        ::close(clientFd);
+    clientFd = -1;
+    rxPos = 0;
+    rxLen = 0;
+}
@@ -0,0 +1,120 @@
+#ifndef WEBSERVER_H
+#define WEBSERVER_H
+
+#include <Arduino.h>
+#include "WiFiS3.h"
+#include <functional>
+#include <vector>
+
+#define HTTP_RAW_BUFLEN 1436     // chunk size of the ESP32 core
+#define HTTP_MAX_DATA_WAIT 5000  // longest wait for request data
+#define HOST_WEBSERVER_BACKLOG 5 // pending connections, close to lwIP's default
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+
+enum HTTPMethod
+{
+    HTTP_ANY,
+    HTTP_GET,
+    HTTP_HEAD,
+    HTTP_POST,
+    HTTP_PUT,
+    HTTP_PATCH,
+    HTTP_DELETE,
+    HTTP_OPTIONS
+};
+
+enum HTTPRawStatus
+{
+    RAW_START,
+    RAW_WRITE,
+    RAW_END,
+    RAW_ABORTED
+};
+
+struct HTTPRaw
+{
+    HTTPRawStatus status;
+    size_t totalSize;
+    size_t currentSize;
+    uint8_t buf[HTTP_RAW_BUFLEN];
+};
+
+/* Host version of the ESP32 WebServer on a TCP socket.
+    Like the original it serves one client per handleClient() call, streams POST
+    bodies to a raw handler in HTTP_RAW_BUFLEN chunks and closes the connection
+    after every response. */
+class WebServer
+{
+public:
+    typedef std::function<void(void)> THandlerFunction;
+
+    WebServer(int port = 80);
+    ~WebServer();
+
+    void begin() { begin(port); }
+    void begin(uint16_t port);
+    void close();
+    void handleClient();
+
+    void on(const char *uri, THandlerFunction handler) { on(uri, HTTP_ANY, handler); }
+    void on(const char *uri, HTTPMethod method, THandlerFunction fn) { on(uri, method, fn, THandlerFunction()); }
+    void on(const char *uri, HTTPMethod method, THandlerFunction fn, THandlerFunction ufn);
+    void onNotFound(THandlerFunction fn) { notFound = fn; }
+
+    void collectHeaders(const char *headerKeys[], const size_t headerKeysCount);
+    String header(const char *name) const;
+    bool hasHeader(const char *name) const;
+    String uri() const { return currentUri; }
+    HTTPMethod method() const { return currentMethod; }
+    HTTPRaw &raw() { return currentRaw; }
+    // Only remoteIP() is meaningful, the connection itself is handled by the server
+    WiFiClient &client() { return currentClient; }
+
+    void sendHeader(const String &name, const String &value, bool first = false);
+    void send(int code, const char *contentType, const char *content);
+    void send(int code, const char *contentType = NULL, const String &content = String());
+    // With CONTENT_LENGTH_UNKNOWN the body of send() is followed by sendContent() calls
+    // until the handler returns. The ESP32 core sends chunks, here the connection just closes.
+    void setContentLength(size_t length) { contentLength = length; }
+    void sendContent(const char *content, size_t length);
+    void sendContent(const String &content) { sendContent(content.c_str(), content.length()); }
+
+private:
+    struct Route
+    {
+        String uri;
+        HTTPMethod method;
+        THandlerFunction fn;
+        THandlerFunction ufn;
+    };
+    struct Header
+    {
+        String name;
+        String value;
+    };
+
+    bool readLine(char *line, size_t size);
+    void write(const char *data, size_t length);
+    size_t readBody(uint8_t *out, size_t size);
+    void serve();
+    void finishClient();
+
+    int port;
+    int listenFd;
+    int clientFd;
+    std::vector<Route> routes;
+    std::vector<Header> headers;
+    String extraHeaders;
+    THandlerFunction notFound;
+    String currentUri;
+    HTTPMethod currentMethod;
+    HTTPRaw currentRaw;
+    WiFiClient currentClient;
+    bool responded;
+    size_t contentLength;
+    uint8_t rx[512];
+    size_t rxPos;
+    size_t rxLen;
+};
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef WIFI_H
+#define WIFI_H
+
+// ESP32 name of the host radio and client, see WiFiS3.h
+#include "WiFiS3.h"
+
+#endif
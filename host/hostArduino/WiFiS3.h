@@ -0,0 +1,85 @@
+#ifndef WIFIS3_H
+#define WIFIS3_H
+
+#include <Arduino.h>
+#include "IPAddress.h"
+
+enum wl_status_t
+{
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6
+};
+
+// Host stand-in for the WiFi radio, joining a network always succeeds
+class HostWiFi
+{
+public:
+    HostWiFi() : state(WL_IDLE_STATUS) {}
+
+    int begin(const char *, const char *)
+    {
+        state = WL_CONNECTED;
+        return state;
+    }
+    void disconnect() { state = WL_DISCONNECTED; }
+    uint8_t status() const { return state; }
+
+    // Host only: simulate the access point going away or coming back
+    void setStatus(wl_status_t status) { state = status; }
+
+private:
+    uint8_t state;
+};
+
+extern HostWiFi WiFi;
+
+/* Host WiFiClient on a plain TCP socket, so firmware code can talk to a server
+    on the same machine (e.g. the gateway simulator on 127.0.0.1).
+    Connecting fails while WiFi.status() is not WL_CONNECTED. */
+class WiFiClient : public Stream
+{
+public:
+    WiFiClient() : fd(-1), connectTimeout(2000), rxPos(0), rxLen(0) {}
+    ~WiFiClient() { stop(); }
+    WiFiClient(const WiFiClient &) = delete;
+    WiFiClient &operator=(const WiFiClient &) = delete;
+
+    void setConnectionTimeout(unsigned long ms) { connectTimeout = ms; }
+    int connect(const char *host, uint16_t port);
+    // ESP32 form with the timeout per call
+    int connect(const char *host, uint16_t port, int32_t timeoutMs)
+    {
+        connectTimeout = timeoutMs;
+        return connect(host, port);
+    }
+    uint8_t connected();
+    void stop();
+    IPAddress remoteIP() const { return remote; }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int peek() override;
+
+protected:
+    void waitForData(unsigned long ms) override;
+
+private:
+    friend class WebServer; // sets the peer of accepted connections
+    bool fill();
+
+    int fd;
+    IPAddress remote;
+    unsigned long connectTimeout;
+    uint8_t rx[256];
+    size_t rxPos;
+    size_t rxLen;
+};
+
+#endif
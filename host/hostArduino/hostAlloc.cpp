@@ -0,0 +1,95 @@
+#include "hostAlloc.h"
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+static std::atomic<uint64_t> allocations(0);
+static std::atomic<uint64_t> allocatedBytes(0);
+static std::atomic<HostAllocationHook> allocationHook(NULL);
+
+static void countAllocation(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    HostAllocationHook hook = allocationHook.load(std::memory_order_relaxed);
+    if (hook != NULL)
+        hook(size);
+}
+
+void hostSetAllocationHook(HostAllocationHook hook)
+{
+    allocationHook.store(hook, std::memory_order_relaxed);
+}
+
+uint64_t hostAllocations()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+uint64_t hostAllocatedBytes()
+{
+    return allocatedBytes.load(std::memory_order_relaxed);
+}
+
+#if defined(__GLIBC__)
+// Wrap the C allocator so ArduinoJson's malloc based pool is counted too.
+// operator new ends up here as well.
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+
+    void *malloc(size_t size)
+    {
+        countAllocation(size);
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t count, size_t size)
+    {
+        countAllocation(count * size);
+        return __libc_calloc(count, size);
+    }
+
+    void *realloc(void *ptr, size_t size)
+    {
+        countAllocation(size);
+        return __libc_realloc(ptr, size);
+    }
+}
+#else
+void *operator new(size_t size)
+{
+    countAllocation(size);
+    void *p = malloc(size);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+#endif
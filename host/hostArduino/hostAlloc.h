@@ -0,0 +1,17 @@
+#ifndef HOSTALLOC_H
+#define HOSTALLOC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Heap allocations made by the process since start. Counts malloc and
+// operator new on glibc, only operator new elsewhere.
+uint64_t hostAllocations();
+uint64_t hostAllocatedBytes();
+
+// Called with the size of every counted allocation, stands in for the malloc
+// wrappers of the board builds (lib/memTelemetry)
+typedef void (*HostAllocationHook)(size_t size);
+void hostSetAllocationHook(HostAllocationHook hook);
+
+#endif
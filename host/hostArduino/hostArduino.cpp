@@ -0,0 +1,165 @@
+#include "Arduino.h"
+#include "EEPROM.h"
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+
+HostSerial Serial;
+EEPROMClass EEPROM;
+
+static std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+static std::atomic<unsigned long long> skippedMicros(0);
+static std::mt19937 rng(1);
+
+static uint8_t pinLevel[HOST_PINS];
+static void (*pinHandler[HOST_PINS])();
+
+static std::atomic<long long> frozenMicros(-1);
+
+static unsigned long long realMicros()
+{
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now - startTime).count();
+}
+
+static unsigned long long elapsedMicros()
+{
+    long long frozen = frozenMicros;
+    return (frozen >= 0 ? frozen : realMicros()) + skippedMicros;
+}
+
+unsigned long millis()
+{
+    return (unsigned long)(elapsedMicros() / 1000);
+}
+
+unsigned long micros()
+{
+    return (unsigned long)elapsedMicros();
+}
+
+void delay(unsigned long ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield()
+{
+    std::this_thread::yield();
+}
+
+void hostAdvanceMillis(unsigned long ms)
+{
+    skippedMicros += (unsigned long long)ms * 1000;
+}
+
+void hostAdvanceMicros(unsigned long us)
+{
+    skippedMicros += us;
+}
+
+void hostFreezeClock(bool frozen)
+{
+    if (frozen && frozenMicros < 0)
+        frozenMicros = realMicros();
+    else if (!frozen && frozenMicros >= 0)
+    {
+        // Continue from the frozen time, the real time in between is skipped
+        skippedMicros -= realMicros() - frozenMicros;
+        frozenMicros = -1;
+    }
+}
+
+int analogRead(uint8_t)
+{
+    return (int)(rng() & 0x3FF);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    // A released line is pulled up
+    if (pin < HOST_PINS && mode != OUTPUT)
+        pinLevel[pin] = HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    if (pin < HOST_PINS)
+        pinLevel[pin] = value ? HIGH : LOW;
+}
+
+int digitalRead(uint8_t pin)
+{
+    return pin < HOST_PINS ? pinLevel[pin] : LOW;
+}
+
+int digitalPinToInterrupt(uint8_t pin)
+{
+    return pin < HOST_PINS ? pin : NOT_AN_INTERRUPT;
+}
+
+void attachInterrupt(int interrupt, void (*handler)(), int)
+{
+    if (interrupt >= 0 && interrupt < HOST_PINS)
+        pinHandler[interrupt] = handler;
+}
+
+void detachInterrupt(int interrupt)
+{
+    if (interrupt >= 0 && interrupt < HOST_PINS)
+        pinHandler[interrupt] = NULL;
+}
+
+// Handlers run on the calling thread, there is nothing to mask
+void noInterrupts() {}
+void interrupts() {}
+
+bool hostTriggerInterrupt(uint8_t pin)
+{
+    if (pin >= HOST_PINS || pinHandler[pin] == NULL)
+        return false;
+    pinHandler[pin]();
+    return true;
+}
+
+long random(long max)
+{
+    return max > 0 ? (long)(rng() % (unsigned long)max) : 0;
+}
+
+long random(long min, long max)
+{
+    return min < max ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned long seed)
+{
+    rng.seed(seed);
+}
+
+bool getLocalTime(struct tm *info, uint32_t)
+{
+    time_t now = time(NULL);
+    return localtime_r(&now, info) != NULL;
+}
+
+size_t HostSerial::write(uint8_t c)
+{
+    if (!muted)
+        fputc(c, stdout);
+    return 1;
+}
+
+size_t HostSerial::write(const uint8_t *buffer, size_t size)
+{
+    if (!muted)
+        fwrite(buffer, 1, size, stdout);
+    return size;
+}
+
+void HostSerial::flush()
+{
+    fflush(stdout);
+}
@@ -0,0 +1,77 @@
+#ifndef HOSTBENCH_H
+#define HOSTBENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+#include "hostAlloc.h"
+
+/* Tiny benchmark runner for the native environment.
+    Each case is run in growing rounds until it has taken at least BENCH_MIN_TIME_MS,
+    then time and heap allocations are reported per operation. */
+
+#define BENCH_MIN_TIME_MS 200
+
+struct BenchResult
+{
+    const char *name;
+    uint64_t iterations;
+    double nsPerOp;
+    double allocsPerOp;
+    double bytesPerOp;
+};
+
+inline void benchHeader(const char *title)
+{
+    printf("\n%s\n", title);
+    printf("%-36s %12s %12s %10s %10s\n", "benchmark", "iterations", "ns/op", "allocs/op", "B/op");
+}
+
+inline void benchReport(const BenchResult &r)
+{
+    printf("%-36s %12llu %12.1f %10.2f %10.1f\n", r.name, (unsigned long long)r.iterations,
+           r.nsPerOp, r.allocsPerOp, r.bytesPerOp);
+    fflush(stdout);
+}
+
+template <typename F>
+BenchResult benchRun(const char *name, F fn)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // Warm up once so lazily created state isn't counted
+    fn();
+
+    uint64_t iterations = 1;
+    while (true)
+    {
+        uint64_t allocs = hostAllocations();
+        uint64_t bytes = hostAllocatedBytes();
+        Clock::time_point start = Clock::now();
+        for (uint64_t i = 0; i < iterations; i++)
+            fn();
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+        if (ns >= BENCH_MIN_TIME_MS * 1e6 || iterations >= (1ULL << 32))
+        {
+            BenchResult r;
+            r.name = name;
+            r.iterations = iterations;
+            r.nsPerOp = ns / iterations;
+            r.allocsPerOp = (double)(hostAllocations() - allocs) / iterations;
+            r.bytesPerOp = (double)(hostAllocatedBytes() - bytes) / iterations;
+            benchReport(r);
+            return r;
+        }
+        iterations *= 2;
+    }
+}
+
+// Keeps the compiler from optimizing away a result
+template <typename T>
+inline void benchKeep(const T &value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif
@@ -0,0 +1,66 @@
+#include "hostFreeRTOS.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct HostTask
+{
+    std::mutex lock;
+    std::condition_variable wake;
+    uint32_t notifications = 0;
+};
+
+// Task notifications of the main thread (loop()) use this one
+static HostTask mainTask;
+static thread_local HostTask *currentTask = &mainTask;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *, uint32_t, void *parameters,
+                                   UBaseType_t, TaskHandle_t *createdTask, BaseType_t)
+{
+    // Tasks never return in the firmware, so the task object lives forever
+    HostTask *task = new HostTask;
+    if (createdTask)
+        *createdTask = task;
+    std::thread([task, code, parameters]() {
+        currentTask = task;
+        code(parameters);
+    }).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stackDepth, void *parameters,
+                       UBaseType_t priority, TaskHandle_t *createdTask)
+{
+    return xTaskCreatePinnedToCore(code, name, stackDepth, parameters, priority, createdTask, 0);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait)
+{
+    HostTask *task = currentTask;
+    std::unique_lock<std::mutex> guard(task->lock);
+    if (ticksToWait == portMAX_DELAY)
+        task->wake.wait(guard, [task] { return task->notifications > 0; });
+    else
+        task->wake.wait_for(guard, std::chrono::milliseconds(ticksToWait), [task] { return task->notifications > 0; });
+
+    uint32_t value = task->notifications;
+    if (value > 0)
+        task->notifications = clearCountOnExit ? 0 : value - 1;
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    {
+        std::lock_guard<std::mutex> guard(task->lock);
+        task->notifications++;
+    }
+    task->wake.notify_one();
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
@@ -0,0 +1,31 @@
+#ifndef HOSTFREERTOS_H
+#define HOSTFREERTOS_H
+
+#include <stdint.h>
+
+/* The few FreeRTOS calls the ESP32 firmware uses, mapped onto host threads.
+    Tasks run as detached std::threads, priorities and cores are ignored. */
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef void (*TaskFunction_t)(void *);
+typedef struct HostTask *TaskHandle_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xFFFFFFFFUL
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name, uint32_t stackDepth, void *parameters,
+                                   UBaseType_t priority, TaskHandle_t *createdTask, BaseType_t coreId);
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stackDepth, void *parameters,
+                       UBaseType_t priority, TaskHandle_t *createdTask);
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+
+#endif
@@ -0,0 +1,156 @@
+#include "WiFiS3.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+HostWiFi WiFi;
+
+int WiFiClient::connect(const char *host, uint16_t port)
+{
+    stop();
+    if (WiFi.status() != WL_CONNECTED)
+        return 0;
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result = NULL;
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    if (getaddrinfo(host, service, &hints, &result) != 0 || result == NULL)
+        return 0;
+
+    fd = socket(result->ai_family, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        freeaddrinfo(result);
+        return 0;
+    }
+
+    // Non-blocking connect so the timeout applies like on the board
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    int rc = ::connect(fd, result->ai_addr, result->ai_addrlen);
+    uint32_t address = ntohl(((sockaddr_in *)result->ai_addr)->sin_addr.s_addr);
+    remote = IPAddress(address >> 24, address >> 16, address >> 8, address);
+    freeaddrinfo(result);
+    if (rc != 0 && errno != EINPROGRESS)
+    {
+        stop();
+        return 0;
+    }
+    if (rc != 0)
+    {
+        pollfd p = {fd, POLLOUT, 0};
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (poll(&p, 1, connectTimeout) != 1 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0 || error != 0)
+        {
+            stop();
+            return 0;
+        }
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return 1;
+}
+
+uint8_t WiFiClient::connected()
+{
+    if (fd < 0)
+        return 0;
+    if (rxPos < rxLen)
+        return 1;
+
+    // Readable with nothing to read means the peer closed
+    char c;
+    ssize_t n = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+    {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+void WiFiClient::stop()
+{
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+    rxPos = 0;
+    rxLen = 0;
+}
+
+size_t WiFiClient::write(const uint8_t *buffer, size_t size)
+{
+    size_t sent = 0;
+    while (fd >= 0 && sent < size)
+    {
+        ssize_t n = send(fd, buffer + sent, size - sent, MSG_NOSIGNAL);
+        if (n > 0)
+        {
+            sent += n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            pollfd p = {fd, POLLOUT, 0};
+            if (poll(&p, 1, 1000) == 1)
+                continue;
+        }
+        stop();
+    }
+    return sent;
+}
+
+bool WiFiClient::fill()
+{
+    if (rxPos < rxLen)
+        return true;
+    if (fd < 0)
+        return false;
+    ssize_t n = recv(fd, rx, sizeof(rx), MSG_DONTWAIT);
+    if (n <= 0)
+        return false;
+    rxPos = 0;
+    rxLen = n;
+    return true;
+}
+
+int WiFiClient::available()
+{
+    int pending = 0;
+    if (fd >= 0)
+        ioctl(fd, FIONREAD, &pending);
+    return (int)(rxLen - rxPos) + pending;
+}
+
+int WiFiClient::read()
+{
+    return fill() ? rx[rxPos++] : -1;
+}
+
+int WiFiClient::peek()
+{
+    return fill() ? rx[rxPos] : -1;
+}
+
+void WiFiClient::waitForData(unsigned long ms)
+{
+    if (fd < 0)
+    {
+        delay(ms);
+        return;
+    }
+    pollfd p = {fd, POLLIN, 0};
+    poll(&p, 1, (int)ms);
+}
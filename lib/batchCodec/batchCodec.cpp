@@ -0,0 +1,316 @@
+#include "batchCodec.h"
+#include <string.h>
+#include <math.h>
+
+static uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+int16_t batchToFixed(float value)
+{
+    if (isnan(value))
+        return 0;
+
+    float scaled = value * BATCH_FIXED_SCALE;
+    // Clamp so out of range sensor values don't wrap around
+    if (scaled > 32767.0f)
+        return 32767;
+    if (scaled < -32768.0f)
+        return -32768;
+    return (int16_t)lroundf(scaled);
+}
+
+float batchFromFixed(int16_t value)
+{
+    return (float)value / BATCH_FIXED_SCALE;
+}
+
+uint16_t batchCrc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+const char *batchDecodeError(BatchDecodeResult result)
+{
+    switch (result)
+    {
+    case BATCH_OK:
+        return "OK";
+    case BATCH_ERR_TRUNCATED:
+        return "Truncated batch";
+    case BATCH_ERR_MAGIC:
+        return "Bad magic";
+    case BATCH_ERR_VERSION:
+        return "Unsupported version";
+    case BATCH_ERR_CRC:
+        return "CRC mismatch";
+    case BATCH_ERR_COUNT:
+        return "Too many readings";
+    default:
+        return "Corrupt batch";
+    }
+}
+
+// ==== ENCODER ====
+
+BatchEncoder::BatchEncoder(uint8_t *buffer, size_t size)
+    : _buf(buffer), _size(size), _pos(0), _count(0), _overflow(false), _flags(0), _lastTemp(0), _lastHum(0), _lastTime(0)
+{
+    memset(_errors, 0, sizeof(_errors));
+}
+
+void BatchEncoder::begin(uint16_t nodeId, uint16_t sequence, uint8_t flags, uint8_t tempTolerance, uint8_t humTolerance,
+                         uint32_t epoch)
+{
+    bool series = flags & (BATCH_FLAG_HOLD | BATCH_FLAG_LINEAR);
+    size_t extra = (series ? BATCH_TOLERANCE_SIZE : 0) + (flags & BATCH_FLAG_EPOCH ? BATCH_EPOCH_SIZE : 0);
+    _pos = 0;
+    _count = 0;
+    _overflow = _size < BATCH_HEADER_SIZE + extra + BATCH_CRC_SIZE;
+    _flags = flags;
+    _lastTemp = 0;
+    _lastHum = 0;
+    _lastTime = 0;
+    memset(_errors, 0, sizeof(_errors));
+
+    if (_overflow)
+        return;
+
+    _buf[0] = BATCH_MAGIC;
+    _buf[1] = BATCH_VERSION;
+    _buf[2] = flags;
+    _buf[3] = 0; // count, patched in finish()
+    _buf[4] = nodeId & 0xFF;
+    _buf[5] = nodeId >> 8;
+    _buf[6] = sequence & 0xFF;
+    _buf[7] = sequence >> 8;
+    _pos = BATCH_HEADER_SIZE;
+    if (series)
+    {
+        _buf[_pos++] = tempTolerance;
+        _buf[_pos++] = humTolerance;
+    }
+    if (flags & BATCH_FLAG_EPOCH)
+    {
+        for (int i = 0; i < BATCH_EPOCH_SIZE; i++)
+            _buf[_pos++] = (epoch >> (8 * i)) & 0xFF;
+    }
+}
+
+bool BatchEncoder::putVarint(uint32_t value)
+{
+    do
+    {
+        if (_pos >= _size)
+            return false;
+        uint8_t b = value & 0x7F;
+        value >>= 7;
+        _buf[_pos++] = b | (value ? 0x80 : 0);
+    } while (value);
+    return true;
+}
+
+bool BatchEncoder::add(float temperature, float humidity, bool error)
+{
+    error = error || isnan(temperature) || isnan(humidity);
+    return addFixed(batchToFixed(temperature), batchToFixed(humidity), error);
+}
+
+bool BatchEncoder::addFixed(int16_t t, int16_t h, bool error, uint16_t timeOffset)
+{
+    if (_overflow || _count >= BATCH_MAX_READINGS)
+        return false;
+
+    size_t start = _pos;
+    if (_flags & BATCH_FLAG_TIMES)
+    {
+        // Offsets only grow, the difference is small and needs no sign
+        if (timeOffset < _lastTime || !putVarint(timeOffset - _lastTime))
+        {
+            _pos = start;
+            return false;
+        }
+    }
+
+    // Roll back a partial reading, or one that leaves no room for the bitmap and CRC
+    // finish() writes: the batch stays valid without it
+    if ((!error && (!putVarint(zigzag((int32_t)t - _lastTemp)) || !putVarint(zigzag((int32_t)h - _lastHum)))) ||
+        _pos + (_count + 8) / 8 + BATCH_CRC_SIZE > _size)
+    {
+        _pos = start;
+        return false;
+    }
+
+    if (error)
+        _errors[_count / 8] |= 1 << (_count % 8);
+    else
+    {
+        _lastTemp = t;
+        _lastHum = h;
+    }
+    _lastTime = timeOffset;
+    _count++;
+    return true;
+}
+
+size_t BatchEncoder::finish()
+{
+    size_t bitmapLen = (_count + 7) / 8;
+    if (_overflow || _pos + bitmapLen + BATCH_CRC_SIZE > _size)
+        return 0;
+
+    _buf[3] = _count;
+    memcpy(_buf + _pos, _errors, bitmapLen);
+    _pos += bitmapLen;
+
+    uint16_t crc = batchCrc16(_buf, _pos);
+    _buf[_pos++] = crc & 0xFF;
+    _buf[_pos++] = crc >> 8;
+    return _pos;
+}
+
+// ==== DECODER ====
+
+BatchDecodeResult BatchDecoder::begin(const uint8_t *buffer, size_t len)
+{
+    _buf = buffer;
+    _index = 0;
+    _corrupt = false;
+    _lastTemp = 0;
+    _lastHum = 0;
+    _lastTime = 0;
+    _header.count = 0;
+
+    if (len < BATCH_HEADER_SIZE + BATCH_CRC_SIZE)
+        return BATCH_ERR_TRUNCATED;
+    if (buffer[0] != BATCH_MAGIC)
+        return BATCH_ERR_MAGIC;
+    if (buffer[1] != BATCH_VERSION)
+        return BATCH_ERR_VERSION;
+
+    uint16_t crc = buffer[len - 2] | (buffer[len - 1] << 8);
+    if (batchCrc16(buffer, len - BATCH_CRC_SIZE) != crc)
+        return BATCH_ERR_CRC;
+
+    _header.version = buffer[1];
+    _header.flags = buffer[2];
+    _header.count = buffer[3];
+    _header.nodeId = buffer[4] | (buffer[5] << 8);
+    _header.sequence = buffer[6] | (buffer[7] << 8);
+    _header.tempTolerance = 0;
+    _header.humTolerance = 0;
+    _header.epoch = 0;
+
+    // Flags change the layout, unknown ones can't be skipped
+    if (_header.flags & ~BATCH_FLAGS_KNOWN)
+    {
+        _header.count = 0;
+        return BATCH_ERR_VERSION;
+    }
+
+    if (_header.count > BATCH_MAX_READINGS)
+    {
+        _header.count = 0;
+        return BATCH_ERR_COUNT;
+    }
+
+    bool series = _header.flags & (BATCH_FLAG_HOLD | BATCH_FLAG_LINEAR);
+    size_t extra = (series ? BATCH_TOLERANCE_SIZE : 0) + (_header.flags & BATCH_FLAG_EPOCH ? BATCH_EPOCH_SIZE : 0);
+    size_t bitmapLen = (_header.count + 7) / 8;
+    if (len < BATCH_HEADER_SIZE + extra + bitmapLen + BATCH_CRC_SIZE)
+    {
+        _header.count = 0;
+        return BATCH_ERR_TRUNCATED;
+    }
+
+    _pos = BATCH_HEADER_SIZE;
+    if (series)
+    {
+        _header.tempTolerance = buffer[_pos++];
+        _header.humTolerance = buffer[_pos++];
+    }
+    if (_header.flags & BATCH_FLAG_EPOCH)
+    {
+        for (int i = 0; i < BATCH_EPOCH_SIZE; i++)
+            _header.epoch |= (uint32_t)buffer[_pos++] << (8 * i);
+    }
+    _valuesEnd = len - BATCH_CRC_SIZE - bitmapLen;
+    _bitmap = buffer + _valuesEnd;
+    return BATCH_OK;
+}
+
+bool BatchDecoder::getVarint(uint32_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 32; shift += 7)
+    {
+        if (_pos >= _valuesEnd)
+            return false;
+        uint8_t b = _buf[_pos++];
+        value |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+bool BatchDecoder::next(BatchReading &out)
+{
+    if (_corrupt)
+        return false;
+    if (_index >= _header.count)
+    {
+        // Every value byte belongs to a reading, bytes left over mean a wrong count or garbage
+        _corrupt = _pos != _valuesEnd;
+        return false;
+    }
+
+    out.error = _bitmap[_index / 8] & (1 << (_index % 8));
+    _index++;
+
+    out.timeOffset = 0;
+    if (_header.flags & BATCH_FLAG_TIMES)
+    {
+        uint32_t dt;
+        if (!getVarint(dt) || _lastTime + dt > 0xFFFF)
+        {
+            _corrupt = true;
+            return false;
+        }
+        _lastTime += dt;
+        out.timeOffset = _lastTime;
+    }
+
+    if (out.error)
+    {
+        out.temperature = 0;
+        out.humidity = 0;
+        return true;
+    }
+
+    uint32_t dt, dh;
+    if (!getVarint(dt) || !getVarint(dh))
+    {
+        _corrupt = true;
+        return false;
+    }
+
+    _lastTemp = (int16_t)(_lastTemp + unzigzag(dt));
+    _lastHum = (int16_t)(_lastHum + unzigzag(dh));
+    out.temperature = _lastTemp;
+    out.humidity = _lastHum;
+    return true;
+}
@@ -0,0 +1,162 @@
+#ifndef BATCHCODEC_H
+#define BATCHCODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Compact binary batch format used between the Arduino node and the ESP32 gateway.
+//
+// Layout (all multi-byte fields little endian):
+//   0     magic (0xCB)
+//   1     version
+//   2     flags (BATCH_FLAG_*)
+//   3     number of readings
+//   4-5   node id
+//   6-7   batch sequence number
+//   8-9   only with BATCH_FLAG_HOLD or BATCH_FLAG_LINEAR: largest reconstruction error
+//         of temperature and humidity in hundredths
+//   ..    only with BATCH_FLAG_EPOCH: 4 byte epoch seconds (UTC) of the batch start
+//   ..    per reading with BATCH_FLAG_TIMES: varint seconds since the previous reading
+//         (the first since the batch start), then per valid reading: zigzag varint delta
+//         of temperature and humidity (fixed-point, hundredths, delta from previous valid reading)
+//   ..    error bitmap, one bit per reading (bit set = reading had an error)
+//   last  CRC-16/CCITT over everything before it
+//
+// Without flags every sample is sent and readings have no times. The series flags mark
+// batches reduced by a change filter: the readings are the kept points and the samples
+// in between are their value held (HOLD) or interpolated (LINEAR) between kept points.
+// With BATCH_FLAG_EPOCH the node's clock was synced to the gateway, so every reading's
+// time is the batch epoch plus its offset. Without it the gateway stamps the readings.
+//
+// The sequence number wraps from 0xFFFF to 0 and a sender's counter may be wider, only
+// its low 16 bits are sent. Compare numbers with batchSequenceDiff, never with < or >.
+//
+// Several batches can be sent in one body as a batch list:
+//   0     list magic (0xCC)
+//   1     number of batches
+//   ..    per batch: 2 byte length, then the encoded batch
+//
+// The codec has no Arduino dependencies so it can be built on a host as well.
+
+#define BATCH_CONTENT_TYPE "application/x-chas-batch"
+#define BATCH_MAGIC 0xCB
+#define BATCH_LIST_MAGIC 0xCC
+#define BATCH_LIST_HEADER_SIZE 2
+#define BATCH_LIST_LENGTH_SIZE 2
+#define BATCH_VERSION 1
+#define BATCH_HEADER_SIZE 8
+#define BATCH_TOLERANCE_SIZE 2
+#define BATCH_EPOCH_SIZE 4
+#define BATCH_FLAG_TIMES 0x01  // readings carry a time offset
+#define BATCH_FLAG_HOLD 0x02   // deadband series, values hold until the next reading
+#define BATCH_FLAG_LINEAR 0x04 // swinging door series, values are interpolated
+#define BATCH_FLAG_EPOCH 0x08  // header carries the epoch of the batch start
+#define BATCH_FLAGS_KNOWN (BATCH_FLAG_TIMES | BATCH_FLAG_HOLD | BATCH_FLAG_LINEAR | BATCH_FLAG_EPOCH)
+#define BATCH_CRC_SIZE 2
+#define BATCH_MAX_READINGS 64
+#define BATCH_FIXED_SCALE 100
+// Worst case: every reading valid with a time and two 3-byte varints
+#define BATCH_MAX_ENCODED_SIZE (BATCH_HEADER_SIZE + BATCH_TOLERANCE_SIZE + BATCH_EPOCH_SIZE + BATCH_MAX_READINGS * 9 + BATCH_MAX_READINGS / 8 + BATCH_CRC_SIZE)
+
+struct BatchHeader
+{
+    uint8_t version;
+    uint8_t flags;
+    uint8_t count;
+    uint16_t nodeId;
+    uint16_t sequence;
+    uint8_t tempTolerance; // hundredths, 0 without a series flag
+    uint8_t humTolerance;
+    uint32_t epoch; // epoch seconds of the batch start, 0 without BATCH_FLAG_EPOCH
+};
+
+// Serial number arithmetic on batch sequence numbers (RFC 1982): how far a is ahead
+// of b, negative if a came before b. Correct across the wrap for gaps below 0x8000.
+inline int16_t batchSequenceDiff(uint16_t a, uint16_t b) { return (int16_t)(uint16_t)(a - b); }
+
+// One reading in fixed point (hundredths of a degree / percent)
+struct BatchReading
+{
+    int16_t temperature;
+    int16_t humidity;
+    bool error;
+    uint16_t timeOffset; // seconds since the batch start, 0 without BATCH_FLAG_TIMES
+};
+
+enum BatchDecodeResult
+{
+    BATCH_OK = 0,
+    BATCH_ERR_TRUNCATED,
+    BATCH_ERR_MAGIC,
+    BATCH_ERR_VERSION,
+    BATCH_ERR_CRC,
+    BATCH_ERR_COUNT,
+    BATCH_ERR_CORRUPT
+};
+
+int16_t batchToFixed(float value);
+float batchFromFixed(int16_t value);
+uint16_t batchCrc16(const uint8_t *data, size_t len);
+const char *batchDecodeError(BatchDecodeResult result);
+
+// Incremental encoder writing into a caller-provided buffer
+class BatchEncoder
+{
+public:
+    BatchEncoder(uint8_t *buffer, size_t size);
+
+    // Tolerances are only written with BATCH_FLAG_HOLD or BATCH_FLAG_LINEAR, epoch only with BATCH_FLAG_EPOCH
+    void begin(uint16_t nodeId, uint16_t sequence, uint8_t flags = 0, uint8_t tempTolerance = 0, uint8_t humTolerance = 0,
+               uint32_t epoch = 0);
+    // Returns false if the batch is full or the buffer is too small
+    bool add(float temperature, float humidity, bool error);
+    // Same as add() for values already in fixed point (hundredths).
+    // timeOffset (seconds since the batch start) is only sent with BATCH_FLAG_TIMES.
+    bool addFixed(int16_t temperature, int16_t humidity, bool error, uint16_t timeOffset = 0);
+    // Writes bitmap and CRC, returns total encoded length (0 on overflow)
+    size_t finish();
+
+    uint8_t count() const { return _count; }
+
+private:
+    bool putVarint(uint32_t value);
+
+    uint8_t *_buf;
+    size_t _size;
+    size_t _pos;
+    uint8_t _count;
+    bool _overflow;
+    uint8_t _flags;
+    int16_t _lastTemp;
+    int16_t _lastHum;
+    uint16_t _lastTime;
+    uint8_t _errors[BATCH_MAX_READINGS / 8];
+};
+
+// Decoder reading readings one at a time from an encoded buffer
+class BatchDecoder
+{
+public:
+    BatchDecodeResult begin(const uint8_t *buffer, size_t len);
+    const BatchHeader &header() const { return _header; }
+    // Returns false when all readings have been read or the data is corrupt.
+    // Call until it returns false, only then are bytes after the last reading detected.
+    bool next(BatchReading &out);
+    bool corrupt() const { return _corrupt; }
+
+private:
+    bool getVarint(uint32_t &value);
+
+    const uint8_t *_buf;
+    size_t _pos;
+    size_t _valuesEnd;
+    const uint8_t *_bitmap;
+    BatchHeader _header;
+    uint8_t _index;
+    bool _corrupt;
+    int16_t _lastTemp;
+    int16_t _lastHum;
+    uint16_t _lastTime;
+};
+
+#endif
@@ -0,0 +1,185 @@
+#include "changeFilter.h"
+#include <math.h>
+#include <float.h>
+#include <stdlib.h>
+
+ChangeFilter::ChangeFilter(ChangeFilterMode mode, int16_t tempTolerance, int16_t humTolerance)
+    : filterMode(mode), tempTolerance(tempTolerance), humTolerance(humTolerance)
+{
+    reset();
+}
+
+void ChangeFilter::reset()
+{
+    started = false;
+    pending = false;
+    sampleCount = 0;
+    keptCount = 0;
+}
+
+bool ChangeFilter::anchor(SeriesPoint &out) const
+{
+    if (!started)
+        return false;
+    out = anchorPoint;
+    return true;
+}
+
+void ChangeFilter::restart(const SeriesPoint &point)
+{
+    anchorPoint = point;
+    started = true;
+    pending = false;
+    tempDoor.low = -FLT_MAX;
+    tempDoor.high = FLT_MAX;
+    humDoor = tempDoor;
+}
+
+size_t ChangeFilter::keep(const SeriesPoint &point, SeriesPoint *out, size_t n)
+{
+    out[n] = point;
+    keptCount++;
+    return n + 1;
+}
+
+// Intersects the door with the slopes that keep value within tolerance, false if that leaves nothing
+bool ChangeFilter::narrow(Door &door, int16_t anchorValue, int16_t value, int16_t tolerance, uint32_t dt, Door &out) const
+{
+    // One hundredth is kept back for rounding the vertex and the reconstructed value
+    float margin = tolerance > 0 ? tolerance - 1 : 0;
+    float low = (value - margin - anchorValue) / (float)dt;
+    float high = (value + margin - anchorValue) / (float)dt;
+    out.low = low > door.low ? low : door.low;
+    out.high = high < door.high ? high : door.high;
+    return out.low <= out.high;
+}
+
+// Vertex at the newest sample on the middle of the doors
+SeriesPoint ChangeFilter::closeSegment()
+{
+    uint32_t dt = last.time - anchorPoint.time;
+    SeriesPoint vertex = last;
+    vertex.temperature = (int16_t)lroundf(anchorPoint.temperature + (tempDoor.low + tempDoor.high) / 2 * dt);
+    vertex.humidity = (int16_t)lroundf(anchorPoint.humidity + (humDoor.low + humDoor.high) / 2 * dt);
+    restart(vertex);
+    return vertex;
+}
+
+size_t ChangeFilter::add(const SeriesPoint &sample, SeriesPoint *out)
+{
+    size_t n = 0;
+    sampleCount++;
+
+    if (filterMode == CHANGE_FILTER_OFF)
+    {
+        restart(sample);
+        return keep(sample, out, n);
+    }
+
+    if (sample.error)
+    {
+        if (pending)
+            n = flush(out);
+        // Only the first error of a run is kept, the series is unknown until the next valid sample
+        if (!started || !anchorPoint.error)
+            n = keep(sample, out, n);
+        restart(sample);
+        last = sample;
+        return n;
+    }
+
+    if (!started || anchorPoint.error)
+    {
+        restart(sample);
+        last = sample;
+        return keep(sample, out, n);
+    }
+
+    uint32_t dt = sample.time - anchorPoint.time;
+    if (dt == 0 || (int32_t)dt < 0)
+        return 0; // not after the anchor, nothing to add
+
+    if (filterMode == CHANGE_FILTER_DEADBAND)
+    {
+        if (abs(sample.temperature - anchorPoint.temperature) > tempTolerance ||
+            abs(sample.humidity - anchorPoint.humidity) > humTolerance)
+        {
+            restart(sample);
+            n = keep(sample, out, n);
+        }
+        else
+        {
+            pending = true;
+        }
+        last = sample;
+        return n;
+    }
+
+    Door temp, hum;
+    if (!narrow(tempDoor, anchorPoint.temperature, sample.temperature, tempTolerance, dt, temp) ||
+        !narrow(humDoor, anchorPoint.humidity, sample.humidity, humTolerance, dt, hum))
+    {
+        // The sample can't be reached from the anchor, end the segment at the previous one
+        n = keep(closeSegment(), out, n);
+        dt = sample.time - anchorPoint.time;
+        narrow(tempDoor, anchorPoint.temperature, sample.temperature, tempTolerance, dt, temp);
+        narrow(humDoor, anchorPoint.humidity, sample.humidity, humTolerance, dt, hum);
+    }
+    tempDoor = temp;
+    humDoor = hum;
+    pending = true;
+    last = sample;
+    return n;
+}
+
+size_t ChangeFilter::flush(SeriesPoint *out)
+{
+    if (!pending)
+        return 0;
+
+    if (filterMode == CHANGE_FILTER_DEADBAND)
+    {
+        // The value held since the anchor, up to the newest sample
+        SeriesPoint end = anchorPoint;
+        end.time = last.time;
+        restart(end);
+        return keep(end, out, 0);
+    }
+    return keep(closeSegment(), out, 0);
+}
+
+SeriesPoint changeFilterValueAt(ChangeFilterMode mode, const SeriesPoint &a, const SeriesPoint &b, uint32_t t)
+{
+    if (t >= b.time)
+        return b;
+
+    SeriesPoint point = a;
+    point.time = t;
+    // Hold before an error and after a dropped sample, interpolate between vertices
+    if (a.error || b.error || mode == CHANGE_FILTER_DEADBAND || b.time == a.time)
+        return point;
+
+    float f = (float)(t - a.time) / (b.time - a.time);
+    point.temperature = (int16_t)lroundf(a.temperature + (b.temperature - a.temperature) * f);
+    point.humidity = (int16_t)lroundf(a.humidity + (b.humidity - a.humidity) * f);
+    return point;
+}
+
+size_t changeFilterExpand(ChangeFilterMode mode, const SeriesPoint *points, size_t count, uint32_t step,
+                          SeriesPoint *out, size_t max)
+{
+    if (count == 0 || max == 0 || step == 0)
+        return 0;
+
+    size_t n = 0;
+    size_t segment = 0;
+    uint32_t span = points[count - 1].time - points[0].time;
+    for (uint32_t offset = 0; offset <= span && n < max; offset += step)
+    {
+        uint32_t t = points[0].time + offset;
+        while (segment + 1 < count - 1 && points[segment + 1].time <= t)
+            segment++;
+        out[n++] = count == 1 ? points[0] : changeFilterValueAt(mode, points[segment], points[segment + 1], t);
+    }
+    return n;
+}
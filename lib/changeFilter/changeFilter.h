@@ -0,0 +1,96 @@
+#ifndef CHANGEFILTER_H
+#define CHANGEFILTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Change driven reduction of a temperature/humidity series before it is sent, and the
+// matching reconstruction on the receiving side.
+//
+// CHANGE_FILTER_DEADBAND keeps a sample only when it differs from the last kept one by
+//   more than the tolerance. Holding every kept value until the next kept point gives
+//   each dropped sample back within the tolerance.
+// CHANGE_FILTER_SWINGING_DOOR keeps the vertices of a piecewise linear approximation.
+//   For every segment the range of slopes from its start that stays within the
+//   tolerance of all samples so far is tracked ("the doors"). Once a sample closes the
+//   doors a vertex is placed at the previous sample on the middle slope, so linear
+//   interpolation between kept points gives every sample back within the tolerance.
+//
+// An error sample ends the current segment and is kept once, the next valid sample
+// starts a new series. flush() closes the current segment at the newest sample, so
+// everything up to it can be reconstructed from the kept points alone.
+//
+// Values are fixed point (hundredths), times are whole seconds from any origin.
+// Has no Arduino dependencies so both firmwares and a host can use it.
+
+enum ChangeFilterMode
+{
+    CHANGE_FILTER_OFF = 0, // every sample is kept
+    CHANGE_FILTER_DEADBAND,
+    CHANGE_FILTER_SWINGING_DOOR
+};
+
+struct SeriesPoint
+{
+    uint32_t time; // seconds
+    int16_t temperature;
+    int16_t humidity;
+    bool error;
+};
+
+#define CHANGE_FILTER_MAX_OUTPUT 2 // most points one add() can keep
+
+class ChangeFilter
+{
+public:
+    // Tolerances are the largest reconstruction error allowed, in hundredths
+    ChangeFilter(ChangeFilterMode mode, int16_t tempTolerance, int16_t humTolerance);
+
+    void reset();
+    // Feeds the next sample, times must increase. Writes the points to keep into out
+    // (CHANGE_FILTER_MAX_OUTPUT entries) and returns how many.
+    size_t add(const SeriesPoint &sample, SeriesPoint *out);
+    // Ends the current segment at the newest sample, returns 1 if a point was kept
+    size_t flush(SeriesPoint *out);
+    // Newest kept point, where the next segment starts. False before the first sample.
+    bool anchor(SeriesPoint &out) const;
+
+    ChangeFilterMode mode() const { return filterMode; }
+    uint32_t samples() const { return sampleCount; }
+    uint32_t kept() const { return keptCount; }
+
+private:
+    // Slopes (hundredths per second) from the anchor that keep one value within tolerance
+    struct Door
+    {
+        float low;
+        float high;
+    };
+
+    void restart(const SeriesPoint &point);
+    bool narrow(Door &door, int16_t anchorValue, int16_t value, int16_t tolerance, uint32_t dt, Door &out) const;
+    SeriesPoint closeSegment();
+    size_t keep(const SeriesPoint &point, SeriesPoint *out, size_t n);
+
+    ChangeFilterMode filterMode;
+    int16_t tempTolerance;
+    int16_t humTolerance;
+    bool started;
+    bool pending; // samples after the anchor not yet covered by a kept point
+    SeriesPoint anchorPoint;
+    SeriesPoint last;
+    Door tempDoor;
+    Door humDoor;
+    uint32_t sampleCount;
+    uint32_t keptCount;
+};
+
+// Value of a kept series at time t, with a.time <= t <= b.time for consecutive kept points
+SeriesPoint changeFilterValueAt(ChangeFilterMode mode, const SeriesPoint &a, const SeriesPoint &b, uint32_t t);
+
+// Samples the series given by count kept points every step seconds from the first to the
+// last point. Writes at most max points and returns how many.
+size_t changeFilterExpand(ChangeFilterMode mode, const SeriesPoint *points, size_t count, uint32_t step,
+                          SeriesPoint *out, size_t max);
+
+#endif
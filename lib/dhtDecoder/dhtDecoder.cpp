@@ -0,0 +1,71 @@
+#include "dhtDecoder.h"
+
+DhtResult dhtDecodeBits(const uint32_t *edges, size_t count, uint8_t frame[5])
+{
+    if (count < DHT_FRAME_EDGES)
+        return DHT_ERR_NO_RESPONSE;
+
+    const uint32_t *first = edges + count - DHT_FRAME_EDGES;
+    for (size_t i = 0; i < 5; i++)
+        frame[i] = 0;
+
+    for (size_t bit = 0; bit < DHT_FRAME_BITS; bit++)
+    {
+        uint32_t period = first[bit + 1] - first[bit];
+        if (period < DHT_BIT_MIN_US || period > DHT_BIT_MAX_US)
+            return DHT_ERR_TIMING;
+        if (period > DHT_BIT_THRESHOLD_US)
+            frame[bit / 8] |= 0x80 >> (bit % 8);
+    }
+
+    uint8_t sum = frame[0] + frame[1] + frame[2] + frame[3];
+    if (sum != frame[4])
+        return DHT_ERR_CHECKSUM;
+    return DHT_OK;
+}
+
+DhtReading dhtConvert(const uint8_t frame[5], DhtType type)
+{
+    DhtReading reading;
+    if (type == DHT_TYPE_22)
+    {
+        // Tenths, temperature as sign and magnitude
+        reading.humidity = ((frame[0] << 8) | frame[1]) * 10;
+        int16_t temperature = ((frame[2] & 0x7F) << 8) | frame[3];
+        reading.temperature = (frame[2] & 0x80 ? -temperature : temperature) * 10;
+    }
+    else
+    {
+        // Integer and tenths bytes, newer DHT11 set bit 7 of the tenths for below zero
+        reading.humidity = frame[0] * 100 + frame[1] * 10;
+        int16_t temperature = frame[2] * 100 + (frame[3] & 0x0F) * 10;
+        reading.temperature = frame[3] & 0x80 ? -temperature : temperature;
+    }
+    return reading;
+}
+
+DhtResult dhtDecode(const uint32_t *edges, size_t count, DhtType type, DhtReading &out)
+{
+    uint8_t frame[5];
+    DhtResult result = dhtDecodeBits(edges, count, frame);
+    if (result == DHT_OK)
+        out = dhtConvert(frame, type);
+    return result;
+}
+
+const char *dhtDecodeError(DhtResult result)
+{
+    switch (result)
+    {
+    case DHT_OK:
+        return "OK";
+    case DHT_ERR_NO_RESPONSE:
+        return "No response";
+    case DHT_ERR_TIMING:
+        return "Bad timing";
+    case DHT_ERR_CHECKSUM:
+        return "Bad checksum";
+    default:
+        return "Unknown error";
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef DHTDECODER_H
+#define DHTDECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Pulse train decoder for DHT11/DHT22 sensors, separated from the pin handling so
+// recorded edge traces can be decoded on a host.
+//
+// After the start pulse the sensor answers with 80 us low + 80 us high, then sends
+// 40 bits, each 50 us low followed by ~27 us high (0) or ~70 us high (1), and ends
+// with a 50 us low. Only falling edges are needed: the time between two falling
+// edges is ~77 us for a 0 bit and ~120 us for a 1 bit. The 40 bits are the 41
+// falling edges at the end of the trace, so a missed response edge at the start
+// doesn't matter.
+//
+// Bytes: humidity high, humidity low, temperature high, temperature low, checksum.
+
+#define DHT_FRAME_BITS 40
+#define DHT_FRAME_EDGES (DHT_FRAME_BITS + 1) // falling edges enclosing the 40 bits
+#define DHT_MAX_EDGES 48                     // edges kept per capture, some spare for glitches
+#define DHT_BIT_THRESHOLD_US 100             // falling edge distance above this is a 1
+#define DHT_BIT_MIN_US 60                    // shorter distances are noise
+#define DHT_BIT_MAX_US 160                   // longer distances mean edges were lost
+
+enum DhtType
+{
+    DHT_TYPE_11 = 11,
+    DHT_TYPE_22 = 22
+};
+
+enum DhtResult
+{
+    DHT_OK = 0,
+    DHT_ERR_NO_RESPONSE, // too few edges, sensor missing or not powered
+    DHT_ERR_TIMING,      // a bit was too short or too long
+    DHT_ERR_CHECKSUM
+};
+
+// One decoded reading in fixed point (hundredths of a degree / percent)
+struct DhtReading
+{
+    int16_t temperature;
+    int16_t humidity;
+};
+
+// Turns the falling edge times (us, wrapping is fine) of one capture into the 5 frame bytes
+DhtResult dhtDecodeBits(const uint32_t *edges, size_t count, uint8_t frame[5]);
+// Converts checked frame bytes to a reading using the data format of the sensor type
+DhtReading dhtConvert(const uint8_t frame[5], DhtType type);
+// dhtDecodeBits and dhtConvert in one step
+DhtResult dhtDecode(const uint32_t *edges, size_t count, DhtType type, DhtReading &out);
+const char *dhtDecodeError(DhtResult result);
+
+#endif
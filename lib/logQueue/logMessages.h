@@ -0,0 +1,68 @@
+#ifndef LOGMESSAGES_H
+#define LOGMESSAGES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Every message either firmware can log, with its id and format (see logFormat()).
+// The ids are what binary logs carry, so messages are only ever appended:
+// never reuse or renumber an id, retired ones stay listed.
+
+// X(name, id, format)
+#define ESP32_LOG_MESSAGES(X)                                             \
+    X(LOG_ESP_RESET, 0x0100, "System reset")                              \
+    X(LOG_ESP_READING, 0x0101, "Node %u %T Temp=%.1f Hum=%.1f")           \
+    X(LOG_ESP_READING_ERROR, 0x0102, "Node %u %T No data")                \
+    X(LOG_ESP_NO_DATA, 0x0103, "No data received for %u seconds")         \
+    X(LOG_ESP_NODE_OFFLINE, 0x0104, "Node %u: no data received for %u seconds") \
+    X(LOG_ESP_REPLAYED, 0x0105, "Replayed %u readings from backlog")      \
+    X(LOG_ESP_INGEST_ERROR, 0x0106, "Ingest error %u (batch error %u)")   \
+    X(LOG_ESP_LOG_DROPPED, 0x0107, "%u log entries dropped")              \
+    X(LOG_ESP_STATION_UP, 0x0108, "Station up on channel %u after %u ms") \
+    X(LOG_ESP_STATION_IP, 0x0109, "Station IP %u.%u.%u.%u")               \
+    X(LOG_ESP_STATION_SCAN, 0x010A, "Cached network not found, scanning") \
+    X(LOG_ESP_STATION_RETRY, 0x010B, "Station join failed, retry in %u ms") \
+    X(LOG_ESP_STATION_LOST, 0x010C, "Station connection lost")            \
+    X(LOG_ESP_UPSTREAM_FAILED, 0x010D, "Upstream request failed, %u readings kept, retry in %u ms") \
+    X(LOG_ESP_UPSTREAM_REJECTED, 0x010E, "Upstream rejected batch: %d, %u readings dropped")  \
+    X(LOG_ESP_LOGGER_STARTED, 0x010F, "Server disconnected, starting logger") \
+    X(LOG_ESP_LOGGER_STOPPED, 0x0110, "Server connected, stopping logger") \
+    X(LOG_ESP_LOGGED, 0x0111, "Logged node %u %T Temp=%C Hum=%C")         \
+    X(LOG_ESP_BACKLOG_MISSING, 0x0112, "No backlog flash partition, backlog disabled")
+
+#define ARDUINO_LOG_MESSAGES(X)                                           \
+    X(LOG_ARD_RESET, 0x0200, "System reset")                              \
+    X(LOG_ARD_READING, 0x0201, "Temp=%.1f Hum=%.1f")                      \
+    X(LOG_ARD_READING_ERROR, 0x0202, "No data")                           \
+    X(LOG_ARD_CONNECT_FAILED, 0x0203, "Connection to ESP32 failed")       \
+    X(LOG_ARD_NO_RESPONSE, 0x0204, "No response from ESP32")              \
+    X(LOG_ARD_REJECTED, 0x0205, "ESP32 rejected batch: %d")               \
+    X(LOG_ARD_PAUSED, 0x0206, "ESP32 unreachable, pausing sends")         \
+    X(LOG_ARD_JOURNAL, 0x0207, "Logging on arduino: %u %.2f,%.2f,%u")     \
+    X(LOG_ARD_LOG_DROPPED, 0x0208, "%u log entries dropped")              \
+    X(LOG_ARD_MEMORY, 0x0209, "Heap free %u largest %u min %u, stack free %u") \
+    X(LOG_ARD_ALLOCS, 0x020A, "Allocs other %u batch %u wifi %u logger %u") \
+    X(LOG_ARD_ALLOC_BYTES, 0x020B, "Alloc bytes other %u batch %u wifi %u logger %u") \
+    X(LOG_ARD_BATCH_REJECTED, 0x020C, "ESP32 refused batch %u, dropped")  \
+    X(LOG_ARD_TIME_REJECTED, 0x020D, "Gateway time %u rejected")          \
+    X(LOG_ARD_READING_DROPPED, 0x020E, "Reading %u of the batch too large, dropped")
+
+#define LOG_MESSAGE_ID(name, id, format) name = id,
+#define LOG_MESSAGE_ENTRY(name, id, format) {id, format},
+
+enum LogMessageId
+{
+    ESP32_LOG_MESSAGES(LOG_MESSAGE_ID)
+    ARDUINO_LOG_MESSAGES(LOG_MESSAGE_ID)
+};
+
+struct LogMessage
+{
+    uint16_t id;
+    const char *format;
+};
+
+// Format of a message id, NULL if the table doesn't have it
+const char *logMessageFormat(const LogMessage *table, size_t count, uint16_t id);
+
+#endif
@@ -0,0 +1,255 @@
+#include "logQueue.h"
+#include "logMessages.h"
+#include <stdio.h>
+#include <time.h>
+
+// ==== QUEUE ====
+
+LogQueue::LogQueue(ClockFunction clock) : clock(clock), head(0), tail(0), droppedCount(0), highWaterMark(0)
+{
+    for (uint32_t i = 0; i < LOG_QUEUE_SIZE; i++)
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+bool LogQueue::push(const LogEntry &entry)
+{
+    uint32_t pos = head.load(std::memory_order_relaxed);
+    while (true)
+    {
+        Slot &slot = slots[pos & (LOG_QUEUE_SIZE - 1)];
+        uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+        int32_t diff = (int32_t)(sequence - pos);
+        if (diff == 0)
+        {
+            // The slot is free for this position, claim it unless another producer was faster
+            if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                slot.entry = entry;
+                slot.sequence.store(pos + 1, std::memory_order_release);
+
+                uint32_t waiting = pos + 1 - tail.load(std::memory_order_relaxed);
+                uint32_t high = highWaterMark.load(std::memory_order_relaxed);
+                if (waiting <= LOG_QUEUE_SIZE && waiting > high)
+                    highWaterMark.compare_exchange_strong(high, waiting, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            // The drain hasn't freed this slot yet
+            droppedCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            pos = head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool LogQueue::pop(LogEntry &entry)
+{
+    uint32_t pos = tail.load(std::memory_order_relaxed);
+    Slot &slot = slots[pos & (LOG_QUEUE_SIZE - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+        return false;
+
+    entry = slot.entry;
+    // Free the slot for the producer one lap ahead
+    slot.sequence.store(pos + LOG_QUEUE_SIZE, std::memory_order_release);
+    tail.store(pos + 1, std::memory_order_relaxed);
+    return true;
+}
+
+// ==== FRAMES ====
+
+static uint8_t crc8(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc;
+}
+
+static void put32(uint8_t *p, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = (value >> (8 * i)) & 0xFF;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+size_t logEncodeFrame(const LogEntry &entry, uint8_t *out, size_t size)
+{
+    uint8_t argc = entry.argc > LOG_MAX_ARGS ? LOG_MAX_ARGS : entry.argc;
+    size_t payload = LOG_PAYLOAD_HEADER_SIZE + argc * 4;
+    if (size < payload + 3)
+        return 0;
+
+    out[0] = LOG_FRAME_MAGIC;
+    out[1] = payload;
+    uint8_t *p = out + 2;
+    put32(p, entry.time);
+    p[4] = entry.id & 0xFF;
+    p[5] = entry.id >> 8;
+    p[6] = entry.level;
+    p[7] = argc;
+    for (uint8_t i = 0; i < argc; i++)
+        put32(p + LOG_PAYLOAD_HEADER_SIZE + i * 4, entry.args[i]);
+    out[2 + payload] = crc8(p, payload);
+    return payload + 3;
+}
+
+int logDecodeFrame(const uint8_t *data, size_t len, LogEntry &entry)
+{
+    if (len < 2)
+        return -1;
+    size_t payload = data[1];
+    if (data[0] != LOG_FRAME_MAGIC || payload < LOG_PAYLOAD_HEADER_SIZE || payload > LOG_FRAME_MAX_SIZE - 3)
+        return 0;
+    if (len < payload + 3)
+        return -1;
+
+    const uint8_t *p = data + 2;
+    if (crc8(p, payload) != data[2 + payload])
+        return 0;
+
+    entry.time = get32(p);
+    entry.id = p[4] | (p[5] << 8);
+    entry.level = p[6];
+    entry.argc = p[7];
+    if (entry.argc > LOG_MAX_ARGS || payload != LOG_PAYLOAD_HEADER_SIZE + entry.argc * 4u)
+        return 0;
+    for (uint8_t i = 0; i < entry.argc; i++)
+        entry.args[i] = get32(p + LOG_PAYLOAD_HEADER_SIZE + i * 4);
+    return payload + 3;
+}
+
+// ==== TEXT ====
+
+const char *logLevelName(uint8_t level)
+{
+    switch (level)
+    {
+    case LOG_LEVEL_DEBUG:
+        return "DEBUG";
+    case LOG_LEVEL_INFO:
+        return "INFO";
+    case LOG_LEVEL_WARN:
+        return "WARN";
+    case LOG_LEVEL_ERROR:
+        return "ERROR";
+    default:
+        return "?";
+    }
+}
+
+const char *logMessageFormat(const LogMessage *table, size_t count, uint16_t id)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (table[i].id == id)
+            return table[i].format;
+    }
+    return NULL;
+}
+
+size_t logFormat(char *out, size_t size, const char *format, const uint32_t *args, uint8_t argc)
+{
+    if (size == 0)
+        return 0;
+
+    size_t n = 0;
+    uint8_t next = 0;
+    for (const char *f = format; *f != '\0' && n < size - 1; f++)
+    {
+        if (*f != '%')
+        {
+            out[n++] = *f;
+            continue;
+        }
+
+        // Precision is only used by %f, length modifiers don't matter with one word per argument
+        int precision = 6;
+        f++;
+        if (*f == '.')
+        {
+            precision = 0;
+            for (f++; *f >= '0' && *f <= '9'; f++)
+                precision = precision * 10 + (*f - '0');
+        }
+        while (*f == 'l' || *f == 'h')
+            f++;
+        if (*f == '\0')
+            break;
+        if (*f == '%')
+        {
+            out[n++] = '%';
+            continue;
+        }
+
+        // A missing argument prints as 0 instead of reading past the entry
+        uint32_t word = next < argc ? args[next] : 0;
+        next++;
+        int written = 0;
+        switch (*f)
+        {
+        case 'd':
+        case 'i':
+            written = snprintf(out + n, size - n, "%ld", (long)(int32_t)word);
+            break;
+        case 'u':
+            written = snprintf(out + n, size - n, "%lu", (unsigned long)word);
+            break;
+        case 'x':
+            written = snprintf(out + n, size - n, "%lx", (unsigned long)word);
+            break;
+        case 'c':
+            written = snprintf(out + n, size - n, "%c", (char)word);
+            break;
+        case 'f':
+        {
+            float value;
+            memcpy(&value, &word, sizeof(value));
+            written = snprintf(out + n, size - n, "%.*f", precision, (double)value);
+            break;
+        }
+        case 'C':
+        {
+            // Fixed-point hundredths, the sign on its own so -0.05 keeps it
+            int32_t value = (int32_t)word;
+            unsigned long magnitude = value < 0 ? (unsigned long)(-(int64_t)value) : (unsigned long)value;
+            written = snprintf(out + n, size - n, "%s%lu.%02lu", value < 0 ? "-" : "", magnitude / 100, magnitude % 100);
+            break;
+        }
+        case 'T':
+        {
+            // 0 is a reading without a known time
+            if (word == 0)
+            {
+                written = snprintf(out + n, size - n, "-");
+                break;
+            }
+            time_t t = word;
+            struct tm local;
+            localtime_r(&t, &local);
+            written = strftime(out + n, size - n, "%Y-%m-%d %H:%M:%S", &local);
+            break;
+        }
+        default:
+            written = snprintf(out + n, size - n, "%%%c", *f);
+            break;
+        }
+        if (written > 0)
+            n += (size_t)written < size - n ? (size_t)written : size - n - 1;
+    }
+    out[n] = '\0';
+    return n;
+}
@@ -0,0 +1,163 @@
+#ifndef LOGQUEUE_H
+#define LOGQUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+// Deferred logging shared by the Arduino node and the ESP32 gateway.
+//
+// A log call stores the message id and its raw arguments in a lock-free queue and
+// returns, nothing is formatted or written to Serial on the caller's time. A
+// background task drains the queue, either formatting lines on the device or writing
+// binary frames that the host tool in tools/logDecode turns back into text.
+// Message ids and formats are listed in logMessages.h.
+//
+// Binary frame (little endian):
+//   0     LOG_FRAME_MAGIC
+//   1     payload length
+//   ..    payload: time (4, ms since boot), id (2), level (1), argc (1), argc x 4 byte argument
+//   last  CRC-8 over the payload
+//
+// Levels below LOG_LEVEL are removed at compile time, their LOG_* calls and
+// arguments generate no code.
+//
+// The queue has no Arduino dependencies so it can be built on a host as well.
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_NONE 4
+
+// ==== CONFIG ====
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO // lowest level compiled in
+#endif
+#ifndef LOG_QUEUE_SIZE
+#define LOG_QUEUE_SIZE 32 // entries waiting for the drain, power of two
+#endif
+#define LOG_MAX_ARGS 4
+#define LOG_FRAME_MAGIC 0x1E // ASCII record separator, never part of a text line
+#define LOG_PAYLOAD_HEADER_SIZE 8
+#define LOG_FRAME_MAX_SIZE (2 + LOG_PAYLOAD_HEADER_SIZE + LOG_MAX_ARGS * 4 + 1)
+
+static_assert((LOG_QUEUE_SIZE & (LOG_QUEUE_SIZE - 1)) == 0, "LOG_QUEUE_SIZE must be a power of two");
+
+// One log call, arguments as raw 32 bit words
+struct LogEntry
+{
+    uint32_t time; // ms since boot
+    uint16_t id;   // LogMessageId
+    uint8_t level;
+    uint8_t argc;
+    uint32_t args[LOG_MAX_ARGS];
+};
+
+// Arguments are stored as 32 bit words, floats by their bit pattern
+inline uint32_t logArg(int value) { return (uint32_t)value; }
+inline uint32_t logArg(unsigned int value) { return value; }
+inline uint32_t logArg(long value) { return (uint32_t)value; }
+inline uint32_t logArg(unsigned long value) { return (uint32_t)value; }
+inline uint32_t logArg(bool value) { return value; }
+inline uint32_t logArg(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+inline uint32_t logArg(double value) { return logArg((float)value); }
+
+/* Bounded multi-producer, single-consumer queue of log entries.
+    Every slot has a sequence number: producers claim a slot with one compare and
+    swap on head and publish it by bumping its sequence, the drain only reads slots
+    that were published. A full queue drops the entry and counts it instead of
+    waiting, so logging never blocks the caller. */
+class LogQueue
+{
+public:
+    typedef uint32_t (*ClockFunction)();
+
+    LogQueue(ClockFunction clock);
+
+    // Any task, never blocks. Returns false if the queue was full.
+    bool push(const LogEntry &entry);
+    // Drain side only
+    bool pop(LogEntry &entry);
+
+    template <typename... Args>
+    bool write(uint8_t level, uint16_t id, Args... args)
+    {
+        static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+        LogEntry entry;
+        entry.time = clock();
+        entry.id = id;
+        entry.level = level;
+        entry.argc = sizeof...(Args);
+        uint32_t words[] = {logArg(args)..., 0};
+        memcpy(entry.args, words, sizeof(uint32_t) * entry.argc);
+        return push(entry);
+    }
+
+    // Entries lost because the queue was full
+    uint32_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+    // Most entries that were waiting at the same time
+    uint32_t highWater() const { return highWaterMark.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot
+    {
+        std::atomic<uint32_t> sequence;
+        LogEntry entry;
+    };
+
+    ClockFunction clock;
+    Slot slots[LOG_QUEUE_SIZE];
+    std::atomic<uint32_t> head; // next slot to claim, shared by the producers
+    std::atomic<uint32_t> tail; // next slot to read, written by the drain only
+    std::atomic<uint32_t> droppedCount;
+    std::atomic<uint32_t> highWaterMark;
+};
+
+// Defined by each firmware next to its drain
+extern LogQueue logQueue;
+
+#define LOG_AT(level, id, ...) logQueue.write(level, id, ##__VA_ARGS__)
+
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(id, ...) LOG_AT(LOG_LEVEL_DEBUG, id, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(id, ...) ((void)0)
+#endif
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(id, ...) LOG_AT(LOG_LEVEL_INFO, id, ##__VA_ARGS__)
+#else
+#define LOG_INFO(id, ...) ((void)0)
+#endif
+#if LOG_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(id, ...) LOG_AT(LOG_LEVEL_WARN, id, ##__VA_ARGS__)
+#else
+#define LOG_WARN(id, ...) ((void)0)
+#endif
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(id, ...) LOG_AT(LOG_LEVEL_ERROR, id, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(id, ...) ((void)0)
+#endif
+
+const char *logLevelName(uint8_t level);
+
+// Writes the binary frame of an entry, returns its length (0 if out is too small)
+size_t logEncodeFrame(const LogEntry &entry, uint8_t *out, size_t size);
+// Parses one frame starting at the magic byte. Returns the frame length, 0 if the
+// data is not a valid frame, or -1 if more bytes are needed.
+int logDecodeFrame(const uint8_t *data, size_t len, LogEntry &entry);
+
+/* Formats the arguments of an entry with a printf subset:
+    %d %i %u %x %c, %f with optional precision (%.1f), %C for hundredths as a decimal
+    (2150 as "21.50"), %T for epoch seconds as local time ("YYYY-MM-DD HH:MM:SS") and %%. Length modifiers (l) are ignored, every
+    argument is one word. Returns the text length, the text is cut to fit size. */
+size_t logFormat(char *out, size_t size, const char *format, const uint32_t *args, uint8_t argc);
+
+#endif
@@ -0,0 +1,160 @@
+#include "memTelemetry.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#ifdef ESP_PLATFORM
+#include <esp_attr.h>
+// The hook runs inside malloc, which IDF keeps callable while the flash cache is off
+#define MEM_HOOK_ATTR IRAM_ATTR
+#else
+#define MEM_HOOK_ATTR
+#endif
+
+// ==== COUNTING ====
+
+static const char *const *tagNames = NULL;
+static size_t tagTotal = 0;
+static std::atomic<uint32_t> allocations[MEM_MAX_TAGS];
+static std::atomic<uint32_t> allocatedBytes[MEM_MAX_TAGS];
+
+// The Uno runs one loop, the ESP32 and the host run tasks on threads of their own
+#if defined(ARDUINO_ARCH_RENESAS)
+static uint8_t currentTag = 0;
+#else
+static thread_local uint8_t currentTag = 0;
+#endif
+
+void memSetTagNames(const char *const *names, size_t count)
+{
+    tagNames = names;
+    tagTotal = count < MEM_MAX_TAGS ? count : MEM_MAX_TAGS;
+}
+
+const char *memTagName(uint8_t tag)
+{
+    return tag < tagTotal ? tagNames[tag] : "?";
+}
+
+size_t memTagCount()
+{
+    return tagTotal;
+}
+
+MEM_HOOK_ATTR void memCountAllocation(size_t size)
+{
+    uint8_t tag = currentTag;
+    allocations[tag].fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes[tag].fetch_add(size, std::memory_order_relaxed);
+}
+
+MemTagCount memAllocations(uint8_t tag)
+{
+    MemTagCount count = {0, 0};
+    if (tag < MEM_MAX_TAGS)
+    {
+        count.allocations = allocations[tag].load(std::memory_order_relaxed);
+        count.bytes = allocatedBytes[tag].load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+MemTagCount memAllocationTotal()
+{
+    MemTagCount total = {0, 0};
+    for (uint8_t tag = 0; tag < MEM_MAX_TAGS; tag++)
+    {
+        MemTagCount count = memAllocations(tag);
+        total.allocations += count.allocations;
+        total.bytes += count.bytes;
+    }
+    return total;
+}
+
+MemScope::MemScope(uint8_t tag) : previous(currentTag)
+{
+    currentTag = tag < MEM_MAX_TAGS ? tag : 0;
+}
+
+MemScope::~MemScope()
+{
+    currentTag = previous;
+}
+
+// ==== HOOK ====
+
+#ifdef MEM_WRAP_MALLOC
+// The linker sends every call of malloc to __wrap_malloc, __real_malloc is the original
+extern "C"
+{
+    void *__real_malloc(size_t size);
+    void *__real_calloc(size_t count, size_t size);
+    void *__real_realloc(void *ptr, size_t size);
+
+    MEM_HOOK_ATTR void *__wrap_malloc(size_t size)
+    {
+        memCountAllocation(size);
+        return __real_malloc(size);
+    }
+
+    MEM_HOOK_ATTR void *__wrap_calloc(size_t count, size_t size)
+    {
+        memCountAllocation(count * size);
+        return __real_calloc(count, size);
+    }
+
+    MEM_HOOK_ATTR void *__wrap_realloc(void *ptr, size_t size)
+    {
+        // String growth lands here, every step counts as an allocation
+        memCountAllocation(size);
+        return __real_realloc(ptr, size);
+    }
+}
+#endif
+
+// ==== REPORT ====
+
+uint8_t memFragmentation(const MemSnapshot &snapshot)
+{
+    if (snapshot.heapFree == 0 || snapshot.heapLargest >= snapshot.heapFree)
+        return 0;
+    return 100 - (uint8_t)((uint64_t)snapshot.heapLargest * 100 / snapshot.heapFree);
+}
+
+void memTrackLowWater(MemSnapshot &snapshot)
+{
+    static uint32_t lowest = UINT32_MAX;
+    if (snapshot.heapFree < lowest)
+        lowest = snapshot.heapFree;
+    if (snapshot.heapMinFree == 0 || lowest < snapshot.heapMinFree)
+        snapshot.heapMinFree = lowest;
+}
+
+size_t memFormatReport(const MemSnapshot &snapshot, char *out, size_t size)
+{
+    if (size == 0)
+        return 0;
+
+    // Host builds have no heap figures, only allocation counts
+    size_t n;
+    if (snapshot.heapFree > 0)
+        n = snprintf(out, size, "heap %lu free %lu largest %u%% frag %lu min", (unsigned long)snapshot.heapFree,
+                     (unsigned long)snapshot.heapLargest, memFragmentation(snapshot), (unsigned long)snapshot.heapMinFree);
+    else
+        n = snprintf(out, size, "heap n/a");
+    if (n < size && snapshot.stackCount > 0)
+    {
+        n += snprintf(out + n, size - n, " | stack");
+        for (size_t i = 0; i < snapshot.stackCount && n < size; i++)
+            n += snprintf(out + n, size - n, " %s %lu", snapshot.stackNames[i], (unsigned long)snapshot.stackFree[i]);
+    }
+    if (n < size)
+        n += snprintf(out + n, size - n, " | alloc");
+    for (uint8_t tag = 0; tag < tagTotal && n < size; tag++)
+    {
+        MemTagCount count = memAllocations(tag);
+        if (count.allocations > 0)
+            n += snprintf(out + n, size - n, " %s %lu/%lu", memTagName(tag), (unsigned long)count.allocations,
+                          (unsigned long)count.bytes);
+    }
+    return n < size ? n : size - 1;
+}
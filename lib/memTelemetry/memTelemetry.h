@@ -0,0 +1,81 @@
+#ifndef MEMTELEMETRY_H
+#define MEMTELEMETRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Heap, stack and allocation telemetry shared by the Arduino node and the ESP32 gateway.
+//
+// Every heap allocation passes a thin hook that counts it, with its requested size,
+// for the subsystem that is running at the time. A subsystem is a small tag set with
+// MemScope around the code it owns; nested scopes restore the outer tag. Each firmware
+// names its tags and reads heap and stack figures from its platform (memoryMonitor.cpp),
+// this part only counts and formats and has no Arduino dependencies.
+//
+// The hook is installed at link time on the boards: build with
+//   -DMEM_WRAP_MALLOC -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc
+// and every malloc, calloc and realloc in the image (String, new, the SDK) is counted.
+// Host builds call memCountAllocation() from the allocator in host/hostAlloc.
+// Frees are not counted, the figures are allocation rates, not live bytes.
+
+// ==== CONFIG ====
+#define MEM_MAX_TAGS 8   // subsystems, tag 0 counts everything outside a scope
+#define MEM_MAX_STACKS 4 // tasks whose stack high-water mark is reported
+#define MEM_REPORT_SIZE 256
+
+// Allocations of one subsystem since boot
+struct MemTagCount
+{
+    uint32_t allocations;
+    uint32_t bytes; // requested, without allocator overhead
+};
+
+// Heap and stack figures at one moment, filled in by the firmware
+struct MemSnapshot
+{
+    uint32_t heapFree;    // free heap in total
+    uint32_t heapLargest; // largest block a single allocation can get
+    uint32_t heapMinFree; // lowest heapFree since boot
+    size_t stackCount;
+    const char *stackNames[MEM_MAX_STACKS];
+    uint32_t stackFree[MEM_MAX_STACKS]; // bytes of the task's stack never used
+};
+
+// Names of the tags, index = tag. Call once at startup, the array must stay valid.
+void memSetTagNames(const char *const *names, size_t count);
+const char *memTagName(uint8_t tag);
+size_t memTagCount();
+
+// The allocation hook, counts one allocation for the current tag
+void memCountAllocation(size_t size);
+MemTagCount memAllocations(uint8_t tag);
+// Sum over all tags
+MemTagCount memAllocationTotal();
+
+// Share of the free heap that a single allocation can't reach, in percent
+uint8_t memFragmentation(const MemSnapshot &snapshot);
+// Lowers heapMinFree to heapFree and to every earlier snapshot, for platforms that
+// don't track the low-water mark themselves
+void memTrackLowWater(MemSnapshot &snapshot);
+
+/* One line report:
+     heap 182340 free 110580 largest 39% frag 170112 min | stack loop 5120 proc 6012 | alloc http 12/480 logger 3/96
+   Allocations are count/bytes since boot, tags without allocations are left out.
+   A snapshot without heap figures (host builds) reads "heap n/a".
+   Returns the length written, cut to fit size. */
+size_t memFormatReport(const MemSnapshot &snapshot, char *out, size_t size);
+
+/* Counts the allocations of a block of code for a subsystem:
+        MemScope scope(MEM_TAG_LOGGER);
+    The tag is per thread on the ESP32 and the host, so both cores keep their own. */
+class MemScope
+{
+public:
+    explicit MemScope(uint8_t tag);
+    ~MemScope();
+
+private:
+    uint8_t previous;
+};
+
+#endif
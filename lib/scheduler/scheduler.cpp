@@ -0,0 +1,69 @@
+#include "scheduler.h"
+
+Scheduler::Scheduler(ClockFunction clock, IdleFunction idle)
+    : clock(clock), idle(idle), count(0)
+{
+}
+
+bool Scheduler::add(const char *name, TaskFunction function, uint32_t periodMs, uint32_t deadlineMs,
+                    uint32_t startDelayMs)
+{
+    if (count >= SCHEDULER_MAX_TASKS || function == NULL)
+        return false;
+
+    SchedulerTask &t = tasks[count++];
+    t.name = name;
+    t.function = function;
+    t.period = periodMs;
+    t.deadline = deadlineMs;
+    t.nextRun = clock() + startDelayMs;
+    t.runs = 0;
+    t.missed = 0;
+    t.maxLate = 0;
+    return true;
+}
+
+uint32_t Scheduler::runDue()
+{
+    uint32_t wait = UINT32_MAX;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        SchedulerTask &t = tasks[i];
+        uint32_t now = clock();
+
+        // Signed difference keeps the comparison correct across millis() overflow
+        int32_t late = (int32_t)(now - t.nextRun);
+        if (late >= 0)
+        {
+            if ((uint32_t)late > t.maxLate)
+                t.maxLate = late;
+            if ((uint32_t)late > t.deadline)
+                t.missed++;
+
+            t.function();
+            t.runs++;
+
+            // Keep the original grid unless we fell a whole period behind, then resync
+            t.nextRun += t.period;
+            if ((int32_t)(clock() - t.nextRun) >= 0)
+                t.nextRun = clock() + t.period;
+            now = clock();
+        }
+
+        uint32_t until = t.nextRun - now;
+        if ((int32_t)until < 0)
+            until = 0;
+        if (until < wait)
+            wait = until;
+    }
+
+    return count == 0 ? 0 : wait;
+}
+
+void Scheduler::run()
+{
+    uint32_t wait = runDue();
+    if (wait > 0 && idle != NULL)
+        idle(wait);
+}
@@ -0,0 +1,58 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Max number of tasks one scheduler can hold
+#define SCHEDULER_MAX_TASKS 8
+
+typedef void (*TaskFunction)();
+// Returns the current time in milliseconds (millis() on the boards, a simulated clock on a host)
+typedef uint32_t (*ClockFunction)();
+// Called with the number of ms until the next task is due, should sleep or yield at most that long
+typedef void (*IdleFunction)(uint32_t waitMs);
+
+struct SchedulerTask
+{
+    const char *name;
+    TaskFunction function;
+    uint32_t period;   // ms between runs
+    uint32_t deadline; // allowed start delay before a run counts as missed
+    uint32_t nextRun;
+    uint32_t runs;
+    uint32_t missed;   // runs started later than deadline
+    uint32_t maxLate;  // worst start delay seen (jitter)
+};
+
+/* Small cooperative scheduler replacing delay() based loops.
+    Tasks run to completion in the order they become due. Between runs the idle
+    function gets the time until the next deadline so the CPU can sleep instead of spinning.
+    Has no Arduino dependencies, the clock and idle functions are injected. */
+class Scheduler
+{
+public:
+    Scheduler(ClockFunction clock, IdleFunction idle = NULL);
+
+    // Adds a periodic task, first run is due after startDelayMs (immediately by default).
+    // Returns false if the table is full.
+    bool add(const char *name, TaskFunction function, uint32_t periodMs, uint32_t deadlineMs = 0,
+             uint32_t startDelayMs = 0);
+
+    // Runs every task that is due, returns ms until the next one
+    uint32_t runDue();
+
+    // Runs due tasks and idles until the next deadline. Call from loop().
+    void run();
+
+    size_t size() const { return count; }
+    const SchedulerTask &task(size_t index) const { return tasks[index]; }
+
+private:
+    ClockFunction clock;
+    IdleFunction idle;
+    SchedulerTask tasks[SCHEDULER_MAX_TASKS];
+    size_t count;
+};
+
+#endif
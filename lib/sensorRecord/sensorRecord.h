@@ -0,0 +1,99 @@
+#ifndef SENSORRECORD_H
+#define SENSORRECORD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <batchCodec.h>
+
+// Reading record shared by the Arduino node and the ESP32 gateway.
+// Values are fixed point so one reading takes 8 bytes instead of 12, in the scale of
+// the wire format (batchToFixed / batchFromFixed). The 16-bit node id is not part of
+// the record, it travels next to the readings of a batch (QueuedReading).
+
+struct SensorData
+{
+    int16_t tempCenti;   // temperature in hundredths of a degree C
+    int16_t humCenti;    // relative humidity in hundredths of a percent
+    uint16_t timeOffset; // seconds since the start of the batch
+    uint8_t error : 1;   // reading failed, values are not valid
+    uint8_t flags : 7;   // ChangeFilterMode of a reduced series, 0 for plain samples
+
+    float temperature() const { return batchFromFixed(tempCenti); }
+    float humidity() const { return batchFromFixed(humCenti); }
+};
+
+inline SensorData makeSensorData(float temperature, float humidity, bool error,
+                                 uint16_t timeOffset = 0)
+{
+    SensorData data;
+    data.error = error || isnan(temperature) || isnan(humidity);
+    data.tempCenti = data.error ? 0 : batchToFixed(temperature);
+    data.humCenti = data.error ? 0 : batchToFixed(humidity);
+    data.timeOffset = timeOffset;
+    data.flags = 0;
+    return data;
+}
+
+/* Column-oriented (struct of arrays) batch of readings.
+    Each field is a contiguous array, so statistics and encoders can run over one
+    column without touching the others. */
+template <size_t N>
+class SensorColumns
+{
+public:
+    int16_t tempCenti[N];
+    int16_t humCenti[N];
+    uint16_t timeOffset[N];
+    uint8_t error[N];
+
+    SensorColumns() : count(0) {}
+
+    void clear() { count = 0; }
+    size_t size() const { return count; }
+    bool full() const { return count == N; }
+    static size_t capacity() { return N; }
+
+    bool push(const SensorData &data)
+    {
+        if (count == N)
+            return false;
+        tempCenti[count] = data.tempCenti;
+        humCenti[count] = data.humCenti;
+        timeOffset[count] = data.timeOffset;
+        error[count] = data.error;
+        count++;
+        return true;
+    }
+
+    SensorData at(size_t index) const
+    {
+        SensorData data;
+        data.tempCenti = tempCenti[index];
+        data.humCenti = humCenti[index];
+        data.timeOffset = timeOffset[index];
+        data.error = error[index];
+        data.flags = 0;
+        return data;
+    }
+
+    // Copies the values of readings without error into out (N entries), returns how many
+    size_t validTemperatures(int16_t *out) const { return copyValid(tempCenti, out); }
+    size_t validHumidities(int16_t *out) const { return copyValid(humCenti, out); }
+
+private:
+    size_t copyValid(const int16_t *column, int16_t *out) const
+    {
+        size_t n = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!error[i])
+                out[n++] = column[i];
+        }
+        return n;
+    }
+
+    size_t count;
+};
+
+#endif
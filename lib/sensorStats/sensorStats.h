@@ -0,0 +1,115 @@
+#ifndef SENSORSTATS_H
+#define SENSORSTATS_H
+
+#include <stddef.h>
+#include <math.h>
+#include <algorithm>
+
+// Allocation-free statistics shared by both firmwares.
+// All functions work on caller-provided storage and any arithmetic value type
+// (float, or the int16 fixed-point columns of SensorColumns). Functions taking a non-const
+// array reorder it in place (selection instead of a full sort).
+
+struct StatsSummary
+{
+    size_t count;
+    float min;
+    float max;
+    float mean;
+    float stddev; // population standard deviation
+};
+
+// min, max, mean and standard deviation in a single pass (Welford)
+template <typename T>
+inline StatsSummary statsSummarize(const T *values, size_t n)
+{
+    StatsSummary s = {0, NAN, NAN, NAN, NAN};
+    double mean = 0.0;
+    double m2 = 0.0;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        float v = values[i];
+        if (s.count == 0 || v < s.min)
+            s.min = v;
+        if (s.count == 0 || v > s.max)
+            s.max = v;
+
+        s.count++;
+        double delta = v - mean;
+        mean += delta / s.count;
+        m2 += delta * (v - mean);
+    }
+
+    if (s.count > 0)
+    {
+        s.mean = mean;
+        s.stddev = sqrt(m2 / s.count);
+    }
+    return s;
+}
+
+// Quantile q (0..1) with linear interpolation between order statistics.
+// Expected linear time, reorders values.
+template <typename T>
+inline float statsQuantile(T *values, size_t n, float q)
+{
+    if (n == 0)
+        return NAN;
+    if (q <= 0.0f)
+        return *std::min_element(values, values + n);
+    if (q >= 1.0f)
+        return *std::max_element(values, values + n);
+
+    float pos = q * (n - 1);
+    size_t k = (size_t)pos;
+    float frac = pos - k;
+
+    std::nth_element(values, values + k, values + n);
+    float lo = values[k];
+    if (frac == 0.0f || k + 1 >= n)
+        return lo;
+
+    // Everything after k is >= lo, so the next order statistic is their minimum
+    float hi = *std::min_element(values + k + 1, values + n);
+    return lo + frac * (hi - lo);
+}
+
+// Median, average of the two middle values for an even count. Reorders values.
+template <typename T>
+inline float statsMedian(T *values, size_t n)
+{
+    return statsQuantile(values, n, 0.5f);
+}
+
+// Several quantiles at once. qs must be sorted ascending: every selection only
+// searches the part of the array above the previous one.
+template <typename T>
+inline void statsQuantiles(T *values, size_t n, const float *qs, float *out, size_t count)
+{
+    size_t from = 0; // values[0, from) are all <= values[from, n)
+
+    for (size_t i = 0; i < count; i++)
+    {
+        float q = qs[i] < 0.0f ? 0.0f : (qs[i] > 1.0f ? 1.0f : qs[i]);
+        if (n == 0)
+        {
+            out[i] = NAN;
+            continue;
+        }
+
+        float pos = q * (n - 1);
+        size_t k = (size_t)pos;
+        float frac = pos - k;
+        if (k < from)
+            k = from; // only possible if qs was not sorted
+
+        std::nth_element(values + from, values + k, values + n);
+        from = k;
+
+        float lo = values[k];
+        out[i] = (frac == 0.0f || k + 1 >= n) ? lo : lo + frac * (*std::min_element(values + k + 1, values + n) - lo);
+    }
+}
+
+#endif
@@ -0,0 +1,112 @@
+// Decodes binary log frames (lib/logQueue) from a capture file, a serial port or stdin.
+// Text around the frames (boot messages, direct Serial prints) is passed through.
+//   program [-r] [file]
+//     -r  print frame times as raw ms since boot instead of seconds
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <logQueue.h>
+#include <logMessages.h>
+
+static const LogMessage messages[] = {
+    ESP32_LOG_MESSAGES(LOG_MESSAGE_ENTRY)
+    ARDUINO_LOG_MESSAGES(LOG_MESSAGE_ENTRY)
+};
+
+static bool rawTimes = false;
+static unsigned long framesDecoded = 0;
+static unsigned long framesBroken = 0;
+
+static void printEntry(const LogEntry &entry)
+{
+    char text[256];
+    const char *format = logMessageFormat(messages, sizeof(messages) / sizeof(messages[0]), entry.id);
+    if (format != NULL)
+        logFormat(text, sizeof(text), format, entry.args, entry.argc);
+    else
+        snprintf(text, sizeof(text), "unknown message 0x%04x (%u arguments)", entry.id, entry.argc);
+
+    if (rawTimes)
+        printf("%lu %s %s\n", (unsigned long)entry.time, logLevelName(entry.level), text);
+    else
+        printf("+%lu.%03lus %s %s\n", (unsigned long)entry.time / 1000, (unsigned long)entry.time % 1000,
+               logLevelName(entry.level), text);
+}
+
+// Decodes the frames in buf[0, len), returns how many bytes were consumed.
+// A frame cut off at the end is kept for the next read.
+static size_t decode(const uint8_t *buf, size_t len, bool last)
+{
+    size_t pos = 0;
+    while (pos < len)
+    {
+        if (buf[pos] != LOG_FRAME_MAGIC)
+        {
+            putchar(buf[pos++]);
+            continue;
+        }
+
+        LogEntry entry;
+        int n = logDecodeFrame(buf + pos, len - pos, entry);
+        if (n < 0 && !last)
+            break;
+        if (n <= 0)
+        {
+            // Not a frame after all, or a damaged one: skip the magic byte and resync
+            framesBroken++;
+            pos++;
+            continue;
+        }
+        printEntry(entry);
+        framesDecoded++;
+        pos += n;
+    }
+    return pos;
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "r")) != -1)
+    {
+        if (opt == 'r')
+            rawTimes = true;
+        else
+        {
+            fprintf(stderr, "usage: %s [-r] [file]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    int in = STDIN_FILENO;
+    if (optind < argc)
+    {
+        in = open(argv[optind], O_RDONLY);
+        if (in < 0)
+        {
+            perror(argv[optind]);
+            return 1;
+        }
+    }
+
+    uint8_t buf[4096];
+    size_t len = 0;
+    while (true)
+    {
+        // read() returns what has arrived, so a live serial port is decoded line by line
+        ssize_t got = read(in, buf + len, sizeof(buf) - len);
+        bool last = got <= 0;
+        if (got > 0)
+            len += got;
+        size_t used = decode(buf, len, last);
+        memmove(buf, buf + used, len - used);
+        len -= used;
+        fflush(stdout);
+        if (last)
+            break;
+    }
+
+    fprintf(stderr, "%lu frames decoded, %lu damaged\n", framesDecoded, framesBroken);
+    return 0;
+}
@@ -0,0 +1,310 @@
+// Stand-in backend for the ESP32 upstream forwarder, for tests on a PC.
+// Accepts keep-alive connections with pipelined POST /readings requests, decodes the
+// batch lists (lib/batchCodec) and answers every request in order.
+// Batch numbers are checked the way a backend has to: they wrap every 65536 batches, so
+// they are compared with serial number arithmetic. Numbers skipped (a restart skips the
+// rest of its reserved block) and ones seen again are counted.
+//   program [-p port] [-f fail %] [-d delay ms] [-t seconds] [-v]
+//     -f  answer this share of the requests with 503, the forwarder must keep their readings
+//     -d  hold every response this long, so several requests are in flight at once
+//     -v  print every reading
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <batchCodec.h>
+
+#define STUB_MAX_CONNECTIONS 8
+#define STUB_MAX_BODY 65536
+
+struct Response
+{
+    unsigned long due; // ms on the stub's clock
+    int status;
+};
+
+struct Connection
+{
+    int fd;
+    std::string input;
+    std::vector<Response> responses; // in request order
+    size_t waiting; // requests received and not answered yet
+};
+
+static volatile sig_atomic_t stopRequested = 0;
+static bool verbose = false;
+static int failPercent = 0;
+static unsigned long delayMs = 0;
+
+static unsigned long requests = 0;
+static unsigned long failed = 0;
+static unsigned long rejected = 0;
+static unsigned long readings = 0;
+static unsigned long errors = 0;
+static unsigned long bodyBytes = 0;
+static size_t maxPipelined = 0;
+static bool haveSequence = false;
+static uint16_t lastSequence = 0;
+static unsigned long sequenceSkipped = 0;
+static unsigned long sequenceRepeated = 0;
+static std::map<unsigned, unsigned long> perNode;
+
+static void onSignal(int) { stopRequested = 1; }
+
+static unsigned long nowMs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000;
+}
+
+// Follows the newest batch number across the 16 bit wrap
+static void checkSequence(uint16_t sequence)
+{
+    int16_t ahead = batchSequenceDiff(sequence, lastSequence);
+    if (haveSequence && ahead <= 0)
+    {
+        sequenceRepeated++;
+        return;
+    }
+    if (haveSequence)
+        sequenceSkipped += ahead - 1;
+    lastSequence = sequence;
+    haveSequence = true;
+}
+
+// Decodes one body, returns false if it is not a valid batch list
+static bool decodeBody(const uint8_t *body, size_t length)
+{
+    if (length < BATCH_LIST_HEADER_SIZE || body[0] != BATCH_LIST_MAGIC)
+        return false;
+
+    size_t pos = BATCH_LIST_HEADER_SIZE;
+    for (uint8_t b = 0; b < body[1]; b++)
+    {
+        if (pos + BATCH_LIST_LENGTH_SIZE > length)
+            return false;
+        size_t size = body[pos] | (body[pos + 1] << 8);
+        pos += BATCH_LIST_LENGTH_SIZE;
+        if (pos + size > length)
+            return false;
+
+        BatchDecoder decoder;
+        BatchDecodeResult result = decoder.begin(body + pos, size);
+        if (result != BATCH_OK)
+        {
+            fprintf(stderr, "batch %u: %s\n", b, batchDecodeError(result));
+            return false;
+        }
+        const BatchHeader &header = decoder.header();
+        checkSequence(header.sequence);
+        BatchReading reading;
+        while (decoder.next(reading))
+        {
+            readings++;
+            perNode[header.nodeId]++;
+            if (reading.error)
+                errors++;
+            if (!verbose)
+                continue;
+            unsigned long time = header.flags & BATCH_FLAG_EPOCH ? header.epoch + reading.timeOffset : 0;
+            // Kept points of a reduced series, the samples between them are held or interpolated
+            const char *series = header.flags & BATCH_FLAG_LINEAR ? "  linear" : header.flags & BATCH_FLAG_HOLD ? "  hold" : "";
+            if (reading.error)
+                printf("node %5u  %10lu  error%s\n", header.nodeId, time, series);
+            else
+                printf("node %5u  %10lu  %6.2f C %6.2f %%%s\n", header.nodeId, time, batchFromFixed(reading.temperature),
+                       batchFromFixed(reading.humidity), series);
+        }
+        if (decoder.corrupt())
+            return false;
+        pos += size;
+    }
+    return pos == length;
+}
+
+// Takes every complete request out of the input, the rest waits for more bytes
+static bool parseRequests(Connection &c)
+{
+    while (true)
+    {
+        size_t end = c.input.find("\r\n\r\n");
+        if (end == std::string::npos)
+            return c.input.size() < 4096;
+
+        std::string head = c.input.substr(0, end);
+        long length = 0;
+        for (size_t line = head.find("\r\n"); line != std::string::npos; line = head.find("\r\n", line + 2))
+        {
+            if (strncasecmp(head.c_str() + line + 2, "Content-Length:", 15) == 0)
+                length = atol(head.c_str() + line + 2 + 15);
+        }
+        if (length < 0 || length > STUB_MAX_BODY)
+            return false;
+        if (c.input.size() < end + 4 + length)
+            return true;
+
+        const uint8_t *body = (const uint8_t *)c.input.data() + end + 4;
+        int status;
+        requests++;
+        bodyBytes += length;
+        if (head.compare(0, 15, "POST /readings ") != 0 || !decodeBody(body, length))
+        {
+            status = 400;
+            rejected++;
+        }
+        else if (rand() % 100 < failPercent)
+        {
+            status = 503;
+            failed++;
+        }
+        else
+        {
+            status = 200;
+        }
+        c.responses.push_back({nowMs() + delayMs, status});
+        c.waiting++;
+        if (c.waiting > maxPipelined)
+            maxPipelined = c.waiting;
+        c.input.erase(0, end + 4 + length);
+    }
+}
+
+// Writes the responses that are due, in request order
+static void answer(Connection &c)
+{
+    unsigned long now = nowMs();
+    size_t n = 0;
+    for (; n < c.responses.size() && (long)(now - c.responses[n].due) >= 0; n++)
+    {
+        int status = c.responses[n].status;
+        const char *reason = status == 200 ? "OK" : status == 503 ? "Service Unavailable" : "Bad Request";
+        char text[128];
+        int length = snprintf(text, sizeof(text), "HTTP/1.1 %d %s\r\nContent-Length: 0\r\nConnection: keep-alive\r\n\r\n",
+                              status, reason);
+        if (send(c.fd, text, length, MSG_NOSIGNAL) != length)
+            break;
+        c.waiting--;
+    }
+    c.responses.erase(c.responses.begin(), c.responses.begin() + n);
+}
+
+static void report(unsigned long start)
+{
+    printf("%6.1fs  requests %6lu  readings %8lu (%lu errors)  %.1f B/reading  503 %4lu  400 %4lu  pipelined %zu  nodes %zu"
+           "  sequence %u (%lu skipped, %lu repeated)\n",
+           (nowMs() - start) / 1000.0, requests, readings, errors, readings ? (double)bodyBytes / readings : 0.0, failed,
+           rejected, maxPipelined, perNode.size(), lastSequence, sequenceSkipped, sequenceRepeated);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    int port = 8090;
+    unsigned long runSeconds = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:f:d:t:v")) != -1)
+    {
+        if (opt == 'p')
+            port = atoi(optarg);
+        else if (opt == 'f')
+            failPercent = atoi(optarg);
+        else if (opt == 'd')
+            delayMs = strtoul(optarg, NULL, 10);
+        else if (opt == 't')
+            runSeconds = strtoul(optarg, NULL, 10);
+        else if (opt == 'v')
+            verbose = true;
+        else
+        {
+            fprintf(stderr, "usage: %s [-p port] [-f fail %%] [-d delay ms] [-t seconds] [-v]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 4) != 0)
+    {
+        perror("listen");
+        return 1;
+    }
+    printf("Upstream stub listening on port %d\n", port);
+
+    std::vector<Connection> connections;
+    unsigned long start = nowMs();
+    unsigned long lastReport = start;
+    while (!stopRequested && (runSeconds == 0 || nowMs() - start < runSeconds * 1000))
+    {
+        std::vector<pollfd> fds;
+        fds.push_back({listener, POLLIN, 0});
+        for (const Connection &c : connections)
+            fds.push_back({c.fd, POLLIN, 0});
+        // Wake up in time for held responses
+        poll(fds.data(), fds.size(), delayMs > 0 ? 5 : 100);
+
+        if ((fds[0].revents & POLLIN) && connections.size() < STUB_MAX_CONNECTIONS)
+        {
+            int fd = accept(listener, NULL, NULL);
+            if (fd >= 0)
+                connections.push_back({fd, std::string(), std::vector<Response>(), 0});
+        }
+
+        for (size_t i = 0; i < connections.size();)
+        {
+            Connection &c = connections[i];
+            bool open = true;
+            if (i + 1 < fds.size() && fds[i + 1].fd == c.fd && (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+            {
+                char buffer[4096];
+                ssize_t n = recv(c.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+                if (n > 0)
+                {
+                    c.input.append(buffer, n);
+                    open = parseRequests(c);
+                }
+                else if (n == 0)
+                {
+                    open = false;
+                }
+            }
+            if (open)
+                answer(c);
+            if (!open)
+            {
+                close(c.fd);
+                connections.erase(connections.begin() + i);
+                continue;
+            }
+            i++;
+        }
+
+        if (nowMs() - lastReport >= 5000)
+        {
+            report(start);
+            lastReport = nowMs();
+        }
+    }
+
+    report(start);
+    for (const auto &node : perNode)
+        printf("node %5u: %8lu readings\n", node.first, node.second);
+    return 0;
+}